@@ -34,7 +34,12 @@ static std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct LRUCacheOptions, high_pri_pool_ratio),
           OptionType::kDouble, OptionVerificationType::kNormal,
           OptionTypeFlags::kMutable,
-          offsetof(struct LRUCacheOptions, high_pri_pool_ratio)}}};
+          offsetof(struct LRUCacheOptions, high_pri_pool_ratio)}},
+        {"use_admission_filter",
+         {offsetof(struct LRUCacheOptions, use_admission_filter),
+          OptionType::kBoolean, OptionVerificationType::kNormal,
+          OptionTypeFlags::kMutable,
+          offsetof(struct LRUCacheOptions, use_admission_filter)}}};
 #endif  // ROCKSDB_LITE
 
 Status Cache::CreateFromString(const ConfigOptions& config_options,
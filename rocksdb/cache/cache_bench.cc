@@ -57,6 +57,9 @@ DEFINE_uint32(erase_percent, 1,
               "Ratio of erase to total workload (expressed as a percentage)");
 
 DEFINE_bool(use_clock_cache, false, "");
+DEFINE_bool(use_hyper_clock_cache, false,
+            "Use HyperClockCache, whose lookups take no lock. Its tables are "
+            "sized for entries of value_bytes.");
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -183,7 +186,14 @@ class CacheBench {
       fprintf(stderr, "Percentages must add to 100.\n");
       exit(1);
     }
-    if (FLAGS_use_clock_cache) {
+    if (FLAGS_use_hyper_clock_cache) {
+      cache_ = NewHyperClockCache(HyperClockCacheOptions(
+          FLAGS_cache_size, FLAGS_value_bytes, FLAGS_num_shard_bits));
+      if (!cache_) {
+        fprintf(stderr, "Invalid hyper clock cache options.\n");
+        exit(1);
+      }
+    } else if (FLAGS_use_clock_cache) {
       cache_ = NewClockCache(FLAGS_cache_size, FLAGS_num_shard_bits);
       if (!cache_) {
         fprintf(stderr, "Clock cache not supported.\n");
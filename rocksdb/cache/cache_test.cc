@@ -15,6 +15,7 @@
 #include <string>
 #include <vector>
 #include "cache/clock_cache.h"
+#include "cache/hyper_clock_cache.h"
 #include "cache/lru_cache.h"
 #include "test_util/testharness.h"
 #include "util/coding.h"
@@ -39,6 +40,7 @@ static int DecodeValue(void* v) {
 
 const std::string kLRU = "lru";
 const std::string kClock = "clock";
+const std::string kHyperClock = "hyper_clock";
 
 void dumbDeleter(const Slice& /*key*/, void* /*value*/) {}
 
@@ -83,6 +85,9 @@ class CacheTest : public testing::TestWithParam<std::string> {
     if (type == kClock) {
       return NewClockCache(capacity);
     }
+    if (type == kHyperClock) {
+      return NewHyperClockCache(HyperClockCacheOptions(capacity, 8 * 1024));
+    }
     return nullptr;
   }
 
@@ -103,6 +108,13 @@ class CacheTest : public testing::TestWithParam<std::string> {
       return NewClockCache(capacity, num_shard_bits, strict_capacity_limit,
                            charge_policy);
     }
+    if (type == kHyperClock) {
+      return NewHyperClockCache(
+          HyperClockCacheOptions(capacity, 1 /* estimated_entry_charge */,
+                                 num_shard_bits, strict_capacity_limit,
+                                 nullptr /* memory_allocator */,
+                                 charge_policy));
+    }
     return nullptr;
   }
 
@@ -148,10 +160,16 @@ class CacheTest : public testing::TestWithParam<std::string> {
   void Erase2(int key) {
     Erase(cache2_, key);
   }
+
+  // How many times more inserts than with LRU it takes to evict an entry.
+  // A HyperClockCache entry survives a sweep of the clock per unit of
+  // countdown, which hits refresh.
+  int EvictionChurnFactor() const { return GetParam() == kHyperClock ? 4 : 1; }
 };
 CacheTest* CacheTest::current_;
 
 class LRUCacheTest : public CacheTest {};
+class HyperClockCacheTest : public CacheTest {};
 
 TEST_P(CacheTest, UsageTest) {
   // cache is std::shared_ptr and will be automatically cleaned up.
@@ -367,7 +385,7 @@ TEST_P(CacheTest, EvictionPolicy) {
   Insert(200, 201);
 
   // Frequently used entry must be kept around
-  for (int i = 0; i < kCacheSize * 2; i++) {
+  for (int i = 0; i < kCacheSize * 2 * EvictionChurnFactor(); i++) {
     Insert(1000+i, 2000+i);
     ASSERT_EQ(101, Lookup(100));
   }
@@ -391,7 +409,7 @@ TEST_P(CacheTest, ExternalRefPinsEntries) {
     }
     // double cache size because the usage bit in block cache prevents 100 from
     // being evicted in the first kCacheSize iterations
-    for (int j = 0; j < 2 * kCacheSize + 100; j++) {
+    for (int j = 0; j < (2 * kCacheSize + 100) * EvictionChurnFactor(); j++) {
       Insert(1000 + j, 2000 + j);
     }
     if (i < 2) {
@@ -420,7 +438,7 @@ TEST_P(CacheTest, EvictionPolicyRef) {
   Insert(303, 104);
 
   // Insert entries much more than Cache capacity
-  for (int i = 0; i < kCacheSize * 2; i++) {
+  for (int i = 0; i < kCacheSize * 2 * EvictionChurnFactor(); i++) {
     Insert(1000 + i, 2000 + i);
   }
 
@@ -757,15 +775,94 @@ TEST_P(CacheTest, GetCharge) {
   cache_->Release(h1);
 }
 
+TEST_P(HyperClockCacheTest, TableFullOfReferencedEntries) {
+  // One shard whose table is sized for a single entry, so that it has the
+  // minimum length
+  std::shared_ptr<Cache> cache = NewHyperClockCache(HyperClockCacheOptions(
+      1000, 1000 /* estimated_entry_charge */, 0, false,
+      nullptr /* memory_allocator */, kDontChargeCacheMetadata));
+  auto shard = static_cast<HyperClockCacheShard*>(
+      static_cast<ShardedCache*>(cache.get())->GetShard(0));
+  const size_t n = shard->TEST_GetTableLength();
+  std::vector<Cache::Handle*> handles(n);
+
+  // Insert more entries than the table can hold, but not releasing. The ones
+  // that find no slot are still returned, but cannot be looked up.
+  size_t found = 0;
+  for (size_t i = 0; i < n; i++) {
+    std::string key = ToString(i + 1);
+    ASSERT_OK(cache->Insert(key, new Value(i + 1), 1, &deleter, &handles[i]));
+    ASSERT_NE(nullptr, handles[i]);
+    ASSERT_EQ(i + 1, static_cast<Value*>(cache->Value(handles[i]))->v_);
+    auto h = cache->Lookup(key);
+    if (h != nullptr) {
+      ASSERT_EQ(handles[i], h);
+      cache->Release(h);
+      found++;
+    }
+  }
+  ASSERT_LT(found, n);
+  ASSERT_EQ(n, cache->GetUsage());
+  ASSERT_EQ(n, cache->GetPinnedUsage());
+
+  for (size_t i = 0; i < n; i++) {
+    cache->Release(handles[i]);
+  }
+  ASSERT_EQ(found, cache->GetUsage());
+  ASSERT_EQ(0, cache->GetPinnedUsage());
+
+  // Once released, the entries in the table make room for new ones
+  Cache::Handle* handle;
+  ASSERT_OK(cache->Insert("extra", new Value(0), 1, &deleter, &handle));
+  ASSERT_EQ(handle, cache->Lookup("extra"));
+  cache->Release(handle);
+  cache->Release(handle);
+}
+
+TEST_P(HyperClockCacheTest, ConcurrentLookup) {
+  std::shared_ptr<Cache> cache = NewCache(1000, 0, false);
+  const int kNumKeys = 100;
+  for (int i = 0; i < kNumKeys; i++) {
+    Insert(cache, i, i);
+  }
+
+  // Lookups race with each other and with the Inserts that overwrite and
+  // evict the entries they look up
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < 10000; i++) {
+        const int key = (i * 7 + t) % (2 * kNumKeys);
+        if (t == 0 && i % 10 == 0) {
+          Insert(cache, key, key, 10);
+        }
+        Cache::Handle* h = cache->Lookup(EncodeKey(key));
+        if (h != nullptr) {
+          EXPECT_EQ(key, DecodeValue(cache->Value(h)));
+          cache->Release(h);
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_EQ(0, cache->GetPinnedUsage());
+  ASSERT_LE(cache->GetUsage(), 1000U);
+}
+
 #ifdef SUPPORT_CLOCK_CACHE
 std::shared_ptr<Cache> (*new_clock_cache_func)(
     size_t, int, bool, CacheMetadataChargePolicy) = NewClockCache;
 INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest,
-                        testing::Values(kLRU, kClock));
+                        testing::Values(kLRU, kClock, kHyperClock));
 #else
-INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest, testing::Values(kLRU));
+INSTANTIATE_TEST_CASE_P(CacheTestInstance, CacheTest,
+                        testing::Values(kLRU, kHyperClock));
 #endif  // SUPPORT_CLOCK_CACHE
 INSTANTIATE_TEST_CASE_P(CacheTestInstance, LRUCacheTest, testing::Values(kLRU));
+INSTANTIATE_TEST_CASE_P(CacheTestInstance, HyperClockCacheTest,
+                        testing::Values(kHyperClock));
 
 }  // namespace ROCKSDB_NAMESPACE
 
@@ -0,0 +1,83 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "cache/frequency_sketch.h"
+
+#include <algorithm>
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+// Multipliers deriving the counters of a hash, one per counter
+const uint64_t kSeeds[] = {0xc3a5c85c97cb3127ull, 0xb492b66fbe98f273ull,
+                           0x9ae16a3b2f90404full, 0xcbf29ce484222325ull};
+const uint64_t kCounterMax = 15;
+// The low three bits of every counter
+const uint64_t kAgeMask = 0x7777777777777777ull;
+}  // namespace
+
+const int FrequencySketch::kDepth;
+const size_t FrequencySketch::kCountersPerWord;
+const size_t FrequencySketch::kMinCapacity;
+
+FrequencySketch::FrequencySketch()
+    : counter_mask_(0), samples_(0), sample_limit_(0) {
+  EnsureCapacity(kMinCapacity);
+}
+
+void FrequencySketch::EnsureCapacity(size_t num_entries) {
+  num_entries = std::max(num_entries, kMinCapacity);
+  size_t num_counters = kCountersPerWord;
+  while (num_counters < num_entries * kDepth) {
+    num_counters *= 2;
+  }
+  if (num_counters / kCountersPerWord <= table_.size()) {
+    return;
+  }
+  table_.assign(num_counters / kCountersPerWord, 0);
+  counter_mask_ = num_counters - 1;
+  samples_ = 0;
+  sample_limit_ = 10 * capacity();
+}
+
+size_t FrequencySketch::CounterIndex(uint32_t hash, int i) const {
+  return static_cast<size_t>((hash * kSeeds[i]) >> 32) & counter_mask_;
+}
+
+void FrequencySketch::Increment(uint32_t hash) {
+  bool added = false;
+  for (int i = 0; i < kDepth; i++) {
+    const size_t index = CounterIndex(hash, i);
+    uint64_t& word = table_[index / kCountersPerWord];
+    const int shift = static_cast<int>(index % kCountersPerWord) * 4;
+    if (((word >> shift) & kCounterMax) < kCounterMax) {
+      word += uint64_t{1} << shift;
+      added = true;
+    }
+  }
+  if (added && ++samples_ >= sample_limit_) {
+    Age();
+  }
+}
+
+uint32_t FrequencySketch::Frequency(uint32_t hash) const {
+  uint64_t frequency = kCounterMax;
+  for (int i = 0; i < kDepth; i++) {
+    const size_t index = CounterIndex(hash, i);
+    const uint64_t word = table_[index / kCountersPerWord];
+    const int shift = static_cast<int>(index % kCountersPerWord) * 4;
+    frequency = std::min(frequency, (word >> shift) & kCounterMax);
+  }
+  return static_cast<uint32_t>(frequency);
+}
+
+void FrequencySketch::Age() {
+  for (auto& word : table_) {
+    word = (word >> 1) & kAgeMask;
+  }
+  samples_ /= 2;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,63 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "rocksdb/rocksdb_namespace.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// A count-min sketch estimating how often each key hash was recorded
+// recently, for the TinyLFU admission policy of a cache.
+//
+// Each hash maps to kDepth 4-bit counters, and its frequency is the smallest
+// of them, so collisions can only overestimate it. Counters saturate at 15.
+// Once the number of recorded accesses reaches ten times the number of
+// entries the sketch is sized for, every counter is halved, so that the
+// estimates favor recent accesses.
+//
+// Not thread-safe.
+class FrequencySketch {
+ public:
+  FrequencySketch();
+
+  // Grows the sketch to hold counters for about num_entries keys. A resized
+  // sketch starts over empty. Shrinking is a no-op.
+  void EnsureCapacity(size_t num_entries);
+
+  // Records an access to hash
+  void Increment(uint32_t hash);
+
+  // Returns the estimated number of recent accesses to hash, at most 15
+  uint32_t Frequency(uint32_t hash) const;
+
+  // The number of entries the sketch is sized for
+  size_t capacity() const { return table_.size() * kCountersPerWord / kDepth; }
+
+ private:
+  static const int kDepth = 4;
+  static const size_t kCountersPerWord = 16;
+  static const size_t kMinCapacity = 64;
+
+  // Returns the index of the i-th counter of hash
+  size_t CounterIndex(uint32_t hash, int i) const;
+
+  // Halves every counter
+  void Age();
+
+  // 16 4-bit counters per word; the number of words is a power of two
+  std::vector<uint64_t> table_;
+  size_t counter_mask_;
+  // Recorded accesses since the last aging, and the number that triggers it
+  size_t samples_;
+  size_t sample_limit_;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
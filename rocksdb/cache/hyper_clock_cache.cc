@@ -0,0 +1,610 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+
+#include "cache/hyper_clock_cache.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cinttypes>
+#include <string>
+
+#include "util/mutexlock.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// Layout of ClockHandle::meta: the number of external references in the low
+// bits, then the CLOCK countdown, then the state.
+const uint64_t kRefsBits = 30;
+const uint64_t kOneRef = 1;
+const uint64_t kRefsMask = (uint64_t{1} << kRefsBits) - 1;
+const int kCountdownShift = static_cast<int>(kRefsBits);
+const uint64_t kOneCountdown = uint64_t{1} << kCountdownShift;
+const uint64_t kMaxCountdown = 3;
+const uint64_t kCountdownMask = kMaxCountdown << kCountdownShift;
+const int kStateShift = 32;
+
+enum ClockState : uint64_t {
+  kStateEmpty = 0,
+  kStateConstruction = 1,
+  kStateVisible = 2,
+  kStateInvisible = 3,
+};
+
+inline ClockState GetState(uint64_t meta) {
+  return static_cast<ClockState>(meta >> kStateShift);
+}
+
+inline uint64_t GetRefs(uint64_t meta) { return meta & kRefsMask; }
+
+inline uint64_t GetCountdown(uint64_t meta) {
+  return (meta & kCountdownMask) >> kCountdownShift;
+}
+
+inline uint64_t MakeMeta(ClockState state, uint64_t refs, uint64_t countdown) {
+  return (static_cast<uint64_t>(state) << kStateShift) |
+         (countdown << kCountdownShift) | refs;
+}
+
+// The table is sized for the expected number of entries at kLoadFactor, and
+// never filled beyond kStrictLoadFactor.
+const double kLoadFactor = 0.7;
+const double kStrictLoadFactor = 0.84;
+const int kMinLengthBits = 6;
+const int kMaxLengthBits = 30;
+
+int CalcLengthBits(size_t capacity, size_t estimated_entry_charge) {
+  double num_slots = static_cast<double>(capacity) /
+                     static_cast<double>(estimated_entry_charge) / kLoadFactor;
+  int length_bits = kMinLengthBits;
+  while (length_bits < kMaxLengthBits &&
+         static_cast<double>(uint64_t{1} << length_bits) < num_slots) {
+    length_bits++;
+  }
+  return length_bits;
+}
+
+// Initial countdown of a new entry: the number of sweeps it survives
+// without being looked up.
+uint64_t InitialCountdown(Cache::Priority priority) {
+  return priority == Cache::Priority::HIGH ? kMaxCountdown : 1;
+}
+
+}  // namespace
+
+void HyperClockCacheShard::FreedEntry::Free() {
+  if (deleter != nullptr) {
+    (*deleter)(Slice(key_data, key_length), value);
+  }
+  delete[] key_data;
+}
+
+HyperClockCacheShard::HyperClockCacheShard(
+    size_t capacity, size_t estimated_entry_charge, bool strict_capacity_limit,
+    CacheMetadataChargePolicy metadata_charge_policy)
+    : length_mask_(static_cast<uint32_t>(
+          (uint64_t{1} << CalcLengthBits(capacity, estimated_entry_charge)) -
+          1)),
+      occupancy_limit_(static_cast<uint32_t>((length_mask_ + 1.0) *
+                                             kStrictLoadFactor)),
+      estimated_entry_charge_(estimated_entry_charge),
+      table_(new ClockHandle[length_mask_ + 1]),
+      capacity_(capacity),
+      strict_capacity_limit_(strict_capacity_limit),
+      clock_pointer_(0),
+      occupancy_(0),
+      usage_(0),
+      pinned_usage_(0) {
+  set_metadata_charge_policy(metadata_charge_policy);
+}
+
+HyperClockCacheShard::~HyperClockCacheShard() {
+  for (uint32_t i = 0; i <= length_mask_; i++) {
+    ClockHandle* h = &table_[i];
+    if (GetState(h->meta.load(std::memory_order_relaxed)) != kStateEmpty) {
+      assert(GetRefs(h->meta.load(std::memory_order_relaxed)) == 0);
+      FreedEntry{h->value, h->deleter, h->key_data, h->key_length}.Free();
+    }
+  }
+}
+
+uint32_t HyperClockCacheShard::ProbeIncrement(uint32_t hash) {
+  // Other bits of the hash than the ones picking the first slot
+  return static_cast<uint32_t>(
+             (static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull) >> 32) |
+         1;
+}
+
+ClockHandle* HyperClockCacheShard::FindLocked(const Slice& key,
+                                              uint32_t hash) {
+  mutex_.AssertHeld();
+  const uint32_t increment = ProbeIncrement(hash);
+  uint32_t index = hash & length_mask_;
+  for (uint32_t probes = 0; probes <= length_mask_; probes++) {
+    ClockHandle* h = &table_[index];
+    // The fields of a Visible entry only change after it is removed, which
+    // takes mutex_.
+    if (GetState(h->meta.load(std::memory_order_acquire)) == kStateVisible &&
+        h->hash.load(std::memory_order_relaxed) == hash && h->key() == key) {
+      return h;
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + increment) & length_mask_;
+  }
+  return nullptr;
+}
+
+ClockHandle* HyperClockCacheShard::ClaimSlotLocked(uint32_t hash) {
+  mutex_.AssertHeld();
+  if (occupancy_ >= occupancy_limit_) {
+    return nullptr;
+  }
+  const uint32_t increment = ProbeIncrement(hash);
+  uint32_t index = hash & length_mask_;
+  for (uint32_t probes = 0; probes <= length_mask_; probes++) {
+    ClockHandle* h = &table_[index];
+    // Only the holder of mutex_ fills Empty slots
+    if (GetState(h->meta.load(std::memory_order_acquire)) == kStateEmpty) {
+      occupancy_++;
+      return h;
+    }
+    h->displacements.fetch_add(1, std::memory_order_relaxed);
+    index = (index + increment) & length_mask_;
+  }
+  // Cannot happen below occupancy_limit_
+  assert(false);
+  return nullptr;
+}
+
+void HyperClockCacheShard::RemoveLocked(ClockHandle* h,
+                                        autovector<FreedEntry>* freed) {
+  mutex_.AssertHeld();
+  assert(GetState(h->meta.load(std::memory_order_relaxed)) ==
+         kStateConstruction);
+  const uint32_t hash = h->hash.load(std::memory_order_relaxed);
+  const uint32_t increment = ProbeIncrement(hash);
+  uint32_t index = hash & length_mask_;
+  while (&table_[index] != h) {
+    table_[index].displacements.fetch_sub(1, std::memory_order_relaxed);
+    index = (index + increment) & length_mask_;
+  }
+  const size_t total_charge = h->CalcTotalCharge(metadata_charge_policy_);
+  assert(usage_.load(std::memory_order_relaxed) >= total_charge);
+  usage_.fetch_sub(total_charge, std::memory_order_relaxed);
+  freed->push_back(FreedEntry{h->value, h->deleter, h->key_data,
+                              h->key_length});
+  h->key_data = nullptr;
+  h->key_length = 0;
+  assert(occupancy_ > 0);
+  occupancy_--;
+  h->meta.store(MakeMeta(kStateEmpty, 0, 0), std::memory_order_release);
+}
+
+void HyperClockCacheShard::EraseLocked(ClockHandle* h,
+                                       autovector<FreedEntry>* freed) {
+  mutex_.AssertHeld();
+  uint64_t meta = h->meta.load(std::memory_order_acquire);
+  while (GetState(meta) == kStateVisible) {
+    if (GetRefs(meta) == 0) {
+      if (h->meta.compare_exchange_weak(
+              meta, MakeMeta(kStateConstruction, 0, 0),
+              std::memory_order_acq_rel, std::memory_order_acquire)) {
+        RemoveLocked(h, freed);
+        return;
+      }
+    } else if (h->meta.compare_exchange_weak(
+                   meta,
+                   MakeMeta(kStateInvisible, GetRefs(meta),
+                            GetCountdown(meta)),
+                   std::memory_order_acq_rel, std::memory_order_acquire)) {
+      // The Release() of the last reference frees it
+      return;
+    }
+  }
+}
+
+void HyperClockCacheShard::EvictLocked(size_t charge,
+                                       autovector<FreedEntry>* freed) {
+  mutex_.AssertHeld();
+  // Every unreferenced entry runs out of countdown within this many sweeps
+  const uint64_t max_steps = (uint64_t{length_mask_} + 1) * (kMaxCountdown + 1);
+  for (uint64_t steps = 0;
+       steps < max_steps &&
+       (usage_.load(std::memory_order_relaxed) + charge >
+            capacity_.load(std::memory_order_relaxed) ||
+        occupancy_ >= occupancy_limit_);
+       steps++) {
+    ClockHandle* h = &table_[clock_pointer_];
+    clock_pointer_ = (clock_pointer_ + 1) & length_mask_;
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    while (GetState(meta) == kStateVisible && GetRefs(meta) == 0) {
+      if (GetCountdown(meta) > 0) {
+        if (h->meta.compare_exchange_weak(meta, meta - kOneCountdown,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+          break;
+        }
+      } else if (h->meta.compare_exchange_weak(
+                     meta, MakeMeta(kStateConstruction, 0, 0),
+                     std::memory_order_acq_rel, std::memory_order_acquire)) {
+        RemoveLocked(h, freed);
+        break;
+      }
+    }
+  }
+}
+
+void HyperClockCacheShard::SetCapacity(size_t capacity) {
+  autovector<FreedEntry> freed;
+  {
+    MutexLock l(&mutex_);
+    capacity_.store(capacity, std::memory_order_relaxed);
+    EvictLocked(0, &freed);
+  }
+  // Free the entries outside of mutex for performance reasons
+  for (auto& entry : freed) {
+    entry.Free();
+  }
+}
+
+void HyperClockCacheShard::SetStrictCapacityLimit(bool strict_capacity_limit) {
+  MutexLock l(&mutex_);
+  strict_capacity_limit_ = strict_capacity_limit;
+}
+
+Cache::Handle* HyperClockCacheShard::Lookup(const Slice& key, uint32_t hash) {
+  const uint32_t increment = ProbeIncrement(hash);
+  uint32_t index = hash & length_mask_;
+  for (uint32_t probes = 0; probes <= length_mask_; probes++) {
+    ClockHandle* h = &table_[index];
+    uint64_t meta = h->meta.load(std::memory_order_acquire);
+    if (GetState(meta) == kStateVisible &&
+        h->hash.load(std::memory_order_relaxed) == hash) {
+      // Take a reference and refresh the countdown at once, as long as the
+      // entry stays Visible. Its fields are stable while referenced.
+      while (GetState(meta) == kStateVisible) {
+        if (h->meta.compare_exchange_weak(meta,
+                                          (meta + kOneRef) | kCountdownMask,
+                                          std::memory_order_acq_rel,
+                                          std::memory_order_acquire)) {
+          if (GetRefs(meta) == 0) {
+            pinned_usage_.fetch_add(h->CalcTotalCharge(metadata_charge_policy_),
+                                    std::memory_order_relaxed);
+          }
+          auto handle = reinterpret_cast<Cache::Handle*>(h);
+          if (h->key() == key) {
+            return handle;
+          }
+          // The slot was refilled since its hash was read
+          Release(handle);
+          break;
+        }
+      }
+    }
+    if (h->displacements.load(std::memory_order_relaxed) == 0) {
+      break;
+    }
+    index = (index + increment) & length_mask_;
+  }
+  return nullptr;
+}
+
+bool HyperClockCacheShard::Ref(Cache::Handle* h) {
+  ClockHandle* handle = reinterpret_cast<ClockHandle*>(h);
+  // The caller holds a reference, so the entry cannot go away meanwhile
+  assert(GetRefs(handle->meta.load(std::memory_order_relaxed)) > 0);
+  handle->meta.fetch_add(kOneRef, std::memory_order_relaxed);
+  return true;
+}
+
+bool HyperClockCacheShard::Release(Cache::Handle* handle, bool force_erase) {
+  if (handle == nullptr) {
+    return false;
+  }
+  ClockHandle* h = reinterpret_cast<ClockHandle*>(handle);
+  const size_t total_charge = h->CalcTotalCharge(metadata_charge_policy_);
+  uint64_t meta = h->meta.load(std::memory_order_acquire);
+  for (;;) {
+    assert(GetRefs(meta) > 0);
+    const bool take = GetRefs(meta) == 1 &&
+                      (GetState(meta) == kStateInvisible || force_erase ||
+                       usage_.load(std::memory_order_relaxed) >
+                           capacity_.load(std::memory_order_relaxed));
+    if (!take) {
+      if (h->meta.compare_exchange_weak(meta, meta - kOneRef,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+        if (GetRefs(meta) == 1) {
+          pinned_usage_.fetch_sub(total_charge, std::memory_order_relaxed);
+        }
+        return false;
+      }
+    } else if (h->meta.compare_exchange_weak(
+                   meta, MakeMeta(kStateConstruction, 0, 0),
+                   std::memory_order_acq_rel, std::memory_order_acquire)) {
+      // Dropped the last reference and took the entry in one step
+      break;
+    }
+  }
+  pinned_usage_.fetch_sub(total_charge, std::memory_order_relaxed);
+
+  if (h->detached) {
+    usage_.fetch_sub(total_charge, std::memory_order_relaxed);
+    FreedEntry{h->value, h->deleter, h->key_data, h->key_length}.Free();
+    delete h;
+    return true;
+  }
+  autovector<FreedEntry> freed;
+  {
+    MutexLock l(&mutex_);
+    RemoveLocked(h, &freed);
+  }
+  // Free the entry here outside of mutex for performance reasons
+  for (auto& entry : freed) {
+    entry.Free();
+  }
+  return true;
+}
+
+Status HyperClockCacheShard::Insert(
+    const Slice& key, uint32_t hash, void* value, size_t charge,
+    void (*deleter)(const Slice& key, void* value), Cache::Handle** handle,
+    Cache::Priority priority) {
+  // Copy the key here outside of the mutex
+  char* key_data = new char[key.size()];
+  memcpy(key_data, key.data(), key.size());
+  ClockHandle tmp;
+  tmp.charge = charge;
+  tmp.key_length = key.size();
+  const size_t total_charge = tmp.CalcTotalCharge(metadata_charge_policy_);
+  const uint64_t refs = handle == nullptr ? 0 : 1;
+  const uint64_t countdown = InitialCountdown(priority);
+  Status s = Status::OK();
+  autovector<FreedEntry> freed;
+
+  {
+    MutexLock l(&mutex_);
+
+    EvictLocked(total_charge, &freed);
+
+    ClockHandle* h = nullptr;
+    if ((usage_.load(std::memory_order_relaxed) + total_charge) >
+            capacity_.load(std::memory_order_relaxed) &&
+        (strict_capacity_limit_ || handle == nullptr)) {
+      if (handle == nullptr) {
+        // Don't insert the entry but still return ok, as if the entry inserted
+        // into cache and get evicted immediately.
+        freed.push_back(FreedEntry{value, deleter, key_data, key.size()});
+      } else {
+        delete[] key_data;
+        *handle = nullptr;
+        s = Status::Incomplete("Insert failed due to CLOCK cache being full.");
+      }
+    } else {
+      // Insert into the cache. Note that the cache might get larger than its
+      // capacity if not enough space was freed up.
+      ClockHandle* old = FindLocked(key, hash);
+      if (old != nullptr) {
+        s = Status::OkOverwritten();
+        EraseLocked(old, &freed);
+      }
+      h = ClaimSlotLocked(hash);
+      if (h == nullptr) {
+        // The table is full of referenced entries
+        if (handle == nullptr) {
+          freed.push_back(FreedEntry{value, deleter, key_data, key.size()});
+        } else {
+          h = new ClockHandle();
+          h->detached = true;
+        }
+      }
+    }
+    if (h != nullptr) {
+      h->value = value;
+      h->deleter = deleter;
+      h->key_data = key_data;
+      h->key_length = key.size();
+      h->charge = charge;
+      h->hash.store(hash, std::memory_order_relaxed);
+      usage_.fetch_add(total_charge, std::memory_order_relaxed);
+      if (refs > 0) {
+        pinned_usage_.fetch_add(total_charge, std::memory_order_relaxed);
+        *handle = reinterpret_cast<Cache::Handle*>(h);
+      }
+      // Publish the entry
+      h->meta.store(
+          MakeMeta(h->detached ? kStateInvisible : kStateVisible, refs,
+                   countdown),
+          std::memory_order_release);
+    }
+  }
+
+  // Free the entries here outside of mutex for performance reasons
+  for (auto& entry : freed) {
+    entry.Free();
+  }
+
+  return s;
+}
+
+void HyperClockCacheShard::Erase(const Slice& key, uint32_t hash) {
+  autovector<FreedEntry> freed;
+  {
+    MutexLock l(&mutex_);
+    ClockHandle* h = FindLocked(key, hash);
+    if (h != nullptr) {
+      EraseLocked(h, &freed);
+    }
+  }
+  // Free the entry here outside of mutex for performance reasons
+  for (auto& entry : freed) {
+    entry.Free();
+  }
+}
+
+size_t HyperClockCacheShard::GetUsage() const {
+  return usage_.load(std::memory_order_relaxed);
+}
+
+size_t HyperClockCacheShard::GetPinnedUsage() const {
+  return pinned_usage_.load(std::memory_order_relaxed);
+}
+
+void HyperClockCacheShard::ApplyToAllCacheEntries(void (*callback)(void*,
+                                                                   size_t),
+                                                  bool thread_safe) {
+  // Entries leave the table only with mutex_ held
+  if (thread_safe) {
+    mutex_.Lock();
+  }
+  for (uint32_t i = 0; i <= length_mask_; i++) {
+    ClockHandle* h = &table_[i];
+    if (GetState(h->meta.load(std::memory_order_acquire)) == kStateVisible) {
+      (*callback)(h->value, h->charge);
+    }
+  }
+  if (thread_safe) {
+    mutex_.Unlock();
+  }
+}
+
+void HyperClockCacheShard::ApplyToAllEntries(
+    const std::function<void(const Slice& key, void* value, size_t charge)>&
+        callback) {
+  MutexLock l(&mutex_);
+  for (uint32_t i = 0; i <= length_mask_; i++) {
+    ClockHandle* h = &table_[i];
+    if (GetState(h->meta.load(std::memory_order_acquire)) == kStateVisible) {
+      callback(h->key(), h->value, h->charge);
+    }
+  }
+}
+
+void HyperClockCacheShard::EraseUnRefEntries() {
+  autovector<FreedEntry> freed;
+  {
+    MutexLock l(&mutex_);
+    for (uint32_t i = 0; i <= length_mask_; i++) {
+      ClockHandle* h = &table_[i];
+      uint64_t meta = h->meta.load(std::memory_order_acquire);
+      while (GetState(meta) == kStateVisible && GetRefs(meta) == 0) {
+        if (h->meta.compare_exchange_weak(
+                meta, MakeMeta(kStateConstruction, 0, 0),
+                std::memory_order_acq_rel, std::memory_order_acquire)) {
+          RemoveLocked(h, &freed);
+          break;
+        }
+      }
+    }
+  }
+  for (auto& entry : freed) {
+    entry.Free();
+  }
+}
+
+std::string HyperClockCacheShard::GetPrintableOptions() const {
+  const int kBufferSize = 200;
+  char buffer[kBufferSize];
+  snprintf(buffer, kBufferSize,
+           "    estimated_entry_charge : %" ROCKSDB_PRIszt
+           "\n"
+           "    table_length : %" PRIu32 "\n",
+           estimated_entry_charge_, length_mask_ + 1);
+  return std::string(buffer);
+}
+
+HyperClockCache::HyperClockCache(
+    size_t capacity, size_t estimated_entry_charge, int num_shard_bits,
+    bool strict_capacity_limit, std::shared_ptr<MemoryAllocator> allocator,
+    CacheMetadataChargePolicy metadata_charge_policy)
+    : ShardedCache(capacity, num_shard_bits, strict_capacity_limit,
+                   std::move(allocator)) {
+  num_shards_ = 1 << num_shard_bits;
+  shards_ = reinterpret_cast<HyperClockCacheShard*>(
+      port::cacheline_aligned_alloc(sizeof(HyperClockCacheShard) *
+                                    num_shards_));
+  size_t per_shard = (capacity + (num_shards_ - 1)) / num_shards_;
+  for (int i = 0; i < num_shards_; i++) {
+    new (&shards_[i])
+        HyperClockCacheShard(per_shard, estimated_entry_charge,
+                             strict_capacity_limit, metadata_charge_policy);
+  }
+}
+
+HyperClockCache::~HyperClockCache() {
+  if (shards_ != nullptr) {
+    assert(num_shards_ > 0);
+    for (int i = 0; i < num_shards_; i++) {
+      shards_[i].~HyperClockCacheShard();
+    }
+    port::cacheline_aligned_free(shards_);
+  }
+}
+
+CacheShard* HyperClockCache::GetShard(int shard) {
+  return reinterpret_cast<CacheShard*>(&shards_[shard]);
+}
+
+const CacheShard* HyperClockCache::GetShard(int shard) const {
+  return reinterpret_cast<CacheShard*>(&shards_[shard]);
+}
+
+void* HyperClockCache::Value(Handle* handle) {
+  return reinterpret_cast<const ClockHandle*>(handle)->value;
+}
+
+size_t HyperClockCache::GetCharge(Handle* handle) const {
+  return reinterpret_cast<const ClockHandle*>(handle)->charge;
+}
+
+uint32_t HyperClockCache::GetHash(Handle* handle) const {
+  return reinterpret_cast<const ClockHandle*>(handle)->hash.load(
+      std::memory_order_relaxed);
+}
+
+void HyperClockCache::DisownData() {
+// Do not drop data if compile with ASAN to suppress leak warning.
+#if defined(__clang__)
+#if !defined(__has_feature) || !__has_feature(address_sanitizer)
+  shards_ = nullptr;
+  num_shards_ = 0;
+#endif
+#else  // __clang__
+#ifndef __SANITIZE_ADDRESS__
+  shards_ = nullptr;
+  num_shards_ = 0;
+#endif  // !__SANITIZE_ADDRESS__
+#endif  // __clang__
+}
+
+std::shared_ptr<Cache> NewHyperClockCache(
+    const HyperClockCacheOptions& cache_opts) {
+  int num_shard_bits = cache_opts.num_shard_bits;
+  if (num_shard_bits >= 20) {
+    return nullptr;  // the cache cannot be sharded into too many fine pieces
+  }
+  if (cache_opts.estimated_entry_charge == 0) {
+    return nullptr;
+  }
+  if (num_shard_bits < 0) {
+    num_shard_bits = GetDefaultCacheShardBits(cache_opts.capacity);
+  }
+  return std::make_shared<HyperClockCache>(
+      cache_opts.capacity, cache_opts.estimated_entry_charge, num_shard_bits,
+      cache_opts.strict_capacity_limit, cache_opts.memory_allocator,
+      cache_opts.metadata_charge_policy);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
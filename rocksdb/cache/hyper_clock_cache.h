@@ -0,0 +1,212 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// Copyright (c) 2011 The LevelDB Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file. See the AUTHORS file for names of contributors.
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "cache/sharded_cache.h"
+#include "port/port.h"
+#include "util/autovector.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+// A CLOCK cache whose hits take no lock.
+//
+// Each shard keeps its entries in a fixed size open addressing table of
+// ClockHandles, probed with double hashing. The state of an entry, its
+// number of external references and its CLOCK countdown share the atomic
+// meta word of its handle, so that Lookup() takes a reference and refreshes
+// the countdown with a single compare-and-swap, and Release() drops it with
+// another. Insert(), Erase() and the eviction sweep serialize on the shard
+// mutex, which Lookup() never takes, and take an entry out of the table only
+// after winning it with a compare-and-swap that expects no references.
+//
+// ClockHandle states (ClockHandle::meta):
+// 1. Empty: the slot is free.
+// 2. Construction: owned by one thread, which fills the slot or empties it.
+// 3. Visible: in the cache, found by Lookup(). Evicted by the sweep once its
+//    countdown has run out while it had no references.
+// 4. Invisible: erased or overwritten while referenced, and freed by the
+//    Release() of its last reference.
+//
+// The slots that a probe sequence passes over count it in their
+// displacements, so that a Lookup() can stop at the first slot that no
+// probe sequence passes.
+struct ClockHandle {
+  std::atomic<uint64_t> meta{0};
+  // The number of entries whose probe sequence passes over this slot
+  std::atomic<uint32_t> displacements{0};
+  // Read by Lookup() before it holds a reference, as a hint
+  std::atomic<uint32_t> hash{0};
+
+  // Written only in the Construction state.
+  void* value = nullptr;
+  void (*deleter)(const Slice&, void* value) = nullptr;
+  char* key_data = nullptr;
+  size_t key_length = 0;
+  size_t charge = 0;
+  // Not in the table, because it was full of referenced entries. Such a
+  // handle is Invisible from the start.
+  bool detached = false;
+
+  Slice key() const { return Slice(key_data, key_length); }
+
+  // Caclculate the memory usage by metadata
+  size_t CalcTotalCharge(
+      CacheMetadataChargePolicy metadata_charge_policy) const {
+    size_t meta_charge = 0;
+    if (metadata_charge_policy == kFullChargeCacheMetadata) {
+      meta_charge += sizeof(ClockHandle) + key_length;
+    }
+    return charge + meta_charge;
+  }
+};
+
+// A single shard of sharded cache.
+class ALIGN_AS(CACHE_LINE_SIZE) HyperClockCacheShard final : public CacheShard {
+ public:
+  HyperClockCacheShard(size_t capacity, size_t estimated_entry_charge,
+                       bool strict_capacity_limit,
+                       CacheMetadataChargePolicy metadata_charge_policy);
+  virtual ~HyperClockCacheShard() override;
+
+  // If current usage is more than new capacity, the function will attempt to
+  // free the needed space. The table keeps the size it got at construction.
+  virtual void SetCapacity(size_t capacity) override;
+
+  // Set the flag to reject insertion if cache if full.
+  virtual void SetStrictCapacityLimit(bool strict_capacity_limit) override;
+
+  // Like Cache methods, but with an extra "hash" parameter.
+  virtual Status Insert(const Slice& key, uint32_t hash, void* value,
+                        size_t charge,
+                        void (*deleter)(const Slice& key, void* value),
+                        Cache::Handle** handle,
+                        Cache::Priority priority) override;
+  virtual Cache::Handle* Lookup(const Slice& key, uint32_t hash) override;
+  virtual bool Ref(Cache::Handle* handle) override;
+  virtual bool Release(Cache::Handle* handle,
+                       bool force_erase = false) override;
+  virtual void Erase(const Slice& key, uint32_t hash) override;
+
+  virtual size_t GetUsage() const override;
+  virtual size_t GetPinnedUsage() const override;
+
+  virtual void ApplyToAllCacheEntries(void (*callback)(void*, size_t),
+                                      bool thread_safe) override;
+
+  virtual void ApplyToAllEntries(
+      const std::function<void(const Slice& key, void* value, size_t charge)>&
+          callback) override;
+
+  virtual void EraseUnRefEntries() override;
+
+  virtual std::string GetPrintableOptions() const override;
+
+  // The number of slots of the table, for unit test purpose only
+  uint32_t TEST_GetTableLength() const { return length_mask_ + 1; }
+
+ private:
+  // An entry taken out of the cache, to be freed without holding mutex_
+  struct FreedEntry {
+    void* value;
+    void (*deleter)(const Slice&, void* value);
+    char* key_data;
+    size_t key_length;
+
+    void Free();
+  };
+
+  // The step of the probe sequence of hash; odd, to visit every slot.
+  static uint32_t ProbeIncrement(uint32_t hash);
+
+  // Returns the Visible entry of key, or nullptr. REQUIRES: mutex_ held
+  ClockHandle* FindLocked(const Slice& key, uint32_t hash);
+
+  // Returns an Empty slot for hash, counted in the displacements of the
+  // slots before it, or nullptr if there is none. REQUIRES: mutex_ held
+  ClockHandle* ClaimSlotLocked(uint32_t hash);
+
+  // Empties the slot of h, which the caller moved to the Construction state,
+  // and adds its entry to *freed. REQUIRES: mutex_ held
+  void RemoveLocked(ClockHandle* h, autovector<FreedEntry>* freed);
+
+  // Takes the Visible entry h out of the cache: frees it if it has no
+  // references, else makes it Invisible. REQUIRES: mutex_ held
+  void EraseLocked(ClockHandle* h, autovector<FreedEntry>* freed);
+
+  // Sweeps the clock over the table, evicting unreferenced entries whose
+  // countdown ran out, until there is room for charge and a free slot, or
+  // every entry is referenced. REQUIRES: mutex_ held
+  void EvictLocked(size_t charge, autovector<FreedEntry>* freed);
+
+  // Not frequently modified data members
+
+  const uint32_t length_mask_;
+
+  // The most slots that may be in use, to keep probe sequences short.
+  const uint32_t occupancy_limit_;
+
+  const size_t estimated_entry_charge_;
+
+  std::unique_ptr<ClockHandle[]> table_;
+
+  // Read by Release() without mutex_, written with it.
+  std::atomic<size_t> capacity_;
+
+  // Whether to reject insertion if cache reaches its full capacity.
+  bool strict_capacity_limit_;
+
+  // Frequently modified data members
+
+  // The next slot the clock sweeps. Protected by mutex_.
+  uint32_t clock_pointer_;
+
+  // The number of slots that are not Empty. Protected by mutex_.
+  uint32_t occupancy_;
+
+  // Memory size for entries residing in the cache, written with mutex_ held
+  // except for detached entries.
+  std::atomic<size_t> usage_;
+
+  // Memory size for entries with external references
+  std::atomic<size_t> pinned_usage_;
+
+  // mutex_ protects the structure of the table, not the entries' references.
+  mutable port::Mutex mutex_;
+};
+
+class HyperClockCache
+#ifdef NDEBUG
+    final
+#endif
+    : public ShardedCache {
+ public:
+  HyperClockCache(size_t capacity, size_t estimated_entry_charge,
+                  int num_shard_bits, bool strict_capacity_limit,
+                  std::shared_ptr<MemoryAllocator> memory_allocator = nullptr,
+                  CacheMetadataChargePolicy metadata_charge_policy =
+                      kDontChargeCacheMetadata);
+  virtual ~HyperClockCache();
+  virtual const char* Name() const override { return "HyperClockCache"; }
+  virtual CacheShard* GetShard(int shard) override;
+  virtual const CacheShard* GetShard(int shard) const override;
+  virtual void* Value(Handle* handle) override;
+  virtual size_t GetCharge(Handle* handle) const override;
+  virtual uint32_t GetHash(Handle* handle) const override;
+  virtual void DisownData() override;
+
+ private:
+  HyperClockCacheShard* shards_ = nullptr;
+  int num_shards_ = 0;
+};
+
+}  // namespace ROCKSDB_NAMESPACE
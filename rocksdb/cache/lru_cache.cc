@@ -14,6 +14,7 @@
 #include <stdlib.h>
 #include <string>
 
+#include "monitoring/statistics.h"
 #include "util/mutexlock.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -98,12 +99,15 @@ void LRUHandleTable::Resize() {
 LRUCacheShard::LRUCacheShard(size_t capacity, bool strict_capacity_limit,
                              double high_pri_pool_ratio,
                              bool use_adaptive_mutex,
-                             CacheMetadataChargePolicy metadata_charge_policy)
+                             CacheMetadataChargePolicy metadata_charge_policy,
+                             bool use_admission_filter, Statistics* statistics)
     : capacity_(0),
       high_pri_pool_usage_(0),
       strict_capacity_limit_(strict_capacity_limit),
       high_pri_pool_ratio_(high_pri_pool_ratio),
       high_pri_pool_capacity_(0),
+      use_admission_filter_(use_admission_filter),
+      statistics_(statistics),
       usage_(0),
       lru_usage_(0),
       mutex_(use_adaptive_mutex) {
@@ -153,6 +157,14 @@ void LRUCacheShard::ApplyToAllCacheEntries(void (*callback)(void*, size_t),
   }
 }
 
+void LRUCacheShard::ApplyToAllEntries(
+    const std::function<void(const Slice& key, void* value, size_t charge)>&
+        callback) {
+  MutexLock l(&mutex_);
+  table_.ApplyToAllCacheEntries(
+      [&callback](LRUHandle* h) { callback(h->key(), h->value, h->charge); });
+}
+
 void LRUCacheShard::TEST_GetLRUList(LRUHandle** lru, LRUHandle** lru_low_pri) {
   MutexLock l(&mutex_);
   *lru = &lru_;
@@ -248,6 +260,24 @@ void LRUCacheShard::EvictFromLRU(size_t charge,
   }
 }
 
+bool LRUCacheShard::AdmitLocked(const Slice& key, uint32_t hash,
+                                size_t total_charge) {
+  mutex_.AssertHeld();
+  // Keep the sketch sized for the entries the shard holds
+  admission_sketch_.EnsureCapacity(table_.GetOccupancyCount());
+  if ((usage_ + total_charge) <= capacity_ || lru_.next == &lru_ ||
+      table_.Lookup(key, hash) != nullptr) {
+    // Nothing would be evicted for it, or it replaces an entry
+    return true;
+  }
+  // Compare with the entry that EvictFromLRU() would evict first
+  bool admit = admission_sketch_.Frequency(hash) >
+               admission_sketch_.Frequency(lru_.next->hash);
+  RecordTick(statistics_,
+             admit ? CACHE_ADMISSION_ACCEPTED : CACHE_ADMISSION_REJECTED);
+  return admit;
+}
+
 void LRUCacheShard::SetCapacity(size_t capacity) {
   autovector<LRUHandle*> last_reference_list;
   {
@@ -270,6 +300,9 @@ void LRUCacheShard::SetStrictCapacityLimit(bool strict_capacity_limit) {
 
 Cache::Handle* LRUCacheShard::Lookup(const Slice& key, uint32_t hash) {
   MutexLock l(&mutex_);
+  if (use_admission_filter_) {
+    admission_sketch_.Increment(hash);
+  }
   LRUHandle* e = table_.Lookup(key, hash);
   if (e != nullptr) {
     assert(e->InCache());
@@ -322,7 +355,7 @@ bool LRUCacheShard::Release(Cache::Handle* handle, bool force_erase) {
         last_reference = false;
       }
     }
-    if (last_reference) {
+    if (last_reference && !e->IsDetached()) {
       size_t total_charge = e->CalcTotalCharge(metadata_charge_policy_);
       assert(usage_ >= total_charge);
       usage_ -= total_charge;
@@ -364,12 +397,29 @@ Status LRUCacheShard::Insert(const Slice& key, uint32_t hash, void* value,
   {
     MutexLock l(&mutex_);
 
-    // Free the space following strict LRU policy until enough space
-    // is freed or the lru list is empty
-    EvictFromLRU(total_charge, &last_reference_list);
+    const bool admitted =
+        !use_admission_filter_ || AdmitLocked(key, hash, total_charge);
+    if (admitted) {
+      // Free the space following strict LRU policy until enough space
+      // is freed or the lru list is empty
+      EvictFromLRU(total_charge, &last_reference_list);
+    }
 
-    if ((usage_ + total_charge) > capacity_ &&
-        (strict_capacity_limit_ || handle == nullptr)) {
+    if (!admitted && (handle == nullptr || !strict_capacity_limit_)) {
+      // Don't cache the entry, as if it was inserted and evicted immediately.
+      e->SetInCache(false);
+      if (handle == nullptr) {
+        last_reference_list.push_back(e);
+      } else {
+        // The caller still gets the entry, which its last Release() frees.
+        // It is not charged to the shard: usage_ only exceeds capacity_ once
+        // the LRU list is empty, which Release() relies on.
+        e->SetDetached();
+        e->Ref();
+        *handle = reinterpret_cast<Cache::Handle*>(e);
+      }
+    } else if ((usage_ + total_charge) > capacity_ &&
+               (strict_capacity_limit_ || handle == nullptr)) {
       if (handle == nullptr) {
         // Don't insert the entry but still return ok, as if the entry inserted
         // into cache and get evicted immediately.
@@ -459,8 +509,10 @@ std::string LRUCacheShard::GetPrintableOptions() const {
   char buffer[kBufferSize];
   {
     MutexLock l(&mutex_);
-    snprintf(buffer, kBufferSize, "    high_pri_pool_ratio: %.3lf\n",
-             high_pri_pool_ratio_);
+    snprintf(buffer, kBufferSize,
+             "    high_pri_pool_ratio: %.3lf\n"
+             "    use_admission_filter: %d\n",
+             high_pri_pool_ratio_, use_admission_filter_);
   }
   return std::string(buffer);
 }
@@ -469,9 +521,12 @@ LRUCache::LRUCache(size_t capacity, int num_shard_bits,
                    bool strict_capacity_limit, double high_pri_pool_ratio,
                    std::shared_ptr<MemoryAllocator> allocator,
                    bool use_adaptive_mutex,
-                   CacheMetadataChargePolicy metadata_charge_policy)
+                   CacheMetadataChargePolicy metadata_charge_policy,
+                   bool use_admission_filter,
+                   std::shared_ptr<Statistics> statistics)
     : ShardedCache(capacity, num_shard_bits, strict_capacity_limit,
-                   std::move(allocator)) {
+                   std::move(allocator)),
+      statistics_(std::move(statistics)) {
   num_shards_ = 1 << num_shard_bits;
   shards_ = reinterpret_cast<LRUCacheShard*>(
       port::cacheline_aligned_alloc(sizeof(LRUCacheShard) * num_shards_));
@@ -479,7 +534,8 @@ LRUCache::LRUCache(size_t capacity, int num_shard_bits,
   for (int i = 0; i < num_shards_; i++) {
     new (&shards_[i])
         LRUCacheShard(per_shard, strict_capacity_limit, high_pri_pool_ratio,
-                      use_adaptive_mutex, metadata_charge_policy);
+                      use_adaptive_mutex, metadata_charge_policy,
+                      use_admission_filter, statistics_.get());
   }
 }
 
@@ -545,31 +601,34 @@ double LRUCache::GetHighPriPoolRatio() {
 }
 
 std::shared_ptr<Cache> NewLRUCache(const LRUCacheOptions& cache_opts) {
-  return NewLRUCache(cache_opts.capacity, cache_opts.num_shard_bits,
-                     cache_opts.strict_capacity_limit,
-                     cache_opts.high_pri_pool_ratio,
-                     cache_opts.memory_allocator, cache_opts.use_adaptive_mutex,
-                     cache_opts.metadata_charge_policy);
-}
-
-std::shared_ptr<Cache> NewLRUCache(
-    size_t capacity, int num_shard_bits, bool strict_capacity_limit,
-    double high_pri_pool_ratio,
-    std::shared_ptr<MemoryAllocator> memory_allocator, bool use_adaptive_mutex,
-    CacheMetadataChargePolicy metadata_charge_policy) {
+  int num_shard_bits = cache_opts.num_shard_bits;
   if (num_shard_bits >= 20) {
     return nullptr;  // the cache cannot be sharded into too many fine pieces
   }
-  if (high_pri_pool_ratio < 0.0 || high_pri_pool_ratio > 1.0) {
+  if (cache_opts.high_pri_pool_ratio < 0.0 ||
+      cache_opts.high_pri_pool_ratio > 1.0) {
     // invalid high_pri_pool_ratio
     return nullptr;
   }
   if (num_shard_bits < 0) {
-    num_shard_bits = GetDefaultCacheShardBits(capacity);
+    num_shard_bits = GetDefaultCacheShardBits(cache_opts.capacity);
   }
   return std::make_shared<LRUCache>(
+      cache_opts.capacity, num_shard_bits, cache_opts.strict_capacity_limit,
+      cache_opts.high_pri_pool_ratio, cache_opts.memory_allocator,
+      cache_opts.use_adaptive_mutex, cache_opts.metadata_charge_policy,
+      cache_opts.use_admission_filter, cache_opts.statistics);
+}
+
+std::shared_ptr<Cache> NewLRUCache(
+    size_t capacity, int num_shard_bits, bool strict_capacity_limit,
+    double high_pri_pool_ratio,
+    std::shared_ptr<MemoryAllocator> memory_allocator, bool use_adaptive_mutex,
+    CacheMetadataChargePolicy metadata_charge_policy) {
+  return NewLRUCache(LRUCacheOptions(
       capacity, num_shard_bits, strict_capacity_limit, high_pri_pool_ratio,
-      std::move(memory_allocator), use_adaptive_mutex, metadata_charge_policy);
+      std::move(memory_allocator), use_adaptive_mutex,
+      metadata_charge_policy));
 }
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -10,6 +10,7 @@
 
 #include <string>
 
+#include "cache/frequency_sketch.h"
 #include "cache/sharded_cache.h"
 
 #include "port/malloc.h"
@@ -69,6 +70,9 @@ struct LRUHandle {
     IN_HIGH_PRI_POOL = (1 << 2),
     // Wwhether this entry has had any lookups (hits).
     HAS_HIT = (1 << 3),
+    // Whether this entry was rejected by the admission filter and handed out
+    // without being charged to the cache.
+    IS_DETACHED = (1 << 4),
   };
 
   uint8_t flags;
@@ -95,6 +99,7 @@ struct LRUHandle {
   bool IsHighPri() const { return flags & IS_HIGH_PRI; }
   bool InHighPriPool() const { return flags & IN_HIGH_PRI_POOL; }
   bool HasHit() const { return flags & HAS_HIT; }
+  bool IsDetached() const { return flags & IS_DETACHED; }
 
   void SetInCache(bool in_cache) {
     if (in_cache) {
@@ -122,6 +127,8 @@ struct LRUHandle {
 
   void SetHit() { flags |= HAS_HIT; }
 
+  void SetDetached() { flags |= IS_DETACHED; }
+
   void Free() {
     assert(refs == 0);
     if (deleter) {
@@ -160,6 +167,8 @@ class LRUHandleTable {
   LRUHandle* Insert(LRUHandle* h);
   LRUHandle* Remove(const Slice& key, uint32_t hash);
 
+  uint32_t GetOccupancyCount() const { return elems_; }
+
   template <typename T>
   void ApplyToAllCacheEntries(T func) {
     for (uint32_t i = 0; i < length_; i++) {
@@ -193,7 +202,9 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
  public:
   LRUCacheShard(size_t capacity, bool strict_capacity_limit,
                 double high_pri_pool_ratio, bool use_adaptive_mutex,
-                CacheMetadataChargePolicy metadata_charge_policy);
+                CacheMetadataChargePolicy metadata_charge_policy,
+                bool use_admission_filter = false,
+                Statistics* statistics = nullptr);
   virtual ~LRUCacheShard() override = default;
 
   // Separate from constructor so caller can easily make an array of LRUCache
@@ -229,6 +240,10 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   virtual void ApplyToAllCacheEntries(void (*callback)(void*, size_t),
                                       bool thread_safe) override;
 
+  virtual void ApplyToAllEntries(
+      const std::function<void(const Slice& key, void* value, size_t charge)>&
+          callback) override;
+
   virtual void EraseUnRefEntries() override;
 
   virtual std::string GetPrintableOptions() const override;
@@ -256,6 +271,10 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // holding the mutex_
   void EvictFromLRU(size_t charge, autovector<LRUHandle*>* deleted);
 
+  // Whether the admission filter lets a new entry of key evict entries to
+  // make room for total_charge. Requires mutex_ held.
+  bool AdmitLocked(const Slice& key, uint32_t hash, size_t total_charge);
+
   // Initialized before use.
   size_t capacity_;
 
@@ -280,6 +299,12 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // Pointer to head of low-pri pool in LRU list.
   LRUHandle* lru_low_pri_;
 
+  // Whether insertions that evict entries go through the admission filter.
+  bool use_admission_filter_;
+
+  // Receives the admission filter's tickers. Owned by the LRUCache.
+  Statistics* statistics_;
+
   // ------------^^^^^^^^^^^^^-----------
   // Not frequently modified data members
   // ------------------------------------
@@ -293,6 +318,9 @@ class ALIGN_AS(CACHE_LINE_SIZE) LRUCacheShard final : public CacheShard {
   // ------------vvvvvvvvvvvvv-----------
   LRUHandleTable table_;
 
+  // Lookups of recent keys, for the admission filter
+  FrequencySketch admission_sketch_;
+
   // Memory size for entries residing in the cache
   size_t usage_;
 
@@ -316,7 +344,9 @@ class LRUCache
            std::shared_ptr<MemoryAllocator> memory_allocator = nullptr,
            bool use_adaptive_mutex = kDefaultToAdaptiveMutex,
            CacheMetadataChargePolicy metadata_charge_policy =
-               kDontChargeCacheMetadata);
+               kDontChargeCacheMetadata,
+           bool use_admission_filter = false,
+           std::shared_ptr<Statistics> statistics = nullptr);
   virtual ~LRUCache();
   virtual const char* Name() const override { return "LRUCache"; }
   virtual CacheShard* GetShard(int shard) override;
@@ -334,6 +364,7 @@ class LRUCache
  private:
   LRUCacheShard* shards_ = nullptr;
   int num_shards_ = 0;
+  std::shared_ptr<Statistics> statistics_;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
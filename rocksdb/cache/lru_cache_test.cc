@@ -8,7 +8,9 @@
 #include <string>
 #include <vector>
 #include "port/port.h"
+#include "rocksdb/statistics.h"
 #include "test_util/testharness.h"
+#include "util/string_util.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -191,6 +193,108 @@ TEST_F(LRUCacheTest, EntriesWithPriority) {
   ValidateLRUList({"e", "f", "g", "Z", "d"}, 2);
 }
 
+TEST_F(LRUCacheTest, AdmissionFilter) {
+  LRUCacheOptions opts(10 /*capacity*/, 0 /*num_shard_bits*/,
+                       false /*strict_capacity_limit*/,
+                       0.0 /*high_pri_pool_ratio*/, nullptr /*allocator*/,
+                       kDefaultToAdaptiveMutex, kDontChargeCacheMetadata);
+  opts.use_admission_filter = true;
+  opts.statistics = CreateDBStatistics();
+  std::shared_ptr<Cache> cache = NewLRUCache(opts);
+
+  auto lookup = [&](const std::string& key) {
+    Cache::Handle* handle = cache->Lookup(key);
+    if (handle != nullptr) {
+      cache->Release(handle);
+    }
+    return handle != nullptr;
+  };
+
+  // A working set that fills the cache and is looked up repeatedly
+  for (int i = 0; i < 10; i++) {
+    ASSERT_FALSE(lookup("hot" + ToString(i)));
+    ASSERT_OK(cache->Insert("hot" + ToString(i), nullptr, 1, nullptr));
+  }
+  for (int round = 0; round < 8; round++) {
+    for (int i = 0; i < 10; i++) {
+      ASSERT_TRUE(lookup("hot" + ToString(i)));
+    }
+  }
+  ASSERT_EQ(0U, opts.statistics->getTickerCount(CACHE_ADMISSION_ACCEPTED));
+  ASSERT_EQ(0U, opts.statistics->getTickerCount(CACHE_ADMISSION_REJECTED));
+
+  // A scan reading each key once does not evict it
+  for (int i = 0; i < 100; i++) {
+    ASSERT_FALSE(lookup("scan" + ToString(i)));
+    ASSERT_OK(cache->Insert("scan" + ToString(i), nullptr, 1, nullptr));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(lookup("hot" + ToString(i)));
+  }
+  ASSERT_EQ(0U, opts.statistics->getTickerCount(CACHE_ADMISSION_ACCEPTED));
+  ASSERT_EQ(100U, opts.statistics->getTickerCount(CACHE_ADMISSION_REJECTED));
+  ASSERT_EQ(10U, cache->GetUsage());
+
+  // A rejected entry inserted with a handle is still handed out, uncached
+  // and not charged to the cache
+  Cache::Handle* handle = nullptr;
+  ASSERT_OK(cache->Insert("once", nullptr, 1, nullptr, &handle));
+  ASSERT_NE(nullptr, handle);
+  ASSERT_EQ(10U, cache->GetUsage());
+  ASSERT_FALSE(lookup("once"));
+  // Releasing a resident entry meanwhile keeps it in the cache
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(lookup("hot" + ToString(i)));
+  }
+  for (int i = 0; i < 10; i++) {
+    ASSERT_TRUE(lookup("hot" + ToString(i)));
+  }
+  ASSERT_TRUE(cache->Release(handle));
+  ASSERT_EQ(10U, cache->GetUsage());
+  ASSERT_EQ(101U, opts.statistics->getTickerCount(CACHE_ADMISSION_REJECTED));
+
+  // A key looked up more often than the least recently used entry replaces it
+  for (int i = 0; i < 15; i++) {
+    ASSERT_FALSE(lookup("new"));
+  }
+  ASSERT_OK(cache->Insert("new", nullptr, 1, nullptr));
+  ASSERT_EQ(1U, opts.statistics->getTickerCount(CACHE_ADMISSION_ACCEPTED));
+  ASSERT_TRUE(lookup("new"));
+  ASSERT_FALSE(lookup("hot0"));
+  ASSERT_EQ(10U, cache->GetUsage());
+}
+
+TEST(FrequencySketchTest, EstimatesAndAging) {
+  FrequencySketch sketch;
+  ASSERT_EQ(64U, sketch.capacity());
+  for (uint32_t hash = 0; hash < 64; hash++) {
+    for (uint32_t i = 0; i < hash % 8; i++) {
+      sketch.Increment(hash * 0x9E3779B9u);
+    }
+  }
+  // Collisions can only overestimate
+  for (uint32_t hash = 0; hash < 64; hash++) {
+    ASSERT_GE(sketch.Frequency(hash * 0x9E3779B9u), hash % 8);
+  }
+
+  // Counters saturate
+  for (int i = 0; i < 20; i++) {
+    sketch.Increment(12345);
+  }
+  ASSERT_EQ(15U, sketch.Frequency(12345));
+
+  // Enough increments halve all counters
+  for (int i = 0; i < 640; i++) {
+    sketch.Increment(static_cast<uint32_t>(i + 1000) * 0x9E3779B9u);
+  }
+  ASSERT_LT(sketch.Frequency(12345), 15U);
+
+  // Growing the sketch starts it over
+  sketch.EnsureCapacity(1000);
+  ASSERT_EQ(1024U, sketch.capacity());
+  ASSERT_EQ(0U, sketch.Frequency(12345));
+}
+
 }  // namespace ROCKSDB_NAMESPACE
 
 int main(int argc, char** argv) {
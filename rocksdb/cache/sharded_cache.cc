@@ -117,6 +117,15 @@ void ShardedCache::ApplyToAllCacheEntries(void (*callback)(void*, size_t),
   }
 }
 
+void ShardedCache::ApplyToAllEntries(
+    const std::function<void(const Slice& key, void* value, size_t charge)>&
+        callback) {
+  int num_shards = 1 << num_shard_bits_;
+  for (int s = 0; s < num_shards; s++) {
+    GetShard(s)->ApplyToAllEntries(callback);
+  }
+}
+
 void ShardedCache::EraseUnRefEntries() {
   int num_shards = 1 << num_shard_bits_;
   for (int s = 0; s < num_shards; s++) {
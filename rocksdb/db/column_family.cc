@@ -530,6 +530,9 @@ ColumnFamilyData::ColumnFamilyData(
       queued_for_flush_(false),
       queued_for_compaction_(false),
       prev_compaction_needed_bytes_(0),
+      prev_l0_delay_trigger_count_(0),
+      feedback_write_rate_control_(db_options.feedback_write_rate_control),
+      feedback_write_rate_(0),
       allow_2pc_(db_options.allow_2pc),
       last_memtable_id_(0),
       db_paths_registered_(false) {
@@ -724,6 +727,7 @@ const double kIncSlowdownRatio = 0.8;
 const double kDecSlowdownRatio = 1 / kIncSlowdownRatio;
 const double kNearStopSlowdownRatio = 0.6;
 const double kDelayRecoverSlowdownRatio = 1.4;
+const uint64_t kMinWriteRate = 16 * 1024u;  // Minimum write rate 16KB/s.
 
 namespace {
 // If penalize_stop is true, we further reduce slowdown rate.
@@ -731,8 +735,6 @@ std::unique_ptr<WriteControllerToken> SetupDelay(
     WriteController* write_controller, uint64_t compaction_needed_bytes,
     uint64_t prev_compaction_need_bytes, bool penalize_stop,
     bool auto_comapctions_disabled) {
-  const uint64_t kMinWriteRate = 16 * 1024u;  // Minimum write rate 16KB/s.
-
   uint64_t max_write_rate = write_controller->max_delayed_write_rate();
   uint64_t write_rate = write_controller->delayed_write_rate();
 
@@ -821,8 +823,107 @@ int GetL0ThresholdSpeedupCompaction(int level0_file_num_compaction_trigger,
     return static_cast<int>(res);
   }
 }
+
+// Returns how close value is to stopping writes, from 0 at start to 1 at stop.
+// If prev_value, the value at the previous recalculation, is known, value is
+// assumed to keep growing as much as it did since, and the pressure it would
+// reach by the next recalculation is returned if higher.
+double FeedbackStallPressure(double value, double prev_value, double start,
+                             double stop) {
+  if (stop <= start) {
+    return 0;
+  }
+  if (prev_value > 0 && value > prev_value) {
+    value += value - prev_value;
+  }
+  return std::min(1.0, std::max(0.0, (value - start) / (stop - start)));
+}
 }  // namespace
 
+std::unique_ptr<WriteControllerToken> ColumnFamilyData::SetupFeedbackDelay(
+    const MutableCFOptions& mutable_cf_options,
+    uint64_t compaction_needed_bytes, double* pressure) {
+  auto* vstorage = current_->storage_info();
+  auto* write_controller = column_family_set_->write_controller_;
+
+  // Writes are delayed from halfway between where compactions are sped up
+  // and where the step thresholds would delay them, so that the rate has
+  // room to fall before the stop triggers.
+  double p = 0;
+  const int max_write_buffer_number =
+      mutable_cf_options.max_write_buffer_number;
+  if (max_write_buffer_number > 3) {
+    p = std::max(p, FeedbackStallPressure(imm()->NumNotFlushed(), 0,
+                                          max_write_buffer_number - 2,
+                                          max_write_buffer_number));
+  }
+  if (!mutable_cf_options.disable_auto_compactions) {
+    const int slowdown_trigger =
+        mutable_cf_options.level0_slowdown_writes_trigger;
+    if (slowdown_trigger >= 0) {
+      const int speedup_trigger = GetL0ThresholdSpeedupCompaction(
+          mutable_cf_options.level0_file_num_compaction_trigger,
+          slowdown_trigger);
+      p = std::max(p, FeedbackStallPressure(
+                          vstorage->l0_delay_trigger_count(),
+                          prev_l0_delay_trigger_count_,
+                          (speedup_trigger + slowdown_trigger) / 2.0,
+                          mutable_cf_options.level0_stop_writes_trigger));
+    }
+    const uint64_t soft_limit =
+        mutable_cf_options.soft_pending_compaction_bytes_limit;
+    const uint64_t hard_limit =
+        mutable_cf_options.hard_pending_compaction_bytes_limit;
+    if (soft_limit > 0) {
+      // Compactions are sped up from a quarter of the soft limit. Without a
+      // hard limit the rate bottoms out at twice the soft limit.
+      p = std::max(p, FeedbackStallPressure(
+                          static_cast<double>(compaction_needed_bytes),
+                          static_cast<double>(prev_compaction_needed_bytes_),
+                          soft_limit * 5 / 8.0,
+                          hard_limit > soft_limit ? hard_limit
+                                                  : 2.0 * soft_limit));
+    }
+  }
+  *pressure = p;
+
+  // Only the column family's own rate is smoothed and compared with, so
+  // that the others do not change what it picks
+  const uint64_t prev_write_rate = feedback_write_rate_;
+  const bool was_delayed = prev_write_rate > 0;
+  if (p <= 0) {
+    if (was_delayed) {
+      internal_stats_->AddCFStats(InternalStats::WRITE_RATE_FEEDBACK_SPEEDUPS,
+                                  1);
+    }
+    feedback_write_rate_ = 0;
+    return nullptr;
+  }
+
+  const uint64_t max_write_rate = write_controller->max_delayed_write_rate();
+  uint64_t write_rate = max_write_rate;
+  if (max_write_rate > kMinWriteRate) {
+    write_rate = kMinWriteRate +
+                 static_cast<uint64_t>(
+                     (1 - p) * static_cast<double>(max_write_rate -
+                                                   kMinWriteRate));
+  }
+  if (was_delayed) {
+    // Only go halfway, so that a single flush or compaction does not swing
+    // the rate from one end to the other
+    write_rate = prev_write_rate / 2 + write_rate / 2;
+  }
+  if (!was_delayed || write_rate < prev_write_rate) {
+    internal_stats_->AddCFStats(InternalStats::WRITE_RATE_FEEDBACK_SLOWDOWNS,
+                                1);
+  } else if (write_rate > prev_write_rate) {
+    internal_stats_->AddCFStats(InternalStats::WRITE_RATE_FEEDBACK_SPEEDUPS,
+                                1);
+  }
+  feedback_write_rate_ = write_rate;
+  return write_controller->GetFeedbackDelayToken(write_rate);
+}
+
 std::pair<WriteStallCondition, ColumnFamilyData::WriteStallCause>
 ColumnFamilyData::GetWriteStallConditionAndCause(
     int num_unflushed_memtables, int num_l0_files,
@@ -876,8 +977,33 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
     bool was_stopped = write_controller->IsStopped();
     bool needed_delay = write_controller->NeedsDelay();
 
-    if (write_stall_condition == WriteStallCondition::kStopped &&
-        write_stall_cause == WriteStallCause::kMemtableLimit) {
+    // With feedback_write_rate_control only the stops are decided by the
+    // thresholds
+    std::unique_ptr<WriteControllerToken> feedback_delay;
+    double feedback_pressure = 0;
+    if (feedback_write_rate_control_ &&
+        write_stall_condition != WriteStallCondition::kStopped) {
+      feedback_delay = SetupFeedbackDelay(
+          mutable_cf_options, compaction_needed_bytes, &feedback_pressure);
+      write_stall_condition = feedback_delay != nullptr
+                                  ? WriteStallCondition::kDelayed
+                                  : WriteStallCondition::kNormal;
+    } else {
+      feedback_write_rate_ = 0;
+    }
+
+    if (feedback_delay != nullptr) {
+      write_controller_token_ = std::move(feedback_delay);
+      ROCKS_LOG_INFO(
+          ioptions_.info_log,
+          "[%s] Delaying writes at rate %" PRIu64
+          " for write stall pressure %.2f: %d immutable memtables, %d "
+          "level-0 files, estimated pending compaction bytes %" PRIu64,
+          name_.c_str(), feedback_write_rate_,
+          feedback_pressure, imm()->NumNotFlushed(),
+          vstorage->l0_delay_trigger_count(), compaction_needed_bytes);
+    } else if (write_stall_condition == WriteStallCondition::kStopped &&
+               write_stall_cause == WriteStallCause::kMemtableLimit) {
       write_controller_token_ = write_controller->GetStopToken();
       internal_stats_->AddCFStats(InternalStats::MEMTABLE_LIMIT_STOPS, 1);
       ROCKS_LOG_WARN(
@@ -1002,7 +1128,7 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
       // If the DB recovers from delay conditions, we reward with reducing
       // double the slowdown ratio. This is to balance the long term slowdown
       // increase signal.
-      if (needed_delay) {
+      if (needed_delay && !feedback_write_rate_control_) {
         uint64_t write_rate = write_controller->delayed_write_rate();
         write_controller->set_delayed_write_rate(static_cast<uint64_t>(
             static_cast<double>(write_rate) * kDelayRecoverSlowdownRatio));
@@ -1015,6 +1141,7 @@ WriteStallCondition ColumnFamilyData::RecalculateWriteStallConditions(
       }
     }
     prev_compaction_needed_bytes_ = compaction_needed_bytes;
+    prev_l0_delay_trigger_count_ = vstorage->l0_delay_trigger_count();
   }
   return write_stall_condition;
 }
@@ -1308,6 +1435,12 @@ Status ColumnFamilyData::ValidateOptions(
     s = Status::InvalidArgument(
         "max_successive_merges > 0 is incompatible with unordered_write");
   }
+  if (s.ok() && db_options.write_queue_shards > 1 &&
+      cf_options.max_successive_merges != 0) {
+    s = Status::InvalidArgument(
+        "max_successive_merges > 0 is incompatible with write_queue_shards > "
+        "1");
+  }
   if (s.ok()) {
     s = CheckCFPathsSupported(db_options, cf_options);
   }
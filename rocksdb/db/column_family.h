@@ -523,6 +523,15 @@ class ColumnFamilyData {
 
   std::vector<std::string> GetDbPaths() const;
 
+  // Used by RecalculateWriteStallConditions() with
+  // feedback_write_rate_control. Picks the write rate of the column family
+  // from how close it is to a write stop, and returns the delay token for it,
+  // or nullptr if writes need not be delayed. The DB is delayed at the lowest
+  // rate picked by its column families.
+  std::unique_ptr<WriteControllerToken> SetupFeedbackDelay(
+      const MutableCFOptions& mutable_cf_options,
+      uint64_t compaction_needed_bytes, double* pressure);
+
   uint32_t id_;
   const std::string name_;
   Version* dummy_versions_;  // Head of circular doubly-linked list of versions.
@@ -590,6 +599,11 @@ class ColumnFamilyData {
   bool queued_for_compaction_;
 
   uint64_t prev_compaction_needed_bytes_;
+  int prev_l0_delay_trigger_count_;
+  const bool feedback_write_rate_control_;
+  // The rate of the delay token from SetupFeedbackDelay() held by the column
+  // family, or 0
+  uint64_t feedback_write_rate_;
 
   // if the database was opened with 2pc enabled
   bool allow_2pc_;
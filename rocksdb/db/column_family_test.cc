@@ -2735,6 +2735,152 @@ TEST_P(ColumnFamilyTest, WriteStallSingleColumnFamily) {
   ASSERT_EQ(kBaseRate / 1.25, GetDbDelayedWriteRate());
 }
 
+#ifndef ROCKSDB_LITE  // GetMapProperty() is not supported in lite
+TEST_P(ColumnFamilyTest, FeedbackWriteRateControl) {
+  const uint64_t kBaseRate = 800000u;
+  db_options_.delayed_write_rate = kBaseRate;
+  db_options_.feedback_write_rate_control = true;
+
+  Open({"default"});
+  ColumnFamilyData* cfd =
+      static_cast<ColumnFamilyHandleImpl*>(db_->DefaultColumnFamily())->cfd();
+
+  VersionStorageInfo* vstorage = cfd->current()->storage_info();
+
+  MutableCFOptions mutable_cf_options(column_family_options_);
+
+  mutable_cf_options.level0_file_num_compaction_trigger = 4;
+  mutable_cf_options.level0_slowdown_writes_trigger = 20;
+  mutable_cf_options.level0_stop_writes_trigger = 36;
+  mutable_cf_options.soft_pending_compaction_bytes_limit = 1000;
+  mutable_cf_options.hard_pending_compaction_bytes_limit = 9000;
+  mutable_cf_options.disable_auto_compactions = false;
+
+  auto get_stat = [&](const std::string& name) {
+    std::map<std::string, std::string> stats;
+    EXPECT_TRUE(db_->GetMapProperty(DB::Properties::kCFStats, &stats));
+    return std::stoull(stats["io_stalls." + name]);
+  };
+
+  // Below the point where the rate starts to fall
+  vstorage->TEST_set_estimated_compaction_needed_bytes(500);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(!IsDbWriteStopped());
+  ASSERT_TRUE(!dbfull()->TEST_write_controler().NeedsDelay());
+
+  // Pending bytes doubled since the last recalculation, so writes are slowed
+  // down for where they are headed, even though the soft limit is not reached
+  vstorage->TEST_set_estimated_compaction_needed_bytes(1000);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(!IsDbWriteStopped());
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  uint64_t rate = GetDbDelayedWriteRate();
+  ASSERT_LT(rate, kBaseRate);
+  ASSERT_EQ(1u, get_stat("feedback_slowdown"));
+
+  // Compactions keep up, so the rate recovers a bit
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  ASSERT_GT(GetDbDelayedWriteRate(), rate);
+  ASSERT_LT(GetDbDelayedWriteRate(), kBaseRate);
+  rate = GetDbDelayedWriteRate();
+  ASSERT_EQ(1u, get_stat("feedback_speedup"));
+
+  // Level-0 files pile up towards the stop trigger
+  vstorage->set_l0_delay_trigger_count(30);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(!IsDbWriteStopped());
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  ASSERT_LT(GetDbDelayedWriteRate(), rate);
+  rate = GetDbDelayedWriteRate();
+  ASSERT_EQ(2u, get_stat("feedback_slowdown"));
+
+  vstorage->set_l0_delay_trigger_count(35);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  ASSERT_LT(GetDbDelayedWriteRate(), rate);
+  ASSERT_EQ(3u, get_stat("feedback_slowdown"));
+
+  // The stop triggers still apply
+  vstorage->set_l0_delay_trigger_count(36);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(IsDbWriteStopped());
+
+  // Once the debt is paid, writes go at full speed again
+  vstorage->set_l0_delay_trigger_count(0);
+  vstorage->TEST_set_estimated_compaction_needed_bytes(100);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(!IsDbWriteStopped());
+  ASSERT_TRUE(!dbfull()->TEST_write_controler().NeedsDelay());
+}
+
+TEST_P(ColumnFamilyTest, FeedbackWriteRateControlTwoColumnFamilies) {
+  const uint64_t kBaseRate = 800000u;
+  db_options_.delayed_write_rate = kBaseRate;
+  db_options_.feedback_write_rate_control = true;
+
+  Open();
+  CreateColumnFamilies({"one"});
+  ColumnFamilyData* cfd =
+      static_cast<ColumnFamilyHandleImpl*>(db_->DefaultColumnFamily())->cfd();
+  VersionStorageInfo* vstorage = cfd->current()->storage_info();
+  ColumnFamilyData* cfd1 =
+      static_cast<ColumnFamilyHandleImpl*>(handles_[1])->cfd();
+  VersionStorageInfo* vstorage1 = cfd1->current()->storage_info();
+
+  MutableCFOptions mutable_cf_options(column_family_options_);
+  mutable_cf_options.level0_file_num_compaction_trigger = 4;
+  mutable_cf_options.level0_slowdown_writes_trigger = 20;
+  mutable_cf_options.level0_stop_writes_trigger = 36;
+  mutable_cf_options.soft_pending_compaction_bytes_limit = 1000;
+  mutable_cf_options.hard_pending_compaction_bytes_limit = 9000;
+  mutable_cf_options.disable_auto_compactions = false;
+
+  auto get_stat = [&](ColumnFamilyHandle* handle, const std::string& name) {
+    std::map<std::string, std::string> stats;
+    EXPECT_TRUE(db_->GetMapProperty(handle, DB::Properties::kCFStats, &stats));
+    return std::stoull(stats["io_stalls." + name]);
+  };
+
+  // "one" is close to stopping writes
+  vstorage1->set_l0_delay_trigger_count(34);
+  RecalculateWriteStallConditions(cfd1, mutable_cf_options);
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  const uint64_t rate = GetDbDelayedWriteRate();
+  ASSERT_LT(rate, kBaseRate);
+
+  // The default column family is fine, which is not a speedup
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_EQ(rate, GetDbDelayedWriteRate());
+  ASSERT_EQ(0u, get_stat(handles_[0], "feedback_speedup"));
+
+  // Its own, milder, delay neither raises the rate of the DB nor is pulled
+  // towards the rate picked by "one"
+  vstorage->set_l0_delay_trigger_count(20);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_EQ(rate, GetDbDelayedWriteRate());
+  ASSERT_EQ(1u, get_stat(handles_[0], "feedback_slowdown"));
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_EQ(rate, GetDbDelayedWriteRate());
+  ASSERT_EQ(0u, get_stat(handles_[0], "feedback_speedup"));
+
+  // The default column family recovers, "one" still holds writes back
+  vstorage->set_l0_delay_trigger_count(0);
+  RecalculateWriteStallConditions(cfd, mutable_cf_options);
+  ASSERT_TRUE(dbfull()->TEST_write_controler().NeedsDelay());
+  ASSERT_EQ(rate, GetDbDelayedWriteRate());
+  ASSERT_EQ(1u, get_stat(handles_[0], "feedback_speedup"));
+
+  // Then "one" recovers too
+  vstorage1->set_l0_delay_trigger_count(0);
+  RecalculateWriteStallConditions(cfd1, mutable_cf_options);
+  ASSERT_TRUE(!dbfull()->TEST_write_controler().NeedsDelay());
+  ASSERT_EQ(1u, get_stat(handles_[1], "feedback_slowdown"));
+  ASSERT_EQ(1u, get_stat(handles_[1], "feedback_speedup"));
+}
+#endif  // !ROCKSDB_LITE
+
 TEST_P(ColumnFamilyTest, CompactionSpeedupSingleColumnFamily) {
   db_options_.max_background_compactions = 6;
   Open({"default"});
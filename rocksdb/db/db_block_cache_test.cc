@@ -286,10 +286,86 @@ TEST_F(DBBlockCacheTest, TestWithCompressedBlockCache) {
   delete iter;
   iter = nullptr;
 }
+
+TEST_F(DBBlockCacheTest, CompressUncompressedBlocksForCompressedCache) {
+  auto table_options = GetTableOptions();
+  auto options = GetOptions(table_options);
+  options.compression = CompressionType::kNoCompression;
+  InitTable(options);
+
+  std::shared_ptr<Cache> cache = NewLRUCache(1 << 25, 0, false);
+  std::shared_ptr<Cache> compressed_cache = NewLRUCache(1 << 25, 0, false);
+  table_options.block_cache = cache;
+  table_options.block_cache_compressed = compressed_cache;
+  table_options.block_cache_compressed_type = kSnappyCompression;
+  options.table_factory.reset(new BlockBasedTableFactory(table_options));
+  Reopen(options);
+  RecordCacheCounters(options);
+
+  // The block read from the file is compressed into the compressed cache.
+  std::string value(kValueSize, 'a');
+  ASSERT_EQ(value, Get("0"));
+  CheckCacheCounters(options, 1, 0, 1, 0);
+  CheckCompressedCacheCounters(options, 1, 0, 1, 0);
+  ASSERT_LT(0, compressed_cache->GetUsage());
+
+  // Once dropped from the block cache, the block comes from the compressed
+  // cache instead of the file.
+  cache->EraseUnRefEntries();
+  ASSERT_EQ(value, Get("0"));
+  CheckCacheCounters(options, 1, 0, 1, 0);
+  CheckCompressedCacheCounters(options, 0, 1, 0, 0);
+}
 #endif  // SNAPPY
 
 #ifndef ROCKSDB_LITE
 
+TEST_F(DBBlockCacheTest, WarmBlockCacheOnOpen) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.statistics = ROCKSDB_NAMESPACE::CreateDBStatistics();
+  options.block_cache_dump_period_sec = 3600;
+  BlockBasedTableOptions table_options;
+  table_options.block_cache = NewLRUCache(1 << 25, 0, false);
+  options.table_factory.reset(new BlockBasedTableFactory(table_options));
+  DestroyAndReopen(options);
+
+  for (int i = 0; i < 4; i++) {
+    ASSERT_OK(
+        Put(Key(i), DummyString(kValueSize, static_cast<char>('a' + i))));
+  }
+  ASSERT_OK(Flush());
+  ASSERT_EQ(DummyString(kValueSize, 'a'), Get(Key(0)));
+  ASSERT_EQ(1, TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS));
+
+  // The keys of the cached blocks are saved on close.
+  Close();
+  ASSERT_OK(env_->FileExists(BlockCacheKeysFileName(dbname_)));
+
+  // Reopened with an empty block cache, the DB loads the saved blocks back,
+  // so the first read is a hit.
+  table_options.block_cache = NewLRUCache(1 << 25, 0, false);
+  options.table_factory.reset(new BlockBasedTableFactory(table_options));
+  options.statistics = ROCKSDB_NAMESPACE::CreateDBStatistics();
+  Reopen(options);
+  dbfull()->TEST_WaitForBlockCacheWarmup();
+  ASSERT_EQ(1, TestGetTickerCount(options, BLOCK_CACHE_DATA_ADD));
+  uint64_t misses = TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS);
+  ASSERT_EQ(DummyString(kValueSize, 'a'), Get(Key(0)));
+  ASSERT_EQ(1, TestGetTickerCount(options, BLOCK_CACHE_DATA_HIT));
+  ASSERT_EQ(misses, TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS));
+
+  // Without the option, nothing is loaded on open.
+  Close();
+  table_options.block_cache = NewLRUCache(1 << 25, 0, false);
+  options.table_factory.reset(new BlockBasedTableFactory(table_options));
+  options.statistics = ROCKSDB_NAMESPACE::CreateDBStatistics();
+  options.block_cache_dump_period_sec = 0;
+  Reopen(options);
+  ASSERT_EQ(DummyString(kValueSize, 'a'), Get(Key(0)));
+  ASSERT_EQ(1, TestGetTickerCount(options, BLOCK_CACHE_DATA_MISS));
+}
+
 // Make sure that when options.block_cache is set, after a new table is
 // created its index/filter blocks are added to block cache.
 TEST_F(DBBlockCacheTest, IndexAndFilterBlocksOfNewTableAddedToCache) {
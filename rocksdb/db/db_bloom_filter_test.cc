@@ -1013,6 +1013,81 @@ TEST_F(DBBloomFilterTest, MemtableWholeKeyBloomFilter) {
   ASSERT_EQ(1, get_perf_context()->bloom_memtable_hit_count);
 }
 
+TEST_F(DBBloomFilterTest, MemtableWholeKeyBloomFilterAutoSize) {
+  // memtable_prefix_bloom_size_ratio is left at 0, so the whole key filter is
+  // sized from write_buffer_size. It must reject misses in every immutable
+  // memtable regardless of the memtable representation.
+  std::vector<std::shared_ptr<MemTableRepFactory>> factories;
+  factories.emplace_back(new SkipListFactory());
+  factories.emplace_back(new VectorRepFactory());
+#ifndef ROCKSDB_LITE
+  factories.emplace_back(NewHashSkipListRepFactory(1000));
+  factories.emplace_back(NewAVLTreeRepFactory());
+  factories.emplace_back(NewBTreeRepFactory());
+  factories.emplace_back(NewARTRepFactory());
+#endif  // ROCKSDB_LITE
+  const int kNumMemtables = 3;
+  for (auto& factory : factories) {
+    Options options = CurrentOptions();
+    options.memtable_factory = factory;
+    options.allow_concurrent_memtable_write = false;
+    if (std::string(factory->Name()) == "HashSkipListRepFactory") {
+      options.prefix_extractor.reset(NewFixedPrefixTransform(4));
+    } else {
+      options.prefix_extractor.reset();
+    }
+    options.write_buffer_size = 1 << 20;
+    options.max_write_buffer_number = kNumMemtables + 1;
+    options.min_write_buffer_number_to_merge = kNumMemtables + 1;
+    options.memtable_prefix_bloom_size_ratio = 0;
+    options.memtable_whole_key_filtering = true;
+    DestroyAndReopen(options);
+
+    for (int i = 0; i < kNumMemtables; ++i) {
+      ASSERT_OK(Put("key" + ToString(i), "value" + ToString(i)));
+      if (i + 1 < kNumMemtables) {
+        ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+      }
+    }
+
+    get_perf_context()->Reset();
+    ASSERT_EQ("NOT_FOUND", Get("missing"));
+    ASSERT_EQ(kNumMemtables, get_perf_context()->bloom_memtable_miss_count);
+    ASSERT_EQ(0, get_perf_context()->bloom_memtable_hit_count);
+
+    // The oldest key is only found after the two newer memtables are skipped
+    get_perf_context()->Reset();
+    ASSERT_EQ("value0", Get("key0"));
+    ASSERT_EQ(kNumMemtables - 1,
+              get_perf_context()->bloom_memtable_miss_count);
+    ASSERT_EQ(1, get_perf_context()->bloom_memtable_hit_count);
+
+    get_perf_context()->Reset();
+    std::vector<std::string> values = MultiGet({"key2", "missing", "key1"});
+    ASSERT_EQ("value2", values[0]);
+    ASSERT_EQ("NOT_FOUND", values[1]);
+    ASSERT_EQ("value1", values[2]);
+    // Found keys drop out of the batch: 2 misses in the mutable memtable, 1
+    // in each immutable one
+    ASSERT_EQ(kNumMemtables + 1,
+              get_perf_context()->bloom_memtable_miss_count);
+    ASSERT_EQ(2, get_perf_context()->bloom_memtable_hit_count);
+
+    // Without whole key filtering there is no filter to consult
+    options.memtable_whole_key_filtering = false;
+    options.prefix_extractor.reset();
+    if (std::string(factory->Name()) == "HashSkipListRepFactory") {
+      continue;
+    }
+    DestroyAndReopen(options);
+    ASSERT_OK(Put("key0", "value0"));
+    get_perf_context()->Reset();
+    ASSERT_EQ("NOT_FOUND", Get("missing"));
+    ASSERT_EQ(0, get_perf_context()->bloom_memtable_miss_count);
+    ASSERT_EQ(0, get_perf_context()->bloom_memtable_hit_count);
+  }
+}
+
 TEST_F(DBBloomFilterTest, MemtablePrefixBloomOutOfDomain) {
   constexpr size_t kPrefixSize = 8;
   const std::string kKey = "key";
@@ -108,6 +108,10 @@ Status DBImpl::GetLiveFiles(std::vector<std::string>& ret,
 }
 
 Status DBImpl::GetSortedWalFiles(VectorLogPtr& files) {
+  if (!immutable_db_options_.wal_stripe_dirs.empty()) {
+    return Status::NotSupported(
+        "GetSortedWalFiles() is not supported with wal_stripe_dirs");
+  }
   {
     // If caller disabled deletions, this function should return files that are
     // guaranteed not to be deleted until deletions are re-enabled. We need to
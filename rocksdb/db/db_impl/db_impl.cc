@@ -179,6 +179,8 @@ DBImpl::DBImpl(const DBOptions& options, const std::string& dbname,
       write_buffer_manager_(immutable_db_options_.write_buffer_manager.get()),
       write_thread_(immutable_db_options_),
       nonmem_write_thread_(immutable_db_options_),
+      write_queue_shards_exclusive_(false),
+      write_queue_shards_cv_(&mutex_),
       write_controller_(mutable_db_options_.delayed_write_rate),
       last_batch_group_size_(0),
       unscheduled_flushes_(0),
@@ -189,6 +191,7 @@ DBImpl::DBImpl(const DBOptions& options, const std::string& dbname,
       bg_flush_scheduled_(0),
       num_running_flushes_(0),
       bg_purge_scheduled_(0),
+      bg_memtable_compaction_scheduled_(0),
       disable_delete_obsolete_files_(0),
       pending_purge_obsolete_files_(0),
       delete_obsolete_files_last_run_(env_->NowMicros()),
@@ -235,6 +238,19 @@ DBImpl::DBImpl(const DBOptions& options, const std::string& dbname,
   // !batch_per_trx_ implies seq_per_batch_ because it is only unset for
   // WriteUnprepared, which should use seq_per_batch_.
   assert(batch_per_txn_ || seq_per_batch_);
+  if (!seq_per_batch_) {
+    for (int i = 1; i < options.write_queue_shards; i++) {
+      write_queue_shards_.emplace_back(new WriteThread(immutable_db_options_));
+    }
+  }
+  if (immutable_db_options_.memtable_insert_threads > 1) {
+    memtable_insert_pool_.reset(
+        NewThreadPool(immutable_db_options_.memtable_insert_threads - 1));
+  }
+  if (!immutable_db_options_.wal_stripe_dirs.empty()) {
+    wal_stripe_mutexes_.reset(
+        new InstrumentedMutex[immutable_db_options_.wal_stripe_dirs.size() + 1]);
+  }
   // TODO: Check for an error here
   env_->GetAbsolutePath(dbname, &db_absolute_path_).PermitUncheckedError();
 
@@ -435,7 +451,7 @@ Status DBImpl::ResumeImpl() {
 void DBImpl::WaitForBackgroundWork() {
   // Wait for background work to finish
   while (bg_bottom_compaction_scheduled_ || bg_compaction_scheduled_ ||
-         bg_flush_scheduled_) {
+         bg_flush_scheduled_ || bg_memtable_compaction_scheduled_) {
     bg_cv_.Wait();
   }
 }
@@ -484,6 +500,23 @@ void DBImpl::CancelAllBackgroundWork(bool wait) {
 }
 
 Status DBImpl::CloseHelper() {
+  // Let the writes of WriteAsync() in flight complete
+  {
+    std::unique_lock<std::mutex> lock(async_write_mutex_);
+    async_write_cv_.wait(lock, [&] { return pending_async_writes_ == 0; });
+    async_write_shutdown_ = true;
+  }
+  async_write_cv_.notify_all();
+  if (async_write_thread_.joinable()) {
+    async_write_thread_.join();
+  }
+  if (memtable_insert_pool_ != nullptr) {
+    memtable_insert_pool_->JoinAllThreads();
+  }
+#ifndef ROCKSDB_LITE
+  StopBlockCacheKeys();
+#endif  // !ROCKSDB_LITE
+
   // Guarantee that there is no background error recovery in progress before
   // continuing with the shutdown
   mutex_.Lock();
@@ -511,7 +544,7 @@ Status DBImpl::CloseHelper() {
   // Wait for background work to finish
   while (bg_bottom_compaction_scheduled_ || bg_compaction_scheduled_ ||
          bg_flush_scheduled_ || bg_purge_scheduled_ ||
-         pending_purge_obsolete_files_ ||
+         bg_memtable_compaction_scheduled_ || pending_purge_obsolete_files_ ||
          error_handler_.IsRecoveryInProgress()) {
     TEST_SYNC_POINT("DBImpl::~DBImpl:WaitJob");
     bg_cv_.Wait();
@@ -532,6 +565,10 @@ Status DBImpl::CloseHelper() {
     auto cfd = PopFirstFromCompactionQueue();
     cfd->UnrefAndTryDelete();
   }
+  while (!memtable_compaction_queue_.empty()) {
+    memtable_compaction_queue_.front()->UnrefAndTryDelete();
+    memtable_compaction_queue_.pop_front();
+  }
 
   if (default_cf_handle_ != nullptr || persist_stats_cf_handle_ != nullptr) {
     // we need to delete handle outside of lock because it does its own locking
@@ -693,9 +730,10 @@ void DBImpl::StartStatsDumpScheduler() {
                              &stats_dump_scheduler_);
   }
 
-  stats_dump_scheduler_->Register(this,
-                                  mutable_db_options_.stats_dump_period_sec,
-                                  mutable_db_options_.stats_persist_period_sec);
+  stats_dump_scheduler_->Register(
+      this, mutable_db_options_.stats_dump_period_sec,
+      mutable_db_options_.stats_persist_period_sec,
+      immutable_db_options_.block_cache_dump_period_sec);
 #endif  // !ROCKSDB_LITE
 }
 
@@ -1087,11 +1125,13 @@ Status DBImpl::SetDBOptions(
           mutex_.Lock();
         }
         if (new_options.stats_dump_period_sec > 0 ||
-            new_options.stats_persist_period_sec > 0) {
+            new_options.stats_persist_period_sec > 0 ||
+            immutable_db_options_.block_cache_dump_period_sec > 0) {
           mutex_.Unlock();
-          stats_dump_scheduler_->Register(this,
-                                          new_options.stats_dump_period_sec,
-                                          new_options.stats_persist_period_sec);
+          stats_dump_scheduler_->Register(
+              this, new_options.stats_dump_period_sec,
+              new_options.stats_persist_period_sec,
+              immutable_db_options_.block_cache_dump_period_sec);
           mutex_.Lock();
         }
       }
@@ -1114,6 +1154,7 @@ Status DBImpl::SetDBOptions(
           mutable_db_options_.compaction_readahead_size;
       WriteThread::Writer w;
       write_thread_.EnterUnbatched(&w, &mutex_);
+      BeginWriteQueueShardsExclusive();
       if (total_log_size_ > GetMaxTotalWalSize() || wal_changed) {
         Status purge_wal_status = SwitchWAL(&write_context);
         if (!purge_wal_status.ok()) {
@@ -1124,6 +1165,7 @@ Status DBImpl::SetDBOptions(
       }
       persist_options_status = WriteOptionsFile(
           false /*need_mutex_lock*/, false /*need_enter_write_thread*/);
+      EndWriteQueueShardsExclusive();
       write_thread_.ExitUnbatched(&w);
     }
   }
@@ -1179,8 +1221,7 @@ Status DBImpl::FlushWAL(bool sync) {
     {
       // We need to lock log_write_mutex_ since logs_ might change concurrently
       InstrumentedMutexLock wl(&log_write_mutex_);
-      log::Writer* cur_log_writer = logs_.back().writer;
-      io_s = cur_log_writer->WriteBuffer();
+      io_s = WriteWALBuffers();
     }
     if (!io_s.ok()) {
       ROCKS_LOG_ERROR(immutable_db_options_.info_log, "WAL flush error %s",
@@ -1223,12 +1264,14 @@ Status DBImpl::SyncWAL() {
     // First check that logs are safe to sync in background.
     for (auto it = logs_.begin();
          it != logs_.end() && it->number <= current_log_number; ++it) {
-      if (!it->writer->file()->writable_file()->IsSyncThreadSafe()) {
-        return Status::NotSupported(
-            "SyncWAL() is not supported for this implementation of WAL file",
-            immutable_db_options_.allow_mmap_writes
-                ? "try setting Options::allow_mmap_writes to false"
-                : Slice());
+      for (size_t i = 0; i < it->num_stripes(); i++) {
+        if (!it->stripe(i)->file()->writable_file()->IsSyncThreadSafe()) {
+          return Status::NotSupported(
+              "SyncWAL() is not supported for this implementation of WAL file",
+              immutable_db_options_.allow_mmap_writes
+                  ? "try setting Options::allow_mmap_writes to false"
+                  : Slice());
+        }
       }
     }
     for (auto it = logs_.begin();
@@ -1236,7 +1279,9 @@ Status DBImpl::SyncWAL() {
       auto& log = *it;
       assert(!log.getting_synced);
       log.getting_synced = true;
-      logs_to_sync.push_back(log.writer);
+      for (size_t i = 0; i < log.num_stripes(); i++) {
+        logs_to_sync.push_back(log.stripe(i));
+      }
     }
 
     need_log_dir_sync = !log_dir_synced_;
@@ -1261,7 +1306,7 @@ Status DBImpl::SyncWAL() {
     IOStatusCheck(io_s);
   }
   if (status.ok() && need_log_dir_sync) {
-    status = directories_.GetWalDir()->Fsync(IOOptions(), nullptr);
+    status = directories_.FsyncWalDirs(IOOptions(), nullptr);
   }
   TEST_SYNC_POINT("DBWALTest::SyncWALNotWaitWrite:2");
 
@@ -1277,8 +1322,7 @@ Status DBImpl::SyncWAL() {
 
 Status DBImpl::LockWAL() {
   log_write_mutex_.Lock();
-  auto cur_log_writer = logs_.back().writer;
-  auto status = cur_log_writer->WriteBuffer();
+  auto status = WriteWALBuffers();
   if (!status.ok()) {
     ROCKS_LOG_ERROR(immutable_db_options_.info_log, "WAL flush error %s",
                     status.ToString().c_str());
@@ -1304,7 +1348,7 @@ void DBImpl::MarkLogsSynced(uint64_t up_to, bool synced_dir,
     auto& log = *it;
     assert(log.getting_synced);
     if (status.ok() && logs_.size() > 1) {
-      logs_to_free_.push_back(log.ReleaseWriter());
+      log.ReleaseWriters(&logs_to_free_);
       // To modify logs_ both mutex_ and log_write_mutex_ must be held
       InstrumentedMutexLock l(&log_write_mutex_);
       it = logs_.erase(it);
@@ -2518,11 +2562,13 @@ Status DBImpl::CreateColumnFamilyImpl(const ColumnFamilyOptions& cf_options,
     {  // write thread
       WriteThread::Writer w;
       write_thread_.EnterUnbatched(&w, &mutex_);
+      BeginWriteQueueShardsExclusive();
       // LogAndApply will both write the creation in MANIFEST and create
       // ColumnFamilyData object
       s = versions_->LogAndApply(nullptr, MutableCFOptions(cf_options), &edit,
                                  &mutex_, directories_.GetDbDir(), false,
                                  &cf_options);
+      EndWriteQueueShardsExclusive();
       write_thread_.ExitUnbatched(&w);
     }
     if (s.ok()) {
@@ -2620,8 +2666,10 @@ Status DBImpl::DropColumnFamilyImpl(ColumnFamilyHandle* column_family) {
       // we drop column family from a single write thread
       WriteThread::Writer w;
       write_thread_.EnterUnbatched(&w, &mutex_);
+      BeginWriteQueueShardsExclusive();
       s = versions_->LogAndApply(cfd, *cfd->GetLatestMutableCFOptions(), &edit,
                                  &mutex_);
+      EndWriteQueueShardsExclusive();
       write_thread_.ExitUnbatched(&w);
     }
     if (s.ok()) {
@@ -3360,6 +3408,10 @@ Status DBImpl::GetUpdatesSince(
     SequenceNumber seq, std::unique_ptr<TransactionLogIterator>* iter,
     const TransactionLogIterator::ReadOptions& read_options) {
   RecordTick(stats_, GET_UPDATES_SINCE_CALLS);
+  if (!immutable_db_options_.wal_stripe_dirs.empty()) {
+    return Status::NotSupported(
+        "GetUpdatesSince() is not supported with wal_stripe_dirs");
+  }
   if (seq > versions_->LastSequence()) {
     return Status::NotFound("Requested sequence not yet written in the db");
   }
@@ -3798,6 +3850,10 @@ Status DestroyDB(const std::string& dbname, const Options& options,
         }
       }
     }
+    // Not recognized by ParseFileName, and absent unless
+    // block_cache_dump_period_sec was set
+    env->DeleteFile(BlockCacheKeysFileName(dbname)).PermitUncheckedError();
+    env->DeleteFile(TempBlockCacheKeysFileName(dbname)).PermitUncheckedError();
 
     std::set<std::string> paths;
     for (const DbPath& db_path : options.db_paths) {
@@ -3871,6 +3927,27 @@ Status DestroyDB(const std::string& dbname, const Options& options,
       env->DeleteDir(soptions.wal_dir).PermitUncheckedError();
     }
 
+    // Delete log files of the other WAL stripes
+    for (const auto& wal_stripe_dir : soptions.wal_stripe_dirs) {
+      std::vector<std::string> stripe_files;
+      if (!env->GetChildren(wal_stripe_dir, &stripe_files).ok()) {
+        continue;
+      }
+      for (const auto& file : stripe_files) {
+        if (ParseFileName(file, &number, &type) && type == kLogFile) {
+          Status del =
+              DeleteDBFile(&soptions, LogFileName(wal_stripe_dir, number),
+                           wal_stripe_dir, /*force_bg=*/false,
+                           /*force_fg=*/true);
+          if (!del.ok() && result.ok()) {
+            result = del;
+          }
+        }
+      }
+      // Ignore error in case dir contains other files
+      env->DeleteDir(wal_stripe_dir).PermitUncheckedError();
+    }
+
     // Ignore error since state is already gone
     env->UnlockFile(lock).PermitUncheckedError();
     env->DeleteFile(lockname).PermitUncheckedError();
@@ -4337,6 +4414,7 @@ Status DBImpl::IngestExternalFiles(
     if (two_write_queues_) {
       nonmem_write_thread_.EnterUnbatched(&nonmem_w, &mutex_);
     }
+    BeginWriteQueueShardsExclusive();
 
     // When unordered_write is enabled, the keys are writing to memtable in an
     // unordered way. If the ingestion job checks memtable key range before the
@@ -4485,6 +4563,7 @@ Status DBImpl::IngestExternalFiles(
     }
 
     // Resume writes to the DB
+    EndWriteQueueShardsExclusive();
     if (two_write_queues_) {
       nonmem_write_thread_.ExitUnbatched(&nonmem_w);
     }
@@ -4598,6 +4677,7 @@ Status DBImpl::CreateColumnFamilyWithImport(
       if (two_write_queues_) {
         nonmem_write_thread_.EnterUnbatched(&nonmem_w, &mutex_);
       }
+      BeginWriteQueueShardsExclusive();
 
       num_running_ingest_file_++;
       assert(!cfd->IsDropped());
@@ -4614,6 +4694,7 @@ Status DBImpl::CreateColumnFamilyWithImport(
       }
 
       // Resume writes to the DB
+      EndWriteQueueShardsExclusive();
       if (two_write_queues_) {
         nonmem_write_thread_.ExitUnbatched(&nonmem_w);
       }
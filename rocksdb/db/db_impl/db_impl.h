@@ -29,6 +29,7 @@
 #include "db/flush_scheduler.h"
 #include "db/import_column_family_job.h"
 #include "db/internal_stats.h"
+#include "db/log_reader.h"
 #include "db/log_writer.h"
 #include "db/logs_with_prep_tracker.h"
 #include "db/memtable_list.h"
@@ -50,6 +51,7 @@
 #include "rocksdb/env.h"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/status.h"
+#include "rocksdb/threadpool.h"
 #include "rocksdb/trace_reader_writer.h"
 #include "rocksdb/transaction_log.h"
 #include "rocksdb/write_buffer_manager.h"
@@ -89,6 +91,7 @@ class Directories {
  public:
   IOStatus SetDirectories(FileSystem* fs, const std::string& dbname,
                           const std::string& wal_dir,
+                          const std::vector<std::string>& wal_stripe_dirs,
                           const std::vector<DbPath>& data_paths);
 
   FSDirectory* GetDataDir(size_t path_id) const {
@@ -108,12 +111,32 @@ class Directories {
     return db_dir_.get();
   }
 
+  // Returns the directory of WAL stripe i, where stripe 0 is in wal_dir and
+  // the others in DBOptions::wal_stripe_dirs
+  FSDirectory* GetWalStripeDir(size_t stripe) {
+    if (stripe == 0) {
+      return GetWalDir();
+    }
+    assert(stripe <= wal_stripe_dirs_.size());
+    return wal_stripe_dirs_[stripe - 1].get();
+  }
+
+  // Fsyncs wal_dir and the directories of the other WAL stripes
+  IOStatus FsyncWalDirs(const IOOptions& options, IODebugContext* dbg) {
+    IOStatus io_s;
+    for (size_t i = 0; io_s.ok() && i <= wal_stripe_dirs_.size(); i++) {
+      io_s = GetWalStripeDir(i)->Fsync(options, dbg);
+    }
+    return io_s;
+  }
+
   FSDirectory* GetDbDir() { return db_dir_.get(); }
 
  private:
   std::unique_ptr<FSDirectory> db_dir_;
   std::vector<std::unique_ptr<FSDirectory>> data_dirs_;
   std::unique_ptr<FSDirectory> wal_dir_;
+  std::vector<std::unique_ptr<FSDirectory>> wal_stripe_dirs_;
 };
 
 // While DB is the public interface of RocksDB, and DBImpl is the actual
@@ -163,6 +186,8 @@ class DBImpl : public DB {
   using DB::Write;
   virtual Status Write(const WriteOptions& options,
                        WriteBatch* updates) override;
+  virtual Status WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                            std::function<void(Status)> callback) override;
 
   using DB::Get;
   virtual Status Get(const ReadOptions& options,
@@ -1003,6 +1028,10 @@ class DBImpl : public DB {
 
 #ifndef ROCKSDB_LITE
   StatsDumpTestScheduler* TEST_GetStatsDumpScheduler() const;
+
+  // Waits until the blocks listed in the block cache keys file were loaded
+  // into the block cache after DB::Open()
+  void TEST_WaitForBlockCacheWarmup();
 #endif  // !ROCKSDB_LITE
 
 #endif  // NDEBUG
@@ -1013,6 +1042,10 @@ class DBImpl : public DB {
   // dump rocksdb.stats to LOG
   void DumpStats();
 
+  // Saves the keys of the blocks in the block cache, unless the block cache
+  // is still being warmed up. See DBOptions::block_cache_dump_period_sec.
+  void SaveBlockCacheKeys();
+
  protected:
   const std::string dbname_;
   std::string db_id_;
@@ -1139,18 +1172,73 @@ class DBImpl : public DB {
                    size_t batch_cnt = 0,
                    PreReleaseCallback* pre_release_callback = nullptr);
 
+  // The part of WriteImpl() done by w once it became the leader of a write
+  // group of write_thread_
+  Status WriteAsBatchGroupLeader(WriteThread::Writer* w,
+                                 const WriteOptions& write_options,
+                                 uint64_t* log_used, bool disable_memtable,
+                                 uint64_t* seq_used);
+
   Status PipelinedWriteImpl(const WriteOptions& options, WriteBatch* updates,
                             WriteCallback* callback = nullptr,
                             uint64_t* log_used = nullptr, uint64_t log_ref = 0,
                             bool disable_memtable = false,
                             uint64_t* seq_used = nullptr);
 
+  // Write through write_thread, one of the queues of write_queue_shards > 1
+  Status ShardedWriteImpl(WriteThread* write_thread,
+                          const WriteOptions& write_options,
+                          WriteBatch* my_batch, WriteCallback* callback,
+                          uint64_t* log_used, uint64_t log_ref,
+                          bool disable_memtable, uint64_t* seq_used,
+                          PreReleaseCallback* pre_release_callback);
+
   // Write only to memtables without joining any write queue
   Status UnorderedWriteMemtable(const WriteOptions& write_options,
                                 WriteBatch* my_batch, WriteCallback* callback,
                                 uint64_t log_ref, SequenceNumber seq,
                                 const size_t sub_batch_cnt);
 
+  // A write of WriteAsync(). No thread waits on it: when it becomes the
+  // leader of a write group, async_write_thread_ does the leader's work, and
+  // it runs the callback once the write is completed.
+  struct AsyncWriter : public WriteThread::Writer {
+    AsyncWriter(const WriteOptions& _write_options, WriteBatch* _batch,
+                std::function<void(Status)>&& _done,
+                WriteThread::AsyncHandler* handler, Env* env,
+                Statistics* statistics)
+        : WriteThread::Writer(_write_options, _batch, nullptr /*callback*/,
+                              0 /*log_ref*/, false /*disable_memtable*/),
+          write_options(_write_options),
+          done(std::move(_done)),
+          write_sw(env, statistics, DB_WRITE) {
+      async_handler = handler;
+    }
+
+    WriteOptions write_options;
+    std::function<void(Status)> done;
+    // Times the write into DB_WRITE until the writer is deleted, like the
+    // StopWatch of WriteImpl() does for a blocking write
+    StopWatch write_sw;
+  };
+
+  class AsyncWriteHandler : public WriteThread::AsyncHandler {
+   public:
+    explicit AsyncWriteHandler(DBImpl* db) : db_(db) {}
+
+    void BecomeLeader(WriteThread::Writer* w) override;
+    void Complete(WriteThread::Writer* w) override;
+
+   private:
+    DBImpl* db_;
+  };
+
+  // Body of async_write_thread_
+  void AsyncWriteThread();
+
+  // Calls back and frees w
+  void CompleteAsyncWrite(AsyncWriter* w, const Status& s);
+
   // Whether the batch requires to be assigned with an order
   enum AssignOrder : bool { kDontAssignOrder, kDoAssignOrder };
   // Whether it requires publishing last sequence or not
@@ -1264,26 +1352,66 @@ class DBImpl : public DB {
   };
 
   struct LogWriterNumber {
-    // pass ownership of _writer
-    LogWriterNumber(uint64_t _number, log::Writer* _writer)
-        : number(_number), writer(_writer) {}
-
-    log::Writer* ReleaseWriter() {
-      auto* w = writer;
+    // pass ownership of _writer and _stripe_writers
+    LogWriterNumber(uint64_t _number, log::Writer* _writer,
+                    std::vector<log::Writer*> _stripe_writers = {})
+        : number(_number),
+          writer(_writer),
+          stripe_writers(std::move(_stripe_writers)) {}
+
+    // Passes the ownership of the writers of all the stripes to *writers
+    void ReleaseWriters(autovector<log::Writer*>* writers) {
+      writers->push_back(writer);
       writer = nullptr;
-      return w;
+      for (auto* w : stripe_writers) {
+        writers->push_back(w);
+      }
+      stripe_writers.clear();
     }
     Status ClearWriter() {
       Status s = writer->WriteBuffer();
       delete writer;
       writer = nullptr;
+      for (auto* w : stripe_writers) {
+        Status ws = w->WriteBuffer();
+        if (s.ok()) {
+          s = ws;
+        }
+        delete w;
+      }
+      stripe_writers.clear();
       return s;
     }
 
+    // The log is striped over num_stripes() files, stripe 0 being the one in
+    // wal_dir, see DBOptions::wal_stripe_dirs
+    size_t num_stripes() const { return stripe_writers.size() + 1; }
+    log::Writer* stripe(size_t i) const {
+      return i == 0 ? writer : stripe_writers[i - 1];
+    }
+
+    // Picks the stripe to write the next record to, in turn, and numbers the
+    // record. The ordinal is zero for a log that is not striped. Callers
+    // serialize as they do the writes to the log.
+    log::Writer* NextStripe(size_t* stripe_index, uint64_t* ordinal) {
+      if (stripe_writers.empty()) {
+        *stripe_index = 0;
+        *ordinal = 0;
+        return writer;
+      }
+      *stripe_index = next_stripe;
+      *ordinal = next_ordinal++;
+      next_stripe = (next_stripe + 1) % num_stripes();
+      return stripe(*stripe_index);
+    }
+
     uint64_t number;
     // Visual Studio doesn't support deque's member to be noncopyable because
     // of a std::unique_ptr as a member.
     log::Writer* writer;  // own
+    std::vector<log::Writer*> stripe_writers;  // own
+    size_t next_stripe = 0;
+    uint64_t next_ordinal = 1;
     // true for some prefix of logs_
     bool getting_synced = false;
   };
@@ -1364,6 +1492,13 @@ class DBImpl : public DB {
     PrepickedCompaction* prepicked_compaction;
   };
 
+  struct MemTableCompactionArg {
+    // caller retains ownership of `db`.
+    DBImpl* db;
+    // the scheduler holds a reference on `cfd` for the background job.
+    ColumnFamilyData* cfd;
+  };
+
   // Initialize the built-in column family for persistent stats. Depending on
   // whether on-disk persistent stats have been enabled before, it may either
   // create a new column family and column family handle or just a column family
@@ -1444,6 +1579,12 @@ class DBImpl : public DB {
 
   // REQUIRES: log_numbers are sorted in ascending order
   // corrupted_log_found is set to true if we recover from a corrupted log file.
+  // Opens the files of log_number in DBOptions::wal_stripe_dirs, if it was
+  // striped, and adds their readers to *readers.
+  Status OpenWalStripeReaders(
+      uint64_t log_number, log::Reader::Reporter* reporter,
+      std::vector<std::unique_ptr<log::Reader>>* readers);
+
   Status RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
                          SequenceNumber* next_sequence, bool read_only,
                          bool* corrupted_log_found);
@@ -1464,7 +1605,9 @@ class DBImpl : public DB {
 
   // num_bytes: for slowdown case, delay time is calculated based on
   //            `num_bytes` going through.
-  Status DelayWrite(uint64_t num_bytes, const WriteOptions& write_options);
+  // write_thread: the write queue whose leader is calling.
+  Status DelayWrite(uint64_t num_bytes, WriteThread* write_thread,
+                    const WriteOptions& write_options);
 
   Status ThrottleLowPriWritesIfNeeded(const WriteOptions& write_options,
                                       WriteBatch* my_batch);
@@ -1538,6 +1681,28 @@ class DBImpl : public DB {
     }
   }
 
+  // Returns the write queue that a write with these options goes through.
+  WriteThread* GetWriteQueue(const WriteOptions& write_options,
+                             WriteBatch* my_batch);
+
+  // With write_queue_shards_, waits for the write groups of all the queues
+  // that are writing to the WAL and memtables to be done, and keeps new ones
+  // from starting until EndWriteQueueShardsExclusive(). This is what entering
+  // write_thread_ guarantees with a single write queue, as needed to switch
+  // memtables or change column families. No-op without write_queue_shards_.
+  // REQUIRES: mutex_ held
+  void BeginWriteQueueShardsExclusive();
+  void EndWriteQueueShardsExclusive();
+
+  // Registers a write group of one of the queues once its leader is done with
+  // PreprocessWrite(). REQUIRES: mutex_ held, write_queue_shards_ not empty
+  void EnterWriteQueueShardGroup();
+  // Makes sequence numbers (prev_sequence, last_sequence] of a registered
+  // write group visible, after the groups of the other queues that got
+  // earlier sequence numbers did, and unregisters it.
+  void ExitWriteQueueShardGroup(SequenceNumber prev_sequence,
+                                SequenceNumber last_sequence);
+
   // REQUIRES: mutex locked and in write thread.
   void AssignAtomicFlushSeq(const autovector<ColumnFamilyData*>& cfds);
 
@@ -1547,25 +1712,58 @@ class DBImpl : public DB {
   // REQUIRES: mutex locked and in write thread.
   Status HandleWriteBufferFull(WriteContext* write_context);
 
-  // REQUIRES: mutex locked
+  // REQUIRES: mutex locked and the leader of write_thread
   Status PreprocessWrite(const WriteOptions& write_options, bool* need_log_sync,
-                         WriteContext* write_context);
+                         WriteContext* write_context,
+                         WriteThread* write_thread);
 
   WriteBatch* MergeBatch(const WriteThread::WriteGroup& write_group,
                          WriteBatch* tmp_batch, size_t* write_with_wal,
                          WriteBatch** to_be_cached_state);
 
+  // Inserts the batch of w, the only writer of its write group, into the
+  // memtables with the calling thread and memtable_insert_pool_, which each
+  // insert a range of its records. Returns false, without inserting anything, if that
+  // is disabled or the batch is too small or cannot be split; otherwise sets
+  // w->status.
+  bool InsertBatchInParallel(WriteThread::Writer* w,
+                             bool ignore_missing_column_families);
+
+  // record_ordinal: numbers the record in a striped WAL, if non-zero. See
+  // LogWriterNumber::NextStripe.
   IOStatus WriteToWAL(const WriteBatch& merged_batch, log::Writer* log_writer,
-                      uint64_t* log_used, uint64_t* log_size);
+                      uint64_t* log_used, uint64_t* log_size,
+                      uint64_t record_ordinal = 0);
+
+  // Returns the size of the WAL record of merged_batch. If the batch refers
+  // to pinned values, also sets *log_entry_parts to the slices the record is
+  // gathered from, see WriteBatchInternal::GetContentsParts().
+  static uint64_t GetWALRecordParts(const WriteBatch& merged_batch,
+                                    std::vector<Slice>* log_entry_parts);
+
+  // Appends merged_batch to the WAL file of log_writer, preceded by its
+  // ordinal if record_ordinal is non-zero. log_entry_parts is as set by
+  // GetWALRecordParts().
+  IOStatus AddWALRecord(const WriteBatch& merged_batch,
+                        const std::vector<Slice>& log_entry_parts,
+                        log::Writer* log_writer, uint64_t record_ordinal);
+
+  // Writes out the buffered records of every stripe of the current WAL.
+  // REQUIRES: log_write_mutex_ held
+  IOStatus WriteWALBuffers();
 
   IOStatus WriteToWAL(const WriteThread::WriteGroup& write_group,
-                      log::Writer* log_writer, uint64_t* log_used,
+                      LogWriterNumber* log, uint64_t* log_used,
                       bool need_log_sync, bool need_log_dir_sync,
                       SequenceNumber sequence);
 
+  // need_log_sync: also sync the WAL, as only the write queues of
+  // write_queue_shards_ do.
   IOStatus ConcurrentWriteToWAL(const WriteThread::WriteGroup& write_group,
                                 uint64_t* log_used,
-                                SequenceNumber* last_sequence, size_t seq_inc);
+                                SequenceNumber* last_sequence, size_t seq_inc,
+                                bool need_log_sync = false,
+                                bool need_log_dir_sync = false);
 
   // Used by WriteImpl to update bg_error_ if paranoid check is enabled.
   // Caller must hold mutex_.
@@ -1621,18 +1819,23 @@ class DBImpl : public DB {
   void SchedulePendingCompaction(ColumnFamilyData* cfd);
   void SchedulePendingPurge(std::string fname, std::string dir_to_sync,
                             FileType type, uint64_t number, int job_id);
+  // Queues an in-memory compaction of one of cfd's immutable memtables.
+  // See ColumnFamilyOptions::compact_immutable_memtables.
+  void ScheduleMemTableCompaction(ColumnFamilyData* cfd);
   static void BGWorkCompaction(void* arg);
   // Runs a pre-chosen universal compaction involving bottom level in a
   // separate, bottom-pri thread pool.
   static void BGWorkBottomCompaction(void* arg);
   static void BGWorkFlush(void* arg);
   static void BGWorkPurge(void* arg);
+  static void BGWorkMemTableCompaction(void* arg);
   static void UnscheduleCompactionCallback(void* arg);
   static void UnscheduleFlushCallback(void* arg);
   void BackgroundCallCompaction(PrepickedCompaction* prepicked_compaction,
                                 Env::Priority thread_pri);
   void BackgroundCallFlush(Env::Priority thread_pri);
   void BackgroundCallPurge();
+  void BackgroundCallMemTableCompaction(ColumnFamilyData* cfd);
   Status BackgroundCompaction(bool* madeProgress, JobContext* job_context,
                               LogBuffer* log_buffer,
                               PrepickedCompaction* prepicked_compaction,
@@ -1654,6 +1857,32 @@ class DBImpl : public DB {
   // Schedule background tasks
   void StartStatsDumpScheduler();
 
+#ifndef ROCKSDB_LITE
+  // Schedules WarmBlockCache() on the LOW pool if block_cache_dump_period_sec
+  // is set. The periodic saves run on stats_dump_scheduler_.
+  void ScheduleBlockCacheWarmup();
+
+  // Stops or waits for the warmup of the block cache, then saves the block
+  // cache keys a last time
+  void StopBlockCacheKeys();
+
+  static void BGWorkWarmBlockCache(void* db);
+
+  // Saves the keys of the blocks of live SST files that are in the block
+  // cache to the block cache keys file
+  Status DumpBlockCacheKeys();
+
+  // Loads the data blocks listed in the block cache keys file into the block
+  // cache
+  Status WarmBlockCache();
+
+  // Calls func with a referenced super version of each column family whose
+  // tables use a block cache, and with that block cache
+  void ForEachBlockCacheColumnFamily(
+      const std::function<void(ColumnFamilyData* cfd, SuperVersion* sv,
+                               Cache* block_cache)>& func);
+#endif  // !ROCKSDB_LITE
+
   void PrintStatistics();
 
   size_t EstimateInMemoryStatsHistorySize() const;
@@ -1736,8 +1965,11 @@ class DBImpl : public DB {
   size_t GetWalPreallocateBlockSize(uint64_t write_buffer_size) const;
   Env::WriteLifeTimeHint CalculateWALWriteHint() { return Env::WLTH_SHORT; }
 
+  // Creates the file of the WAL in wal_dir, and the other stripes of the WAL
+  // in DBOptions::wal_stripe_dirs, if any, in *new_stripes.
   IOStatus CreateWAL(uint64_t log_file_num, uint64_t recycle_log_number,
-                     size_t preallocate_block_size, log::Writer** new_log);
+                     size_t preallocate_block_size, log::Writer** new_log,
+                     std::vector<log::Writer*>* new_stripes);
 
   // Validate self-consistency of DB options
   static Status ValidateOptions(const DBOptions& db_options);
@@ -1838,6 +2070,11 @@ class DBImpl : public DB {
   // Note: to avoid dealock, if needed to acquire both log_write_mutex_ and
   // mutex_, the order should be first mutex_ and then log_write_mutex_.
   InstrumentedMutex log_write_mutex_;
+  // One per stripe of the WAL if DBOptions::wal_stripe_dirs is set. The write
+  // queues of write_queue_shards_ append to the stripes holding only these, so
+  // anything else that touches the files of the current WAL while writes may
+  // be in progress has to hold them too. Acquired after log_write_mutex_.
+  std::unique_ptr<InstrumentedMutex[]> wal_stripe_mutexes_;
 
   std::atomic<bool> shutting_down_;
 
@@ -1853,7 +2090,8 @@ class DBImpl : public DB {
   // * if AnyManualCompaction, whenever a compaction finishes, even if it hasn't
   // made any progress
   // * whenever a compaction made any progress
-  // * whenever bg_flush_scheduled_ or bg_purge_scheduled_ value decreases
+  // * whenever bg_flush_scheduled_, bg_purge_scheduled_ or
+  // bg_memtable_compaction_scheduled_ value decreases
   // (i.e. whenever a flush is done, even if it didn't make any progress)
   // * whenever there is an error in background purge, flush or compaction
   // * whenever num_running_ingest_file_ goes to 0.
@@ -1937,6 +2175,13 @@ class DBImpl : public DB {
   // The write thread when the writers have no memtable write. This will be used
   // in 2PC to batch the prepares separately from the serial commit.
   WriteThread nonmem_write_thread_;
+  // The write queues besides write_thread_ with write_queue_shards > 1, see
+  // DBOptions::write_queue_shards. Empty otherwise.
+  std::vector<std::unique_ptr<WriteThread>> write_queue_shards_;
+  // Set by BeginWriteQueueShardsExclusive(), protected by mutex_
+  bool write_queue_shards_exclusive_;
+  // Signalled when write_queue_shards_exclusive_ is cleared
+  InstrumentedCondVar write_queue_shards_cv_;
 
   WriteController write_controller_;
 
@@ -1987,6 +2232,10 @@ class DBImpl : public DB {
   // invariant(column family present in compaction_queue_ <==>
   // ColumnFamilyData::pending_compaction_ == true)
   std::deque<ColumnFamilyData*> compaction_queue_;
+  // Column families with an immutable memtable to compact in memory, see
+  // ScheduleMemTableCompaction(). They are Ref()-erenced, and scheduled by
+  // MaybeScheduleFlushOrCompaction() within the compaction budget.
+  std::deque<ColumnFamilyData*> memtable_compaction_queue_;
 
   // A map to store file numbers and filenames of the files to be purged
   std::unordered_map<uint64_t, PurgeFileInfo> purge_files_;
@@ -2020,6 +2269,10 @@ class DBImpl : public DB {
   // number of background obsolete file purge jobs, submitted to the HIGH pool
   int bg_purge_scheduled_;
 
+  // number of background in-memory compactions of immutable memtables,
+  // submitted to the LOW pool. They count against max_compactions.
+  int bg_memtable_compaction_scheduled_;
+
   std::deque<ManualCompactionState*> manual_compaction_dequeue_;
 
   // shall we disable deletion of obsolete files
@@ -2042,13 +2295,45 @@ class DBImpl : public DB {
   std::atomic<uint64_t> last_stats_dump_time_microsec_;
 
   // The thread that wants to switch memtable, can wait on this cv until the
-  // pending writes to memtable finishes.
+  // pending writes to memtable finishes. With write_queue_shards_, it is also
+  // signalled when a write group publishes its sequence numbers.
   std::condition_variable switch_cv_;
   // The mutex used by switch_cv_. mutex_ should be acquired beforehand.
   std::mutex switch_mutex_;
-  // Number of threads intending to write to memtable
+  // Number of threads intending to write to memtable. With
+  // write_queue_shards_, the number of write groups between
+  // EnterWriteQueueShardGroup() and ExitWriteQueueShardGroup().
   std::atomic<size_t> pending_memtable_writes_ = {};
 
+  AsyncWriteHandler async_write_handler_{this};
+  // Protects the async write fields below
+  std::mutex async_write_mutex_;
+  // Signalled when async_write_leaders_ or async_write_completions_ gets a
+  // writer, when pending_async_writes_ drops to 0 and on shutdown
+  std::condition_variable async_write_cv_;
+  // The writers of WriteAsync() that became the leader of a write group
+  std::deque<AsyncWriter*> async_write_leaders_;
+  // The writers of WriteAsync() completed by the leader of their group,
+  // whose callbacks async_write_thread_ has yet to run
+  std::deque<AsyncWriter*> async_write_completions_;
+  // Number of WriteAsync() writes not called back yet
+  size_t pending_async_writes_ = 0;
+  bool async_write_shutdown_ = false;
+  // Started by the first WriteAsync()
+  port::Thread async_write_thread_;
+
+  // The threads besides the writing one that InsertBatchInParallel() hands
+  // ranges of a batch to. Only with memtable_insert_threads > 1.
+  std::unique_ptr<ThreadPool> memtable_insert_pool_;
+
+#ifndef ROCKSDB_LITE
+  // number of background warmups of the block cache, submitted to the LOW
+  // pool. At most one, right after DB::Open().
+  int bg_block_cache_warmup_scheduled_ = 0;
+  // Stops the warmup of the block cache on close
+  std::atomic<bool> block_cache_warmup_stop_{false};
+#endif  // !ROCKSDB_LITE
+
   // Each flush or compaction gets its own job id. this counter makes sure
   // they're unique
   std::atomic<int> next_job_id_;
@@ -0,0 +1,376 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include <algorithm>
+#include <cinttypes>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "db/column_family.h"
+#include "db/db_impl/db_impl.h"
+#include "db/table_cache.h"
+#include "db/version_set.h"
+#include "file/filename.h"
+#include "logging/logging.h"
+#include "monitoring/iostats_context_imp.h"
+#include "monitoring/stats_dump_scheduler.h"
+#include "rocksdb/table.h"
+#include "table/block_based/block_based_table_factory.h"
+#include "table/block_based/block_based_table_reader.h"
+#include "test_util/sync_point.h"
+#include "util/coding.h"
+#include "util/crc32c.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+#ifndef ROCKSDB_LITE
+namespace {
+// The block offsets of each table file, by file number
+using BlockCacheKeys = std::map<uint64_t, std::vector<uint64_t>>;
+
+const uint32_t kBlockCacheKeysFormatVersion = 1;
+
+// The block cache keys file holds the format version as fixed32, then for
+// each table file its number, its number of blocks and the deltas between
+// its sorted block offsets as varint64, then the masked crc32c of everything
+// before it as fixed32.
+void EncodeBlockCacheKeys(const BlockCacheKeys& keys, std::string* dst) {
+  PutFixed32(dst, kBlockCacheKeysFormatVersion);
+  for (const auto& file : keys) {
+    PutVarint64(dst, file.first);
+    PutVarint64(dst, file.second.size());
+    uint64_t prev_offset = 0;
+    for (uint64_t offset : file.second) {
+      PutVarint64(dst, offset - prev_offset);
+      prev_offset = offset;
+    }
+  }
+  PutFixed32(dst, crc32c::Mask(crc32c::Value(dst->data(), dst->size())));
+}
+
+Status DecodeBlockCacheKeys(Slice input, BlockCacheKeys* keys) {
+  if (input.size() < 2 * sizeof(uint32_t)) {
+    return Status::Corruption("Block cache keys file too short");
+  }
+  const size_t crc_offset = input.size() - sizeof(uint32_t);
+  if (crc32c::Unmask(DecodeFixed32(input.data() + crc_offset)) !=
+      crc32c::Value(input.data(), crc_offset)) {
+    return Status::Corruption("Block cache keys file checksum mismatch");
+  }
+  input.remove_suffix(sizeof(uint32_t));
+  if (DecodeFixed32(input.data()) != kBlockCacheKeysFormatVersion) {
+    return Status::NotSupported("Unknown block cache keys file version");
+  }
+  input.remove_prefix(sizeof(uint32_t));
+  while (!input.empty()) {
+    uint64_t file_number = 0;
+    uint64_t num_blocks = 0;
+    if (!GetVarint64(&input, &file_number) ||
+        !GetVarint64(&input, &num_blocks) || num_blocks > input.size()) {
+      return Status::Corruption("Bad block cache keys file entry");
+    }
+    std::vector<uint64_t>& offsets = (*keys)[file_number];
+    offsets.reserve(static_cast<size_t>(num_blocks));
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < num_blocks; i++) {
+      uint64_t delta = 0;
+      if (!GetVarint64(&input, &delta)) {
+        return Status::Corruption("Bad block cache keys file entry");
+      }
+      offset += delta;
+      offsets.push_back(offset);
+    }
+  }
+  return Status::OK();
+}
+
+// Returns the block cache of the block-based tables of cfd, or nullptr if
+// its tables are not block-based or do not use a block cache
+Cache* GetBlockCache(ColumnFamilyData* cfd) {
+  auto* table_factory = cfd->ioptions()->table_factory;
+  if (table_factory == nullptr ||
+      BlockBasedTableFactory::kName != table_factory->Name()) {
+    return nullptr;
+  }
+  auto* table_options =
+      reinterpret_cast<BlockBasedTableOptions*>(table_factory->GetOptions());
+  if (table_options == nullptr || table_options->no_block_cache) {
+    return nullptr;
+  }
+  return table_options->block_cache.get();
+}
+}  // namespace
+
+void DBImpl::ScheduleBlockCacheWarmup() {
+  if (immutable_db_options_.block_cache_dump_period_sec == 0) {
+    return;
+  }
+  InstrumentedMutexLock l(&mutex_);
+  bg_block_cache_warmup_scheduled_++;
+  env_->Schedule(&DBImpl::BGWorkWarmBlockCache, this, Env::Priority::LOW,
+                 &block_cache_warmup_stop_);
+}
+
+void DBImpl::BGWorkWarmBlockCache(void* db) {
+  IOSTATS_SET_THREAD_POOL_ID(Env::Priority::LOW);
+  auto* dbimpl = reinterpret_cast<DBImpl*>(db);
+  Status s = dbimpl->WarmBlockCache();
+  if (!s.ok()) {
+    ROCKS_LOG_WARN(dbimpl->immutable_db_options_.info_log,
+                   "Failed to warm the block cache up: %s",
+                   s.ToString().c_str());
+  }
+  InstrumentedMutexLock l(&dbimpl->mutex_);
+  dbimpl->bg_block_cache_warmup_scheduled_--;
+  dbimpl->bg_cv_.SignalAll();
+}
+
+void DBImpl::StopBlockCacheKeys() {
+  if (immutable_db_options_.block_cache_dump_period_sec == 0 ||
+      !opened_successfully_) {
+    return;
+  }
+  // No periodic save may run concurrently with the last one
+  if (stats_dump_scheduler_ != nullptr) {
+    stats_dump_scheduler_->Unregister(this);
+  }
+  block_cache_warmup_stop_.store(true, std::memory_order_release);
+  int warmups_unscheduled =
+      env_->UnSchedule(&block_cache_warmup_stop_, Env::Priority::LOW);
+  {
+    InstrumentedMutexLock l(&mutex_);
+    bg_block_cache_warmup_scheduled_ -= warmups_unscheduled;
+    while (bg_block_cache_warmup_scheduled_ > 0) {
+      bg_cv_.Wait();
+    }
+  }
+
+  Status s = DumpBlockCacheKeys();
+  if (!s.ok()) {
+    ROCKS_LOG_WARN(immutable_db_options_.info_log,
+                   "Failed to save block cache keys on close: %s",
+                   s.ToString().c_str());
+  }
+}
+
+void DBImpl::SaveBlockCacheKeys() {
+  {
+    // The keys file is still being read, and the cache is not filled yet
+    InstrumentedMutexLock l(&mutex_);
+    if (bg_block_cache_warmup_scheduled_ > 0) {
+      return;
+    }
+  }
+  TEST_SYNC_POINT("DBImpl::SaveBlockCacheKeys:StartRunning");
+  Status s = DumpBlockCacheKeys();
+  if (!s.ok()) {
+    ROCKS_LOG_WARN(immutable_db_options_.info_log,
+                   "Failed to save block cache keys: %s",
+                   s.ToString().c_str());
+  }
+}
+
+void DBImpl::ForEachBlockCacheColumnFamily(
+    const std::function<void(ColumnFamilyData* cfd, SuperVersion* sv,
+                             Cache* block_cache)>& func) {
+  std::vector<ColumnFamilyData*> cfd_list;
+  {
+    InstrumentedMutexLock l(&mutex_);
+    for (auto cfd : *versions_->GetColumnFamilySet()) {
+      if (!cfd->IsDropped() && cfd->initialized() &&
+          GetBlockCache(cfd) != nullptr) {
+        cfd->Ref();
+        cfd_list.push_back(cfd);
+      }
+    }
+  }
+  for (auto cfd : cfd_list) {
+    SuperVersion* sv = GetAndRefSuperVersion(cfd);
+    func(cfd, sv, GetBlockCache(cfd));
+    ReturnAndCleanupSuperVersion(cfd, sv);
+  }
+  {
+    InstrumentedMutexLock l(&mutex_);
+    for (auto cfd : cfd_list) {
+      cfd->UnrefAndTryDelete();
+    }
+  }
+}
+
+Status DBImpl::DumpBlockCacheKeys() {
+  // The file number of each live table by its cache key prefix, per block
+  // cache
+  std::unordered_map<Cache*, std::unordered_map<std::string, uint64_t>>
+      prefixes;
+  ForEachBlockCacheColumnFamily(
+      [&](ColumnFamilyData* cfd, SuperVersion* sv, Cache* block_cache) {
+        auto& cache_prefixes = prefixes[block_cache];
+        VersionStorageInfo* vstorage = sv->current->storage_info();
+        for (int i = 0; i < vstorage->num_non_empty_levels(); i++) {
+          const LevelFilesBrief& files = vstorage->LevelFilesBrief(i);
+          for (size_t j = 0; j < files.num_files; j++) {
+            const FileDescriptor& fd = files.files[j].fd;
+            TableReader* reader = fd.table_reader;
+            Cache::Handle* handle = nullptr;
+            if (reader == nullptr) {
+              // A table that is not open has no blocks in the cache
+              Status s = cfd->table_cache()->FindTable(
+                  ReadOptions(), file_options_, cfd->internal_comparator(), fd,
+                  &handle, nullptr /* prefix_extractor */, true /* no_io */);
+              if (!s.ok()) {
+                continue;
+              }
+              reader = cfd->table_cache()->GetTableReaderFromHandle(handle);
+            }
+            Slice prefix =
+                static_cast<BlockBasedTable*>(reader)->GetCacheKeyPrefix();
+            if (!prefix.empty()) {
+              cache_prefixes.emplace(prefix.ToString(), fd.GetNumber());
+            }
+            if (handle != nullptr) {
+              cfd->table_cache()->ReleaseHandle(handle);
+            }
+          }
+        }
+      });
+
+  BlockCacheKeys keys;
+  for (const auto& cache : prefixes) {
+    const auto& cache_prefixes = cache.second;
+    std::vector<size_t> prefix_sizes;
+    for (const auto& prefix : cache_prefixes) {
+      prefix_sizes.push_back(prefix.first.size());
+    }
+    std::sort(prefix_sizes.begin(), prefix_sizes.end());
+    prefix_sizes.erase(std::unique(prefix_sizes.begin(), prefix_sizes.end()),
+                       prefix_sizes.end());
+    if (prefix_sizes.empty()) {
+      continue;
+    }
+    // The callback runs under the lock of a cache shard. It only matches the
+    // key against the prefixes, which are read-only by now, and keeps the
+    // block offsets of this DB's tables. They are grouped by file afterwards.
+    std::vector<std::pair<uint64_t, uint64_t>> blocks;
+    std::string prefix;
+    prefix.reserve(prefix_sizes.back());
+    cache.first->ApplyToAllEntries(
+        [&](const Slice& key, void* /*value*/, size_t /*charge*/) {
+          for (size_t prefix_size : prefix_sizes) {
+            if (key.size() <= prefix_size) {
+              break;
+            }
+            prefix.assign(key.data(), prefix_size);
+            auto it = cache_prefixes.find(prefix);
+            if (it == cache_prefixes.end()) {
+              continue;
+            }
+            // The rest of a block key is the block offset
+            Slice rest(key.data() + prefix_size, key.size() - prefix_size);
+            uint64_t offset = 0;
+            if (GetVarint64(&rest, &offset) && rest.empty()) {
+              blocks.emplace_back(it->second, offset);
+            }
+            break;
+          }
+        });
+    for (const auto& block : blocks) {
+      keys[block.first].push_back(block.second);
+    }
+  }
+  for (auto& file : keys) {
+    std::sort(file.second.begin(), file.second.end());
+    file.second.erase(std::unique(file.second.begin(), file.second.end()),
+                      file.second.end());
+  }
+
+  std::string data;
+  EncodeBlockCacheKeys(keys, &data);
+  const std::string temp_fname = TempBlockCacheKeysFileName(dbname_);
+  IOStatus io_s =
+      WriteStringToFile(fs_.get(), data, temp_fname, true /* should_sync */);
+  if (io_s.ok()) {
+    io_s = fs_->RenameFile(temp_fname, BlockCacheKeysFileName(dbname_),
+                           IOOptions(), nullptr);
+  }
+  if (!io_s.ok()) {
+    fs_->DeleteFile(temp_fname, IOOptions(), nullptr).PermitUncheckedError();
+    return io_s;
+  }
+  ROCKS_LOG_INFO(immutable_db_options_.info_log,
+                 "Saved the keys of blocks of %" ROCKSDB_PRIszt
+                 " table files in the block cache",
+                 keys.size());
+  return Status::OK();
+}
+
+Status DBImpl::WarmBlockCache() {
+  const std::string fname = BlockCacheKeysFileName(dbname_);
+  Status s = env_->FileExists(fname);
+  if (s.IsNotFound()) {
+    return Status::OK();
+  }
+  std::string data;
+  if (s.ok()) {
+    s = ReadFileToString(fs_.get(), fname, &data);
+  }
+  BlockCacheKeys keys;
+  if (s.ok()) {
+    s = DecodeBlockCacheKeys(data, &keys);
+  }
+  if (!s.ok()) {
+    return s;
+  }
+
+  size_t num_files = 0;
+  ForEachBlockCacheColumnFamily(
+      [&](ColumnFamilyData* cfd, SuperVersion* sv, Cache* /*block_cache*/) {
+        VersionStorageInfo* vstorage = sv->current->storage_info();
+        for (int i = 0; i < vstorage->num_non_empty_levels(); i++) {
+          const LevelFilesBrief& files = vstorage->LevelFilesBrief(i);
+          for (size_t j = 0; j < files.num_files; j++) {
+            if (block_cache_warmup_stop_.load(std::memory_order_acquire)) {
+              return;
+            }
+            const FileDescriptor& fd = files.files[j].fd;
+            auto it = keys.find(fd.GetNumber());
+            if (it == keys.end()) {
+              continue;
+            }
+            Cache::Handle* handle = nullptr;
+            Status load_s = cfd->table_cache()->FindTable(
+                ReadOptions(), file_options_, cfd->internal_comparator(), fd,
+                &handle, sv->mutable_cf_options.prefix_extractor.get());
+            if (load_s.ok()) {
+              auto* reader = static_cast<BlockBasedTable*>(
+                  cfd->table_cache()->GetTableReaderFromHandle(handle));
+              load_s = reader->LoadDataBlocksToCache(
+                  it->second, immutable_db_options_.rate_limiter.get(),
+                  &block_cache_warmup_stop_);
+              cfd->table_cache()->ReleaseHandle(handle);
+            }
+            if (!load_s.ok()) {
+              ROCKS_LOG_WARN(immutable_db_options_.info_log,
+                             "Failed to load blocks of table file %" PRIu64
+                             " into the block cache: %s",
+                             fd.GetNumber(), load_s.ToString().c_str());
+              continue;
+            }
+            num_files++;
+            // Each file is loaded at most once, even if it is shared
+            keys.erase(it);
+          }
+        }
+      });
+  ROCKS_LOG_INFO(immutable_db_options_.info_log,
+                 "Loaded blocks of %" ROCKSDB_PRIszt
+                 " table files into the block cache",
+                 num_files);
+  return Status::OK();
+}
+#endif  // !ROCKSDB_LITE
+
+}  // namespace ROCKSDB_NAMESPACE
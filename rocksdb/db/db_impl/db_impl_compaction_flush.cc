@@ -92,7 +92,9 @@ IOStatus DBImpl::SyncClosedLogs(JobContext* job_context) {
     auto& log = *it;
     assert(!log.getting_synced);
     log.getting_synced = true;
-    logs_to_sync.push_back(log.writer);
+    for (size_t i = 0; i < log.num_stripes(); i++) {
+      logs_to_sync.push_back(log.stripe(i));
+    }
   }
 
   IOStatus io_s;
@@ -116,7 +118,7 @@ IOStatus DBImpl::SyncClosedLogs(JobContext* job_context) {
       }
     }
     if (io_s.ok()) {
-      io_s = directories_.GetWalDir()->Fsync(IOOptions(), nullptr);
+      io_s = directories_.FsyncWalDirs(IOOptions(), nullptr);
     }
 
     mutex_.Lock();
@@ -1610,6 +1612,7 @@ Status DBImpl::FlushMemTable(ColumnFamilyData* cfd,
       if (two_write_queues_) {
         nonmem_write_thread_.EnterUnbatched(&nonmem_w, &mutex_);
       }
+      BeginWriteQueueShardsExclusive();
     }
     WaitForPendingWrites();
 
@@ -1672,6 +1675,7 @@ Status DBImpl::FlushMemTable(ColumnFamilyData* cfd,
     }
 
     if (!writes_stopped) {
+      EndWriteQueueShardsExclusive();
       write_thread_.ExitUnbatched(&w);
       if (two_write_queues_) {
         nonmem_write_thread_.ExitUnbatched(&nonmem_w);
@@ -1733,6 +1737,7 @@ Status DBImpl::AtomicFlushMemTables(
       if (two_write_queues_) {
         nonmem_write_thread_.EnterUnbatched(&nonmem_w, &mutex_);
       }
+      BeginWriteQueueShardsExclusive();
     }
     WaitForPendingWrites();
 
@@ -1776,6 +1781,7 @@ Status DBImpl::AtomicFlushMemTables(
     }
 
     if (!writes_stopped) {
+      EndWriteQueueShardsExclusive();
       write_thread_.ExitUnbatched(&w);
       if (two_write_queues_) {
         nonmem_write_thread_.ExitUnbatched(&nonmem_w);
@@ -2035,7 +2041,8 @@ void DBImpl::MaybeScheduleFlushOrCompaction() {
     return;
   }
 
-  while (bg_compaction_scheduled_ < bg_job_limits.max_compactions &&
+  while (bg_compaction_scheduled_ + bg_memtable_compaction_scheduled_ <
+             bg_job_limits.max_compactions &&
          unscheduled_compactions_ > 0) {
     CompactionArg* ca = new CompactionArg;
     ca->db = this;
@@ -2045,6 +2052,19 @@ void DBImpl::MaybeScheduleFlushOrCompaction() {
     env_->Schedule(&DBImpl::BGWorkCompaction, ca, Env::Priority::LOW, this,
                    &DBImpl::UnscheduleCompactionCallback);
   }
+
+  // In-memory compactions take the compaction slots left over
+  while (bg_compaction_scheduled_ + bg_memtable_compaction_scheduled_ <
+             bg_job_limits.max_compactions &&
+         !memtable_compaction_queue_.empty()) {
+    MemTableCompactionArg* ca = new MemTableCompactionArg;
+    ca->db = this;
+    ca->cfd = memtable_compaction_queue_.front();
+    memtable_compaction_queue_.pop_front();
+    bg_memtable_compaction_scheduled_++;
+    env_->Schedule(&DBImpl::BGWorkMemTableCompaction, ca, Env::Priority::LOW,
+                   nullptr);
+  }
 }
 
 DBImpl::BGJobLimits DBImpl::GetBGJobLimits() const {
@@ -2156,6 +2176,13 @@ void DBImpl::SchedulePendingPurge(std::string fname, std::string dir_to_sync,
   purge_files_.insert({{number, std::move(file_info)}});
 }
 
+void DBImpl::ScheduleMemTableCompaction(ColumnFamilyData* cfd) {
+  mutex_.AssertHeld();
+  cfd->Ref();
+  memtable_compaction_queue_.push_back(cfd);
+  MaybeScheduleFlushOrCompaction();
+}
+
 void DBImpl::BGWorkFlush(void* arg) {
   FlushThreadArg fta = *(reinterpret_cast<FlushThreadArg*>(arg));
   delete reinterpret_cast<FlushThreadArg*>(arg);
@@ -2197,6 +2224,105 @@ void DBImpl::BGWorkPurge(void* db) {
   TEST_SYNC_POINT("DBImpl::BGWorkPurge:end");
 }
 
+void DBImpl::BGWorkMemTableCompaction(void* arg) {
+  MemTableCompactionArg ca = *(reinterpret_cast<MemTableCompactionArg*>(arg));
+  delete reinterpret_cast<MemTableCompactionArg*>(arg);
+  IOSTATS_SET_THREAD_POOL_ID(Env::Priority::LOW);
+  TEST_SYNC_POINT("DBImpl::BGWorkMemTableCompaction");
+  ca.db->BackgroundCallMemTableCompaction(ca.cfd);
+}
+
+void DBImpl::BackgroundCallMemTableCompaction(ColumnFamilyData* cfd) {
+  JobContext job_context(next_job_id_.fetch_add(1), true);
+  mutex_.Lock();
+  assert(bg_memtable_compaction_scheduled_);
+
+  // A memtable that a flush is about to pick is not worth compacting.
+  MemTable* mem = nullptr;
+  if (!shutting_down_.load(std::memory_order_acquire) && !cfd->IsDropped() &&
+      !cfd->imm()->IsFlushPending()) {
+    mem = cfd->imm()->PickMemTableToCompact();
+  }
+  if (mem != nullptr) {
+    // Pin the memtable through the current version so that its memory keeps
+    // being accounted for until the last reader is done with it.
+    MemTableListVersion* imm_version = cfd->imm()->current();
+    imm_version->Ref();
+
+    std::vector<SequenceNumber> snapshot_seqs;
+    SequenceNumber earliest_write_conflict_snapshot;
+    SnapshotChecker* snapshot_checker;
+    GetSnapshotContext(&job_context, &snapshot_seqs,
+                       &earliest_write_conflict_snapshot, &snapshot_checker);
+    const MutableCFOptions mutable_cf_options =
+        *cfd->GetLatestMutableCFOptions();
+    MemTable* new_mem = cfd->ConstructNewMemtable(
+        mutable_cf_options, mem->GetEarliestSequenceNumber());
+    new_mem->InheritFrom(*mem);
+    new_mem->Ref();
+    mutex_.Unlock();
+
+    TEST_SYNC_POINT("DBImpl::BackgroundCallMemTableCompaction:Start");
+    Status s = CompactMemTable(*cfd->ioptions(), mem, new_mem,
+                               std::move(snapshot_seqs),
+                               earliest_write_conflict_snapshot,
+                               snapshot_checker);
+    new_mem->MarkImmutable();
+    const uint64_t old_size = mem->get_data_size();
+    const uint64_t new_size = new_mem->get_data_size();
+
+    mutex_.Lock();
+    // Keep the original unless the copy is meaningfully smaller, the extra
+    // memtable id and allocation churn is not worth a few percent.
+    bool installed = false;
+    if (s.ok() && !cfd->IsDropped() && new_size <= old_size / 4 * 3) {
+      installed = cfd->imm()->ReplaceMemTable(
+          mem, new_mem, &job_context.memtables_to_free);
+    }
+    if (installed) {
+      InstallSuperVersionAndScheduleWork(cfd,
+                                         &job_context.superversion_contexts[0],
+                                         mutable_cf_options);
+      ROCKS_LOG_INFO(immutable_db_options_.info_log,
+                     "[%s] [JOB %d] In-memory compaction of memtable #%" PRIu64
+                     ": %" PRIu64 " entries, %" PRIu64 " bytes -> %" PRIu64
+                     " entries, %" PRIu64 " bytes",
+                     cfd->GetName().c_str(), job_context.job_id, mem->GetID(),
+                     mem->num_entries(), old_size, new_mem->num_entries(),
+                     new_size);
+    } else {
+      if (!s.ok()) {
+        ROCKS_LOG_WARN(immutable_db_options_.info_log,
+                       "[%s] [JOB %d] In-memory compaction failed: %s",
+                       cfd->GetName().c_str(), job_context.job_id,
+                       s.ToString().c_str());
+      }
+      MemTable* m = new_mem->Unref();
+      if (m != nullptr) {
+        job_context.memtables_to_free.push_back(m);
+      }
+    }
+    imm_version->Unref(&job_context.memtables_to_free);
+    TEST_SYNC_POINT_CALLBACK("DBImpl::BackgroundCallMemTableCompaction:Done",
+                             &installed);
+
+    mutex_.Unlock();
+    job_context.Clean();
+    mutex_.Lock();
+  }
+
+  cfd->UnrefAndTryDelete();
+  bg_memtable_compaction_scheduled_--;
+  MaybeScheduleFlushOrCompaction();
+
+  bg_cv_.SignalAll();
+  // IMPORTANT: there should be no code after calling SignalAll. This call may
+  // signal the DB destructor that it's OK to proceed with destruction. In
+  // that case, all DB variables will be dealloacated and referencing them
+  // will cause trouble.
+  mutex_.Unlock();
+}
+
 void DBImpl::UnscheduleCompactionCallback(void* arg) {
   CompactionArg ca = *(reinterpret_cast<CompactionArg*>(arg));
   delete reinterpret_cast<CompactionArg*>(arg);
@@ -168,7 +168,7 @@ Status DBImpl::TEST_WaitForCompact(bool wait_unscheduled) {
 
   InstrumentedMutexLock l(&mutex_);
   while ((bg_bottom_compaction_scheduled_ || bg_compaction_scheduled_ ||
-          bg_flush_scheduled_ ||
+          bg_flush_scheduled_ || bg_memtable_compaction_scheduled_ ||
           (wait_unscheduled && unscheduled_compactions_)) &&
          (error_handler_.GetBGError() == Status::OK())) {
     bg_cv_.Wait();
@@ -283,6 +283,13 @@ void DBImpl::TEST_WaitForStatsDumpRun(std::function<void()> callback) const {
 StatsDumpTestScheduler* DBImpl::TEST_GetStatsDumpScheduler() const {
   return static_cast<StatsDumpTestScheduler*>(stats_dump_scheduler_);
 }
+
+void DBImpl::TEST_WaitForBlockCacheWarmup() {
+  InstrumentedMutexLock l(&mutex_);
+  while (bg_block_cache_warmup_scheduled_ > 0) {
+    bg_cv_.Wait();
+  }
+}
 #endif  // !ROCKSDB_LITE
 
 size_t DBImpl::TEST_EstimateInMemoryStatsHistorySize() const {
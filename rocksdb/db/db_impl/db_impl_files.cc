@@ -221,6 +221,15 @@ void DBImpl::FindObsoleteFiles(JobContext* job_context, bool force,
             log_file, immutable_db_options_.wal_dir);
       }
     }
+    // Add the log files of the other WAL stripes
+    for (const auto& wal_stripe_dir : immutable_db_options_.wal_stripe_dirs) {
+      std::vector<std::string> log_files;
+      env_->GetChildren(wal_stripe_dir, &log_files);  // Ignore errors
+      for (const std::string& log_file : log_files) {
+        job_context->full_scan_candidate_files.emplace_back(log_file,
+                                                            wal_stripe_dir);
+      }
+    }
     // Add info log files in db_log_dir
     if (!immutable_db_options_.db_log_dir.empty() &&
         immutable_db_options_.db_log_dir != dbname_) {
@@ -275,7 +284,7 @@ void DBImpl::FindObsoleteFiles(JobContext* job_context, bool force,
         // logs_ could have changed while we were waiting.
         continue;
       }
-      logs_to_free_.push_back(log.ReleaseWriter());
+      log.ReleaseWriters(&logs_to_free_);
       {
         InstrumentedMutexLock wl(&log_write_mutex_);
         logs_.pop_front();
@@ -395,6 +404,10 @@ void DBImpl::PurgeObsoleteFiles(JobContext& state, bool schedule_only) {
     if (file_num > 0) {
       candidate_files.emplace_back(LogFileName(file_num),
                                    immutable_db_options_.wal_dir);
+      for (const auto& wal_stripe_dir :
+           immutable_db_options_.wal_stripe_dirs) {
+        candidate_files.emplace_back(LogFileName(file_num), wal_stripe_dir);
+      }
     }
   }
   for (const auto& filename : state.manifest_delete_files) {
@@ -545,6 +558,13 @@ void DBImpl::PurgeObsoleteFiles(JobContext& state, bool schedule_only) {
     } else {
       dir_to_sync =
           (type == kLogFile) ? immutable_db_options_.wal_dir : dbname_;
+      const auto& wal_stripe_dirs = immutable_db_options_.wal_stripe_dirs;
+      if (type == kLogFile &&
+          std::find(wal_stripe_dirs.begin(), wal_stripe_dirs.end(),
+                    candidate_file.file_path) != wal_stripe_dirs.end()) {
+        // A file of another stripe of the WAL
+        dir_to_sync = candidate_file.file_path;
+      }
       fname = dir_to_sync +
               ((!dir_to_sync.empty() && dir_to_sync.back() == '/') ||
                        (!to_delete.empty() && to_delete.front() == '/')
@@ -21,6 +21,7 @@
 #include "rocksdb/wal_filter.h"
 #include "table/block_based/block_based_table_factory.h"
 #include "test_util/sync_point.h"
+#include "util/compression.h"
 #include "util/rate_limiter.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -89,6 +90,12 @@ DBOptions SanitizeOptions(const std::string& dbname, const DBOptions& src) {
     result.recycle_log_file_num = false;
   }
 
+  // Like the compression type record below, the record ordinals of a striped
+  // WAL have no room for the log number of a recycled file.
+  if (!result.wal_stripe_dirs.empty()) {
+    result.recycle_log_file_num = 0;
+  }
+
   if (result.recycle_log_file_num &&
       (result.wal_recovery_mode ==
            WALRecoveryMode::kTolerateCorruptedTailRecords ||
@@ -109,6 +116,20 @@ DBOptions SanitizeOptions(const std::string& dbname, const DBOptions& src) {
     result.recycle_log_file_num = 0;
   }
 
+  // The compression type record has no room for the log number that tells a
+  // recycled file's new records from its old ones.
+  if (result.wal_compression != kNoCompression &&
+      (result.recycle_log_file_num > 0 ||
+       !StreamingCompressionTypeSupported(result.wal_compression))) {
+    ROCKS_LOG_WARN(result.info_log,
+                   "WAL compression %s is not supported%s, disabling it",
+                   CompressionTypeToString(result.wal_compression).c_str(),
+                   result.recycle_log_file_num > 0
+                       ? " with recycle_log_file_num"
+                       : "");
+    result.wal_compression = kNoCompression;
+  }
+
   if (result.wal_dir.empty()) {
     // Use dbname as default
     result.wal_dir = dbname;
@@ -234,6 +255,13 @@ Status DBImpl::ValidateOptions(const DBOptions& db_options) {
         "be disabled. ");
   }
 
+  if (db_options.allow_mmap_writes && db_options.use_direct_io_for_wal) {
+    return Status::NotSupported(
+        "If memory mapped writes (allow_mmap_writes) are enabled "
+        "then direct I/O WAL writes (use_direct_io_for_wal) must be "
+        "disabled. ");
+  }
+
   if (db_options.keep_log_file_num == 0) {
     return Status::InvalidArgument("keep_log_file_num must be greater than 0");
   }
@@ -249,6 +277,39 @@ Status DBImpl::ValidateOptions(const DBOptions& db_options) {
         "unordered_write is incompatible with enable_pipelined_write");
   }
 
+  if (db_options.write_queue_shards > 1) {
+    if (!db_options.allow_concurrent_memtable_write) {
+      return Status::InvalidArgument(
+          "write_queue_shards > 1 is incompatible with "
+          "!allow_concurrent_memtable_write");
+    }
+    if (db_options.enable_pipelined_write || db_options.unordered_write ||
+        db_options.two_write_queues) {
+      return Status::InvalidArgument(
+          "write_queue_shards > 1 is incompatible with enable_pipelined_write, "
+          "unordered_write and two_write_queues");
+    }
+  }
+
+  if (!db_options.wal_stripe_dirs.empty()) {
+    if (db_options.WAL_ttl_seconds > 0 || db_options.WAL_size_limit_MB > 0) {
+      return Status::NotSupported(
+          "WAL archiving is not supported with wal_stripe_dirs");
+    }
+    // The files of a WAL have the same name in every directory
+    std::set<std::string> wal_dirs;
+    if (!db_options.wal_dir.empty()) {
+      wal_dirs.insert(db_options.wal_dir);
+    }
+    for (const auto& dir : db_options.wal_stripe_dirs) {
+      if (dir.empty() || !wal_dirs.insert(dir).second) {
+        return Status::InvalidArgument(
+            "wal_stripe_dirs must be distinct from each other and from "
+            "wal_dir");
+      }
+    }
+  }
+
   if (db_options.atomic_flush && db_options.enable_pipelined_write) {
     return Status::InvalidArgument(
         "atomic_flush is incompatible with enable_pipelined_write");
@@ -330,9 +391,10 @@ IOStatus DBImpl::CreateAndNewDirectory(
   return fs->NewDirectory(dirname, IOOptions(), directory, nullptr);
 }
 
-IOStatus Directories::SetDirectories(FileSystem* fs, const std::string& dbname,
-                                     const std::string& wal_dir,
-                                     const std::vector<DbPath>& data_paths) {
+IOStatus Directories::SetDirectories(
+    FileSystem* fs, const std::string& dbname, const std::string& wal_dir,
+    const std::vector<std::string>& wal_stripe_dirs,
+    const std::vector<DbPath>& data_paths) {
   IOStatus io_s = DBImpl::CreateAndNewDirectory(fs, dbname, &db_dir_);
   if (!io_s.ok()) {
     return io_s;
@@ -343,6 +405,15 @@ IOStatus Directories::SetDirectories(FileSystem* fs, const std::string& dbname,
       return io_s;
     }
   }
+  wal_stripe_dirs_.clear();
+  for (const auto& stripe_dir : wal_stripe_dirs) {
+    std::unique_ptr<FSDirectory> directory;
+    io_s = DBImpl::CreateAndNewDirectory(fs, stripe_dir, &directory);
+    if (!io_s.ok()) {
+      return io_s;
+    }
+    wal_stripe_dirs_.emplace_back(directory.release());
+  }
 
   data_dirs_.clear();
   for (auto& p : data_paths) {
@@ -372,9 +443,9 @@ Status DBImpl::Recover(
   assert(db_lock_ == nullptr);
   std::vector<std::string> files_in_dbname;
   if (!read_only) {
-    Status s = directories_.SetDirectories(fs_.get(), dbname_,
-                                           immutable_db_options_.wal_dir,
-                                           immutable_db_options_.db_paths);
+    Status s = directories_.SetDirectories(
+        fs_.get(), dbname_, immutable_db_options_.wal_dir,
+        immutable_db_options_.wal_stripe_dirs, immutable_db_options_.db_paths);
     if (!s.ok()) {
       return s;
     }
@@ -752,6 +823,167 @@ Status DBImpl::InitPersistStatsColumnFamily() {
   return s;
 }
 
+namespace {
+// Applies the write batches read from a WAL to the memtables with a pool of
+// threads, so that the recovering thread only has to read and checksum the
+// log. Batches are handed over in waves: the batches of a wave are inserted
+// concurrently, in any order, while the recovering thread reads the next
+// wave. Every entry carries its sequence number, so the order in which they
+// reach a memtable does not change what a read of a key sees. The same rules
+// as for concurrent memtable writes in DBImpl::WriteImpl apply: the memtables
+// must support concurrent inserts and batches with merges are not handed
+// over.
+class WalReplayPool {
+ public:
+  struct Batch {
+    WriteBatch batch;
+    size_t record_size;
+    Status status;
+    bool has_valid_writes;
+  };
+
+  static const size_t kMaxWaveBatches = 1024;
+  static const size_t kMaxWaveBytes = 4 << 20;
+
+  WalReplayPool(int num_threads, DBImpl* db,
+                ColumnFamilyMemTablesImpl* column_family_memtables,
+                FlushScheduler* flush_scheduler,
+                TrimHistoryScheduler* trim_history_scheduler)
+      : db_(db),
+        column_family_memtables_(column_family_memtables),
+        flush_scheduler_(flush_scheduler),
+        trim_history_scheduler_(trim_history_scheduler),
+        cv_(&mu_),
+        log_number_(0),
+        next_batch_(0),
+        generation_(0),
+        running_(0),
+        stop_(false),
+        queued_log_number_(0),
+        queued_bytes_(0) {
+    for (int i = 0; i < num_threads; i++) {
+      threads_.emplace_back(&WalReplayPool::ThreadBody, this);
+    }
+  }
+
+  ~WalReplayPool() {
+    Wait();
+    {
+      MutexLock l(&mu_);
+      stop_ = true;
+      cv_.SignalAll();
+    }
+    for (auto& thread : threads_) {
+      thread.join();
+    }
+  }
+
+  // Queues a batch of log `log_number` for the next wave. Returns true once
+  // the wave is large enough to be started.
+  bool Add(WriteBatch* batch, size_t record_size, uint64_t log_number) {
+    assert(queued_.empty() || log_number == queued_log_number_);
+    queued_log_number_ = log_number;
+    queued_.emplace_back();
+    Batch& b = queued_.back();
+    b.batch = std::move(*batch);
+    b.record_size = record_size;
+    b.has_valid_writes = false;
+    queued_bytes_ += record_size;
+    return queued_.size() >= kMaxWaveBatches || queued_bytes_ >= kMaxWaveBytes;
+  }
+
+  // Drops the queued batches.
+  void Discard() {
+    queued_.clear();
+    queued_bytes_ = 0;
+  }
+
+  // Waits for the running wave, if any, and returns its batches in the order
+  // they were read. They stay valid until the next call to Start().
+  std::vector<Batch>& Wait() {
+    MutexLock l(&mu_);
+    while (running_ > 0) {
+      cv_.Wait();
+    }
+    return wave_;
+  }
+
+  // Drops the batches of the previous wave and starts applying the queued
+  // ones as the next wave, if there are any.
+  // REQUIRES: Wait() has returned since the previous call.
+  void Start() {
+    MutexLock l(&mu_);
+    assert(running_ == 0);
+    wave_.clear();
+    wave_.swap(queued_);
+    queued_bytes_ = 0;
+    if (wave_.empty()) {
+      return;
+    }
+    log_number_ = queued_log_number_;
+    next_batch_.store(0, std::memory_order_relaxed);
+    running_ = static_cast<int>(threads_.size());
+    generation_++;
+    cv_.SignalAll();
+  }
+
+ private:
+  void ThreadBody() {
+    // Each thread needs its own cursor over the column families
+    ColumnFamilyMemTablesImpl memtables(column_family_memtables_);
+    uint64_t seen_generation = 0;
+    MutexLock l(&mu_);
+    while (true) {
+      while (!stop_ && generation_ == seen_generation) {
+        cv_.Wait();
+      }
+      if (stop_) {
+        return;
+      }
+      seen_generation = generation_;
+      mu_.Unlock();
+      size_t i;
+      while ((i = next_batch_.fetch_add(1, std::memory_order_relaxed)) <
+             wave_.size()) {
+        Batch& b = wave_[i];
+        // See DBImpl::RecoverLogFiles() for why missing column families are
+        // ignored
+        b.status = WriteBatchInternal::InsertInto(
+            &b.batch, &memtables, flush_scheduler_, trim_history_scheduler_,
+            true, log_number_, db_, true /* concurrent_memtable_writes */,
+            nullptr /* next_seq */, &b.has_valid_writes);
+      }
+      mu_.Lock();
+      if (--running_ == 0) {
+        cv_.SignalAll();
+      }
+    }
+  }
+
+  DBImpl* const db_;
+  ColumnFamilyMemTablesImpl* const column_family_memtables_;
+  FlushScheduler* const flush_scheduler_;
+  TrimHistoryScheduler* const trim_history_scheduler_;
+  std::vector<port::Thread> threads_;
+
+  port::Mutex mu_;
+  port::CondVar cv_;
+  // The running wave; written by the recovering thread only while no thread
+  // of the pool is running
+  std::vector<Batch> wave_;
+  uint64_t log_number_;
+  std::atomic<size_t> next_batch_;
+  uint64_t generation_;
+  int running_;
+  bool stop_;
+
+  // Owned by the recovering thread
+  std::vector<Batch> queued_;
+  uint64_t queued_log_number_;
+  size_t queued_bytes_;
+};
+}  // namespace
+
 // REQUIRES: log_numbers are sorted in ascending order
 Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
                                SequenceNumber* next_sequence, bool read_only,
@@ -811,6 +1043,48 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
   bool stop_replay_by_wal_filter = false;
   bool stop_replay_for_corruption = false;
   bool flushed = false;
+
+  // Flushes the memtables that filled up while replaying, so that replaying
+  // large WALs does not run out of memory. `sequence` is the first sequence
+  // number of the batches that have not been applied yet.
+  auto flush_full_memtables = [&](uint64_t log_number,
+                                  SequenceNumber sequence) -> Status {
+    // we can do this because this is called before client has access to the
+    // DB and there is only a single thread operating on DB
+    ColumnFamilyData* cfd;
+
+    while ((cfd = flush_scheduler_.TakeNextColumnFamily()) != nullptr) {
+      cfd->UnrefAndTryDelete();
+      // If this asserts, it means that InsertInto failed in
+      // filtering updates to already-flushed column families
+      assert(cfd->GetLogNumber() <= log_number);
+      (void)log_number;
+      auto iter = version_edits.find(cfd->GetID());
+      assert(iter != version_edits.end());
+      VersionEdit* edit = &iter->second;
+      Status s = WriteLevel0TableForRecovery(job_id, cfd, cfd->mem(), edit);
+      if (!s.ok()) {
+        return s;
+      }
+      flushed = true;
+
+      cfd->CreateNewMemtable(*cfd->GetLatestMutableCFOptions(), sequence);
+    }
+    return Status::OK();
+  };
+
+  // Replay batches on wal_recovery_threads threads when concurrent memtable
+  // writes are allowed. Transactions that use a sequence number per batch
+  // rebuild their state while replaying and always replay on this thread.
+  std::unique_ptr<WalReplayPool> replay_pool;
+  if (immutable_db_options_.wal_recovery_threads > 1 &&
+      immutable_db_options_.allow_concurrent_memtable_write &&
+      !seq_per_batch_ && batch_per_txn_) {
+    replay_pool.reset(new WalReplayPool(
+        immutable_db_options_.wal_recovery_threads, this,
+        column_family_memtables_.get(), &flush_scheduler_,
+        &trim_history_scheduler_));
+  }
   uint64_t corrupted_log_number = kMaxSequenceNumber;
   uint64_t min_log_number = MinLogNumberToKeep();
   for (auto log_number : log_numbers) {
@@ -881,8 +1155,30 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
     // paranoid_checks==false so that corruptions cause entire commits
     // to be skipped instead of propagating bad information (like overly
     // large sequence numbers).
-    log::Reader reader(immutable_db_options_.info_log, std::move(file_reader),
-                       &reporter, true /*checksum*/, log_number);
+    std::unique_ptr<log::Reader> reader(
+        new log::Reader(immutable_db_options_.info_log, std::move(file_reader),
+                        &reporter, true /*checksum*/, log_number));
+
+    // A striped WAL is read from all of its files. Even with a single file
+    // left, its records are checked to follow each other.
+    std::unique_ptr<log::StripedReader> striped_reader;
+    if (!immutable_db_options_.wal_stripe_dirs.empty()) {
+      std::vector<std::unique_ptr<log::Reader>> readers;
+      readers.push_back(std::move(reader));
+      status = OpenWalStripeReaders(log_number, &reporter, &readers);
+      if (!status.ok()) {
+        return status;
+      }
+      striped_reader.reset(
+          new log::StripedReader(std::move(readers), &reporter));
+    }
+    auto read_record = [&](Slice* rec, std::string* buf) {
+      return striped_reader != nullptr
+                 ? striped_reader->ReadRecord(
+                       rec, buf, immutable_db_options_.wal_recovery_mode)
+                 : reader->ReadRecord(rec, buf,
+                                      immutable_db_options_.wal_recovery_mode);
+    };
 
     // Determine if we should tolerate incomplete records at the tail end of the
     // Read all the records and add to a memtable
@@ -890,11 +1186,43 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
     Slice record;
     WriteBatch batch;
 
+    // Waits for the running wave of replay_pool, checks how its batches were
+    // applied, flushes the memtables they filled and starts the batches
+    // queued since as the next wave. Calling it twice applies everything
+    // that was queued. Only batches that parse are queued, so a batch fails
+    // here only on an error unrelated to its contents; it sets `status` and
+    // drops the batches queued after it, as replay stops there.
+    SequenceNumber running_sequence = *next_sequence;
+    auto replay_wave = [&]() -> Status {
+      bool has_valid_writes = false;
+      for (auto& b : replay_pool->Wait()) {
+        Status s = b.status;
+        MaybeIgnoreError(&s);
+        if (!s.ok()) {
+          // We are treating this as a failure while reading since we read
+          // valid blocks that do not form coherent data
+          reporter.Corruption(b.record_size, s);
+          status = s;
+          replay_pool->Discard();
+          replay_pool->Start();
+          return Status::OK();
+        }
+        has_valid_writes |= b.has_valid_writes;
+      }
+      if (has_valid_writes && !read_only) {
+        Status s = flush_full_memtables(log_number, running_sequence);
+        if (!s.ok()) {
+          return s;
+        }
+      }
+      running_sequence = *next_sequence;
+      replay_pool->Start();
+      return Status::OK();
+    };
+
     TEST_SYNC_POINT_CALLBACK("DBImpl::RecoverLogFiles:BeforeReadWal",
                              /*arg=*/nullptr);
-    while (!stop_replay_by_wal_filter &&
-           reader.ReadRecord(&record, &scratch,
-                             immutable_db_options_.wal_recovery_mode) &&
+    while (!stop_replay_by_wal_filter && read_record(&record, &scratch) &&
            status.ok()) {
       if (record.size() < WriteBatchInternal::kHeader) {
         reporter.Corruption(record.size(),
@@ -1001,6 +1329,40 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
       }
 #endif  // ROCKSDB_LITE
 
+      if (replay_pool != nullptr) {
+        // A batch of a wave must not fail once the batches read after it may
+        // have been applied, so only batches that parse are handed over. A
+        // malformed batch is left to fail below, once everything read
+        // before it is applied, exactly as without the pool.
+        if (WriteBatchInternal::CheckContents(&batch).ok() &&
+            !batch.HasMerge() && !batch.HasBeginPrepare() &&
+            !batch.HasEndPrepare() && !batch.HasCommit() &&
+            !batch.HasRollback()) {
+          // Without seq_per_batch, every entry of the batch takes one
+          // sequence number, like MemTableInserter::MaybeAdvanceSeq() does
+          *next_sequence = WriteBatchInternal::Sequence(&batch) +
+                           WriteBatchInternal::Count(&batch);
+          if (replay_pool->Add(&batch, record.size(), log_number)) {
+            Status s = replay_wave();
+            if (!s.ok()) {
+              return s;
+            }
+          }
+          continue;
+        }
+        // Everything read before the batch is applied before it
+        Status s = replay_wave();
+        if (s.ok()) {
+          s = replay_wave();
+        }
+        if (!s.ok()) {
+          return s;
+        }
+        if (!status.ok()) {
+          continue;
+        }
+      }
+
       // If column family was not found, it might mean that the WAL write
       // batch references to the column family that was dropped after the
       // insert. We don't want to fail the whole write batch in that case --
@@ -1021,32 +1383,27 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
       }
 
       if (has_valid_writes && !read_only) {
-        // we can do this because this is called before client has access to the
-        // DB and there is only a single thread operating on DB
-        ColumnFamilyData* cfd;
-
-        while ((cfd = flush_scheduler_.TakeNextColumnFamily()) != nullptr) {
-          cfd->UnrefAndTryDelete();
-          // If this asserts, it means that InsertInto failed in
-          // filtering updates to already-flushed column families
-          assert(cfd->GetLogNumber() <= log_number);
-          auto iter = version_edits.find(cfd->GetID());
-          assert(iter != version_edits.end());
-          VersionEdit* edit = &iter->second;
-          status = WriteLevel0TableForRecovery(job_id, cfd, cfd->mem(), edit);
-          if (!status.ok()) {
-            // Reflect errors immediately so that conditions like full
-            // file-systems cause the DB::Open() to fail.
-            return status;
-          }
-          flushed = true;
-
-          cfd->CreateNewMemtable(*cfd->GetLatestMutableCFOptions(),
-                                 *next_sequence);
+        status = flush_full_memtables(log_number, *next_sequence);
+        if (!status.ok()) {
+          // Reflect errors immediately so that conditions like full
+          // file-systems cause the DB::Open() to fail.
+          return status;
         }
       }
     }
 
+    if (replay_pool != nullptr) {
+      // Apply what was read before the end of the log, or before replay
+      // stopped, the same as if it had been replayed batch by batch
+      Status s = replay_wave();
+      if (s.ok()) {
+        s = replay_wave();
+      }
+      if (!s.ok()) {
+        return s;
+      }
+    }
+
     if (!status.ok()) {
       if (status.IsNotSupported()) {
         // We should not treat NotSupported as corruption. It is rather a clear
@@ -1213,6 +1570,30 @@ Status DBImpl::RecoverLogFiles(const std::vector<uint64_t>& log_numbers,
   return status;
 }
 
+Status DBImpl::OpenWalStripeReaders(
+    uint64_t log_number, log::Reader::Reporter* reporter,
+    std::vector<std::unique_ptr<log::Reader>>* readers) {
+  for (const auto& stripe_dir : immutable_db_options_.wal_stripe_dirs) {
+    std::string fname = LogFileName(stripe_dir, log_number);
+    std::unique_ptr<FSSequentialFile> file;
+    IOStatus io_s = fs_->NewSequentialFile(
+        fname, fs_->OptimizeForLogRead(file_options_), &file, nullptr);
+    if (io_s.IsNotFound() || io_s.IsPathNotFound()) {
+      // The log was not striped, or not over this directory
+      continue;
+    } else if (!io_s.ok()) {
+      return io_s;
+    }
+    std::unique_ptr<SequentialFileReader> file_reader(new SequentialFileReader(
+        std::move(file), fname, immutable_db_options_.log_readahead_size,
+        io_tracer_));
+    readers->emplace_back(new log::Reader(immutable_db_options_.info_log,
+                                          std::move(file_reader), reporter,
+                                          true /*checksum*/, log_number));
+  }
+  return Status::OK();
+}
+
 Status DBImpl::RestoreAliveLogFiles(const std::vector<uint64_t>& log_numbers) {
   if (log_numbers.empty()) {
     return Status::OK();
@@ -1235,6 +1616,13 @@ Status DBImpl::RestoreAliveLogFiles(const std::vector<uint64_t>& log_numbers) {
     if (!s.ok()) {
       break;
     }
+    for (const auto& stripe_dir : immutable_db_options_.wal_stripe_dirs) {
+      uint64_t stripe_size;
+      if (env_->GetFileSize(LogFileName(stripe_dir, log_number), &stripe_size)
+              .ok()) {
+        log.AddSize(stripe_size);
+      }
+    }
     total_log_size_ += log.size;
     alive_log_files_.push_back(log);
     // We preallocate space for logs, but then after a crash and restart, those
@@ -1405,8 +1793,8 @@ Status DB::Open(const DBOptions& db_options, const std::string& dbname,
 }
 
 IOStatus DBImpl::CreateWAL(uint64_t log_file_num, uint64_t recycle_log_number,
-                           size_t preallocate_block_size,
-                           log::Writer** new_log) {
+                           size_t preallocate_block_size, log::Writer** new_log,
+                           std::vector<log::Writer*>* new_stripes) {
   IOStatus io_s;
   std::unique_ptr<FSWritableFile> lfile;
 
@@ -1438,10 +1826,41 @@ IOStatus DBImpl::CreateWAL(uint64_t log_file_num, uint64_t recycle_log_number,
     const auto& listeners = immutable_db_options_.listeners;
     std::unique_ptr<WritableFileWriter> file_writer(
         new WritableFileWriter(std::move(lfile), log_fname, opt_file_options,
-                               env_, nullptr /* stats */, listeners));
+                               env_, nullptr /* stats */, listeners,
+                               nullptr /* file_checksum_gen_factory */,
+                               true /* is_wal */));
     *new_log = new log::Writer(std::move(file_writer), log_file_num,
                                immutable_db_options_.recycle_log_file_num > 0,
-                               immutable_db_options_.manual_wal_flush);
+                               immutable_db_options_.manual_wal_flush,
+                               immutable_db_options_.wal_compression);
+    io_s = (*new_log)->AddCompressionTypeRecord();
+  }
+
+  assert(new_stripes->empty());
+  for (size_t i = 0;
+       io_s.ok() && i < immutable_db_options_.wal_stripe_dirs.size(); i++) {
+    log_fname =
+        LogFileName(immutable_db_options_.wal_stripe_dirs[i], log_file_num);
+    io_s = NewWritableFile(fs_.get(), log_fname, &lfile, opt_file_options);
+    if (io_s.ok()) {
+      lfile->SetWriteLifeTimeHint(CalculateWALWriteHint());
+      lfile->SetPreallocationBlockSize(preallocate_block_size);
+      std::unique_ptr<WritableFileWriter> file_writer(new WritableFileWriter(
+          std::move(lfile), log_fname, opt_file_options, env_,
+          nullptr /* stats */, immutable_db_options_.listeners,
+          nullptr /* file_checksum_gen_factory */, true /* is_wal */));
+      new_stripes->push_back(new log::Writer(
+          std::move(file_writer), log_file_num, false /* recycle_log_files */,
+          immutable_db_options_.manual_wal_flush,
+          immutable_db_options_.wal_compression));
+      io_s = new_stripes->back()->AddCompressionTypeRecord();
+    }
+  }
+  if (!io_s.ok()) {
+    for (auto* stripe_writer : *new_stripes) {
+      delete stripe_writer;
+    }
+    new_stripes->clear();
   }
   return io_s;
 }
@@ -1511,15 +1930,21 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
   if (s.ok()) {
     uint64_t new_log_number = impl->versions_->NewFileNumber();
     log::Writer* new_log = nullptr;
+    std::vector<log::Writer*> new_stripes;
     const size_t preallocate_block_size =
         impl->GetWalPreallocateBlockSize(max_write_buffer_size);
     s = impl->CreateWAL(new_log_number, 0 /*recycle_log_number*/,
-                        preallocate_block_size, &new_log);
+                        preallocate_block_size, &new_log, &new_stripes);
     if (s.ok()) {
       InstrumentedMutexLock wl(&impl->log_write_mutex_);
       impl->logfile_number_ = new_log_number;
       assert(new_log != nullptr);
-      impl->logs_.emplace_back(new_log_number, new_log);
+      impl->logs_.emplace_back(new_log_number, new_log, std::move(new_stripes));
+    }
+    if (s.ok() && impl->manual_wal_flush_) {
+      // With manual_wal_flush, the compression type record of the new WAL is
+      // only buffered. Write it out before the first batch.
+      s = impl->FlushWAL(false);
     }
 
     if (s.ok()) {
@@ -1584,8 +2009,12 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
         WriteBatchInternal::SetSequence(&empty_batch, recovered_seq);
         WriteOptions write_options;
         uint64_t log_used, log_size;
-        log::Writer* log_writer = impl->logs_.back().writer;
-        s = impl->WriteToWAL(empty_batch, log_writer, &log_used, &log_size);
+        size_t stripe;
+        uint64_t record_ordinal;
+        log::Writer* log_writer =
+            impl->logs_.back().NextStripe(&stripe, &record_ordinal);
+        s = impl->WriteToWAL(empty_batch, log_writer, &log_used, &log_size,
+                             record_ordinal);
         if (s.ok()) {
           // Need to fsync, otherwise it might get lost after a power reset.
           s = impl->FlushWAL(false);
@@ -1738,6 +2167,9 @@ Status DBImpl::Open(const DBOptions& db_options, const std::string& dbname,
   }
   if (s.ok()) {
     impl->StartStatsDumpScheduler();
+#ifndef ROCKSDB_LITE
+    impl->ScheduleBlockCacheWarmup();
+#endif  // !ROCKSDB_LITE
   } else {
     for (auto* h : *handles) {
       delete h;
@@ -67,6 +67,11 @@ class DBImplReadOnly : public DBImpl {
                        WriteBatch* /*updates*/) override {
     return Status::NotSupported("Not supported operation in read only mode.");
   }
+  virtual Status WriteAsync(
+      const WriteOptions& /*options*/, WriteBatch* /*updates*/,
+      std::function<void(Status)> /*callback*/) override {
+    return Status::NotSupported("Not supported operation in read only mode.");
+  }
   using DBImpl::CompactRange;
   virtual Status CompactRange(const CompactRangeOptions& /*options*/,
                               ColumnFamilyHandle* /*column_family*/,
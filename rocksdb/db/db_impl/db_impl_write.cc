@@ -53,6 +53,115 @@ Status DBImpl::Write(const WriteOptions& write_options, WriteBatch* my_batch) {
   return WriteImpl(write_options, my_batch, nullptr, nullptr);
 }
 
+Status DBImpl::WriteAsync(const WriteOptions& write_options,
+                          WriteBatch* my_batch,
+                          std::function<void(Status)> callback) {
+  if (my_batch == nullptr) {
+    return Status::Corruption("Batch is nullptr!");
+  }
+  if (write_options.sync && write_options.disableWAL) {
+    return Status::InvalidArgument("Sync writes has to enable WAL.");
+  }
+  if (two_write_queues_ || immutable_db_options_.unordered_write ||
+      immutable_db_options_.enable_pipelined_write ||
+      !write_queue_shards_.empty() || write_options.low_pri) {
+    // Only WriteImpl() with a single write queue lets another thread do the
+    // work of the leader of a write group. Low priority writes may have to
+    // be throttled before joining it.
+    return DB::WriteAsync(write_options, my_batch, std::move(callback));
+  }
+  if (tracer_) {
+    InstrumentedMutexLock lock(&trace_mutex_);
+    if (tracer_) {
+      tracer_->Write(my_batch);
+    }
+  }
+  if (!write_options.disableWAL) {
+    RecordTick(stats_, WRITE_WITH_WAL);
+  }
+
+  AsyncWriter* w = new AsyncWriter(write_options, my_batch, std::move(callback),
+                                   &async_write_handler_, env_,
+                                   immutable_db_options_.statistics.get());
+  {
+    std::lock_guard<std::mutex> lock(async_write_mutex_);
+    pending_async_writes_++;
+    if (!async_write_thread_.joinable()) {
+      async_write_thread_ = port::Thread(&DBImpl::AsyncWriteThread, this);
+    }
+  }
+  write_thread_.JoinBatchGroupAsync(w);
+  return Status::OK();
+}
+
+void DBImpl::AsyncWriteHandler::BecomeLeader(WriteThread::Writer* w) {
+  {
+    std::lock_guard<std::mutex> lock(db_->async_write_mutex_);
+    db_->async_write_leaders_.push_back(static_cast<AsyncWriter*>(w));
+  }
+  db_->async_write_cv_.notify_all();
+}
+
+void DBImpl::AsyncWriteHandler::Complete(WriteThread::Writer* w) {
+  // The state may change under mutex_ (a write stall) or while the leader
+  // exits the group, so the callback is left to async_write_thread_
+  {
+    std::lock_guard<std::mutex> lock(db_->async_write_mutex_);
+    db_->async_write_completions_.push_back(static_cast<AsyncWriter*>(w));
+  }
+  db_->async_write_cv_.notify_all();
+}
+
+void DBImpl::AsyncWriteThread() {
+  std::unique_lock<std::mutex> lock(async_write_mutex_);
+  while (true) {
+    async_write_cv_.wait(lock, [&] {
+      return !async_write_completions_.empty() ||
+             !async_write_leaders_.empty() || async_write_shutdown_;
+    });
+    if (!async_write_completions_.empty()) {
+      AsyncWriter* w = async_write_completions_.front();
+      async_write_completions_.pop_front();
+      lock.unlock();
+      CompleteAsyncWrite(w, w->FinalStatus());
+      lock.lock();
+      continue;
+    }
+    if (async_write_leaders_.empty()) {
+      break;
+    }
+    AsyncWriter* w = async_write_leaders_.front();
+    async_write_leaders_.pop_front();
+    lock.unlock();
+
+    // This thread now waits on the state of w like the one of a blocking
+    // write would.
+    w->async_handler = nullptr;
+    Status s = WriteAsBatchGroupLeader(w, w->write_options,
+                                       nullptr /*log_used*/,
+                                       false /*disable_memtable*/,
+                                       nullptr /*seq_used*/);
+    CompleteAsyncWrite(w, s);
+
+    lock.lock();
+  }
+}
+
+void DBImpl::CompleteAsyncWrite(AsyncWriter* w, const Status& s) {
+  std::function<void(Status)> done = std::move(w->done);
+  delete w;
+  done(s);
+
+  bool no_pending_writes;
+  {
+    std::lock_guard<std::mutex> lock(async_write_mutex_);
+    no_pending_writes = --pending_async_writes_ == 0;
+  }
+  if (no_pending_writes) {
+    async_write_cv_.notify_all();
+  }
+}
+
 #ifndef ROCKSDB_LITE
 Status DBImpl::WriteWithCallback(const WriteOptions& write_options,
                                  WriteBatch* my_batch,
@@ -97,12 +206,17 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     return Status::NotSupported(
         "pipelined_writes is not compatible with unordered_write");
   }
+  if (callback != nullptr && !write_queue_shards_.empty()) {
+    // A callback cannot check the DB against the writes of the other queues,
+    // and may need mutex_ while its group holds up a memtable switch
+    return Status::NotSupported(
+        "write callbacks are not compatible with write_queue_shards > 1");
+  }
   // Otherwise IsLatestPersistentState optimization does not make sense
   assert(!WriteBatchInternal::IsLatestPersistentState(my_batch) ||
          disable_memtable);
 
   Status status;
-  IOStatus io_s;
   if (write_options.low_pri) {
     status = ThrottleLowPriWritesIfNeeded(write_options, my_batch);
     if (!status.ok()) {
@@ -153,6 +267,13 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
                               log_ref, disable_memtable, seq_used);
   }
 
+  if (!write_queue_shards_.empty()) {
+    return ShardedWriteImpl(GetWriteQueue(write_options, my_batch),
+                            write_options, my_batch, callback, log_used,
+                            log_ref, disable_memtable, seq_used,
+                            pre_release_callback);
+  }
+
   PERF_TIMER_GUARD(write_pre_and_post_process_time);
   WriteThread::Writer w(write_options, my_batch, callback, log_ref,
                         disable_memtable, batch_cnt, pre_release_callback);
@@ -208,6 +329,20 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
   }
   // else we are the leader of the write batch group
   assert(w.state == WriteThread::STATE_GROUP_LEADER);
+  PERF_TIMER_STOP(write_pre_and_post_process_time);
+  return WriteAsBatchGroupLeader(&w, write_options, log_used, disable_memtable,
+                                 seq_used);
+}
+
+Status DBImpl::WriteAsBatchGroupLeader(WriteThread::Writer* w,
+                                       const WriteOptions& write_options,
+                                       uint64_t* log_used,
+                                       bool disable_memtable,
+                                       uint64_t* seq_used) {
+  assert(w->state == WriteThread::STATE_GROUP_LEADER);
+  PERF_TIMER_GUARD(write_pre_and_post_process_time);
+  Status status;
+  IOStatus io_s;
 
   // Once reaches this point, the current writer "w" will try to do its write
   // job.  It may also pick up some of the remaining writers in the "writers_"
@@ -230,7 +365,8 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     // PreprocessWrite does its own perf timing.
     PERF_TIMER_STOP(write_pre_and_post_process_time);
 
-    status = PreprocessWrite(write_options, &need_log_sync, &write_context);
+    status = PreprocessWrite(write_options, &need_log_sync, &write_context,
+                             &write_thread_);
     if (!two_write_queues_) {
       // Assign it after ::PreprocessWrite since the sequence might advance
       // inside it by WriteRecoverableState
@@ -239,7 +375,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
 
     PERF_TIMER_START(write_pre_and_post_process_time);
   }
-  log::Writer* log_writer = logs_.back().writer;
+  LogWriterNumber* cur_log = &logs_.back();
 
   mutex_.Unlock();
 
@@ -250,7 +386,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
 
   TEST_SYNC_POINT("DBImpl::WriteImpl:BeforeLeaderEnters");
   last_batch_group_size_ =
-      write_thread_.EnterAsBatchGroupLeader(&w, &write_group);
+      write_thread_.EnterAsBatchGroupLeader(w, &write_group);
 
   if (status.ok()) {
     // Rules for when we can update the memtable concurrently
@@ -264,6 +400,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     // assumed to be true.  Rule 3 is checked for each batch.  We could
     // relax rules 2 if we could prevent write batches from referring
     // more than once to a particular key.
+    // The writers of WriteAsync() have no thread to insert their batches.
     bool parallel = immutable_db_options_.allow_concurrent_memtable_write &&
                     write_group.size > 1;
     size_t total_count = 0;
@@ -271,6 +408,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     size_t total_byte_size = 0;
     size_t pre_release_callback_cnt = 0;
     for (auto* writer : write_group) {
+      parallel = parallel && writer->async_handler == nullptr;
       if (writer->CheckCallback(this)) {
         valid_batches += writer->batch_cnt;
         if (writer->ShouldWriteToMemtable()) {
@@ -324,7 +462,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     if (!two_write_queues_) {
       if (status.ok() && !write_options.disableWAL) {
         PERF_TIMER_GUARD(write_wal_time);
-        io_s = WriteToWAL(write_group, log_writer, log_used, need_log_sync,
+        io_s = WriteToWAL(write_group, cur_log, log_used, need_log_sync,
                           need_log_dir_sync, last_sequence + 1);
       }
     } else {
@@ -378,9 +516,13 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
     if (status.ok()) {
       PERF_TIMER_GUARD(write_memtable_time);
 
-      if (!parallel) {
-        // w.sequence will be set inside InsertInto
-        w.status = WriteBatchInternal::InsertInto(
+      if (!parallel && write_group.size == 1 &&
+          InsertBatchInParallel(w,
+                                write_options.ignore_missing_column_families)) {
+        assert(w->sequence == current_sequence);
+      } else if (!parallel) {
+        // w->sequence will be set inside InsertInto
+        w->status = WriteBatchInternal::InsertInto(
             write_group, current_sequence, column_family_memtables_.get(),
             &flush_scheduler_, &trim_history_scheduler_,
             write_options.ignore_missing_column_families,
@@ -393,27 +535,27 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
 
         // Each parallel follower is doing each own writes. The leader should
         // also do its own.
-        if (w.ShouldWriteToMemtable()) {
+        if (w->ShouldWriteToMemtable()) {
           ColumnFamilyMemTablesImpl column_family_memtables(
               versions_->GetColumnFamilySet());
-          assert(w.sequence == current_sequence);
-          w.status = WriteBatchInternal::InsertInto(
-              &w, w.sequence, &column_family_memtables, &flush_scheduler_,
+          assert(w->sequence == current_sequence);
+          w->status = WriteBatchInternal::InsertInto(
+              w, w->sequence, &column_family_memtables, &flush_scheduler_,
               &trim_history_scheduler_,
               write_options.ignore_missing_column_families, 0 /*log_number*/,
               this, true /*concurrent_memtable_writes*/, seq_per_batch_,
-              w.batch_cnt, batch_per_txn_,
+              w->batch_cnt, batch_per_txn_,
               write_options.memtable_insert_hint_per_batch);
         }
       }
       if (seq_used != nullptr) {
-        *seq_used = w.sequence;
+        *seq_used = w->sequence;
       }
     }
   }
   PERF_TIMER_START(write_pre_and_post_process_time);
 
-  if (!w.CallbackFailed()) {
+  if (!w->CallbackFailed()) {
     if (!io_s.ok()) {
       IOStatusCheck(io_s);
     } else {
@@ -440,7 +582,7 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
   if (in_parallel_group) {
     // CompleteParallelWorker returns true if this thread should
     // handle exit, false means somebody else did
-    should_exit_batch_group = write_thread_.CompleteParallelMemTableWriter(&w);
+    should_exit_batch_group = write_thread_.CompleteParallelMemTableWriter(w);
   }
   if (should_exit_batch_group) {
     if (status.ok()) {
@@ -448,12 +590,12 @@ Status DBImpl::WriteImpl(const WriteOptions& write_options,
       // we reacts to non-OK statuses here.
       versions_->SetLastSequence(last_sequence);
     }
-    MemTableInsertStatusCheck(w.status);
+    MemTableInsertStatusCheck(w->status);
     write_thread_.ExitAsBatchGroupLeader(write_group, status);
   }
 
   if (status.ok()) {
-    status = w.FinalStatus();
+    status = w->FinalStatus();
   }
   return status;
 }
@@ -480,9 +622,10 @@ Status DBImpl::PipelinedWriteImpl(const WriteOptions& write_options,
     bool need_log_dir_sync = need_log_sync && !log_dir_synced_;
     // PreprocessWrite does its own perf timing.
     PERF_TIMER_STOP(write_pre_and_post_process_time);
-    w.status = PreprocessWrite(write_options, &need_log_sync, &write_context);
+    w.status = PreprocessWrite(write_options, &need_log_sync, &write_context,
+                               &write_thread_);
     PERF_TIMER_START(write_pre_and_post_process_time);
-    log::Writer* log_writer = logs_.back().writer;
+    LogWriterNumber* cur_log = &logs_.back();
     mutex_.Unlock();
 
     // This can set non-OK status if callback fail.
@@ -532,7 +675,7 @@ Status DBImpl::PipelinedWriteImpl(const WriteOptions& write_options,
                           wal_write_group.size - 1);
         RecordTick(stats_, WRITE_DONE_BY_OTHER, wal_write_group.size - 1);
       }
-      io_s = WriteToWAL(wal_write_group, log_writer, log_used, need_log_sync,
+      io_s = WriteToWAL(wal_write_group, cur_log, log_used, need_log_sync,
                         need_log_dir_sync, current_sequence);
       w.status = io_s;
     }
@@ -597,6 +740,344 @@ Status DBImpl::PipelinedWriteImpl(const WriteOptions& write_options,
   return w.FinalStatus();
 }
 
+Status DBImpl::ShardedWriteImpl(WriteThread* write_thread,
+                                const WriteOptions& write_options,
+                                WriteBatch* my_batch, WriteCallback* callback,
+                                uint64_t* log_used, uint64_t log_ref,
+                                bool disable_memtable, uint64_t* seq_used,
+                                PreReleaseCallback* pre_release_callback) {
+  // The write groups of the different queues go through the same steps as the
+  // ones of the main write queue in WriteImpl(), but concurrently: they append
+  // to the WAL in turn, which allocates their sequence numbers in WAL order,
+  // and insert into the memtables concurrently. The sequence numbers are then
+  // published in the order they were allocated in, so that no write becomes
+  // visible before an earlier one. While registered with
+  // EnterWriteQueueShardGroup(), a group must not lock mutex_ since
+  // BeginWriteQueueShardsExclusive() waits for it while holding mutex_, which
+  // is why WriteImpl() turns down write callbacks here.
+  assert(!seq_per_batch_);
+  assert(callback == nullptr);
+  PERF_TIMER_GUARD(write_pre_and_post_process_time);
+  WriteThread::Writer w(write_options, my_batch, callback, log_ref,
+                        disable_memtable, 0 /*batch_cnt*/,
+                        pre_release_callback);
+
+  if (!write_options.disableWAL) {
+    RecordTick(stats_, WRITE_WITH_WAL);
+  }
+
+  StopWatch write_sw(env_, immutable_db_options_.statistics.get(), DB_WRITE);
+
+  write_thread->JoinBatchGroup(&w);
+  if (w.state == WriteThread::STATE_PARALLEL_MEMTABLE_WRITER) {
+    // we are a non-leader in a parallel group
+    if (w.ShouldWriteToMemtable()) {
+      PERF_TIMER_STOP(write_pre_and_post_process_time);
+      PERF_TIMER_GUARD(write_memtable_time);
+
+      ColumnFamilyMemTablesImpl column_family_memtables(
+          versions_->GetColumnFamilySet());
+      w.status = WriteBatchInternal::InsertInto(
+          &w, w.sequence, &column_family_memtables, &flush_scheduler_,
+          &trim_history_scheduler_,
+          write_options.ignore_missing_column_families, 0 /*log_number*/, this,
+          true /*concurrent_memtable_writes*/, false /*seq_per_batch*/,
+          0 /*batch_cnt*/, batch_per_txn_,
+          write_options.memtable_insert_hint_per_batch);
+
+      PERF_TIMER_START(write_pre_and_post_process_time);
+    }
+
+    if (write_thread->CompleteParallelMemTableWriter(&w)) {
+      // we're responsible for exit batch group
+      ExitWriteQueueShardGroup(w.write_group->prev_sequence,
+                               w.write_group->last_sequence);
+      MemTableInsertStatusCheck(w.status);
+      write_thread->ExitAsBatchGroupFollower(&w);
+    }
+    assert(w.state == WriteThread::STATE_COMPLETED);
+    // STATE_COMPLETED conditional below handles exit
+  }
+  if (w.state == WriteThread::STATE_COMPLETED) {
+    if (log_used != nullptr) {
+      *log_used = w.log_used;
+    }
+    if (seq_used != nullptr) {
+      *seq_used = w.sequence;
+    }
+    // write is complete and leader has published the sequence
+    return w.FinalStatus();
+  }
+  // else we are the leader of the write batch group
+  assert(w.state == WriteThread::STATE_GROUP_LEADER);
+
+  WriteContext write_context;
+  WriteThread::WriteGroup write_group;
+  bool in_parallel_group = false;
+  SequenceNumber last_sequence = kMaxSequenceNumber;
+  Status status;
+  IOStatus io_s;
+
+  mutex_.Lock();
+  bool need_log_sync = write_options.sync;
+  bool need_log_dir_sync = need_log_sync && !log_dir_synced_;
+  // PreprocessWrite does its own perf timing.
+  PERF_TIMER_STOP(write_pre_and_post_process_time);
+  status = PreprocessWrite(write_options, &need_log_sync, &write_context,
+                           write_thread);
+  PERF_TIMER_START(write_pre_and_post_process_time);
+  const bool registered = status.ok();
+  if (registered) {
+    EnterWriteQueueShardGroup();
+  }
+  // No WAL can be created until the group is done, see MarkLogsSynced() below
+  const uint64_t log_number = logfile_number_;
+  mutex_.Unlock();
+
+  last_batch_group_size_ =
+      write_thread->EnterAsBatchGroupLeader(&w, &write_group);
+
+  if (status.ok()) {
+    // Merges are fine to insert concurrently since max_successive_merges,
+    // which needs to read the memtable, is required to be 0.
+    bool parallel = write_group.size > 1;
+    size_t total_count = 0;
+    size_t total_byte_size = 0;
+    size_t pre_release_callback_cnt = 0;
+    for (auto* writer : write_group) {
+      if (writer->CheckCallback(this)) {
+        if (writer->ShouldWriteToMemtable()) {
+          total_count += WriteBatchInternal::Count(writer->batch);
+        }
+        total_byte_size = WriteBatchInternal::AppendedByteSize(
+            total_byte_size, WriteBatchInternal::ByteSize(writer->batch));
+        if (writer->pre_release_callback) {
+          pre_release_callback_cnt++;
+        }
+      }
+    }
+
+    // The leaders of the other queues update the stats too.
+    const bool concurrent_update = true;
+    auto stats = default_cf_internal_stats_;
+    stats->AddDBStats(InternalStats::kIntStatsNumKeysWritten, total_count,
+                      concurrent_update);
+    RecordTick(stats_, NUMBER_KEYS_WRITTEN, total_count);
+    stats->AddDBStats(InternalStats::kIntStatsBytesWritten, total_byte_size,
+                      concurrent_update);
+    RecordTick(stats_, BYTES_WRITTEN, total_byte_size);
+    stats->AddDBStats(InternalStats::kIntStatsWriteDoneBySelf, 1,
+                      concurrent_update);
+    RecordTick(stats_, WRITE_DONE_BY_SELF);
+    auto write_done_by_other = write_group.size - 1;
+    if (write_done_by_other > 0) {
+      stats->AddDBStats(InternalStats::kIntStatsWriteDoneByOther,
+                        write_done_by_other, concurrent_update);
+      RecordTick(stats_, WRITE_DONE_BY_OTHER, write_done_by_other);
+    }
+    RecordInHistogram(stats_, BYTES_PER_WRITE, total_byte_size);
+
+    if (write_options.disableWAL) {
+      has_unpersisted_data_.store(true, std::memory_order_relaxed);
+    }
+
+    PERF_TIMER_STOP(write_pre_and_post_process_time);
+
+    if (!write_options.disableWAL) {
+      PERF_TIMER_GUARD(write_wal_time);
+      // LastAllocatedSequence is increased inside WriteToWAL under
+      // log_write_mutex_ to ensure ordered events in WAL
+      io_s = ConcurrentWriteToWAL(write_group, log_used, &last_sequence,
+                                  total_count, need_log_sync,
+                                  need_log_dir_sync);
+      status = io_s;
+    } else {
+      last_sequence = versions_->FetchAddLastAllocatedSequence(total_count);
+    }
+    write_group.prev_sequence = last_sequence;
+    const SequenceNumber current_sequence = last_sequence + 1;
+    last_sequence += total_count;
+
+    // PreReleaseCallback is called after WAL write and before memtable write
+    if (status.ok()) {
+      SequenceNumber next_sequence = current_sequence;
+      size_t index = 0;
+      for (auto* writer : write_group) {
+        if (writer->CallbackFailed()) {
+          continue;
+        }
+        writer->sequence = next_sequence;
+        if (writer->pre_release_callback) {
+          Status ws = writer->pre_release_callback->Callback(
+              writer->sequence, disable_memtable, writer->log_used, index++,
+              pre_release_callback_cnt);
+          if (!ws.ok()) {
+            status = ws;
+            break;
+          }
+        }
+        if (writer->ShouldWriteToMemtable()) {
+          next_sequence += WriteBatchInternal::Count(writer->batch);
+        }
+      }
+    }
+
+    if (status.ok()) {
+      PERF_TIMER_GUARD(write_memtable_time);
+
+      // The column_family_memtables_ of the main write queue cannot be used
+      // concurrently with the other queues.
+      ColumnFamilyMemTablesImpl column_family_memtables(
+          versions_->GetColumnFamilySet());
+      if (!parallel) {
+        // w.sequence will be set inside InsertInto
+        w.status = WriteBatchInternal::InsertInto(
+            write_group, current_sequence, &column_family_memtables,
+            &flush_scheduler_, &trim_history_scheduler_,
+            write_options.ignore_missing_column_families,
+            0 /*recovery_log_number*/, this,
+            true /*concurrent_memtable_writes*/, false /*seq_per_batch*/,
+            batch_per_txn_);
+      } else {
+        write_group.last_sequence = last_sequence;
+        write_thread->LaunchParallelMemTableWriters(&write_group);
+        in_parallel_group = true;
+
+        // Each parallel follower is doing each own writes. The leader should
+        // also do its own.
+        if (w.ShouldWriteToMemtable()) {
+          assert(w.sequence == current_sequence);
+          w.status = WriteBatchInternal::InsertInto(
+              &w, w.sequence, &column_family_memtables, &flush_scheduler_,
+              &trim_history_scheduler_,
+              write_options.ignore_missing_column_families, 0 /*log_number*/,
+              this, true /*concurrent_memtable_writes*/,
+              false /*seq_per_batch*/, 0 /*batch_cnt*/, batch_per_txn_,
+              write_options.memtable_insert_hint_per_batch);
+        }
+      }
+      if (seq_used != nullptr) {
+        *seq_used = w.sequence;
+      }
+    }
+  }
+  PERF_TIMER_START(write_pre_and_post_process_time);
+
+  bool should_exit_batch_group = true;
+  if (in_parallel_group) {
+    // CompleteParallelWorker returns true if this thread should
+    // handle exit, false means somebody else did
+    should_exit_batch_group = write_thread->CompleteParallelMemTableWriter(&w);
+  }
+  if (should_exit_batch_group) {
+    if (registered) {
+      // Even if the write failed, the queues that got later sequence numbers
+      // wait for these to be published.
+      ExitWriteQueueShardGroup(write_group.prev_sequence, last_sequence);
+    }
+    MemTableInsertStatusCheck(w.status);
+    write_thread->ExitAsBatchGroupLeader(write_group, status);
+  }
+
+  if (!w.CallbackFailed()) {
+    if (!io_s.ok()) {
+      IOStatusCheck(io_s);
+    } else {
+      WriteStatusCheck(status);
+    }
+  }
+
+  if (need_log_sync) {
+    // The WAL was synced by ConcurrentWriteToWAL.
+    mutex_.Lock();
+    MarkLogsSynced(log_number, need_log_dir_sync, status);
+    mutex_.Unlock();
+  }
+
+  if (status.ok()) {
+    status = w.FinalStatus();
+  }
+  return status;
+}
+
+WriteThread* DBImpl::GetWriteQueue(const WriteOptions& write_options,
+                                   WriteBatch* my_batch) {
+  const size_t num_queues = write_queue_shards_.size() + 1;
+  size_t queue;
+  if (write_options.write_queue_shard >= 0) {
+    queue = static_cast<size_t>(write_options.write_queue_shard);
+  } else {
+    // Writes to the same column family share a queue, and so a WAL record
+    uint32_t column_family = 0;
+    Slice input(WriteBatchInternal::Contents(my_batch));
+    if (input.size() > WriteBatchInternal::kHeader) {
+      input.remove_prefix(WriteBatchInternal::kHeader);
+      char tag = 0;
+      Slice key, value, blob, xid;
+      Status s = ReadRecordFromWriteBatch(
+          &input, &tag, &column_family, &key, &value, &blob, &xid,
+          WriteBatchInternal::HasPinnedValues(my_batch));
+      if (!s.ok()) {
+        column_family = 0;
+      }
+    }
+    queue = column_family;
+  }
+  queue %= num_queues;
+  return queue == 0 ? &write_thread_ : write_queue_shards_[queue - 1].get();
+}
+
+void DBImpl::BeginWriteQueueShardsExclusive() {
+  mutex_.AssertHeld();
+  if (write_queue_shards_.empty()) {
+    return;
+  }
+  while (write_queue_shards_exclusive_) {
+    write_queue_shards_cv_.Wait();
+  }
+  write_queue_shards_exclusive_ = true;
+  // The registered write groups finish without mutex_
+  if (pending_memtable_writes_.load() != 0) {
+    std::unique_lock<std::mutex> guard(switch_mutex_);
+    switch_cv_.wait(guard,
+                    [&] { return pending_memtable_writes_.load() == 0; });
+  }
+}
+
+void DBImpl::EndWriteQueueShardsExclusive() {
+  mutex_.AssertHeld();
+  if (write_queue_shards_.empty()) {
+    return;
+  }
+  assert(write_queue_shards_exclusive_);
+  write_queue_shards_exclusive_ = false;
+  write_queue_shards_cv_.SignalAll();
+}
+
+void DBImpl::EnterWriteQueueShardGroup() {
+  mutex_.AssertHeld();
+  assert(!write_queue_shards_.empty());
+  while (write_queue_shards_exclusive_) {
+    write_queue_shards_cv_.Wait();
+  }
+  pending_memtable_writes_.fetch_add(1);
+}
+
+void DBImpl::ExitWriteQueueShardGroup(SequenceNumber prev_sequence,
+                                      SequenceNumber last_sequence) {
+  std::unique_lock<std::mutex> guard(switch_mutex_);
+  if (last_sequence > prev_sequence) {
+    TEST_SYNC_POINT("DBImpl::ExitWriteQueueShardGroup:BeforePublish");
+    switch_cv_.wait(
+        guard, [&] { return versions_->LastSequence() == prev_sequence; });
+    versions_->SetLastSequence(last_sequence);
+  }
+  pending_memtable_writes_.fetch_sub(1);
+  // Wakes up both the groups waiting to publish and
+  // BeginWriteQueueShardsExclusive()
+  switch_cv_.notify_all();
+}
+
 Status DBImpl::UnorderedWriteMemtable(const WriteOptions& write_options,
                                       WriteBatch* my_batch,
                                       WriteCallback* callback, uint64_t log_ref,
@@ -687,7 +1168,8 @@ Status DBImpl::WriteImplWALOnly(
     if (status.ok()) {
       InstrumentedMutexLock l(&mutex_);
       bool need_log_sync = false;
-      status = PreprocessWrite(write_options, &need_log_sync, &write_context);
+      status = PreprocessWrite(write_options, &need_log_sync, &write_context,
+                               write_thread);
       WriteStatusCheckOnLocked(status);
     }
     if (!status.ok()) {
@@ -878,7 +1360,8 @@ void DBImpl::MemTableInsertStatusCheck(const Status& status) {
 
 Status DBImpl::PreprocessWrite(const WriteOptions& write_options,
                                bool* need_log_sync,
-                               WriteContext* write_context) {
+                               WriteContext* write_context,
+                               WriteThread* write_thread) {
   mutex_.AssertHeld();
   assert(write_context != nullptr && need_log_sync != nullptr);
   Status status;
@@ -889,11 +1372,22 @@ Status DBImpl::PreprocessWrite(const WriteOptions& write_options,
 
   PERF_TIMER_GUARD(write_scheduling_flushes_compactions_time);
 
+  // Being the leader of write_thread is not enough to switch the WAL or the
+  // memtables with write_queue_shards_: the other queues may be writing.
+  bool shards_exclusive = false;
+  auto begin_shards_exclusive = [&]() {
+    if (!shards_exclusive) {
+      BeginWriteQueueShardsExclusive();
+      shards_exclusive = true;
+    }
+  };
+
   assert(!single_column_family_mode_ ||
          versions_->GetColumnFamilySet()->NumberOfColumnFamilies() == 1);
   if (UNLIKELY(status.ok() && !single_column_family_mode_ &&
                total_log_size_ > GetMaxTotalWalSize())) {
     WaitForPendingWrites();
+    begin_shards_exclusive();
     status = SwitchWAL(write_context);
   }
 
@@ -904,6 +1398,7 @@ Status DBImpl::PreprocessWrite(const WriteOptions& write_options,
     // be flushed. We may end up with flushing much more DBs than needed. It's
     // suboptimal but still correct.
     WaitForPendingWrites();
+    begin_shards_exclusive();
     status = HandleWriteBufferFull(write_context);
   }
 
@@ -913,9 +1408,14 @@ Status DBImpl::PreprocessWrite(const WriteOptions& write_options,
 
   if (UNLIKELY(status.ok() && !flush_scheduler_.Empty())) {
     WaitForPendingWrites();
+    begin_shards_exclusive();
     status = ScheduleFlushes(write_context);
   }
 
+  if (shards_exclusive) {
+    EndWriteQueueShardsExclusive();
+  }
+
   PERF_TIMER_STOP(write_scheduling_flushes_compactions_time);
   PERF_TIMER_GUARD(write_pre_and_post_process_time);
 
@@ -927,7 +1427,7 @@ Status DBImpl::PreprocessWrite(const WriteOptions& write_options,
     // for previous one. It might create a fairness issue that expiration
     // might happen for smaller writes but larger writes can go through.
     // Can optimize it if it is an issue.
-    status = DelayWrite(last_batch_group_size_, write_options);
+    status = DelayWrite(last_batch_group_size_, write_thread, write_options);
     PERF_TIMER_START(write_pre_and_post_process_time);
   }
 
@@ -998,26 +1498,100 @@ WriteBatch* DBImpl::MergeBatch(const WriteThread::WriteGroup& write_group,
   return merged_batch;
 }
 
+bool DBImpl::InsertBatchInParallel(WriteThread::Writer* w,
+                                   bool ignore_missing_column_families) {
+  // Same rules as for parallel write groups in WriteImpl(), where merges are
+  // checked by SplitForParallelInsert()
+  if (memtable_insert_pool_ == nullptr ||
+      !immutable_db_options_.allow_concurrent_memtable_write ||
+      seq_per_batch_ || !batch_per_txn_ || !w->ShouldWriteToMemtable()) {
+    return false;
+  }
+  // Smaller ranges are not worth handing to another thread
+  static const size_t kMinRangeBytes = 1 << 20;
+  const size_t max_ranges = std::min(
+      static_cast<size_t>(immutable_db_options_.memtable_insert_threads),
+      WriteBatchInternal::ByteSize(w->batch) / kMinRangeBytes);
+  std::vector<WriteBatchInternal::Range> ranges;
+  if (max_ranges < 2 ||
+      !WriteBatchInternal::SplitForParallelInsert(w->batch, max_ranges,
+                                                  &ranges) ||
+      ranges.size() < 2) {
+    return false;
+  }
+  TEST_SYNC_POINT_CALLBACK("DBImpl::InsertBatchInParallel:Ranges", &ranges);
+
+  WriteBatchInternal::SetSequence(w->batch, w->sequence);
+  std::vector<Status> statuses(ranges.size());
+  auto insert_range = [&](size_t i) {
+    // Each thread needs its own cursor over the column families
+    ColumnFamilyMemTablesImpl column_family_memtables(
+        versions_->GetColumnFamilySet());
+    statuses[i] = WriteBatchInternal::InsertInto(
+        w, ranges[i], w->sequence, &column_family_memtables, &flush_scheduler_,
+        &trim_history_scheduler_, ignore_missing_column_families, this);
+  };
+  // The pool's threads count down `pending` as they finish their ranges
+  std::mutex mu;
+  std::condition_variable cv;
+  size_t pending = ranges.size() - 1;
+  for (size_t i = 1; i < ranges.size(); i++) {
+    memtable_insert_pool_->SubmitJob([&, i]() {
+      insert_range(i);
+      std::lock_guard<std::mutex> guard(mu);
+      if (--pending == 0) {
+        cv.notify_one();
+      }
+    });
+  }
+  insert_range(0);
+  {
+    std::unique_lock<std::mutex> guard(mu);
+    cv.wait(guard, [&] { return pending == 0; });
+  }
+
+  w->status = Status::OK();
+  for (const auto& s : statuses) {
+    if (!s.ok()) {
+      w->status = s;
+      break;
+    }
+  }
+  return true;
+}
+
+uint64_t DBImpl::GetWALRecordParts(const WriteBatch& merged_batch,
+                                   std::vector<Slice>* log_entry_parts) {
+  if (!WriteBatchInternal::HasPinnedValues(&merged_batch)) {
+    return WriteBatchInternal::Contents(&merged_batch).size();
+  }
+  // Gather the pinned values straight from the callers' buffers
+  return WriteBatchInternal::GetContentsParts(&merged_batch, log_entry_parts);
+}
+
 // When two_write_queues_ is disabled, this function is called from the only
 // write thread. Otherwise this must be called holding log_write_mutex_.
 IOStatus DBImpl::WriteToWAL(const WriteBatch& merged_batch,
                             log::Writer* log_writer, uint64_t* log_used,
-                            uint64_t* log_size) {
+                            uint64_t* log_size, uint64_t record_ordinal) {
   assert(log_size != nullptr);
-  Slice log_entry = WriteBatchInternal::Contents(&merged_batch);
-  *log_size = log_entry.size();
+  std::vector<Slice> log_entry_parts;
+  *log_size = GetWALRecordParts(merged_batch, &log_entry_parts);
   // When two_write_queues_ WriteToWAL has to be protected from concurretn calls
-  // from the two queues anyway and log_write_mutex_ is already held. Otherwise
-  // if manual_wal_flush_ is enabled we need to protect log_writer->AddRecord
-  // from possible concurrent calls via the FlushWAL by the application.
-  const bool needs_locking = manual_wal_flush_ && !two_write_queues_;
+  // from the two queues anyway and log_write_mutex_ is already held, as it is
+  // with write_queue_shards_. Otherwise if manual_wal_flush_ is enabled we need
+  // to protect log_writer->AddRecord from possible concurrent calls via the
+  // FlushWAL by the application.
+  const bool needs_locking =
+      manual_wal_flush_ && !two_write_queues_ && write_queue_shards_.empty();
   // Due to performance cocerns of missed branch prediction penalize the new
   // manual_wal_flush_ feature (by UNLIKELY) instead of the more common case
   // when we do not need any locking.
   if (UNLIKELY(needs_locking)) {
     log_write_mutex_.Lock();
   }
-  IOStatus io_s = log_writer->AddRecord(log_entry);
+  IOStatus io_s =
+      AddWALRecord(merged_batch, log_entry_parts, log_writer, record_ordinal);
 
   if (UNLIKELY(needs_locking)) {
     log_write_mutex_.Unlock();
@@ -1025,16 +1599,49 @@ IOStatus DBImpl::WriteToWAL(const WriteBatch& merged_batch,
   if (log_used != nullptr) {
     *log_used = logfile_number_;
   }
-  total_log_size_ += log_entry.size();
+  total_log_size_ += *log_size;
   // TODO(myabandeh): it might be unsafe to access alive_log_files_.back() here
   // since alive_log_files_ might be modified concurrently
-  alive_log_files_.back().AddSize(log_entry.size());
+  alive_log_files_.back().AddSize(*log_size);
   log_empty_ = false;
   return io_s;
 }
 
+IOStatus DBImpl::AddWALRecord(const WriteBatch& merged_batch,
+                              const std::vector<Slice>& log_entry_parts,
+                              log::Writer* log_writer,
+                              uint64_t record_ordinal) {
+  IOStatus io_s;
+  if (record_ordinal != 0) {
+    io_s = log_writer->AddRecordOrdinal(record_ordinal);
+    if (!io_s.ok()) {
+      return io_s;
+    }
+  }
+  if (!log_entry_parts.empty()) {
+    return log_writer->AddRecord(SliceParts(
+        log_entry_parts.data(), static_cast<int>(log_entry_parts.size())));
+  }
+  return log_writer->AddRecord(WriteBatchInternal::Contents(&merged_batch));
+}
+
+IOStatus DBImpl::WriteWALBuffers() {
+  log_write_mutex_.AssertHeld();
+  LogWriterNumber& log = logs_.back();
+  IOStatus io_s;
+  for (size_t i = 0; io_s.ok() && i < log.num_stripes(); i++) {
+    if (wal_stripe_mutexes_) {
+      InstrumentedMutexLock sl(&wal_stripe_mutexes_[i]);
+      io_s = log.stripe(i)->WriteBuffer();
+    } else {
+      io_s = log.stripe(i)->WriteBuffer();
+    }
+  }
+  return io_s;
+}
+
 IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
-                            log::Writer* log_writer, uint64_t* log_used,
+                            LogWriterNumber* log, uint64_t* log_used,
                             bool need_log_sync, bool need_log_dir_sync,
                             SequenceNumber sequence) {
   IOStatus io_s;
@@ -1054,15 +1661,21 @@ IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
 
   WriteBatchInternal::SetSequence(merged_batch, sequence);
 
+  // Only the write thread numbers the records and picks the stripe
+  size_t stripe;
+  uint64_t record_ordinal;
+  log::Writer* log_writer = log->NextStripe(&stripe, &record_ordinal);
   uint64_t log_size;
-  io_s = WriteToWAL(*merged_batch, log_writer, log_used, &log_size);
+  io_s = WriteToWAL(*merged_batch, log_writer, log_used, &log_size,
+                    record_ordinal);
   if (to_be_cached_state) {
     cached_recoverable_state_ = *to_be_cached_state;
     cached_recoverable_state_empty_ = false;
   }
 
+  uint64_t sync_micros = 0;
   if (io_s.ok() && need_log_sync) {
-    StopWatch sw(env_, stats_, WAL_FILE_SYNC_MICROS);
+    StopWatch sw(env_, stats_, WAL_FILE_SYNC_MICROS, &sync_micros);
     // It's safe to access logs_ with unlocked mutex_ here because:
     //  - we've set getting_synced=true for all logs,
     //    so other threads won't pop from logs_ while we're here,
@@ -1070,8 +1683,10 @@ IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
     //    writer thread, so no one will push to logs_,
     //  - as long as other threads don't modify it, it's safe to read
     //    from std::deque from multiple threads concurrently.
-    for (auto& log : logs_) {
-      io_s = log.writer->file()->Sync(immutable_db_options_.use_fsync);
+    for (auto& l : logs_) {
+      for (size_t i = 0; io_s.ok() && i < l.num_stripes(); i++) {
+        io_s = l.stripe(i)->file()->Sync(immutable_db_options_.use_fsync);
+      }
       if (!io_s.ok()) {
         break;
       }
@@ -1081,7 +1696,7 @@ IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
       // We only sync WAL directory the first time WAL syncing is
       // requested, so that in case users never turn on WAL sync,
       // we can avoid the disk I/O in the write code path.
-      io_s = directories_.GetWalDir()->Fsync(IOOptions(), nullptr);
+      io_s = directories_.FsyncWalDirs(IOOptions(), nullptr);
     }
   }
 
@@ -1093,6 +1708,8 @@ IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
     if (need_log_sync) {
       stats->AddDBStats(InternalStats::kIntStatsWalFileSynced, 1);
       RecordTick(stats_, WAL_FILE_SYNCED);
+      TEST_SYNC_POINT_CALLBACK("DBImpl::WriteToWAL:SyncMicros", &sync_micros);
+      write_thread_.RecordSyncLatency(sync_micros);
     }
     stats->AddDBStats(InternalStats::kIntStatsWalFileBytes, log_size);
     RecordTick(stats_, WAL_FILE_BYTES, log_size);
@@ -1104,7 +1721,8 @@ IOStatus DBImpl::WriteToWAL(const WriteThread::WriteGroup& write_group,
 
 IOStatus DBImpl::ConcurrentWriteToWAL(
     const WriteThread::WriteGroup& write_group, uint64_t* log_used,
-    SequenceNumber* last_sequence, size_t seq_inc) {
+    SequenceNumber* last_sequence, size_t seq_inc, bool need_log_sync,
+    bool need_log_dir_sync) {
   IOStatus io_s;
 
   assert(!write_group.leader->disable_wal);
@@ -1128,19 +1746,77 @@ IOStatus DBImpl::ConcurrentWriteToWAL(
   *last_sequence = versions_->FetchAddLastAllocatedSequence(seq_inc);
   auto sequence = *last_sequence + 1;
   WriteBatchInternal::SetSequence(merged_batch, sequence);
-
-  log::Writer* log_writer = logs_.back().writer;
-  uint64_t log_size;
-  io_s = WriteToWAL(*merged_batch, log_writer, log_used, &log_size);
   if (to_be_cached_state) {
     cached_recoverable_state_ = *to_be_cached_state;
     cached_recoverable_state_empty_ = false;
   }
-  log_write_mutex_.Unlock();
+
+  size_t stripe;
+  uint64_t record_ordinal;
+  log::Writer* log_writer = logs_.back().NextStripe(&stripe, &record_ordinal);
+  uint64_t log_size;
+  bool log_write_mutex_held = true;
+  if (record_ordinal == 0) {
+    io_s = WriteToWAL(*merged_batch, log_writer, log_used, &log_size);
+  } else {
+    // The records were numbered in the order of their sequence numbers above,
+    // so the write queues of write_queue_shards_ can append them to the other
+    // stripes while this one is being appended, unless the WAL is to be
+    // synced.
+    InstrumentedMutexLock sl(&wal_stripe_mutexes_[stripe]);
+    if (!write_queue_shards_.empty() && !need_log_sync) {
+      std::vector<Slice> log_entry_parts;
+      log_size = GetWALRecordParts(*merged_batch, &log_entry_parts);
+      if (log_used != nullptr) {
+        *log_used = logfile_number_;
+      }
+      total_log_size_ += log_size;
+      alive_log_files_.back().AddSize(log_size);
+      log_empty_ = false;
+      log_write_mutex_.Unlock();
+      log_write_mutex_held = false;
+      io_s = AddWALRecord(*merged_batch, log_entry_parts, log_writer,
+                          record_ordinal);
+    } else {
+      io_s = WriteToWAL(*merged_batch, log_writer, log_used, &log_size,
+                        record_ordinal);
+    }
+  }
+  if (io_s.ok() && need_log_sync) {
+    assert(log_write_mutex_held);
+    StopWatch sw(env_, stats_, WAL_FILE_SYNC_MICROS);
+    // We've set getting_synced=true for all logs, and no log is added before
+    // the write group is done. Holding log_write_mutex_ keeps the other write
+    // queues from appending to the log being synced, once the appends to its
+    // stripes in progress are done.
+    for (auto& log : logs_) {
+      for (size_t i = 0; io_s.ok() && i < log.num_stripes(); i++) {
+        if (wal_stripe_mutexes_) {
+          InstrumentedMutexLock sl(&wal_stripe_mutexes_[i]);
+          io_s = log.stripe(i)->file()->Sync(immutable_db_options_.use_fsync);
+        } else {
+          io_s = log.stripe(i)->file()->Sync(immutable_db_options_.use_fsync);
+        }
+      }
+      if (!io_s.ok()) {
+        break;
+      }
+    }
+    if (io_s.ok() && need_log_dir_sync) {
+      io_s = directories_.FsyncWalDirs(IOOptions(), nullptr);
+    }
+  }
+  if (log_write_mutex_held) {
+    log_write_mutex_.Unlock();
+  }
 
   if (io_s.ok()) {
     const bool concurrent = true;
     auto stats = default_cf_internal_stats_;
+    if (need_log_sync) {
+      stats->AddDBStats(InternalStats::kIntStatsWalFileSynced, 1, concurrent);
+      RecordTick(stats_, WAL_FILE_SYNCED);
+    }
     stats->AddDBStats(InternalStats::kIntStatsWalFileBytes, log_size,
                       concurrent);
     RecordTick(stats_, WAL_FILE_BYTES, log_size);
@@ -1160,7 +1836,10 @@ Status DBImpl::WriteRecoverableState() {
       log_write_mutex_.Lock();
     }
     SequenceNumber seq;
-    if (two_write_queues_) {
+    // The write queues of write_queue_shards_ are excluded by the caller, but
+    // allocate their sequence numbers too.
+    const bool allocate_seq = two_write_queues_ || !write_queue_shards_.empty();
+    if (allocate_seq) {
       seq = versions_->FetchAddLastAllocatedSequence(0);
     } else {
       seq = versions_->LastSequence();
@@ -1172,7 +1851,7 @@ Status DBImpl::WriteRecoverableState() {
         0 /*recovery_log_number*/, this, false /* concurrent_memtable_writes */,
         &next_seq, &dont_care_bool, seq_per_batch_);
     auto last_seq = next_seq - 1;
-    if (two_write_queues_) {
+    if (allocate_seq) {
       versions_->FetchAddLastAllocatedSequence(last_seq - seq);
       versions_->SetLastPublishedSequence(last_seq);
     }
@@ -1407,7 +2086,7 @@ uint64_t DBImpl::GetMaxTotalWalSize() const {
 
 // REQUIRES: mutex_ is held
 // REQUIRES: this thread is currently at the front of the writer queue
-Status DBImpl::DelayWrite(uint64_t num_bytes,
+Status DBImpl::DelayWrite(uint64_t num_bytes, WriteThread* write_thread,
                           const WriteOptions& write_options) {
   uint64_t time_delayed = 0;
   bool delayed = false;
@@ -1420,9 +2099,9 @@ Status DBImpl::DelayWrite(uint64_t num_bytes,
       }
       TEST_SYNC_POINT("DBImpl::DelayWrite:Sleep");
 
-      // Notify write_thread_ about the stall so it can setup a barrier and
+      // Notify write_thread about the stall so it can setup a barrier and
       // fail any pending writers with no_slowdown
-      write_thread_.BeginWriteStall();
+      write_thread->BeginWriteStall();
       TEST_SYNC_POINT("DBImpl::DelayWrite:BeginWriteStallDone");
       mutex_.Unlock();
       // We will delay the write until we have slept for delay ms or
@@ -1440,7 +2119,7 @@ Status DBImpl::DelayWrite(uint64_t num_bytes,
         env_->SleepForMicroseconds(kDelayInterval);
       }
       mutex_.Lock();
-      write_thread_.EndWriteStall();
+      write_thread->EndWriteStall();
     }
 
     // Don't wait if there's a background error, even if its a soft error. We
@@ -1453,12 +2132,12 @@ Status DBImpl::DelayWrite(uint64_t num_bytes,
       }
       delayed = true;
 
-      // Notify write_thread_ about the stall so it can setup a barrier and
+      // Notify write_thread about the stall so it can setup a barrier and
       // fail any pending writers with no_slowdown
-      write_thread_.BeginWriteStall();
+      write_thread->BeginWriteStall();
       TEST_SYNC_POINT("DBImpl::DelayWrite:Wait");
       bg_cv_.Wait();
-      write_thread_.EndWriteStall();
+      write_thread->EndWriteStall();
     }
   }
   assert(!delayed || !write_options.no_slowdown);
@@ -1650,6 +2329,7 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
   WriteThread::Writer nonmem_w;
   std::unique_ptr<WritableFile> lfile;
   log::Writer* new_log = nullptr;
+  std::vector<log::Writer*> new_stripes;
   MemTable* new_mem = nullptr;
   IOStatus io_s;
 
@@ -1698,7 +2378,7 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
     // TODO: Write buffer size passed in should be max of all CF's instead
     // of mutable_cf_options.write_buffer_size.
     io_s = CreateWAL(new_log_number, recycle_log_number, preallocate_block_size,
-                     &new_log);
+                     &new_log, &new_stripes);
     if (s.ok()) {
       s = io_s;
     }
@@ -1727,7 +2407,7 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
     if (!logs_.empty()) {
       // Alway flush the buffer of the last log before switching to a new one
       log::Writer* cur_log_writer = logs_.back().writer;
-      io_s = cur_log_writer->WriteBuffer();
+      io_s = WriteWALBuffers();
       if (s.ok()) {
         s = io_s;
       }
@@ -1743,7 +2423,7 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
       logfile_number_ = new_log_number;
       log_empty_ = true;
       log_dir_synced_ = false;
-      logs_.emplace_back(logfile_number_, new_log);
+      logs_.emplace_back(logfile_number_, new_log, std::move(new_stripes));
       alive_log_files_.push_back(LogFileNumberSize(logfile_number_));
     }
     log_write_mutex_.Unlock();
@@ -1758,6 +2438,9 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
     if (new_log) {
       delete new_log;
     }
+    for (auto* new_stripe : new_stripes) {
+      delete new_stripe;
+    }
     SuperVersion* new_superversion =
         context->superversion_context.new_superversion.release();
     if (new_superversion != nullptr) {
@@ -1795,6 +2478,10 @@ Status DBImpl::SwitchMemtable(ColumnFamilyData* cfd, WriteContext* context) {
   cfd->SetMemtable(new_mem);
   InstallSuperVersionAndScheduleWork(cfd, &context->superversion_context,
                                      mutable_cf_options);
+  if (mutable_cf_options.compact_immutable_memtables &&
+      !cfd->imm()->IsFlushPending()) {
+    ScheduleMemTableCompaction(cfd);
+  }
 #ifndef ROCKSDB_LITE
   mutex_.Unlock();
   // Notify client that memtable is sealed, now that we have successfully
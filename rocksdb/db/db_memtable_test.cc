@@ -9,9 +9,11 @@
 #include "db/db_test_util.h"
 #include "db/memtable.h"
 #include "db/range_del_aggregator.h"
+#include "db/write_batch_internal.h"
 #include "port/stack_trace.h"
 #include "rocksdb/memtablerep.h"
 #include "rocksdb/slice_transform.h"
+#include "table/scoped_arena_iterator.h"
 
 namespace ROCKSDB_NAMESPACE {
 
@@ -204,6 +206,70 @@ TEST_F(DBMemTableTest, DuplicateSeq) {
   delete mem;
 }
 
+// Test that a duplicate key+seq is rejected when the write batch inserts it
+// with the hint of a sorted run
+TEST_F(DBMemTableTest, DuplicateSeqWithSortedRunHint) {
+  std::vector<std::shared_ptr<MemTableRepFactory>> factories;
+  factories.emplace_back(new SkipListFactory());
+#ifndef ROCKSDB_LITE
+  factories.emplace_back(NewAVLTreeRepFactory());
+  factories.emplace_back(NewBTreeRepFactory());
+  factories.emplace_back(NewARTRepFactory());
+#endif  // ROCKSDB_LITE
+  InternalKeyComparator cmp(BytewiseComparator());
+  for (auto& factory : factories) {
+    for (bool concurrent : {false, true}) {
+      if (concurrent && !factory->IsInsertConcurrentlySupported()) {
+        continue;
+      }
+      Options options;
+      options.memtable_factory = factory;
+      options.allow_concurrent_memtable_write = concurrent;
+      ImmutableCFOptions ioptions(options);
+      WriteBufferManager wb(options.db_write_buffer_size);
+      MemTable* mem =
+          new MemTable(cmp, ioptions, MutableCFOptions(options), &wb,
+                       kMaxSequenceNumber, 0 /* column_family_id */);
+      mem->Ref();
+
+      // "z" comes again after a run of ascending keys long enough to be
+      // inserted with a hint. With one sequence number per batch, it is a
+      // duplicate key+seq and must go into a new sub-batch.
+      const SequenceNumber kSeq = 100;
+      WriteBatch batch;
+      ASSERT_OK(batch.Put("z", "v1"));
+      for (char c = 'a'; c < 'a' + 20; c++) {
+        ASSERT_OK(batch.Put(std::string(1, c), "v"));
+      }
+      ASSERT_OK(batch.Put("z", "v2"));
+      WriteBatchInternal::SetSequence(&batch, kSeq);
+      ColumnFamilyMemTablesDefault cf_mems_default(mem);
+      ASSERT_OK(WriteBatchInternal::InsertInto(
+          &batch, &cf_mems_default, nullptr, nullptr,
+          false /* ignore_missing_column_families */, 0 /* log_number */,
+          nullptr /* db */, concurrent, nullptr /* next_seq */,
+          nullptr /* has_valid_writes */, true /* seq_per_batch */));
+
+      Arena arena;
+      ScopedArenaIterator iter(mem->NewIterator(ReadOptions(), &arena));
+      std::vector<std::pair<SequenceNumber, std::string>> versions;
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+        ParsedInternalKey ikey;
+        ASSERT_TRUE(ParseInternalKey(iter->key(), &ikey));
+        if (ikey.user_key == "z") {
+          versions.emplace_back(ikey.sequence, iter->value().ToString());
+        }
+      }
+      ASSERT_EQ(2U, versions.size()) << factory->Name();
+      ASSERT_EQ(kSeq + 1, versions[0].first);
+      ASSERT_EQ("v2", versions[0].second);
+      ASSERT_EQ(kSeq, versions[1].first);
+      ASSERT_EQ("v1", versions[1].second);
+      delete mem->Unref();
+    }
+  }
+}
+
 // A simple test to verify that the concurrent merge writes is functional
 TEST_F(DBMemTableTest, ConcurrentMergeWrite) {
   int num_ops = 1000;
@@ -313,6 +379,183 @@ TEST_F(DBMemTableTest, InsertWithHint) {
   ASSERT_EQ("vvv", Get("NotInPrefixDomain"));
 }
 
+TEST_F(DBMemTableTest, SortedBatchInsertWithHint) {
+  Options options;
+  options.allow_concurrent_memtable_write = false;
+  options.create_if_missing = true;
+  options.memtable_factory.reset(new MockMemTableRepFactory());
+  options.env = env_;
+  Reopen(options);
+  MockMemTableRep* rep =
+      reinterpret_cast<MockMemTableRepFactory*>(options.memtable_factory.get())
+          ->rep();
+  auto key = [](int i) {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "key%06d", i);
+    return std::string(buf);
+  };
+
+  // Once the run is long enough, the rest of an ascending batch is inserted
+  // with a single hint
+  const int kNumKeys = 100;
+  WriteBatch ascending;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_OK(ascending.Put(key(2 * i), "v"));
+  }
+  ASSERT_OK(dbfull()->Write(WriteOptions(), &ascending));
+  int num_hinted = rep->num_insert_with_hint();
+  ASSERT_GT(num_hinted, kNumKeys / 2);
+  ASSERT_LT(num_hinted, kNumKeys);
+  ASSERT_EQ(rep->last_hint_in(), rep->last_hint_out());
+
+  // Descending keys never form a run
+  WriteBatch descending;
+  for (int i = kNumKeys - 1; i >= 0; i--) {
+    ASSERT_OK(descending.Put(key(2 * i + 1), "v"));
+  }
+  ASSERT_OK(dbfull()->Write(WriteOptions(), &descending));
+  ASSERT_EQ(num_hinted, rep->num_insert_with_hint());
+
+  // Sorted batches interleaved with existing keys, with and without
+  // concurrent memtable writes
+  std::vector<std::shared_ptr<MemTableRepFactory>> factories;
+  factories.emplace_back(new SkipListFactory());
+#ifndef ROCKSDB_LITE
+  factories.emplace_back(NewAVLTreeRepFactory());
+#endif  // ROCKSDB_LITE
+  for (auto& factory : factories) {
+    for (bool concurrent : {false, true}) {
+      options.memtable_factory = factory;
+      options.allow_concurrent_memtable_write = concurrent;
+      DestroyAndReopen(options);
+      for (int stride : {7, 3, 1}) {
+        WriteBatch batch;
+        for (int i = 0; i < 3000; i += stride) {
+          ASSERT_OK(batch.Put(key(i), key(i) + ToString(stride)));
+        }
+        ASSERT_OK(dbfull()->Write(WriteOptions(), &batch));
+      }
+      std::unique_ptr<Iterator> iter(db_->NewIterator(ReadOptions()));
+      int i = 0;
+      for (iter->SeekToFirst(); iter->Valid(); iter->Next(), i++) {
+        ASSERT_EQ(key(i), iter->key().ToString());
+        ASSERT_EQ(key(i) + "1", iter->value().ToString());
+      }
+      ASSERT_OK(iter->status());
+      ASSERT_EQ(3000, i);
+    }
+  }
+}
+
+TEST_F(DBMemTableTest, CompactImmutableMemTables) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compact_immutable_memtables = true;
+  options.min_write_buffer_number_to_merge = 3;
+  options.max_write_buffer_number = 4;
+  options.merge_operator = MergeOperators::CreateStringAppendOperator();
+  DestroyAndReopen(options);
+
+  int num_installed = 0;
+  SyncPoint::GetInstance()->SetCallBack(
+      "DBImpl::BackgroundCallMemTableCompaction:Done", [&](void* arg) {
+        if (*static_cast<bool*>(arg)) {
+          num_installed++;
+        }
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // Hot keys: only the last version of each survives.
+  for (int i = 0; i < 100; i++) {
+    for (int k = 0; k < 5; k++) {
+      ASSERT_OK(Put("key" + ToString(k), "v" + ToString(i)));
+    }
+  }
+  ASSERT_OK(Delete("key4"));
+  // A snapshot keeps the version it can see.
+  ASSERT_OK(Put("snap", "old"));
+  const Snapshot* snapshot = db_->GetSnapshot();
+  ASSERT_OK(Put("snap", "new"));
+  // Merge operands on top of a base value are combined.
+  ASSERT_OK(Put("merge", "x"));
+  ASSERT_OK(Merge("merge", "a"));
+  ASSERT_OK(Merge("merge", "b"));
+  ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+  ASSERT_OK(dbfull()->TEST_WaitForCompact());
+
+  ASSERT_EQ(1, num_installed);
+  uint64_t num_entries = 0;
+  ASSERT_TRUE(dbfull()->GetIntProperty(
+      DB::Properties::kNumEntriesImmMemTables, &num_entries));
+  // key0-3, the key4 tombstone, both versions of snap and the merged value.
+  ASSERT_EQ(8U, num_entries);
+
+  auto verify = [&]() {
+    for (int k = 0; k < 4; k++) {
+      ASSERT_EQ("v99", Get("key" + ToString(k)));
+    }
+    ASSERT_EQ("NOT_FOUND", Get("key4"));
+    ASSERT_EQ("new", Get("snap"));
+    ASSERT_EQ("old", Get("snap", snapshot));
+    ASSERT_EQ("x,a,b", Get("merge"));
+  };
+  verify();
+  ASSERT_OK(Flush());
+  verify();
+
+  db_->ReleaseSnapshot(snapshot);
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+}
+
+TEST_F(DBMemTableTest, MemTableCompactionWaitsForCompactionSlot) {
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.compact_immutable_memtables = true;
+  options.min_write_buffer_number_to_merge = 3;
+  options.max_write_buffer_number = 4;
+  options.level0_file_num_compaction_trigger = 2;
+  // A single compaction slot, but enough LOW threads to run both jobs
+  options.max_background_jobs = 2;
+  env_->SetBackgroundThreads(2, Env::LOW);
+  DestroyAndReopen(options);
+
+  std::atomic<bool> compaction_released(false);
+  std::atomic<int> num_installed(0);
+  SyncPoint::GetInstance()->LoadDependency(
+      {{"DBMemTableTest::MemTableCompactionWaitsForCompactionSlot:Release",
+        "DBImpl::BGWorkCompaction"}});
+  SyncPoint::GetInstance()->SetCallBack(
+      "DBImpl::BackgroundCallMemTableCompaction:Done", [&](void* arg) {
+        if (*static_cast<bool*>(arg)) {
+          // The compaction holding the slot was let go first
+          ASSERT_TRUE(compaction_released.load());
+          num_installed++;
+        }
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // Two L0 files take the compaction slot
+  for (int f = 0; f < 2; f++) {
+    ASSERT_OK(Put("file" + ToString(f), "v"));
+    ASSERT_OK(Flush());
+  }
+  for (int i = 0; i < 100; i++) {
+    ASSERT_OK(Put("key", "v" + ToString(i)));
+  }
+  ASSERT_OK(dbfull()->TEST_SwitchMemtable());
+
+  compaction_released = true;
+  TEST_SYNC_POINT(
+      "DBMemTableTest::MemTableCompactionWaitsForCompactionSlot:Release");
+  ASSERT_OK(dbfull()->TEST_WaitForCompact());
+  ASSERT_EQ(1, num_installed.load());
+  ASSERT_EQ("v99", Get("key"));
+
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+}
+
 TEST_F(DBMemTableTest, ColumnFamilyId) {
   // Verifies MemTableRepFactory is told the right column family id.
   Options options;
@@ -331,6 +574,123 @@ TEST_F(DBMemTableTest, ColumnFamilyId) {
   }
 }
 
+#ifndef ROCKSDB_LITE
+TEST_F(DBMemTableTest, VectorRepSortedRuns) {
+  // Enough keys to sort and merge on several threads at flush; reads of the
+  // mutable memtable see a mix of sorted and unsorted runs.
+  const int kNumKeys = 70000;
+  for (int config = 0; config < 3; config++) {
+    Options options = CurrentOptions();
+    options.create_if_missing = true;
+    options.allow_concurrent_memtable_write = false;
+    options.write_buffer_size = 64 << 20;
+    // Unsorted until flush; runs sorted on Env::Default(); runs sorted on
+    // the DB's Env
+    const size_t sort_run_size = config == 0 ? 0 : 1000;
+    Env* sort_env = config == 2 ? options.env : nullptr;
+    options.memtable_factory.reset(
+        new VectorRepFactory(0, sort_run_size, sort_env));
+    DestroyAndReopen(options);
+
+    Random rnd(301);
+    std::map<std::string, std::string> model;
+    for (int i = 0; i < kNumKeys; i++) {
+      std::string key = Key(static_cast<int>(rnd.Uniform(kNumKeys)));
+      std::string value = std::to_string(i);
+      ASSERT_OK(Put(key, value));
+      model[key] = value;
+      if (i % 20000 == 0) {
+        ASSERT_EQ(value, Get(key));
+      }
+    }
+
+    for (int flushed = 0; flushed < 2; flushed++) {
+      std::unique_ptr<Iterator> iter(db_->NewIterator(ReadOptions()));
+      iter->SeekToFirst();
+      for (const auto& kv : model) {
+        ASSERT_TRUE(iter->Valid());
+        ASSERT_EQ(kv.first, iter->key().ToString());
+        ASSERT_EQ(kv.second, iter->value().ToString());
+        iter->Next();
+      }
+      ASSERT_FALSE(iter->Valid());
+      iter.reset();
+      if (!flushed) {
+        ASSERT_OK(Flush());
+      }
+    }
+  }
+}
+
+TEST_F(DBMemTableTest, ARTRep) {
+  // The ART memtable orders keys by their bytes; keys containing 0x00 and
+  // keys that are prefixes of one another must still sort like the bytewise
+  // comparator, and newer versions must shadow older ones.
+  Options options = CurrentOptions();
+  options.create_if_missing = true;
+  options.memtable_factory.reset(NewARTRepFactory());
+  DestroyAndReopen(options);
+
+  const std::vector<std::string> keys = {
+      "", "a", std::string("a\0", 2), std::string("a\0\0", 3),
+      std::string("a\0b", 3), "a\x01", "ab", "\xff", "\xff\xff"};
+  for (const std::string& key : keys) {
+    ASSERT_OK(Put(key, "v1_" + key));
+  }
+  const Snapshot* snapshot = db_->GetSnapshot();
+  for (const std::string& key : keys) {
+    ASSERT_OK(Put(key, "v2_" + key));
+  }
+  ASSERT_OK(Delete("ab"));
+
+  std::set<std::string> live(keys.begin(), keys.end());
+  live.erase("ab");
+  for (const std::string& key : keys) {
+    ASSERT_EQ("v1_" + key, Get(key, snapshot));
+    ASSERT_EQ(live.count(key) ? "v2_" + key : "NOT_FOUND", Get(key));
+  }
+
+  std::unique_ptr<Iterator> iter(db_->NewIterator(ReadOptions()));
+  iter->SeekToFirst();
+  for (const std::string& key : live) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(key, iter->key().ToString());
+    ASSERT_EQ("v2_" + key, iter->value().ToString());
+    iter->Next();
+  }
+  ASSERT_FALSE(iter->Valid());
+  iter->SeekToLast();
+  for (auto it = live.rbegin(); it != live.rend(); ++it) {
+    ASSERT_TRUE(iter->Valid());
+    ASSERT_EQ(*it, iter->key().ToString());
+    iter->Prev();
+  }
+  ASSERT_FALSE(iter->Valid());
+
+  iter->Seek(std::string("a\0a", 3));
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(std::string("a\0b", 3), iter->key().ToString());
+  iter->SeekForPrev(std::string("a\0a", 3));
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ(std::string("a\0\0", 3), iter->key().ToString());
+  iter.reset();
+  db_->ReleaseSnapshot(snapshot);
+
+  // Any other comparator gets a skip list instead
+  options.comparator = ReverseBytewiseComparator();
+  DestroyAndReopen(options);
+  ASSERT_OK(Put("a", "1"));
+  ASSERT_OK(Put("b", "2"));
+  iter.reset(db_->NewIterator(ReadOptions()));
+  iter->SeekToFirst();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("b", iter->key().ToString());
+  iter->Next();
+  ASSERT_TRUE(iter->Valid());
+  ASSERT_EQ("a", iter->key().ToString());
+}
+#endif  // ROCKSDB_LITE
+
 }  // namespace ROCKSDB_NAMESPACE
 
 int main(int argc, char** argv) {
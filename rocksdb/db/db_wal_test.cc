@@ -8,11 +8,14 @@
 // found in the LICENSE file. See the AUTHORS file for names of contributors.
 
 #include "db/db_test_util.h"
+#include "db/write_batch_internal.h"
 #include "env/composite_env_wrapper.h"
 #include "options/options_helper.h"
 #include "port/port.h"
 #include "port/stack_trace.h"
+#include "rocksdb/wal_filter.h"
 #include "test_util/sync_point.h"
+#include "util/compression.h"
 #include "utilities/fault_injection_env.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -440,6 +443,41 @@ TEST_F(DBWALTest, RecoveryWithEmptyLog) {
   } while (ChangeWalOptions());
 }
 
+TEST_F(DBWALTest, RecoverCompressedWAL) {
+  for (auto type : {kZlibCompression, kZSTD}) {
+    if (!StreamingCompressionTypeSupported(type)) {
+      continue;
+    }
+    Options options = CurrentOptions();
+    options.wal_compression = type;
+    DestroyAndReopen(options);
+    std::string value(1000, 'v');
+    for (int i = 0; i < 100; i++) {
+      ASSERT_OK(Put(Key(i), value + ToString(i)));
+    }
+    Reopen(options);
+    for (int i = 0; i < 100; i++) {
+      ASSERT_EQ(value + ToString(i), Get(Key(i)));
+    }
+    // Nothing has been flushed, so the recovered data all came from WALs
+    // much smaller than the data they hold.
+    VectorLogPtr wal_files;
+    ASSERT_OK(dbfull()->GetSortedWalFiles(wal_files));
+    uint64_t wal_bytes = 0;
+    for (const auto& wal : wal_files) {
+      wal_bytes += wal->SizeFileBytes();
+    }
+    ASSERT_LT(wal_bytes, 100 * value.size() / 10);
+
+    // An empty compressed WAL is recovered too.
+    Reopen(options);
+    ASSERT_OK(Put(Key(0), "new"));
+    Reopen(options);
+    ASSERT_EQ("new", Get(Key(0)));
+    ASSERT_EQ(value + ToString(1), Get(Key(1)));
+  }
+}
+
 #if !(defined NDEBUG) || !defined(OS_WIN)
 TEST_F(DBWALTest, PreallocateBlock) {
   Options options = CurrentOptions();
@@ -530,6 +568,229 @@ TEST_F(DBWALTest, PreallocateBlock) {
 #endif  // !(defined NDEBUG) || !defined(OS_WIN)
 
 #ifndef ROCKSDB_LITE
+TEST_F(DBWALTest, DirectIOWAL) {
+  if (!IsDirectIOSupported()) {
+    return;
+  }
+  for (bool recycle : {false, true}) {
+    Options options = CurrentOptions();
+    // SpecialEnv turns direct writes off for WAL files
+    options.env = env_->target();
+    options.use_direct_io_for_wal = true;
+    // Only the WAL is double buffered
+    options.use_direct_io_for_flush_and_compaction = true;
+    options.allow_mmap_writes = false;
+    // A small buffer, so that values larger than it are written from the
+    // other buffer while they are still being appended.
+    options.writable_file_max_buffer_size = 16 << 10;
+    options.recycle_log_file_num = recycle ? 2 : 0;
+    options.wal_recovery_mode = WALRecoveryMode::kTolerateCorruptedTailRecords;
+    DestroyAndReopen(options);
+
+    std::atomic<int> direct_files(0);
+    std::atomic<int> background_writes(0);
+    SyncPoint::GetInstance()->SetCallBack(
+        "NewWritableFile:O_DIRECT", [&](void*) { direct_files++; });
+    SyncPoint::GetInstance()->SetCallBack(
+        "WritableFileWriter::WriteDirectInBackground", [&](void* arg) {
+          const std::string& fname = *static_cast<std::string*>(arg);
+          ASSERT_TRUE(fname.size() > 4 &&
+                      fname.compare(fname.size() - 4, 4, ".log") == 0)
+              << fname;
+          background_writes++;
+        });
+    SyncPoint::GetInstance()->EnableProcessing();
+
+    Random rnd(301);
+    std::vector<std::string> values;
+    for (int i = 0; i < 200; i++) {
+      // Mix values spanning several buffers with ones not filling a page.
+      values.push_back(rnd.RandomString(i % 10 == 0 ? 40 << 10 : 100));
+      WriteOptions write_options;
+      write_options.sync = (i % 7 == 0);
+      ASSERT_OK(db_->Put(write_options, Key(i), values.back()));
+      if (i == 100) {
+        // Switch to a new (possibly recycled) WAL file.
+        ASSERT_OK(Flush());
+      }
+    }
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    ASSERT_GT(direct_files.load(), 0);
+    ASSERT_GT(background_writes.load(), 0);
+
+    Reopen(options);
+    for (int i = 0; i < 200; i++) {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+  }
+}
+
+TEST_F(DBWALTest, DirectIOWALSmallRecords) {
+  if (!IsDirectIOSupported()) {
+    return;
+  }
+  for (bool manual_wal_flush : {false, true}) {
+    Options options = CurrentOptions();
+    // SpecialEnv turns direct writes off for WAL files
+    options.env = env_->target();
+    options.use_direct_io_for_wal = true;
+    options.use_direct_io_for_flush_and_compaction = true;
+    options.allow_mmap_writes = false;
+    options.writable_file_max_buffer_size = 16 << 10;
+    options.manual_wal_flush = manual_wal_flush;
+    DestroyAndReopen(options);
+
+    std::atomic<int> background_writes(0);
+    SyncPoint::GetInstance()->SetCallBack(
+        "WritableFileWriter::WriteDirectInBackground",
+        [&](void*) { background_writes++; });
+    SyncPoint::GetInstance()->EnableProcessing();
+
+    // Many times the buffer size, in records much smaller than a page
+    Random rnd(301);
+    std::vector<std::string> values;
+    for (int i = 0; i < 2000; i++) {
+      values.push_back(rnd.RandomString(100));
+      ASSERT_OK(Put(Key(i), values.back()));
+    }
+    ASSERT_OK(db_->FlushWAL(true /* sync */));
+    SyncPoint::GetInstance()->DisableProcessing();
+    SyncPoint::GetInstance()->ClearAllCallBacks();
+    // Without manual_wal_flush, each write flushes the WAL before the buffer
+    // fills up
+    if (manual_wal_flush) {
+      ASSERT_GT(background_writes.load(), 0);
+    } else {
+      ASSERT_EQ(0, background_writes.load());
+    }
+
+    Reopen(options);
+    for (int i = 0; i < 2000; i++) {
+      ASSERT_EQ(values[i], Get(Key(i)));
+    }
+  }
+}
+
+TEST_F(DBWALTest, StripedWAL) {
+  Options options = CurrentOptions();
+  options.wal_stripe_dirs = {dbname_ + "/stripe1", dbname_ + "/stripe2"};
+  options.write_queue_shards = 3;
+  DestroyAndReopen(options);
+
+  const int kNumThreads = 4;
+  const int kNumKeys = 300;
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = t; i < kNumKeys; i += kNumThreads) {
+        WriteOptions write_options;
+        write_options.sync = (i % 10 == 0);
+        ASSERT_OK(db_->Put(write_options, Key(i), "v" + ToString(i)));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  // Switch to a new WAL, then write to it
+  ASSERT_OK(Flush());
+  for (int i = 0; i < kNumKeys; i += 3) {
+    ASSERT_OK(Put(Key(i), "w" + ToString(i)));
+  }
+
+  auto count_logs = [&](const std::string& dir) {
+    std::vector<std::string> files;
+    EXPECT_OK(env_->GetChildren(dir, &files));
+    int logs = 0;
+    for (const auto& f : files) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(f, &number, &type) && type == kLogFile) {
+        logs++;
+      }
+    }
+    return logs;
+  };
+  for (const auto& dir : options.wal_stripe_dirs) {
+    ASSERT_GE(count_logs(dir), 1);
+  }
+
+  Reopen(options);
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_EQ((i % 3 == 0 ? "w" : "v") + ToString(i), Get(Key(i)));
+  }
+  // Obsolete WAL files go away from every stripe
+  ASSERT_OK(Flush());
+  Reopen(options);
+  for (const auto& dir : options.wal_stripe_dirs) {
+    ASSERT_EQ(1, count_logs(dir));
+  }
+}
+
+TEST_F(DBWALTest, StripedWALRecoveryStopsAtGap) {
+  // With one stripe directory, losing its file leaves a single file that is
+  // still checked for gaps
+  for (int num_dirs = 1; num_dirs <= 2; num_dirs++) {
+    Options options = CurrentOptions();
+    options.wal_stripe_dirs.clear();
+    for (int d = 1; d <= num_dirs; d++) {
+      options.wal_stripe_dirs.push_back(dbname_ + "/stripe" + ToString(d));
+    }
+    options.wal_recovery_mode = WALRecoveryMode::kPointInTimeRecovery;
+    options.avoid_flush_during_recovery = true;
+    DestroyAndReopen(options);
+
+    const int kNumKeys = 30;
+    for (int i = 0; i < kNumKeys; i++) {
+      ASSERT_OK(Put(Key(i), "v" + ToString(i)));
+    }
+    Close();
+
+    // Lose the records of the last stripe
+    const std::string& lost_dir = options.wal_stripe_dirs.back();
+    std::vector<std::string> files;
+    ASSERT_OK(env_->GetChildren(lost_dir, &files));
+    for (const auto& f : files) {
+      uint64_t number;
+      FileType type;
+      if (ParseFileName(f, &number, &type) && type == kLogFile) {
+        ASSERT_OK(env_->DeleteFile(lost_dir + "/" + f));
+      }
+    }
+
+    // The writes before the first lost record are recovered, none after it
+    Reopen(options);
+    int recovered = 0;
+    while (recovered < kNumKeys && Get(Key(recovered)) != "NOT_FOUND") {
+      ASSERT_EQ("v" + ToString(recovered), Get(Key(recovered)));
+      recovered++;
+    }
+    ASSERT_GT(recovered, 0);
+    ASSERT_LT(recovered, kNumKeys);
+    for (int i = recovered; i < kNumKeys; i++) {
+      ASSERT_EQ("NOT_FOUND", Get(Key(i)));
+    }
+  }
+}
+
+TEST_F(DBWALTest, StripedWALRecoversUnstripedWAL) {
+  Options options = CurrentOptions();
+  options.avoid_flush_during_recovery = true;
+  DestroyAndReopen(options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_OK(Put(Key(i), "v" + ToString(i)));
+  }
+  Close();
+
+  // The WAL written without striping is read as it is
+  options.wal_stripe_dirs = {dbname_ + "/stripe1"};
+  Reopen(options);
+  for (int i = 0; i < 10; i++) {
+    ASSERT_EQ("v" + ToString(i), Get(Key(i)));
+  }
+}
+
 TEST_F(DBWALTest, DISABLED_FullPurgePreservesRecycledLog) {
   // TODO(ajkr): Disabled until WAL recycling is fixed for
   // `kPointInTimeRecovery`.
@@ -727,6 +988,109 @@ TEST_F(DBWALTest, RecoverWithLargeLog) {
   } while (ChangeWalOptions());
 }
 
+TEST_F(DBWALTest, RecoverWithParallelReplay) {
+  Options options = CurrentOptions();
+  options.merge_operator = MergeOperators::CreateStringAppendOperator();
+  CreateAndReopenWithCF({"pikachu"}, options);
+
+  // Overwrite and delete the keys many times over, so that the latest
+  // version of a key has to win however the replaying threads interleave
+  std::map<std::string, std::string> expected[2];
+  Random rnd(301);
+  for (int i = 0; i < 20000; i++) {
+    int cf = static_cast<int>(rnd.Uniform(2));
+    std::string key = Key(static_cast<int>(rnd.Uniform(500)));
+    if (i % 100 == 99) {
+      // Replayed on the opening thread, between two waves
+      ASSERT_OK(Merge(cf, key, "m"));
+      auto it = expected[cf].find(key);
+      expected[cf][key] = it == expected[cf].end() ? "m" : it->second + ",m";
+    } else if (rnd.OneIn(5)) {
+      ASSERT_OK(Delete(cf, key));
+      expected[cf].erase(key);
+    } else {
+      WriteBatch batch;
+      std::string value = rnd.RandomString(100);
+      ASSERT_OK(batch.Put(handles_[cf], key, value));
+      ASSERT_OK(batch.Put(handles_[cf], key + "x", value));
+      ASSERT_OK(db_->Write(WriteOptions(), &batch));
+      expected[cf][key] = value;
+      expected[cf][key + "x"] = value;
+    }
+  }
+  SequenceNumber last_sequence = db_->GetLatestSequenceNumber();
+
+  // A small write buffer makes memtables fill up in the middle of the log
+  options.write_buffer_size = 256 << 10;
+  options.disable_auto_compactions = true;
+  options.wal_recovery_threads = 4;
+  ReopenWithColumnFamilies({"default", "pikachu"}, options);
+  ASSERT_GT(NumTableFilesAtLevel(0, 1), 1);
+  ASSERT_EQ(last_sequence, db_->GetLatestSequenceNumber());
+  for (int cf = 0; cf < 2; cf++) {
+    for (int k = 0; k < 500; k++) {
+      for (const std::string& key : {Key(k), Key(k) + "x"}) {
+        auto it = expected[cf].find(key);
+        ASSERT_EQ(it == expected[cf].end() ? "NOT_FOUND" : it->second,
+                  Get(cf, key));
+      }
+    }
+  }
+}
+
+#ifndef ROCKSDB_LITE
+TEST_F(DBWALTest, ParallelRecoveryCorruptBatchInWave) {
+  // Empties the batch of the given sequence number but keeps its count, so
+  // that applying it fails
+  class CorruptBatchWalFilter : public WalFilter {
+   public:
+    explicit CorruptBatchWalFilter(SequenceNumber sequence)
+        : sequence_(sequence) {}
+
+    WalProcessingOption LogRecord(const WriteBatch& batch,
+                                  WriteBatch* new_batch,
+                                  bool* batch_changed) const override {
+      if (WriteBatchInternal::Sequence(&batch) == sequence_) {
+        EXPECT_OK(WriteBatchInternal::SetContents(
+            new_batch, Slice(batch.Data().data(), WriteBatchInternal::kHeader)));
+        *batch_changed = true;
+      }
+      return WalProcessingOption::kContinueProcessing;
+    }
+
+    const char* Name() const override { return "CorruptBatchWalFilter"; }
+
+   private:
+    const SequenceNumber sequence_;
+  };
+
+  Options options = CurrentOptions();
+  options.allow_concurrent_memtable_write = true;
+  DestroyAndReopen(options);
+  // All of them fit in one wave
+  const int kNumKeys = 200;
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_OK(Put(Key(k), "v" + ToString(k)));
+  }
+  ASSERT_EQ(static_cast<SequenceNumber>(kNumKeys),
+            db_->GetLatestSequenceNumber());
+
+  // The batch of Key(kCorruptKey) fails in the middle of the wave; nothing
+  // after it may be recovered
+  const int kCorruptKey = 100;
+  CorruptBatchWalFilter wal_filter(kCorruptKey + 1);
+  options.wal_filter = &wal_filter;
+  options.wal_recovery_mode = WALRecoveryMode::kPointInTimeRecovery;
+  options.wal_recovery_threads = 4;
+  Reopen(options);
+  ASSERT_EQ(static_cast<SequenceNumber>(kCorruptKey),
+            db_->GetLatestSequenceNumber());
+  for (int k = 0; k < kNumKeys; k++) {
+    ASSERT_EQ(k < kCorruptKey ? "v" + ToString(k) : "NOT_FOUND", Get(Key(k)));
+  }
+}
+#endif  // ROCKSDB_LITE
+
 // In https://reviews.facebook.net/D20661 we change
 // recovery behavior: previously for each log file each column family
 // memtable was flushed, even it was empty. Now it's changed:
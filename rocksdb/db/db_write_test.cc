@@ -6,15 +6,18 @@
 #include <atomic>
 #include <fstream>
 #include <memory>
+#include <set>
 #include <thread>
 #include <vector>
 
 #include "db/db_test_util.h"
 #include "db/write_batch_internal.h"
+#include "db/write_callback.h"
 #include "db/write_thread.h"
 #include "port/port.h"
 #include "port/stack_trace.h"
 #include "test_util/sync_point.h"
+#include "util/compression.h"
 #include "util/random.h"
 #include "util/string_util.h"
 #include "utilities/fault_injection_env.h"
@@ -317,6 +320,437 @@ TEST_P(DBWriteTest, ConcurrentlyDisabledWAL) {
     ASSERT_LE(bytes_num, 1024 * 100);
 }
 
+TEST_P(DBWriteTest, WriteAsync) {
+  Options options = GetOptions();
+  options.write_buffer_size = 64 << 10;
+  options.statistics = ROCKSDB_NAMESPACE::CreateDBStatistics();
+  Reopen(options);
+
+  const int kNumThreads = 4;
+  const int kNumWrites = 200;
+  // Batches and statuses are owned here so they outlive the callbacks.
+  std::vector<WriteBatch> batches(kNumThreads * kNumWrites);
+  std::vector<Status> statuses(batches.size());
+  port::Mutex mu;
+  port::CondVar cv(&mu);
+  size_t completed = 0;
+  // The threads that ran the callbacks
+  std::set<std::thread::id> callback_threads;
+
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kNumWrites; i++) {
+        size_t idx = static_cast<size_t>(t * kNumWrites + i);
+        std::string key = "key" + ToString(idx);
+        if (i % 10 == 0) {
+          // Mix in blocking writes, which join the same write groups.
+          WriteOptions write_options;
+          write_options.sync = (t == 0);
+          ASSERT_OK(dbfull()->Put(write_options, key, "sync" + key));
+          MutexLock l(&mu);
+          completed++;
+          continue;
+        }
+        ASSERT_OK(batches[idx].Put(key, "async" + key));
+        ASSERT_OK(dbfull()->WriteAsync(WriteOptions(), &batches[idx],
+                                       [&, idx](Status s) {
+                                         MutexLock l(&mu);
+                                         statuses[idx] = s;
+                                         callback_threads.insert(
+                                             std::this_thread::get_id());
+                                         completed++;
+                                         cv.SignalAll();
+                                       }));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  {
+    MutexLock l(&mu);
+    while (completed < batches.size()) {
+      cv.Wait();
+    }
+  }
+  if (GetParam() == kDefault) {
+    // Never on a writing thread, which may be the one completing a group
+    // or holding the DB mutex when a write stall begins
+    ASSERT_EQ(1u, callback_threads.size());
+  }
+
+  for (size_t idx = 0; idx < batches.size(); idx++) {
+    std::string key = "key" + ToString(idx);
+    bool async = idx % kNumWrites % 10 != 0;
+    if (async) {
+      ASSERT_OK(statuses[idx]);
+    }
+    ASSERT_EQ((async ? "async" : "sync") + key, Get(key));
+  }
+  // Async writes are timed like blocking ones
+  HistogramData write_micros;
+  options.statistics->histogramData(DB_WRITE, &write_micros);
+  ASSERT_EQ(batches.size(), write_micros.count);
+
+  WriteOptions write_options;
+  write_options.sync = true;
+  write_options.disableWAL = true;
+  WriteBatch batch;
+  ASSERT_OK(batch.Put("foo", "bar"));
+  ASSERT_TRUE(dbfull()
+                  ->WriteAsync(write_options, &batch, [](Status) { FAIL(); })
+                  .IsInvalidArgument());
+
+  Reopen(options);
+  for (size_t idx = 0; idx < batches.size(); idx += 7) {
+    std::string key = "key" + ToString(idx);
+    bool async = idx % kNumWrites % 10 != 0;
+    ASSERT_EQ((async ? "async" : "sync") + key, Get(key));
+  }
+}
+
+TEST_P(DBWriteTest, SyncWriteGroupDelay) {
+  Options options = GetOptions();
+  options.statistics = ROCKSDB_NAMESPACE::CreateDBStatistics();
+  options.max_write_group_sync_delay_usec = 1000;
+  Reopen(options);
+
+  // Pretend WAL syncs are slow, so that the leaders of sync write groups
+  // wait for the other sync writers.
+  SyncPoint::GetInstance()->SetCallBack(
+      "DBImpl::WriteToWAL:SyncMicros",
+      [](void* arg) { *static_cast<uint64_t*>(arg) = 10000; });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  const int kNumThreads = 8;
+  const int kNumWrites = 50;
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      WriteOptions write_options;
+      write_options.sync = true;
+      for (int i = 0; i < kNumWrites; i++) {
+        std::string key = "key" + ToString(t) + "_" + ToString(i);
+        ASSERT_OK(dbfull()->Put(write_options, key, "value" + key));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+
+  for (int t = 0; t < kNumThreads; t++) {
+    for (int i = 0; i < kNumWrites; i++) {
+      std::string key = "key" + ToString(t) + "_" + ToString(i);
+      ASSERT_EQ("value" + key, Get(key));
+    }
+  }
+  uint64_t delayed =
+      options.statistics->getTickerCount(WRITE_GROUP_SYNC_DELAYED);
+  if (options.two_write_queues) {
+    // The WAL is written through ConcurrentWriteToWAL, which does not feed
+    // the sync latency.
+    ASSERT_EQ(0U, delayed);
+  } else {
+    ASSERT_GT(delayed, 0U);
+    ASSERT_LE(options.statistics->getTickerCount(WRITE_GROUP_SYNC_DELAY_WRITERS),
+              static_cast<uint64_t>(kNumThreads * kNumWrites));
+  }
+}
+
+class DBWriteQueueShardsTest : public DBTestBase {
+ public:
+  DBWriteQueueShardsTest()
+      : DBTestBase("/db_write_queue_shards_test", /*env_do_fsync=*/true) {}
+
+  Options GetShardedOptions() {
+    Options options = CurrentOptions();
+    options.write_queue_shards = 4;
+    options.write_buffer_size = 64 << 10;
+    return options;
+  }
+};
+
+TEST_F(DBWriteQueueShardsTest, IncompatibleOptions) {
+  Options options = GetShardedOptions();
+  options.allow_concurrent_memtable_write = false;
+  ASSERT_TRUE(TryReopen(options).IsInvalidArgument());
+
+  options = GetShardedOptions();
+  options.enable_pipelined_write = true;
+  ASSERT_TRUE(TryReopen(options).IsInvalidArgument());
+
+  options = GetShardedOptions();
+  options.two_write_queues = true;
+  ASSERT_TRUE(TryReopen(options).IsInvalidArgument());
+
+  options = GetShardedOptions();
+  options.max_successive_merges = 2;
+  ASSERT_TRUE(TryReopen(options).IsInvalidArgument());
+
+  ASSERT_OK(TryReopen(GetShardedOptions()));
+}
+
+#ifndef ROCKSDB_LITE
+// A write callback may lock mutex_ while its write group holds up a memtable
+// switch, and cannot check the writes of the other queues.
+TEST_F(DBWriteQueueShardsTest, WriteCallback) {
+  class NoopCallback : public WriteCallback {
+   public:
+    Status Callback(DB* /*db*/) override { return Status::OK(); }
+    bool AllowWriteBatching() override { return true; }
+  };
+
+  Reopen(GetShardedOptions());
+  NoopCallback callback;
+  WriteBatch batch;
+  ASSERT_OK(batch.Put("key", "value"));
+  ASSERT_TRUE(dbfull()
+                  ->WriteWithCallback(WriteOptions(), &batch, &callback)
+                  .IsNotSupported());
+  ASSERT_EQ("NOT_FOUND", Get("key"));
+  ASSERT_OK(dbfull()->Write(WriteOptions(), &batch));
+  ASSERT_EQ("value", Get("key"));
+}
+#endif  // ROCKSDB_LITE
+
+// Every batch updates two column families, which usually go through different
+// write queues than the ones of the other threads. A snapshot must see either
+// both updates of a batch or none.
+TEST_F(DBWriteQueueShardsTest, ConcurrentWrites) {
+  Options options = GetShardedOptions();
+  CreateAndReopenWithCF({"one", "two", "three"}, options);
+
+  const int kNumThreads = 8;
+  const int kNumWrites = 500;
+  std::atomic<bool> done(false);
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 1; i <= kNumWrites; i++) {
+        WriteOptions wo;
+        wo.sync = i % 100 == 0;
+        if (t % 2 == 0) {
+          wo.write_queue_shard = t / 2;
+        }
+        WriteBatch batch;
+        std::string value = ToString(i);
+        ASSERT_OK(batch.Put(handles_[t % 4], "k" + ToString(t), value));
+        ASSERT_OK(batch.Put(handles_[(t + 1) % 4], "m" + ToString(t), value));
+        ASSERT_OK(db_->Write(wo, &batch));
+      }
+    });
+  }
+  threads.emplace_back([&]() {
+    while (!done.load()) {
+      const Snapshot* snapshot = db_->GetSnapshot();
+      ReadOptions ro;
+      ro.snapshot = snapshot;
+      for (int t = 0; t < kNumThreads; t++) {
+        std::string k_value, m_value;
+        Status s1 = db_->Get(ro, handles_[t % 4], "k" + ToString(t), &k_value);
+        Status s2 =
+            db_->Get(ro, handles_[(t + 1) % 4], "m" + ToString(t), &m_value);
+        ASSERT_EQ(s1.IsNotFound(), s2.IsNotFound());
+        ASSERT_EQ(k_value, m_value);
+      }
+      db_->ReleaseSnapshot(snapshot);
+    }
+  });
+  threads.emplace_back([&]() {
+    for (int i = 0; !done.load(); i++) {
+      ASSERT_OK(Flush(i % 4));
+    }
+  });
+  for (int t = 0; t < kNumThreads; t++) {
+    threads[t].join();
+  }
+  done.store(true);
+  for (size_t t = kNumThreads; t < threads.size(); t++) {
+    threads[t].join();
+  }
+
+  ASSERT_EQ(static_cast<SequenceNumber>(kNumThreads * kNumWrites * 2),
+            db_->GetLatestSequenceNumber());
+  for (int reopen = 0; reopen < 2; reopen++) {
+    for (int t = 0; t < kNumThreads; t++) {
+      ASSERT_EQ(ToString(kNumWrites), Get(t % 4, "k" + ToString(t)));
+      ASSERT_EQ(ToString(kNumWrites), Get((t + 1) % 4, "m" + ToString(t)));
+    }
+    ReopenWithColumnFamilies({"default", "one", "two", "three"}, options);
+  }
+}
+
+// The write queues append to the WAL holding log_write_mutex_, which
+// manual_wal_flush must not take again.
+TEST_F(DBWriteQueueShardsTest, ManualWalFlush) {
+  Options options = GetShardedOptions();
+  options.manual_wal_flush = true;
+  Reopen(options);
+
+  const int kNumThreads = 4;
+  const int kNumWrites = 100;
+  std::vector<port::Thread> threads;
+  for (int t = 0; t < kNumThreads; t++) {
+    threads.emplace_back([&, t]() {
+      for (int i = 0; i < kNumWrites; i++) {
+        WriteOptions wo;
+        wo.write_queue_shard = t;
+        ASSERT_OK(db_->Put(wo, Key(t * kNumWrites + i), ToString(i)));
+        if (i % 10 == 0) {
+          ASSERT_OK(db_->FlushWAL(false /* sync */));
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  ASSERT_OK(db_->FlushWAL(true /* sync */));
+
+  Reopen(options);
+  for (int t = 0; t < kNumThreads; t++) {
+    for (int i = 0; i < kNumWrites; i++) {
+      ASSERT_EQ(ToString(i), Get(Key(t * kNumWrites + i)));
+    }
+  }
+}
+
+TEST_P(DBWriteTest, PutPinned) {
+  for (auto type : {kNoCompression, kZlibCompression}) {
+    if (type != kNoCompression && !StreamingCompressionTypeSupported(type)) {
+      continue;
+    }
+    Options options = GetOptions();
+    options.wal_compression = type;
+    options.write_buffer_size = 4 << 20;
+    DestroyAndReopen(options);
+
+    // Values larger than a log block, written from several threads so that
+    // pinned batches also get merged into write groups
+    const int kNumThreads = 4;
+    const int kNumWrites = 20;
+    std::vector<port::Thread> threads;
+    for (int t = 0; t < kNumThreads; t++) {
+      threads.emplace_back([&, t]() {
+        Random rnd(301 + t);
+        for (int i = 0; i < kNumWrites; i++) {
+          std::string key = "key" + ToString(t * kNumWrites + i);
+          std::string value = rnd.RandomString(64 << 10) + key;
+          WriteBatch batch;
+          ASSERT_OK(batch.Put("small" + key, key));
+          ASSERT_OK(batch.PutPinned(key, value));
+          ASSERT_OK(dbfull()->Write(WriteOptions(), &batch));
+          ASSERT_EQ(value, Get(key));
+        }
+      });
+    }
+    for (auto& t : threads) {
+      t.join();
+    }
+
+    // Everything is recovered from the WAL
+    Reopen(options);
+    for (int t = 0; t < kNumThreads; t++) {
+      Random rnd(301 + t);
+      for (int i = 0; i < kNumWrites; i++) {
+        std::string key = "key" + ToString(t * kNumWrites + i);
+        ASSERT_EQ(rnd.RandomString(64 << 10) + key, Get(key));
+        ASSERT_EQ(key, Get("small" + key));
+      }
+    }
+  }
+}
+
+TEST_P(DBWriteTest, PutPinnedEmptyValue) {
+  Options options = GetOptions();
+  options.statistics = CreateDBStatistics();
+  Reopen(options);
+
+  std::string empty;
+  WriteBatch batch;
+  ASSERT_OK(batch.PutPinned("a", empty));
+  ASSERT_OK(batch.Put("b", "vb"));
+  ASSERT_OK(dbfull()->Write(WriteOptions(), &batch));
+  ASSERT_OK(Put("c", "vc"));
+
+  // The WAL records are plain Puts, and their size is counted as written
+  WriteBatch expected;
+  ASSERT_OK(expected.Put("a", ""));
+  ASSERT_OK(expected.Put("b", "vb"));
+  WriteBatch expected_c;
+  ASSERT_OK(expected_c.Put("c", "vc"));
+  ASSERT_EQ(expected.GetDataSize() + expected_c.GetDataSize(),
+            options.statistics->getTickerCount(WAL_FILE_BYTES));
+
+  Reopen(options);
+  ASSERT_EQ("", Get("a"));
+  ASSERT_EQ("vb", Get("b"));
+  ASSERT_EQ("vc", Get("c"));
+}
+
+TEST_P(DBWriteTest, ParallelInsertLargeBatch) {
+  Options options = GetOptions();
+  options.memtable_insert_threads = 4;
+  options.write_buffer_size = 64 << 20;
+  Reopen(options);
+
+  std::atomic<size_t> num_ranges(0);
+  SyncPoint::GetInstance()->SetCallBack(
+      "DBImpl::InsertBatchInParallel:Ranges", [&](void* arg) {
+        num_ranges += static_cast<std::vector<WriteBatchInternal::Range>*>(arg)
+                          ->size();
+      });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  // The later updates of a key land in other ranges than the first ones, and
+  // must still win
+  // Over 4 MB, so that it is split into four ranges of at least 1 MB
+  const int kNumKeys = 4000;
+  const std::string value(1100, 'v');
+  WriteBatch batch;
+  for (int i = 0; i < kNumKeys; i++) {
+    ASSERT_OK(batch.Put(Key(i), value + ToString(i)));
+  }
+  ASSERT_OK(batch.PutLogData("blob"));
+  for (int i = 0; i < kNumKeys; i += 2) {
+    ASSERT_OK(batch.Delete(Key(i)));
+  }
+  for (int i = 0; i < kNumKeys; i += 4) {
+    ASSERT_OK(batch.Put(Key(i), "again"));
+  }
+  const SequenceNumber seq = dbfull()->GetLatestSequenceNumber();
+  ASSERT_OK(dbfull()->Write(WriteOptions(), &batch));
+  ASSERT_EQ(seq + batch.Count(), dbfull()->GetLatestSequenceNumber());
+
+  // The main write path splits the batch; the pipelined one does not
+  if (options.enable_pipelined_write) {
+    ASSERT_EQ(0U, num_ranges.load());
+  } else {
+    ASSERT_EQ(4U, num_ranges.load());
+  }
+  SyncPoint::GetInstance()->DisableProcessing();
+  SyncPoint::GetInstance()->ClearAllCallBacks();
+
+  auto verify = [&]() {
+    for (int i = 0; i < kNumKeys; i++) {
+      if (i % 4 == 0) {
+        ASSERT_EQ("again", Get(Key(i)));
+      } else if (i % 2 == 0) {
+        ASSERT_EQ("NOT_FOUND", Get(Key(i)));
+      } else {
+        ASSERT_EQ(value + ToString(i), Get(Key(i)));
+      }
+    }
+  };
+  verify();
+  Reopen(options);
+  verify();
+}
+
 INSTANTIATE_TEST_CASE_P(DBWriteTestInstance, DBWriteTest,
                         testing::Values(DBTestBase::kDefault,
                                         DBTestBase::kConcurrentWALWrites,
@@ -70,6 +70,12 @@ enum ValueType : unsigned char {
   // another.
   kTypeBeginUnprepareXID = 0x13,  // WAL only.
   kTypeDeletionWithTimestamp = 0x14,
+  // A Put whose value is referenced by pointer rather than copied, see
+  // WriteBatch::PutPinned(). Only ever lives in an in-memory WriteBatch: it is
+  // translated back to kTypeValue/kTypeColumnFamilyValue before the record
+  // reaches the WAL, and is rejected when decoding anything else.
+  kTypeValuePinned = 0x7D,
+  kTypeColumnFamilyValuePinned = 0x7E,
   kMaxValue = 0x7F  // Not used for storing records.
 };
 
@@ -621,9 +627,15 @@ extern bool ReadKeyFromWriteBatchEntry(Slice* input, Slice* key,
 // Slice they point to.
 // Tag is defined as ValueType.
 // input will be advanced to after the record.
+// Pinned records are reported as the plain Put they stand for, with value
+// pointing at the caller-owned buffer. They are only accepted when
+// allow_pinned is true, i.e. when input is the rep of a live WriteBatch that
+// holds pinned values, so bytes read from a file can never be taken as a
+// pointer.
 extern Status ReadRecordFromWriteBatch(Slice* input, char* tag,
                                        uint32_t* column_family, Slice* key,
-                                       Slice* value, Slice* blob, Slice* xid);
+                                       Slice* value, Slice* blob, Slice* xid,
+                                       bool allow_pinned = false);
 
 // When user call DeleteRange() to delete a range of keys,
 // we will store a serialized RangeTombstone in MemTable and SST.
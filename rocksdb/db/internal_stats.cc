@@ -1210,6 +1210,10 @@ void InternalStats::DumpCFMapStatsIOStalls(
 
   (*cf_stats)["io_stalls.total_stop"] = std::to_string(total_stop);
   (*cf_stats)["io_stalls.total_slowdown"] = std::to_string(total_slowdown);
+  (*cf_stats)["io_stalls.feedback_slowdown"] =
+      std::to_string(cf_stats_count_[WRITE_RATE_FEEDBACK_SLOWDOWNS]);
+  (*cf_stats)["io_stalls.feedback_speedup"] =
+      std::to_string(cf_stats_count_[WRITE_RATE_FEEDBACK_SPEEDUPS]);
 }
 
 void InternalStats::DumpCFStats(std::string* value) {
@@ -1384,6 +1388,16 @@ void InternalStats::DumpCFStatsNoFileHistogram(std::string* value) {
            cf_stats_count_[MEMTABLE_LIMIT_SLOWDOWNS],
            total_stall_count - cf_stats_snapshot_.stall_count);
   value->append(buf);
+  if (cf_stats_count_[WRITE_RATE_FEEDBACK_SLOWDOWNS] +
+          cf_stats_count_[WRITE_RATE_FEEDBACK_SPEEDUPS] >
+      0) {
+    snprintf(buf, sizeof(buf),
+             "Write rate feedback(count): %" PRIu64 " slowdown, %" PRIu64
+             " speedup\n",
+             cf_stats_count_[WRITE_RATE_FEEDBACK_SLOWDOWNS],
+             cf_stats_count_[WRITE_RATE_FEEDBACK_SPEEDUPS]);
+    value->append(buf);
+  }
 
   cf_stats_snapshot_.seconds_up = seconds_up;
   cf_stats_snapshot_.ingest_bytes_flush = flush_ingest;
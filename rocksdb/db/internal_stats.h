@@ -105,6 +105,9 @@ class InternalStats {
     INGESTED_NUM_FILES_TOTAL,
     INGESTED_LEVEL0_NUM_FILES_TOTAL,
     INGESTED_NUM_KEYS_TOTAL,
+    // Delayed write rate changes by feedback_write_rate_control
+    WRITE_RATE_FEEDBACK_SLOWDOWNS,
+    WRITE_RATE_FEEDBACK_SPEEDUPS,
     INTERNAL_CF_STATS_ENUM_MAX,
   };
 
@@ -613,6 +616,9 @@ class InternalStats {
     INGESTED_NUM_FILES_TOTAL,
     INGESTED_LEVEL0_NUM_FILES_TOTAL,
     INGESTED_NUM_KEYS_TOTAL,
+    // Delayed write rate changes by feedback_write_rate_control
+    WRITE_RATE_FEEDBACK_SLOWDOWNS,
+    WRITE_RATE_FEEDBACK_SPEEDUPS,
     INTERNAL_CF_STATS_ENUM_MAX,
   };
 
@@ -32,8 +32,16 @@ enum RecordType {
   kRecyclableFirstType = 6,
   kRecyclableMiddleType = 7,
   kRecyclableLastType = 8,
+
+  // Sets the compression of the records that follow it in the file, always
+  // in the legacy record format
+  kSetCompressionType = 9,
+
+  // Numbers the record that follows it in a striped WAL, always in the
+  // legacy record format
+  kRecordOrdinalType = 10,
 };
-static const int kMaxRecordType = kRecyclableLastType;
+static const int kMaxRecordType = kRecordOrdinalType;
 
 static const unsigned int kBlockSize = 32768;
 
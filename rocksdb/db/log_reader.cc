@@ -15,6 +15,7 @@
 #include "rocksdb/env.h"
 #include "test_util/sync_point.h"
 #include "util/coding.h"
+#include "util/compression.h"
 #include "util/crc32c.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -38,7 +39,10 @@ Reader::Reader(std::shared_ptr<Logger> info_log,
       last_record_offset_(0),
       end_of_buffer_offset_(0),
       log_number_(log_num),
-      recycled_(false) {}
+      recycled_(false),
+      compression_type_(kNoCompression),
+      next_record_ordinal_(0),
+      last_record_ordinal_(0) {}
 
 Reader::~Reader() {
   delete[] backing_store_;
@@ -78,7 +82,11 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch,
         prospective_record_offset = physical_record_offset;
         scratch->clear();
         *record = fragment;
+        if (!MaybeUncompressRecord(record)) {
+          break;
+        }
         last_record_offset_ = prospective_record_offset;
+        TakeRecordOrdinal();
         return true;
 
       case kFirstType:
@@ -113,11 +121,35 @@ bool Reader::ReadRecord(Slice* record, std::string* scratch,
         } else {
           scratch->append(fragment.data(), fragment.size());
           *record = Slice(*scratch);
+          if (!MaybeUncompressRecord(record)) {
+            in_fragmented_record = false;
+            scratch->clear();
+            break;
+          }
           last_record_offset_ = prospective_record_offset;
+          TakeRecordOrdinal();
           return true;
         }
         break;
 
+      case kSetCompressionType:
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "partial record without end(3)");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        InitCompression(fragment);
+        break;
+
+      case kRecordOrdinalType:
+        if (in_fragmented_record) {
+          ReportCorruption(scratch->size(), "partial record without end(4)");
+          in_fragmented_record = false;
+          scratch->clear();
+        }
+        SetNextRecordOrdinal(fragment);
+        break;
+
       case kBadHeader:
         if (wal_recovery_mode == WALRecoveryMode::kAbsoluteConsistency) {
           // in clean shutdown we don't expect any error in the log files
@@ -270,6 +302,43 @@ void Reader::UnmarkEOFInternal() {
   }
 }
 
+void Reader::InitCompression(const Slice& payload) {
+  if (compression_type_ != kNoCompression || payload.size() != 1) {
+    ReportCorruption(payload.size(), "unexpected compression type record");
+    return;
+  }
+  compression_type_ = static_cast<CompressionType>(payload[0]);
+  uncompress_.reset(StreamingUncompress::Create(compression_type_));
+}
+
+void Reader::SetNextRecordOrdinal(const Slice& payload) {
+  if (payload.size() != sizeof(next_record_ordinal_)) {
+    ReportCorruption(payload.size(), "bad record ordinal");
+    return;
+  }
+  next_record_ordinal_ = DecodeFixed64(payload.data());
+}
+
+bool Reader::MaybeUncompressRecord(Slice* record) {
+  if (compression_type_ == kNoCompression || record->empty()) {
+    return true;
+  }
+  if (uncompress_ == nullptr) {
+    ReportDrop(record->size(),
+               Status::NotSupported("WAL compression type " +
+                                    CompressionTypeToString(compression_type_)));
+    return false;
+  }
+  uncompressed_record_.clear();
+  Status s = uncompress_->Uncompress(*record, &uncompressed_record_);
+  if (!s.ok()) {
+    ReportDrop(record->size(), s);
+    return false;
+  }
+  *record = Slice(uncompressed_record_);
+  return true;
+}
+
 void Reader::ReportCorruption(size_t bytes, const char* reason) {
   ReportDrop(bytes, Status::Corruption(reason));
 }
@@ -422,9 +491,13 @@ bool FragmentBufferedReader::ReadRecord(Slice* record, std::string* scratch,
         }
         fragments_.clear();
         *record = fragment;
+        in_fragmented_record_ = false;
+        if (!MaybeUncompressRecord(record)) {
+          break;
+        }
         prospective_record_offset = physical_record_offset;
         last_record_offset_ = prospective_record_offset;
-        in_fragmented_record_ = false;
+        TakeRecordOrdinal();
         return true;
 
       case kFirstType:
@@ -457,12 +530,34 @@ bool FragmentBufferedReader::ReadRecord(Slice* record, std::string* scratch,
           scratch->assign(fragments_.data(), fragments_.size());
           fragments_.clear();
           *record = Slice(*scratch);
-          last_record_offset_ = prospective_record_offset;
           in_fragmented_record_ = false;
+          if (!MaybeUncompressRecord(record)) {
+            break;
+          }
+          last_record_offset_ = prospective_record_offset;
+          TakeRecordOrdinal();
           return true;
         }
         break;
 
+      case kSetCompressionType:
+        if (in_fragmented_record_) {
+          ReportCorruption(fragments_.size(), "partial record without end(3)");
+          in_fragmented_record_ = false;
+          fragments_.clear();
+        }
+        InitCompression(fragment);
+        break;
+
+      case kRecordOrdinalType:
+        if (in_fragmented_record_) {
+          ReportCorruption(fragments_.size(), "partial record without end(4)");
+          in_fragmented_record_ = false;
+          fragments_.clear();
+        }
+        SetNextRecordOrdinal(fragment);
+        break;
+
       case kBadHeader:
       case kBadRecord:
       case kEof:
@@ -625,5 +720,79 @@ bool FragmentBufferedReader::TryReadFragment(
   return true;
 }
 
+StripedReader::StripedReader(std::vector<std::unique_ptr<Reader>>&& readers,
+                             Reader::Reporter* reporter)
+    : stripes_(readers.size()),
+      reporter_(reporter),
+      next_ordinal_(1),
+      unstriped_(false) {
+  for (size_t i = 0; i < readers.size(); i++) {
+    stripes_[i].reader = std::move(readers[i]);
+  }
+}
+
+bool StripedReader::ReadRecord(Slice* record, std::string* scratch,
+                               WALRecoveryMode wal_recovery_mode) {
+  if (unstriped_) {
+    return stripes_[0].reader->ReadRecord(record, scratch, wal_recovery_mode);
+  }
+  record->clear();
+  scratch->clear();
+  Stripe* next = nullptr;
+  for (auto& stripe : stripes_) {
+    while (stripe.ordinal == 0 && !stripe.eof) {
+      Slice fragment;
+      if (!stripe.reader->ReadRecord(&fragment, &stripe.scratch,
+                                     wal_recovery_mode)) {
+        stripe.eof = true;
+        break;
+      }
+      if (stripe.reader->LastRecordOrdinal() == 0 && stripes_.size() == 1 &&
+          next_ordinal_ == 1) {
+        // A WAL written before striping was enabled
+        unstriped_ = true;
+        scratch->assign(fragment.data(), fragment.size());
+        *record = Slice(*scratch);
+        return true;
+      }
+      if (stripe.reader->LastRecordOrdinal() < next_ordinal_) {
+        // Unnumbered, or numbered like a record already returned
+        ReportCorruption(fragment.size(), "misplaced record in striped WAL");
+        continue;
+      }
+      stripe.ordinal = stripe.reader->LastRecordOrdinal();
+      stripe.record.assign(fragment.data(), fragment.size());
+    }
+    if (stripe.ordinal != 0 &&
+        (next == nullptr || stripe.ordinal < next->ordinal)) {
+      next = &stripe;
+    }
+  }
+  if (next == nullptr) {
+    return false;
+  }
+  if (next->ordinal != next_ordinal_) {
+    // The records numbered in between were lost
+    if (wal_recovery_mode == WALRecoveryMode::kTolerateCorruptedTailRecords) {
+      return false;
+    }
+    if (wal_recovery_mode != WALRecoveryMode::kSkipAnyCorruptedRecords) {
+      ReportCorruption(next->record.size(), "missing records in striped WAL");
+      return false;
+    }
+  }
+  next_ordinal_ = next->ordinal + 1;
+  next->ordinal = 0;
+  scratch->swap(next->record);
+  *record = Slice(*scratch);
+  return true;
+}
+
+void StripedReader::ReportCorruption(size_t bytes, const char* reason) {
+  if (reporter_ != nullptr) {
+    reporter_->Corruption(bytes, Status::Corruption(reason));
+  }
+}
+
 }  // namespace log
 }  // namespace ROCKSDB_NAMESPACE
@@ -10,6 +10,7 @@
 #pragma once
 #include <memory>
 #include <stdint.h>
+#include <vector>
 
 #include "db/log_format.h"
 #include "file/sequence_file_reader.h"
@@ -19,6 +20,7 @@
 
 namespace ROCKSDB_NAMESPACE {
 class Logger;
+class StreamingUncompress;
 
 namespace log {
 
@@ -76,6 +78,10 @@ class Reader {
   // thought of as the "current" position in processing the file bytes.
   uint64_t LastRecordEnd();
 
+  // Returns the ordinal of the last record returned by ReadRecord in a
+  // striped WAL, or zero if no kRecordOrdinalType record preceded it.
+  uint64_t LastRecordOrdinal() const { return last_record_ordinal_; }
+
   // returns true if the reader has encountered an eof condition.
   bool IsEOF() {
     return eof_;
@@ -128,6 +134,16 @@ class Reader {
   // Whether this is a recycled log file
   bool recycled_;
 
+  // Set by a kSetCompressionType record; records that follow it are
+  // decompressed into uncompressed_record_ before they are returned.
+  CompressionType compression_type_;
+  std::unique_ptr<StreamingUncompress> uncompress_;
+  std::string uncompressed_record_;
+
+  // Set by a kRecordOrdinalType record for the record that follows it
+  uint64_t next_record_ordinal_;
+  uint64_t last_record_ordinal_;
+
   // Extend record types with the following special values
   enum {
     kEof = kMaxRecordType + 1,
@@ -154,6 +170,23 @@ class Reader {
 
   void UnmarkEOFInternal();
 
+  // Handles a kSetCompressionType record.
+  void InitCompression(const Slice& payload);
+
+  // Replaces *record, a complete logical record, by its decompressed form if
+  // the file is compressed. Returns false, after reporting the corruption, if
+  // the record cannot be decompressed.
+  bool MaybeUncompressRecord(Slice* record);
+
+  // Handles a kRecordOrdinalType record.
+  void SetNextRecordOrdinal(const Slice& payload);
+
+  // Called whenever a record is returned, to number it
+  void TakeRecordOrdinal() {
+    last_record_ordinal_ = next_record_ordinal_;
+    next_record_ordinal_ = 0;
+  }
+
   // Reports dropped bytes to the reporter.
   // buffer_ must be updated to remove the dropped bytes prior to invocation.
   void ReportCorruption(size_t bytes, const char* reason);
@@ -188,5 +221,47 @@ class FragmentBufferedReader : public Reader {
   void operator=(const FragmentBufferedReader&);
 };
 
+// StripedReader reads a WAL striped over several files, each one read by a
+// Reader, and returns its records in the order they were written in, as
+// given by their ordinals. A record is only returned after all the records
+// numbered before it, so that the records after a gap, left by a file that
+// lost its unsynced tail, are not applied without the ones before them. The
+// gap ends the WAL with kTolerateCorruptedTailRecords, is skipped with
+// kSkipAnyCorruptedRecords, and is reported as a corruption otherwise.
+// This holds for a single file as well, which is all that is left of a WAL
+// whose other files were lost. A single file whose first record is not
+// numbered was not striped, and is read as it is.
+class StripedReader {
+ public:
+  StripedReader(std::vector<std::unique_ptr<Reader>>&& readers,
+                Reader::Reporter* reporter);
+  // No copying allowed
+  StripedReader(const StripedReader&) = delete;
+  void operator=(const StripedReader&) = delete;
+
+  // Same as Reader::ReadRecord()
+  bool ReadRecord(Slice* record, std::string* scratch,
+                  WALRecoveryMode wal_recovery_mode =
+                      WALRecoveryMode::kTolerateCorruptedTailRecords);
+
+ private:
+  struct Stripe {
+    std::unique_ptr<Reader> reader;
+    std::string scratch;
+    // The next record of the file and its ordinal, zero if not read yet
+    std::string record;
+    uint64_t ordinal = 0;
+    bool eof = false;
+  };
+
+  void ReportCorruption(size_t bytes, const char* reason);
+
+  std::vector<Stripe> stripes_;
+  Reader::Reporter* const reporter_;
+  uint64_t next_ordinal_;
+  // The WAL is a single file without ordinals
+  bool unstriped_;
+};
+
 }  // namespace log
 }  // namespace ROCKSDB_NAMESPACE
@@ -16,6 +16,7 @@
 #include "test_util/testharness.h"
 #include "test_util/testutil.h"
 #include "util/coding.h"
+#include "util/compression.h"
 #include "util/crc32c.h"
 #include "util/random.h"
 
@@ -48,7 +49,8 @@ static std::string RandomSkewedString(int i, Random* rnd) {
 // Param type is tuple<int, bool>
 // get<0>(tuple): non-zero if recycling log, zero if regular log
 // get<1>(tuple): true if allow retry after read EOF, false otherwise
-class LogTest : public ::testing::TestWithParam<std::tuple<int, bool>> {
+class LogTest
+    : public ::testing::TestWithParam<std::tuple<int, bool, CompressionType>> {
  private:
   class StringSource : public SequentialFile {
    public:
@@ -176,8 +178,10 @@ class LogTest : public ::testing::TestWithParam<std::tuple<int, bool>> {
         source_holder_(test::GetSequentialFileReader(
             new StringSource(reader_contents_, !std::get<1>(GetParam())),
             "" /* file name */)),
-        writer_(std::move(dest_holder_), 123, std::get<0>(GetParam())),
+        writer_(std::move(dest_holder_), 123, std::get<0>(GetParam()),
+                false /* manual_flush */, std::get<2>(GetParam())),
         allow_retry_read_(std::get<1>(GetParam())) {
+    writer_.AddCompressionTypeRecord();
     if (allow_retry_read_) {
       reader_.reset(new FragmentBufferedReader(
           nullptr, std::move(source_holder_), &report_, true /* checksum */,
@@ -699,11 +703,100 @@ TEST_P(LogTest, Recycle) {
   ASSERT_EQ("EOF", Read());
 }
 
-INSTANTIATE_TEST_CASE_P(bool, LogTest,
-                        ::testing::Values(std::make_tuple(0, false),
-                                          std::make_tuple(0, true),
-                                          std::make_tuple(1, false),
-                                          std::make_tuple(1, true)));
+INSTANTIATE_TEST_CASE_P(
+    bool, LogTest,
+    ::testing::Values(std::make_tuple(0, false, kNoCompression),
+                      std::make_tuple(0, true, kNoCompression),
+                      std::make_tuple(1, false, kNoCompression),
+                      std::make_tuple(1, true, kNoCompression)));
+
+class CompressionLogTest : public LogTest {
+ public:
+  bool Supported() const {
+    if (!StreamingCompressionTypeSupported(std::get<2>(GetParam()))) {
+      fprintf(stderr, "skipping test, compression type not supported\n");
+      return false;
+    }
+    return true;
+  }
+};
+
+TEST_P(CompressionLogTest, Empty) {
+  if (!Supported()) {
+    return;
+  }
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_P(CompressionLogTest, ReadWrite) {
+  if (!Supported()) {
+    return;
+  }
+  Write("foo");
+  Write("bar");
+  Write("");
+  Write("xxxx");
+  ASSERT_EQ("foo", Read());
+  ASSERT_EQ("bar", Read());
+  ASSERT_EQ("", Read());
+  ASSERT_EQ("xxxx", Read());
+  ASSERT_EQ("EOF", Read());
+  ASSERT_EQ("EOF", Read());  // Make sure reads at eof work
+}
+
+TEST_P(CompressionLogTest, ManyBlocks) {
+  if (!Supported()) {
+    return;
+  }
+  for (int i = 0; i < 100000; i++) {
+    Write(NumberString(i));
+  }
+  for (int i = 0; i < 100000; i++) {
+    ASSERT_EQ(NumberString(i), Read());
+  }
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_P(CompressionLogTest, Fragmentation) {
+  if (!Supported()) {
+    return;
+  }
+  Random rnd(301);
+  const std::string large = rnd.RandomString(3 * kBlockSize);
+  Write("small");
+  Write(BigString("medium", 50000));
+  Write(large);
+  ASSERT_EQ("small", Read());
+  ASSERT_EQ(BigString("medium", 50000), Read());
+  ASSERT_EQ(large, Read());
+  ASSERT_EQ("EOF", Read());
+}
+
+TEST_P(CompressionLogTest, ContextSpansRecords) {
+  if (!Supported()) {
+    return;
+  }
+  // Each record on its own is not compressible, but repeats the previous
+  // ones.
+  Random rnd(301);
+  const std::string value = rnd.RandomString(1000);
+  const int kNumRecords = 100;
+  for (int i = 0; i < kNumRecords; i++) {
+    Write(value);
+  }
+  ASSERT_LT(WrittenBytes(), value.size() * kNumRecords / 10);
+  for (int i = 0; i < kNumRecords; i++) {
+    ASSERT_EQ(value, Read());
+  }
+  ASSERT_EQ("EOF", Read());
+}
+
+INSTANTIATE_TEST_CASE_P(
+    Compression, CompressionLogTest,
+    ::testing::Values(std::make_tuple(0, false, kZlibCompression),
+                      std::make_tuple(0, true, kZlibCompression),
+                      std::make_tuple(0, false, kZSTD),
+                      std::make_tuple(0, true, kZSTD)));
 
 class RetriableLogTest : public ::testing::TestWithParam<int> {
  private:
@@ -10,21 +10,27 @@
 #include "db/log_writer.h"
 
 #include <stdint.h>
+
+#include <algorithm>
+
 #include "file/writable_file_writer.h"
 #include "rocksdb/env.h"
 #include "util/coding.h"
+#include "util/compression.h"
 #include "util/crc32c.h"
 
 namespace ROCKSDB_NAMESPACE {
 namespace log {
 
 Writer::Writer(std::unique_ptr<WritableFileWriter>&& dest, uint64_t log_number,
-               bool recycle_log_files, bool manual_flush)
+               bool recycle_log_files, bool manual_flush,
+               CompressionType compression_type)
     : dest_(std::move(dest)),
       block_offset_(0),
       log_number_(log_number),
       recycle_log_files_(recycle_log_files),
-      manual_flush_(manual_flush) {
+      manual_flush_(manual_flush),
+      compression_type_(compression_type) {
   for (int i = 0; i <= kMaxRecordType; i++) {
     char t = static_cast<char>(i);
     type_crc_[i] = crc32c::Value(&t, 1);
@@ -48,9 +54,85 @@ IOStatus Writer::Close() {
   return s;
 }
 
+IOStatus Writer::AddCompressionTypeRecord() {
+  if (compression_type_ == kNoCompression) {
+    return IOStatus::OK();
+  }
+  // The record is only understood in the legacy format, and has to come
+  // before any other record.
+  assert(!recycle_log_files_);
+  assert(block_offset_ == 0);
+  compress_.reset(StreamingCompress::Create(compression_type_,
+                                            CompressionOptions()));
+  if (compress_ == nullptr) {
+    return IOStatus::NotSupported("WAL compression type " +
+                                  CompressionTypeToString(compression_type_));
+  }
+  const char type = static_cast<char>(compression_type_);
+  IOStatus s = EmitPhysicalRecord(kSetCompressionType, &type, 1);
+  if (s.ok() && !manual_flush_) {
+    s = dest_->Flush();
+  }
+  return s;
+}
+
+IOStatus Writer::AddRecordOrdinal(uint64_t ordinal) {
+  // The record is only understood in the legacy format
+  assert(!recycle_log_files_);
+  char payload[sizeof(ordinal)];
+  EncodeFixed64(payload, ordinal);
+  IOStatus s;
+  const size_t leftover = kBlockSize - block_offset_;
+  if (leftover < kHeaderSize + sizeof(payload)) {
+    // Switch to a new block. The trailer may be large enough for a header,
+    // which the reader then sees as a zero-length record ending the block.
+    if (leftover > 0) {
+      static const char kZeroes[kHeaderSize + sizeof(payload)] = {0};
+      s = dest_->Append(Slice(kZeroes, leftover));
+      if (!s.ok()) {
+        return s;
+      }
+    }
+    block_offset_ = 0;
+  }
+  return EmitPhysicalRecord(kRecordOrdinalType, payload, sizeof(payload));
+}
+
 IOStatus Writer::AddRecord(const Slice& slice) {
-  const char* ptr = slice.data();
-  size_t left = slice.size();
+  return AddRecord(SliceParts(&slice, 1));
+}
+
+IOStatus Writer::AddRecord(const SliceParts& record) {
+  const Slice* parts = record.parts;
+  int num_parts = record.num_parts;
+  size_t left = 0;
+  for (int i = 0; i < num_parts; i++) {
+    left += parts[i].size();
+  }
+
+  Slice compressed;
+  if (compress_ != nullptr && left > 0) {
+    compressed_buffer_.clear();
+    Status cs;
+    if (num_parts == 1) {
+      cs = compress_->Compress(parts[0], &compressed_buffer_);
+    } else {
+      // The record has to be compressed as a whole
+      std::string buf;
+      buf.reserve(left);
+      for (int i = 0; i < num_parts; i++) {
+        buf.append(parts[i].data(), parts[i].size());
+      }
+      cs = compress_->Compress(buf, &compressed_buffer_);
+    }
+    if (!cs.ok()) {
+      return IOStatus::IOError("WAL compression failed: " + cs.ToString());
+    }
+    compressed = compressed_buffer_;
+    parts = &compressed;
+    num_parts = 1;
+    left = compressed.size();
+  }
 
   // Header size varies depending on whether we are recycling or not.
   const int header_size =
@@ -61,6 +143,8 @@ IOStatus Writer::AddRecord(const Slice& slice) {
   // zero-length record
   IOStatus s;
   bool begin = true;
+  int part = 0;
+  size_t part_offset = 0;
   do {
     const int64_t leftover = kBlockSize - block_offset_;
     assert(leftover >= 0);
@@ -97,8 +181,23 @@ IOStatus Writer::AddRecord(const Slice& slice) {
       type = recycle_log_files_ ? kRecyclableMiddleType : kMiddleType;
     }
 
-    s = EmitPhysicalRecord(type, ptr, fragment_length);
-    ptr += fragment_length;
+    // Collect the pieces of the parts that make up this fragment
+    fragment_parts_.clear();
+    size_t needed = fragment_length;
+    while (needed > 0) {
+      assert(part < num_parts);
+      const size_t n = std::min(needed, parts[part].size() - part_offset);
+      fragment_parts_.emplace_back(parts[part].data() + part_offset, n);
+      needed -= n;
+      part_offset += n;
+      if (part_offset == parts[part].size()) {
+        part++;
+        part_offset = 0;
+      }
+    }
+
+    s = EmitPhysicalRecord(type, fragment_parts_.data(),
+                           fragment_parts_.size(), fragment_length);
     left -= fragment_length;
     begin = false;
   } while (s.ok() && left > 0);
@@ -115,6 +214,12 @@ IOStatus Writer::AddRecord(const Slice& slice) {
 bool Writer::TEST_BufferIsEmpty() { return dest_->TEST_BufferIsEmpty(); }
 
 IOStatus Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n) {
+  const Slice payload(ptr, n);
+  return EmitPhysicalRecord(t, &payload, 1, n);
+}
+
+IOStatus Writer::EmitPhysicalRecord(RecordType t, const Slice* parts,
+                                    size_t num_parts, size_t n) {
   assert(n <= 0xffff);  // Must fit in two bytes
 
   size_t header_size;
@@ -126,7 +231,8 @@ IOStatus Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n) {
   buf[6] = static_cast<char>(t);
 
   uint32_t crc = type_crc_[t];
-  if (t < kRecyclableFullType) {
+  if (t < kRecyclableFullType || t == kSetCompressionType ||
+      t == kRecordOrdinalType) {
     // Legacy record format
     assert(block_offset_ + kHeaderSize + n <= kBlockSize);
     header_size = kHeaderSize;
@@ -145,7 +251,9 @@ IOStatus Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n) {
   }
 
   // Compute the crc of the record type and the payload.
-  crc = crc32c::Extend(crc, ptr, n);
+  for (size_t i = 0; i < num_parts; i++) {
+    crc = crc32c::Extend(crc, parts[i].data(), parts[i].size());
+  }
   crc = crc32c::Mask(crc);  // Adjust for storage
   TEST_SYNC_POINT_CALLBACK("LogWriter::EmitPhysicalRecord:BeforeEncodeChecksum",
                            &crc);
@@ -153,8 +261,8 @@ IOStatus Writer::EmitPhysicalRecord(RecordType t, const char* ptr, size_t n) {
 
   // Write the header and the payload
   IOStatus s = dest_->Append(Slice(buf, header_size));
-  if (s.ok()) {
-    s = dest_->Append(Slice(ptr, n));
+  for (size_t i = 0; s.ok() && i < num_parts; i++) {
+    s = dest_->Append(parts[i]);
   }
   block_offset_ += header_size + n;
   return s;
@@ -11,14 +11,17 @@
 #include <stdint.h>
 
 #include <memory>
+#include <vector>
 
 #include "db/log_format.h"
+#include "rocksdb/compression_type.h"
 #include "rocksdb/io_status.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/status.h"
 
 namespace ROCKSDB_NAMESPACE {
 
+class StreamingCompress;
 class WritableFileWriter;
 
 namespace log {
@@ -65,6 +68,21 @@ namespace log {
  * Same as above, with the addition of
  * Log number = 32bit log file number, so that we can distinguish between
  * records written by the most recent log writer vs a previous one.
+ *
+ * Compressed records:
+ *
+ * A kSetCompressionType record, whose payload is the 1-byte CompressionType,
+ * may start the file. Every logical record after it is compressed, as one
+ * flush of a single compression stream that spans the whole file, before it
+ * is fragmented into physical records as above. A reader must therefore see
+ * all the records of a file in order to decompress any of them.
+ *
+ * Striped WALs:
+ *
+ * A WAL striped over several files (see DBOptions::wal_stripe_dirs) precedes
+ * each logical record with a kRecordOrdinalType record, whose payload is the
+ * 8-byte position of the record among the records of all the files, starting
+ * from 1. Recovery merges the files back into one stream by these ordinals.
  */
 class Writer {
  public:
@@ -73,7 +91,8 @@ class Writer {
   // "*dest" must remain live while this Writer is in use.
   explicit Writer(std::unique_ptr<WritableFileWriter>&& dest,
                   uint64_t log_number, bool recycle_log_files,
-                  bool manual_flush = false);
+                  bool manual_flush = false,
+                  CompressionType compression_type = kNoCompression);
   // No copying allowed
   Writer(const Writer&) = delete;
   void operator=(const Writer&) = delete;
@@ -82,6 +101,20 @@ class Writer {
 
   IOStatus AddRecord(const Slice& slice);
 
+  // Writes the concatenation of the parts as one record, without first
+  // copying them together unless the record has to be compressed.
+  IOStatus AddRecord(const SliceParts& record);
+
+  // Writes the kSetCompressionType record that makes AddRecord() compress
+  // the records that follow. A no-op unless the Writer was created with a
+  // compression type. Must be called before the first AddRecord().
+  IOStatus AddCompressionTypeRecord();
+
+  // Writes the kRecordOrdinalType record numbering the next record of a
+  // striped WAL. Does not flush, as the record is only useful along with the
+  // one that follows it.
+  IOStatus AddRecordOrdinal(uint64_t ordinal);
+
   WritableFileWriter* file() { return dest_.get(); }
   const WritableFileWriter* file() const { return dest_.get(); }
 
@@ -105,10 +138,23 @@ class Writer {
   uint32_t type_crc_[kMaxRecordType + 1];
 
   IOStatus EmitPhysicalRecord(RecordType type, const char* ptr, size_t length);
+  // Emits a physical record whose payload is the concatenation of the first
+  // num_parts of parts, length bytes in total.
+  IOStatus EmitPhysicalRecord(RecordType type, const Slice* parts,
+                              size_t num_parts, size_t length);
 
   // If true, it does not flush after each write. Instead it relies on the upper
   // layer to manually does the flush by calling ::WriteBuffer()
   bool manual_flush_;
+
+  // Compression of the records, set up by AddCompressionTypeRecord()
+  CompressionType compression_type_;
+  std::unique_ptr<StreamingCompress> compress_;
+  std::string compressed_buffer_;
+
+  // Pieces of the payload of the fragment being emitted, kept to reuse its
+  // allocation
+  std::vector<Slice> fragment_parts_;
 };
 
 }  // namespace log
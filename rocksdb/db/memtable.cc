@@ -40,15 +40,30 @@
 
 namespace ROCKSDB_NAMESPACE {
 
+namespace {
+// Share of write_buffer_size given to the memtable bloom filter when whole key
+// filtering is enabled without an explicit memtable_prefix_bloom_size_ratio.
+// That is about 10 bits for every 64 bytes of write buffer, or roughly a 1%
+// false positive rate when entries are small.
+const double kDefaultMemtableWholeKeyBloomSizeRatio = 0.02;
+
+uint32_t MemtableBloomBits(const MutableCFOptions& mutable_cf_options) {
+  double ratio = mutable_cf_options.memtable_prefix_bloom_size_ratio;
+  if (ratio <= 0 && mutable_cf_options.memtable_whole_key_filtering) {
+    ratio = kDefaultMemtableWholeKeyBloomSizeRatio;
+  }
+  return static_cast<uint32_t>(
+             static_cast<double>(mutable_cf_options.write_buffer_size) *
+             ratio) *
+         8u;
+}
+}  // namespace
+
 ImmutableMemTableOptions::ImmutableMemTableOptions(
     const ImmutableCFOptions& ioptions,
     const MutableCFOptions& mutable_cf_options)
     : arena_block_size(mutable_cf_options.arena_block_size),
-      memtable_prefix_bloom_bits(
-          static_cast<uint32_t>(
-              static_cast<double>(mutable_cf_options.write_buffer_size) *
-              mutable_cf_options.memtable_prefix_bloom_size_ratio) *
-          8u),
+      memtable_prefix_bloom_bits(MemtableBloomBits(mutable_cf_options)),
       memtable_huge_page_size(mutable_cf_options.memtable_huge_page_size),
       memtable_whole_key_filtering(
           mutable_cf_options.memtable_whole_key_filtering),
@@ -91,6 +106,7 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
       flush_in_progress_(false),
       flush_completed_(false),
       file_number_(0),
+      compaction_picked_(false),
       first_seqno_(0),
       earliest_seqno_(latest_seq),
       creation_seq_(latest_seq),
@@ -111,7 +127,8 @@ MemTable::MemTable(const InternalKeyComparator& cmp,
   // something went wrong if we need to flush before inserting anything
   assert(!ShouldScheduleFlush());
 
-  // use bloom_filter_ for both whole key and prefix bloom filter
+  // use bloom_filter_ for both whole key and prefix bloom filter. It lives
+  // outside table_, so it works the same way for every MemTableRep.
   if ((prefix_extractor_ || moptions_.memtable_whole_key_filtering) &&
       moptions_.memtable_prefix_bloom_bits > 0) {
     bloom_filter_.reset(
@@ -216,6 +233,24 @@ void MemTable::UpdateFlushState() {
   }
 }
 
+void MemTable::InheritFrom(const MemTable& mem) {
+  assert(num_entries_.load(std::memory_order_relaxed) == 0);
+  id_ = mem.id_;
+  compaction_picked_ = true;
+  first_seqno_.store(mem.first_seqno_.load(std::memory_order_relaxed),
+                     std::memory_order_relaxed);
+  earliest_seqno_.store(mem.earliest_seqno_.load(std::memory_order_relaxed),
+                        std::memory_order_relaxed);
+  creation_seq_ = mem.creation_seq_;
+  mem_next_logfile_number_ = mem.mem_next_logfile_number_;
+  min_prep_log_referenced_.store(
+      mem.min_prep_log_referenced_.load(std::memory_order_relaxed),
+      std::memory_order_relaxed);
+  oldest_key_time_.store(mem.oldest_key_time_.load(std::memory_order_relaxed),
+                         std::memory_order_relaxed);
+  atomic_flush_seqno_ = mem.atomic_flush_seqno_;
+}
+
 void MemTable::UpdateOldestKeyTime() {
   uint64_t oldest_key_time = oldest_key_time_.load(std::memory_order_relaxed);
   if (oldest_key_time == std::numeric_limits<uint64_t>::max()) {
@@ -519,6 +554,11 @@ bool MemTable::Add(SequenceNumber s, ValueType type,
       if (UNLIKELY(!res)) {
         return res;
       }
+    } else if (hint != nullptr) {
+      bool res = table->InsertKeyWithHint(handle, hint);
+      if (UNLIKELY(!res)) {
+        return res;
+      }
     } else {
       bool res = table->InsertKey(handle);
       if (UNLIKELY(!res)) {
@@ -896,22 +936,28 @@ void MemTable::MultiGet(const ReadOptions& read_options, MultiGetRange* range,
 
   MultiGetRange temp_range(*range, range->begin(), range->end());
   if (bloom_filter_) {
+    // Like Get(), prefer whole key filtering when both are enabled, and strip
+    // the timestamp the same way Add() does.
+    const bool whole_key = moptions_.memtable_whole_key_filtering;
+    size_t ts_sz =
+        GetInternalKeyComparator().user_comparator()->timestamp_size();
     std::array<Slice*, MultiGetContext::MAX_BATCH_SIZE> keys;
     std::array<bool, MultiGetContext::MAX_BATCH_SIZE> may_match = {{true}};
-    autovector<Slice, MultiGetContext::MAX_BATCH_SIZE> prefixes;
+    autovector<Slice, MultiGetContext::MAX_BATCH_SIZE> bloom_keys;
     int num_keys = 0;
     for (auto iter = temp_range.begin(); iter != temp_range.end(); ++iter) {
-      if (!prefix_extractor_) {
-        keys[num_keys++] = &iter->ukey;
+      if (whole_key) {
+        bloom_keys.emplace_back(StripTimestampFromUserKey(iter->ukey, ts_sz));
+        keys[num_keys++] = &bloom_keys.back();
       } else if (prefix_extractor_->InDomain(iter->ukey)) {
-        prefixes.emplace_back(prefix_extractor_->Transform(iter->ukey));
-        keys[num_keys++] = &prefixes.back();
+        bloom_keys.emplace_back(prefix_extractor_->Transform(iter->ukey));
+        keys[num_keys++] = &bloom_keys.back();
       }
     }
     bloom_filter_->MayContain(num_keys, &keys[0], &may_match[0]);
     int idx = 0;
     for (auto iter = temp_range.begin(); iter != temp_range.end(); ++iter) {
-      if (prefix_extractor_ && !prefix_extractor_->InDomain(iter->ukey)) {
+      if (!whole_key && !prefix_extractor_->InDomain(iter->ukey)) {
         PERF_COUNTER_ADD(bloom_memtable_hit_count, 1);
         continue;
       }
@@ -88,6 +88,9 @@ class MemTable {
                            const char* prefix_len_key2) const override;
     virtual int operator()(const char* prefix_len_key,
                            const DecodedType& key) const override;
+    virtual const Comparator* user_comparator() const override {
+      return comparator.user_comparator();
+    }
   };
 
   // MemTables are reference counted.  The initial reference count
@@ -181,6 +184,12 @@ class MemTable {
   // REQUIRES: if allow_concurrent = false, external synchronization to prevent
   // simultaneous operations on the same MemTable.
   //
+  // If hint is not nullptr, the key is inserted with MemTableRep's
+  // InsertKeyWithHint*() using *hint, which must only ever be passed to this
+  // memtable and not for kTypeRangeDeletion. Without allow_concurrent the rep
+  // allocates a new hint from the memtable's arena, otherwise on heap, to be
+  // deleted by the caller.
+  //
   // Returns false if MemTableRepFactory::CanHandleDuplicatedKey() is true and
   // the <key, seq> already exists.
   bool Add(SequenceNumber seq, ValueType type, const Slice& key,
@@ -435,6 +444,12 @@ class MemTable {
     flush_in_progress_ = in_progress;
   }
 
+  // Prepares this empty memtable to replace the immutable memtable "mem"
+  // once the entries of mem that can still be read have been added to it:
+  // takes over mem's ID, sequence numbers, log numbers and oldest key time.
+  // REQUIRES: db_mutex held.
+  void InheritFrom(const MemTable& mem);
+
 #ifndef ROCKSDB_LITE
   void SetFlushJobInfo(std::unique_ptr<FlushJobInfo>&& info) {
     flush_job_info_ = std::move(info);
@@ -474,6 +489,8 @@ class MemTable {
   bool flush_in_progress_; // started the flush
   bool flush_completed_;   // finished the flush
   uint64_t file_number_;    // filled up after flush is complete
+  // picked for, or produced by, an in-memory compaction
+  bool compaction_picked_;
 
   // The updates to be applied to the transaction log when this
   // memtable is flushed to storage.
@@ -5,12 +5,16 @@
 //
 #include "db/memtable_list.h"
 
+#include <algorithm>
 #include <cinttypes>
 #include <limits>
 #include <queue>
 #include <string>
+#include "db/compaction/compaction_iterator.h"
 #include "db/db_impl/db_impl.h"
 #include "db/memtable.h"
+#include "db/merge_helper.h"
+#include "db/range_del_aggregator.h"
 #include "db/range_tombstone_fragmenter.h"
 #include "db/version_set.h"
 #include "logging/log_buffer.h"
@@ -19,6 +23,7 @@
 #include "rocksdb/env.h"
 #include "rocksdb/iterator.h"
 #include "table/merging_iterator.h"
+#include "table/scoped_arena_iterator.h"
 #include "test_util/sync_point.h"
 #include "util/coding.h"
 
@@ -278,6 +283,16 @@ void MemTableListVersion::Remove(MemTable* m,
   }
 }
 
+void MemTableListVersion::Replace(MemTable* old_m, MemTable* new_m,
+                                  autovector<MemTable*>* to_delete) {
+  assert(refs_ == 1);  // only when refs_ == 1 is MemTableListVersion mutable
+  auto it = std::find(memlist_.begin(), memlist_.end(), old_m);
+  assert(it != memlist_.end());
+  *it = new_m;
+  *parent_memtable_list_memory_usage_ += new_m->ApproximateMemoryUsage();
+  UnrefMemTable(to_delete, old_m);
+}
+
 // return the total memory usage assuming the oldest flushed memtable is dropped
 size_t MemTableListVersion::ApproximateMemoryUsageExcludingLast() const {
   size_t total_memtable_size = 0;
@@ -552,6 +567,33 @@ void MemTableList::Add(MemTable* m, autovector<MemTable*>* to_delete) {
   ResetTrimHistoryNeeded();
 }
 
+MemTable* MemTableList::PickMemTableToCompact() {
+  for (auto m : current_->memlist_) {
+    if (!m->flush_in_progress_ && !m->compaction_picked_) {
+      m->compaction_picked_ = true;
+      return m;
+    }
+  }
+  return nullptr;
+}
+
+bool MemTableList::ReplaceMemTable(MemTable* old_m, MemTable* new_m,
+                                   autovector<MemTable*>* to_delete) {
+  if (old_m->flush_in_progress_ || old_m->flush_completed_) {
+    return false;
+  }
+  const auto& memlist = current_->memlist_;
+  if (std::find(memlist.begin(), memlist.end(), old_m) == memlist.end()) {
+    return false;
+  }
+  // AssignAtomicFlushSeq() may have run while old_m was being compacted.
+  new_m->atomic_flush_seqno_ = old_m->atomic_flush_seqno_;
+  InstallNewVersion();
+  current_->Replace(old_m, new_m, to_delete);
+  UpdateCachedValuesFromMemTableListVersion();
+  return true;
+}
+
 bool MemTableList::TrimHistory(autovector<MemTable*>* to_delete, size_t usage) {
   InstallNewVersion();
   bool ret = current_->TrimHistory(to_delete, usage);
@@ -773,4 +815,51 @@ void MemTableList::RemoveOldMemTables(uint64_t log_number,
   ResetTrimHistoryNeeded();
 }
 
+Status CompactMemTable(const ImmutableCFOptions& ioptions, MemTable* m,
+                       MemTable* new_m, std::vector<SequenceNumber> snapshots,
+                       SequenceNumber earliest_write_conflict_snapshot,
+                       const SnapshotChecker* snapshot_checker) {
+  const InternalKeyComparator& icmp = m->GetInternalKeyComparator();
+  ReadOptions ro;
+  ro.total_order_seek = true;
+  Arena arena;
+  ScopedArenaIterator iter(m->NewIterator(ro, &arena));
+  iter->SeekToFirst();
+  CompactionRangeDelAggregator range_del_agg(&icmp, snapshots);
+  std::unique_ptr<FragmentedRangeTombstoneIterator> range_del_iter(
+      m->NewRangeTombstoneIterator(ro, kMaxSequenceNumber));
+  if (range_del_iter != nullptr) {
+    range_del_agg.AddTombstones(std::move(range_del_iter));
+  }
+
+  MergeHelper merge(ioptions.env, icmp.user_comparator(),
+                    ioptions.merge_operator, nullptr, ioptions.info_log,
+                    true /* internal key corruption is not ok */,
+                    snapshots.empty() ? 0 : snapshots.back(), snapshot_checker);
+  // Without a Compaction the iterator never treats its output as bottommost,
+  // so deletions survive to hide older data in the remaining memtables and
+  // SST files.
+  CompactionIterator c_iter(
+      iter.get(), icmp.user_comparator(), &merge, kMaxSequenceNumber,
+      &snapshots, earliest_write_conflict_snapshot, snapshot_checker,
+      ioptions.env, false /* report_detailed_time */,
+      true /* internal key corruption is not ok */, &range_del_agg);
+  c_iter.SeekToFirst();
+  for (; c_iter.Valid(); c_iter.Next()) {
+    const ParsedInternalKey& ikey = c_iter.ikey();
+    new_m->Add(ikey.sequence, ikey.type, ikey.user_key, c_iter.value());
+  }
+  Status s = c_iter.status();
+  if (s.ok()) {
+    auto range_del_it = range_del_agg.NewIterator();
+    for (range_del_it->SeekToFirst(); range_del_it->Valid();
+         range_del_it->Next()) {
+      auto tombstone = range_del_it->Tombstone();
+      new_m->Add(tombstone.seq_, kTypeRangeDeletion, tombstone.start_key_,
+                 tombstone.end_key_);
+    }
+  }
+  return s;
+}
+
 }  // namespace ROCKSDB_NAMESPACE
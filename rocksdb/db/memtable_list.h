@@ -32,6 +32,7 @@ class InternalKeyComparator;
 class InstrumentedMutex;
 class MergeIteratorBuilder;
 class MemTableList;
+class SnapshotChecker;
 
 struct FlushJobInfo;
 
@@ -148,6 +149,11 @@ class MemTableListVersion {
   // REQUIRE: m is an immutable memtable
   void Remove(MemTable* m, autovector<MemTable*>* to_delete);
 
+  // Puts new_m in the place of old_m. Caller is responsible for referencing
+  // new_m and should NOT Unref old_m.
+  void Replace(MemTable* old_m, MemTable* new_m,
+               autovector<MemTable*>* to_delete);
+
   // Return true if memtable is trimmed
   bool TrimHistory(autovector<MemTable*>* to_delete, size_t usage);
 
@@ -274,6 +280,17 @@ class MemTableList {
   // Takes ownership of the referenced held on *m by the caller of Add().
   void Add(MemTable* m, autovector<MemTable*>* to_delete);
 
+  // Returns the most recent memtable that neither a flush nor an in-memory
+  // compaction has picked yet and marks it picked, or returns nullptr.
+  MemTable* PickMemTableToCompact();
+
+  // Replaces old_m with new_m, the result of its in-memory compaction (see
+  // CompactMemTable()), unless a flush has picked old_m in the meantime.
+  // Returns true and takes ownership of the reference held on *new_m by the
+  // caller if the memtable was replaced.
+  bool ReplaceMemTable(MemTable* old_m, MemTable* new_m,
+                       autovector<MemTable*>* to_delete);
+
   // Returns an estimate of the number of bytes of data in use.
   size_t ApproximateMemoryUsage();
 
@@ -427,4 +444,14 @@ extern Status InstallMemtableAtomicFlushResults(
     InstrumentedMutex* mu, const autovector<FileMetaData*>& file_meta,
     autovector<MemTable*>* to_delete, FSDirectory* db_directory,
     LogBuffer* log_buffer);
+
+// Adds to new_m, an empty memtable prepared with MemTable::InheritFrom(m),
+// what can still be read from the immutable memtable m: versions that none of
+// `snapshots` can see are dropped and merge operands are combined, the same
+// way a flush would.
+extern Status CompactMemTable(
+    const ImmutableCFOptions& ioptions, MemTable* m, MemTable* new_m,
+    std::vector<SequenceNumber> snapshots,
+    SequenceNumber earliest_write_conflict_snapshot,
+    const SnapshotChecker* snapshot_checker);
 }  // namespace ROCKSDB_NAMESPACE
@@ -29,9 +29,17 @@
 //    kTypeBeginPersistedPrepareXID varstring
 //    kTypeBeginUnprepareXID varstring
 //    kTypeNoop
+//    kTypeValuePinned varstring pinnedstring
+//    kTypeColumnFamilyValuePinned varint32 varstring pinnedstring
 // varstring :=
 //    len: varint32
 //    data: uint8[len]
+// pinnedstring :=
+//    len: varint32
+//    data: fixed64, the address of uint8[len] owned by the caller
+//
+// Pinned records never leave the process: GetContentsParts() turns them into
+// kTypeValue/kTypeColumnFamilyValue records with the data spliced in.
 
 #include "rocksdb/write_batch.h"
 
@@ -237,6 +245,55 @@ class TimestampAssigner : public WriteBatch::Handler {
 };
 const std::vector<Slice> TimestampAssigner::kEmptyTimestampList;
 
+void PutPinnedSlice(std::string* dst, const Slice& value) {
+  PutVarint32(dst, static_cast<uint32_t>(value.size()));
+  PutFixed64(dst, static_cast<uint64_t>(
+                      reinterpret_cast<uintptr_t>(value.data())));
+}
+
+bool GetPinnedSlice(Slice* input, Slice* value) {
+  uint32_t len = 0;
+  if (!GetVarint32(input, &len) || input->size() < sizeof(uint64_t)) {
+    return false;
+  }
+  *value = Slice(reinterpret_cast<const char*>(
+                     static_cast<uintptr_t>(DecodeFixed64(input->data()))),
+                 len);
+  input->remove_prefix(sizeof(uint64_t));
+  return true;
+}
+
+bool IsPinnedRecord(char tag) {
+  return tag == static_cast<char>(kTypeValuePinned) ||
+         tag == static_cast<char>(kTypeColumnFamilyValuePinned);
+}
+
+// Sets *records and *bytes to the number and the total size of the values
+// referenced by the pinned records in rep[begin, end).
+void CountPinnedValues(const std::string& rep, size_t begin, size_t end,
+                       size_t* records, size_t* bytes) {
+  *records = 0;
+  *bytes = 0;
+  Slice input(rep.data() + begin, end - begin);
+  char tag = 0;
+  uint32_t column_family = 0;
+  Slice key, value, blob, xid;
+  while (!input.empty()) {
+    const bool pinned = IsPinnedRecord(input[0]);
+    Status s = ReadRecordFromWriteBatch(&input, &tag, &column_family, &key,
+                                        &value, &blob, &xid,
+                                        true /* allow_pinned */);
+    if (!s.ok()) {
+      assert(false);
+      break;
+    }
+    if (pinned) {
+      ++*records;
+      *bytes += value.size();
+    }
+  }
+}
+
 }  // anon namespace
 
 struct SavePoints {
@@ -274,6 +331,8 @@ WriteBatch::WriteBatch(const WriteBatch& src)
     : wal_term_point_(src.wal_term_point_),
       content_flags_(src.content_flags_.load(std::memory_order_relaxed)),
       max_bytes_(src.max_bytes_),
+      pinned_records_(src.pinned_records_),
+      pinned_value_bytes_(src.pinned_value_bytes_),
       rep_(src.rep_),
       timestamp_size_(src.timestamp_size_) {
   if (src.save_points_ != nullptr) {
@@ -287,6 +346,8 @@ WriteBatch::WriteBatch(WriteBatch&& src) noexcept
       wal_term_point_(std::move(src.wal_term_point_)),
       content_flags_(src.content_flags_.load(std::memory_order_relaxed)),
       max_bytes_(src.max_bytes_),
+      pinned_records_(src.pinned_records_),
+      pinned_value_bytes_(src.pinned_value_bytes_),
       rep_(std::move(src.rep_)),
       timestamp_size_(src.timestamp_size_) {}
 
@@ -324,6 +385,8 @@ void WriteBatch::Clear() {
   rep_.resize(WriteBatchInternal::kHeader);
 
   content_flags_.store(0, std::memory_order_relaxed);
+  pinned_records_ = 0;
+  pinned_value_bytes_ = 0;
 
   if (save_points_ != nullptr) {
     while (!save_points_->stack.empty()) {
@@ -413,7 +476,8 @@ bool WriteBatch::HasRollback() const {
 
 Status ReadRecordFromWriteBatch(Slice* input, char* tag,
                                 uint32_t* column_family, Slice* key,
-                                Slice* value, Slice* blob, Slice* xid) {
+                                Slice* value, Slice* blob, Slice* xid,
+                                bool allow_pinned) {
   assert(key != nullptr && value != nullptr);
   *tag = (*input)[0];
   input->remove_prefix(1);
@@ -430,6 +494,20 @@ Status ReadRecordFromWriteBatch(Slice* input, char* tag,
         return Status::Corruption("bad WriteBatch Put");
       }
       break;
+    case kTypeColumnFamilyValuePinned:
+      if (!allow_pinned || !GetVarint32(input, column_family)) {
+        return Status::Corruption("bad WriteBatch Put");
+      }
+      FALLTHROUGH_INTENDED;
+    case kTypeValuePinned:
+      if (!allow_pinned || !GetLengthPrefixedSlice(input, key) ||
+          !GetPinnedSlice(input, value)) {
+        return Status::Corruption("bad WriteBatch Put");
+      }
+      *tag = (*tag == static_cast<char>(kTypeValuePinned))
+                 ? kTypeValue
+                 : kTypeColumnFamilyValue;
+      break;
     case kTypeColumnFamilyDeletion:
     case kTypeColumnFamilySingleDeletion:
       if (!GetVarint32(input, column_family)) {
@@ -555,7 +633,7 @@ Status WriteBatchInternal::Iterate(const WriteBatch* wb,
       column_family = 0;  // default
 
       s = ReadRecordFromWriteBatch(&input, &tag, &column_family, &key, &value,
-                                   &blob, &xid);
+                                   &blob, &xid, wb->pinned_records_ > 0);
       if (!s.ok()) {
         return s;
       }
@@ -790,6 +868,49 @@ Status WriteBatch::Put(ColumnFamilyHandle* column_family, const Slice& key,
                                  value);
 }
 
+Status WriteBatchInternal::PutPinned(WriteBatch* b, uint32_t column_family_id,
+                                     const Slice& key, const Slice& value) {
+  if (key.size() > size_t{port::kMaxUint32}) {
+    return Status::InvalidArgument("key is too large");
+  }
+  if (value.size() > size_t{port::kMaxUint32}) {
+    return Status::InvalidArgument("value is too large");
+  }
+
+  LocalSavePoint save(b);
+  WriteBatchInternal::SetCount(b, WriteBatchInternal::Count(b) + 1);
+  if (column_family_id == 0) {
+    b->rep_.push_back(static_cast<char>(kTypeValuePinned));
+  } else {
+    b->rep_.push_back(static_cast<char>(kTypeColumnFamilyValuePinned));
+    PutVarint32(&b->rep_, column_family_id);
+  }
+  if (0 == b->timestamp_size_) {
+    PutLengthPrefixedSlice(&b->rep_, key);
+  } else {
+    PutVarint32(&b->rep_,
+                static_cast<uint32_t>(key.size() + b->timestamp_size_));
+    b->rep_.append(key.data(), key.size());
+    b->rep_.append(b->timestamp_size_, '\0');
+  }
+  PutPinnedSlice(&b->rep_, value);
+  b->content_flags_.store(
+      b->content_flags_.load(std::memory_order_relaxed) | ContentFlags::HAS_PUT,
+      std::memory_order_relaxed);
+  Status s = save.commit();
+  if (s.ok()) {
+    b->pinned_records_++;
+    b->pinned_value_bytes_ += value.size();
+  }
+  return s;
+}
+
+Status WriteBatch::PutPinned(ColumnFamilyHandle* column_family,
+                             const Slice& key, const Slice& value) {
+  return WriteBatchInternal::PutPinned(this, GetColumnFamilyID(column_family),
+                                       key, value);
+}
+
 Status WriteBatchInternal::CheckSlicePartsLength(const SliceParts& key,
                                                  const SliceParts& value) {
   size_t total_key_bytes = 0;
@@ -1170,6 +1291,10 @@ Status WriteBatch::RollbackToSavePoint() {
     rep_.resize(savepoint.size);
     WriteBatchInternal::SetCount(this, savepoint.count);
     content_flags_.store(savepoint.content_flags, std::memory_order_relaxed);
+    if (pinned_records_ > 0) {
+      CountPinnedValues(rep_, WriteBatchInternal::kHeader, rep_.size(),
+                        &pinned_records_, &pinned_value_bytes_);
+    }
   }
 
   return Status::OK();
@@ -1242,8 +1367,15 @@ class MemTableInserter : public WriteBatch::Handler {
   using HintMapType = std::aligned_storage<sizeof(HintMap)>::type;
   HintMapType hint_;
 
+  // The run of ascending keys most recently put into sorted_run_mem_, and
+  // the hint used for it once it is long enough; see GetInsertHint()
+  static const size_t kMinSortedRunForHint = 16;
+  MemTable* sorted_run_mem_;
+  Slice sorted_run_last_key_;
+  size_t sorted_run_length_;
+  void** sorted_run_hint_;
+
   HintMap& GetHintMap() {
-    assert(hint_per_batch_);
     if (!hint_created_) {
       new (&hint_) HintMap();
       hint_created_ = true;
@@ -1251,6 +1383,35 @@ class MemTableInserter : public WriteBatch::Handler {
     return *reinterpret_cast<HintMap*>(&hint_);
   }
 
+  // Returns the insert hint to pass to MemTable::Add() for key, or nullptr.
+  // Besides the hints requested with hint_per_batch, a hint is used once
+  // kMinSortedRunForHint keys in a row have been put into the same memtable in
+  // ascending order, so that each insert of a sorted batch starts from the
+  // position of the previous one instead of searching from the top.
+  void** GetInsertHint(MemTable* mem, const Slice& key) {
+    if (hint_per_batch_) {
+      return &GetHintMap()[mem];
+    }
+    if (mem != sorted_run_mem_) {
+      sorted_run_mem_ = mem;
+      sorted_run_length_ = 0;
+      sorted_run_hint_ = nullptr;
+    } else if (sorted_run_length_ > 0 &&
+               mem->GetInternalKeyComparator().user_comparator()->Compare(
+                   key, sorted_run_last_key_) <= 0) {
+      sorted_run_length_ = 0;
+    }
+    // key points into the batch, which outlives this inserter
+    sorted_run_last_key_ = key;
+    if (++sorted_run_length_ <= kMinSortedRunForHint) {
+      return nullptr;
+    }
+    if (sorted_run_hint_ == nullptr) {
+      sorted_run_hint_ = &GetHintMap()[mem];
+    }
+    return sorted_run_hint_;
+  }
+
   MemPostInfoMap& GetPostMap() {
     assert(concurrent_memtable_writes_);
     if(!post_info_created_) {
@@ -1310,7 +1471,10 @@ class MemTableInserter : public WriteBatch::Handler {
         duplicate_detector_(),
         dup_dectector_on_(false),
         hint_per_batch_(hint_per_batch),
-        hint_created_(false) {
+        hint_created_(false),
+        sorted_run_mem_(nullptr),
+        sorted_run_length_(0),
+        sorted_run_hint_(nullptr) {
     assert(cf_mems_);
   }
 
@@ -1324,8 +1488,11 @@ class MemTableInserter : public WriteBatch::Handler {
         (&mem_post_info_map_)->~MemPostInfoMap();
     }
     if (hint_created_) {
-      for (auto iter : GetHintMap()) {
-        delete[] reinterpret_cast<char*>(iter.second);
+      // Without concurrent writes the hints live in the memtable's arena
+      if (concurrent_memtable_writes_) {
+        for (auto iter : GetHintMap()) {
+          delete[] reinterpret_cast<char*>(iter.second);
+        }
       }
       reinterpret_cast<HintMap*>(&hint_)->~HintMap();
     }
@@ -1438,7 +1605,7 @@ class MemTableInserter : public WriteBatch::Handler {
       bool mem_res =
           mem->Add(sequence_, value_type, key, value,
                    concurrent_memtable_writes_, get_post_process_info(mem),
-                   hint_per_batch_ ? &GetHintMap()[mem] : nullptr);
+                   GetInsertHint(mem, key));
       if (UNLIKELY(!mem_res)) {
         assert(seq_per_batch_);
         ret_status = Status::TryAgain("key+seq exists");
@@ -1519,10 +1686,12 @@ class MemTableInserter : public WriteBatch::Handler {
                     const Slice& value, ValueType delete_type) {
     Status ret_status;
     MemTable* mem = cf_mems_->GetMemTable();
+    // Range deletions go to a separate table, which the hints are not for
     bool mem_res =
         mem->Add(sequence_, delete_type, key, value,
                  concurrent_memtable_writes_, get_post_process_info(mem),
-                 hint_per_batch_ ? &GetHintMap()[mem] : nullptr);
+                 delete_type == kTypeRangeDeletion ? nullptr
+                                                   : GetInsertHint(mem, key));
     if (UNLIKELY(!mem_res)) {
       assert(seq_per_batch_);
       ret_status = Status::TryAgain("key+seq exists");
@@ -1769,7 +1938,8 @@ class MemTableInserter : public WriteBatch::Handler {
       // Add merge operator to memtable
       bool mem_res =
           mem->Add(sequence_, kTypeMerge, key, value,
-                   concurrent_memtable_writes_, get_post_process_info(mem));
+                   concurrent_memtable_writes_, get_post_process_info(mem),
+                   GetInsertHint(mem, key));
       if (UNLIKELY(!mem_res)) {
         assert(seq_per_batch_);
         ret_status = Status::TryAgain("key+seq exists");
@@ -2001,6 +2171,7 @@ Status WriteBatchInternal::InsertInto(
       ignore_missing_column_families, recovery_log_number, db,
       concurrent_memtable_writes, nullptr /*has_valid_writes*/, seq_per_batch,
       batch_per_txn);
+  Status s;
   for (auto w : write_group) {
     if (w->CallbackFailed()) {
       continue;
@@ -2015,12 +2186,18 @@ Status WriteBatchInternal::InsertInto(
     inserter.set_log_number_ref(w->log_ref);
     w->status = w->batch->Iterate(&inserter);
     if (!w->status.ok()) {
-      return w->status;
+      s = w->status;
+      break;
     }
     assert(!seq_per_batch || w->batch_cnt != 0);
     assert(!seq_per_batch || inserter.sequence() - w->sequence == w->batch_cnt);
   }
-  return Status::OK();
+  if (concurrent_memtable_writes) {
+    // With write_queue_shards, a whole write group is inserted concurrently
+    // with the ones of the other write queues.
+    inserter.PostProcess();
+  }
+  return s;
 }
 
 Status WriteBatchInternal::InsertInto(
@@ -2050,6 +2227,81 @@ Status WriteBatchInternal::InsertInto(
   return s;
 }
 
+bool WriteBatchInternal::SplitForParallelInsert(const WriteBatch* batch,
+                                                size_t max_ranges,
+                                                std::vector<Range>* ranges) {
+  assert(max_ranges > 0);
+  ranges->clear();
+  const std::string& rep = batch->rep_;
+  if (rep.size() <= kHeader) {
+    return false;
+  }
+  const size_t range_bytes = ByteSize(batch) / max_ranges + 1;
+  const bool allow_pinned = batch->pinned_records_ > 0;
+
+  Slice input(rep.data() + kHeader, rep.size() - kHeader);
+  size_t bytes = 0;
+  SequenceNumber count = 0;
+  ranges->push_back({kHeader, rep.size(), 0});
+  char tag = 0;
+  uint32_t column_family = 0;
+  Slice key, value, blob, xid;
+  while (!input.empty()) {
+    if (bytes >= range_bytes && ranges->size() < max_ranges) {
+      const size_t offset = input.data() - rep.data();
+      ranges->back().end = offset;
+      ranges->push_back({offset, rep.size(), count});
+      bytes = 0;
+    }
+    const size_t before = input.size();
+    const bool pinned = IsPinnedRecord(input[0]);
+    if (!ReadRecordFromWriteBatch(&input, &tag, &column_family, &key, &value,
+                                  &blob, &xid, allow_pinned)
+             .ok()) {
+      return false;
+    }
+    bytes += before - input.size() + (pinned ? value.size() : 0);
+    switch (tag) {
+      case kTypeColumnFamilyValue:
+      case kTypeValue:
+      case kTypeColumnFamilyDeletion:
+      case kTypeDeletion:
+      case kTypeColumnFamilySingleDeletion:
+      case kTypeSingleDeletion:
+      case kTypeColumnFamilyRangeDeletion:
+      case kTypeRangeDeletion:
+      case kTypeColumnFamilyBlobIndex:
+      case kTypeBlobIndex:
+        // Each of these takes a sequence number, see MemTableInserter
+        count++;
+        break;
+      case kTypeLogData:
+        break;
+      default:
+        return false;
+    }
+  }
+  // A batch with a wrong count is left for Iterate() to report
+  return count == Count(batch);
+}
+
+Status WriteBatchInternal::InsertInto(
+    WriteThread::Writer* writer, const Range& range, SequenceNumber sequence,
+    ColumnFamilyMemTables* memtables, FlushScheduler* flush_scheduler,
+    TrimHistoryScheduler* trim_history_scheduler,
+    bool ignore_missing_column_families, DB* db) {
+  assert(writer->ShouldWriteToMemtable());
+  MemTableInserter inserter(
+      sequence + range.sequence_offset, memtables, flush_scheduler,
+      trim_history_scheduler, ignore_missing_column_families,
+      0 /* recovering_log_number */, db, true /* concurrent_memtable_writes */,
+      nullptr /*has_valid_writes*/);
+  inserter.set_log_number_ref(writer->log_ref);
+  Status s = Iterate(writer->batch, &inserter, range.begin, range.end);
+  inserter.PostProcess();
+  return s;
+}
+
 Status WriteBatchInternal::InsertInto(
     const WriteBatch* batch, ColumnFamilyMemTables* memtables,
     FlushScheduler* flush_scheduler,
@@ -2076,9 +2328,79 @@ Status WriteBatchInternal::SetContents(WriteBatch* b, const Slice& contents) {
   assert(contents.size() >= WriteBatchInternal::kHeader);
   b->rep_.assign(contents.data(), contents.size());
   b->content_flags_.store(ContentFlags::DEFERRED, std::memory_order_relaxed);
+  b->pinned_records_ = 0;
+  b->pinned_value_bytes_ = 0;
   return Status::OK();
 }
 
+Status WriteBatchInternal::CheckContents(const WriteBatch* b) {
+  BatchContentClassifier classifier;
+  Status s = b->Iterate(&classifier);
+  if (s.ok()) {
+    b->content_flags_.store(classifier.content_flags,
+                            std::memory_order_relaxed);
+  }
+  return s;
+}
+
+size_t WriteBatchInternal::GetContentsParts(const WriteBatch* b,
+                                            std::vector<Slice>* parts) {
+  static const char kValueTag = static_cast<char>(kTypeValue);
+  static const char kColumnFamilyValueTag =
+      static_cast<char>(kTypeColumnFamilyValue);
+  parts->clear();
+  const std::string& rep = b->rep_;
+  if (b->pinned_records_ == 0) {
+    parts->emplace_back(rep);
+    return rep.size();
+  }
+
+  // Start of the part of rep not yet in *parts
+  const char* pending = rep.data();
+  Slice input(rep.data() + kHeader, rep.size() - kHeader);
+  char tag = 0;
+  uint32_t column_family = 0;
+  Slice key, value, blob, xid;
+  while (!input.empty()) {
+    const char* record = input.data();
+    Status s = ReadRecordFromWriteBatch(&input, &tag, &column_family, &key,
+                                        &value, &blob, &xid,
+                                        true /* allow_pinned */);
+    if (!s.ok()) {
+      assert(false);
+      break;
+    }
+    if (IsPinnedRecord(record[0])) {
+      // Everything between the tag and the address is encoded as in a plain
+      // Put, so only the tag and the address have to be replaced.
+      const char* address = input.data() - sizeof(uint64_t);
+      parts->emplace_back(pending, record - pending);
+      parts->emplace_back(
+          tag == kTypeValue ? &kValueTag : &kColumnFamilyValueTag, 1);
+      parts->emplace_back(record + 1, address - record - 1);
+      parts->emplace_back(value);
+      pending = input.data();
+    }
+  }
+  parts->emplace_back(pending, rep.data() + rep.size() - pending);
+  size_t size = 0;
+  for (const Slice& part : *parts) {
+    size += part.size();
+  }
+  return size;
+}
+
+void WriteBatchInternal::GetMaterializedContents(const WriteBatch* b,
+                                                 std::string* contents) {
+  std::vector<Slice> parts;
+  const size_t size = GetContentsParts(b, &parts);
+  contents->clear();
+  contents->reserve(size);
+  for (const Slice& part : parts) {
+    contents->append(part.data(), part.size());
+  }
+}
+
 Status WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src,
                                   const bool wal_only) {
   size_t src_len;
@@ -2100,6 +2422,17 @@ Status WriteBatchInternal::Append(WriteBatch* dst, const WriteBatch* src,
   SetCount(dst, Count(dst) + src_count);
   assert(src->rep_.size() >= WriteBatchInternal::kHeader);
   dst->rep_.append(src->rep_.data() + WriteBatchInternal::kHeader, src_len);
+  if (src->pinned_records_ > 0) {
+    size_t src_pinned_records = src->pinned_records_;
+    size_t src_pinned_value_bytes = src->pinned_value_bytes_;
+    if (src_len != src->rep_.size() - WriteBatchInternal::kHeader) {
+      CountPinnedValues(src->rep_, WriteBatchInternal::kHeader,
+                        WriteBatchInternal::kHeader + src_len,
+                        &src_pinned_records, &src_pinned_value_bytes);
+    }
+    dst->pinned_records_ += src_pinned_records;
+    dst->pinned_value_bytes_ += src_pinned_value_bytes;
+  }
   dst->content_flags_.store(
       dst->content_flags_.load(std::memory_order_relaxed) | src_flags,
       std::memory_order_relaxed);
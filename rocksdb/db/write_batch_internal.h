@@ -76,6 +76,9 @@ class WriteBatchInternal {
   static Status Put(WriteBatch* batch, uint32_t column_family_id,
                     const SliceParts& key, const SliceParts& value);
 
+  static Status PutPinned(WriteBatch* batch, uint32_t column_family_id,
+                          const Slice& key, const Slice& value);
+
   static Status Delete(WriteBatch* batch, uint32_t column_family_id,
                        const SliceParts& key);
 
@@ -135,12 +138,35 @@ class WriteBatchInternal {
     return Slice(batch->rep_);
   }
 
+  // Includes the values added with PutPinned(), which Contents() only refers
+  // to.
   static size_t ByteSize(const WriteBatch* batch) {
-    return batch->rep_.size();
+    return batch->rep_.size() + batch->pinned_value_bytes_;
+  }
+
+  static bool HasPinnedValues(const WriteBatch* batch) {
+    return batch->pinned_records_ > 0;
   }
 
+  // Sets *parts to the slices that, concatenated, form the serialized batch
+  // as it is written to the WAL: Contents() with every pinned value spliced
+  // in place of its reference. The slices point into the batch and into the
+  // caller-owned values, so they are only valid while both are unchanged.
+  // Returns the total size of the slices.
+  static size_t GetContentsParts(const WriteBatch* batch,
+                                 std::vector<Slice>* parts);
+
+  // Contents() with the pinned values copied in, see GetContentsParts().
+  static void GetMaterializedContents(const WriteBatch* batch,
+                                      std::string* contents);
+
   static Status SetContents(WriteBatch* batch, const Slice& contents);
 
+  // Parses every record of the batch, computing its content flags on the way
+  // like WriteBatch::HasPut() and friends do, and returns a Corruption if
+  // the batch is malformed.
+  static Status CheckContents(const WriteBatch* batch);
+
   static Status CheckSlicePartsLength(const SliceParts& key,
                                       const SliceParts& value);
 
@@ -191,6 +217,33 @@ class WriteBatchInternal {
                            bool batch_per_txn = true,
                            bool hint_per_batch = false);
 
+  // A range of records of a batch, and the offset from the sequence number of
+  // the batch to the one of its first record.
+  struct Range {
+    size_t begin;
+    size_t end;
+    SequenceNumber sequence_offset;
+  };
+
+  // Splits the records of the batch into at most max_ranges ranges of about
+  // the same size that can be inserted into the memtables concurrently.
+  // Returns false, leaving *ranges unspecified, if the batch holds records
+  // whose effect depends on the order of insertion, i.e. merges and
+  // transaction markers.
+  static bool SplitForParallelInsert(const WriteBatch* batch,
+                                     size_t max_ranges,
+                                     std::vector<Range>* ranges);
+
+  // Inserts a range of the batch of writer, as returned by
+  // SplitForParallelInsert(), into the memtables with concurrent memtable
+  // writes. sequence is the sequence number of the batch.
+  static Status InsertInto(WriteThread::Writer* writer, const Range& range,
+                           SequenceNumber sequence,
+                           ColumnFamilyMemTables* memtables,
+                           FlushScheduler* flush_scheduler,
+                           TrimHistoryScheduler* trim_history_scheduler,
+                           bool ignore_missing_column_families, DB* db);
+
   static Status Append(WriteBatch* dst, const WriteBatch* src,
                        const bool WAL_only = false);
 
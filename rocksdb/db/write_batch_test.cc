@@ -603,6 +603,99 @@ TEST_F(WriteBatchTest, PutGatherSlices) {
   ASSERT_EQ(3u, batch.Count());
 }
 
+TEST_F(WriteBatchTest, PutPinned) {
+  std::string value1 = "pinned1";
+  std::string value2(1000, 'x');
+  WriteBatch batch;
+  batch.Put("a", "va");
+  ASSERT_OK(batch.PutPinned("b", value1));
+  batch.Delete("c");
+  ASSERT_OK(batch.PutPinned("d", value2));
+  // Only the key is copied
+  ASSERT_LT(batch.GetDataSize(), value2.size());
+  ASSERT_EQ(batch.GetDataSize() + value1.size() + value2.size(),
+            WriteBatchInternal::ByteSize(&batch));
+
+  // The serialized form is that of plain Puts
+  WriteBatch expected;
+  expected.Put("a", "va");
+  expected.Put("b", value1);
+  expected.Delete("c");
+  expected.Put("d", value2);
+  std::string contents;
+  WriteBatchInternal::GetMaterializedContents(&batch, &contents);
+  ASSERT_EQ(expected.Data(), contents);
+
+  // The values are referenced, not copied
+  value1[0] = 'P';
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ("Put(a, va)@100"
+            "Put(b, Pinned1)@101"
+            "Delete(c)@102"
+            "Put(d, " + value2 + ")@103",
+            PrintContents(&batch));
+  ASSERT_EQ(4u, batch.Count());
+
+  // A pinned record read back from a file is corruption
+  WriteBatch copy;
+  WriteBatchInternal::SetContents(&copy, batch.Data());
+  ASSERT_NE(std::string::npos, PrintContents(&copy).find("Corruption"));
+
+  WriteBatch b2;
+  WriteBatchInternal::Append(&b2, &batch);
+  ASSERT_EQ(WriteBatchInternal::ByteSize(&batch),
+            WriteBatchInternal::ByteSize(&b2));
+  b2.MarkWalTerminationPoint();
+  b2.Put("e", "ve");
+  WriteBatch b3;
+  WriteBatchInternal::Append(&b3, &b2, /*wal only*/ true);
+  ASSERT_EQ(WriteBatchInternal::ByteSize(&batch),
+            WriteBatchInternal::ByteSize(&b3));
+
+  batch.SetSavePoint();
+  ASSERT_OK(batch.PutPinned("f", value1));
+  ASSERT_OK(batch.RollbackToSavePoint());
+  value1[0] = 'p';
+  WriteBatchInternal::GetMaterializedContents(&batch, &contents);
+  WriteBatchInternal::SetSequence(&expected, 100);
+  ASSERT_EQ(expected.Data(), contents);
+
+  batch.Clear();
+  ASSERT_EQ(batch.GetDataSize(), WriteBatchInternal::ByteSize(&batch));
+}
+
+TEST_F(WriteBatchTest, PutPinnedEmptyValue) {
+  std::string value;
+  WriteBatch batch;
+  ASSERT_OK(batch.PutPinned("a", value));
+  ASSERT_TRUE(WriteBatchInternal::HasPinnedValues(&batch));
+  ASSERT_OK(batch.Put("b", "vb"));
+  ASSERT_OK(batch.PutPinned("c", value));
+
+  WriteBatch expected;
+  ASSERT_OK(expected.Put("a", ""));
+  ASSERT_OK(expected.Put("b", "vb"));
+  ASSERT_OK(expected.Put("c", ""));
+  std::vector<Slice> parts;
+  ASSERT_EQ(expected.GetDataSize(),
+            WriteBatchInternal::GetContentsParts(&batch, &parts));
+  std::string contents;
+  WriteBatchInternal::GetMaterializedContents(&batch, &contents);
+  ASSERT_EQ(expected.Data(), contents);
+
+  WriteBatchInternal::SetSequence(&batch, 100);
+  ASSERT_EQ("Put(a, )@100"
+            "Put(b, vb)@101"
+            "Put(c, )@102",
+            PrintContents(&batch));
+
+  WriteBatch b2;
+  ASSERT_OK(WriteBatchInternal::Append(&b2, &batch));
+  ASSERT_TRUE(WriteBatchInternal::HasPinnedValues(&b2));
+  WriteBatchInternal::GetMaterializedContents(&b2, &contents);
+  ASSERT_EQ(expected.Data(), contents);
+}
+
 namespace {
 class ColumnFamilyHandleImplDummy : public ColumnFamilyHandleImpl {
  public:
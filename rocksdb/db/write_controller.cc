@@ -27,6 +27,18 @@ std::unique_ptr<WriteControllerToken> WriteController::GetDelayToken(
   return std::unique_ptr<WriteControllerToken>(new DelayWriteToken(this));
 }
 
+std::unique_ptr<WriteControllerToken> WriteController::GetFeedbackDelayToken(
+    uint64_t write_rate) {
+  total_delayed_++;
+  // Reset counters.
+  last_refill_time_ = 0;
+  bytes_left_ = 0;
+  feedback_write_rates_.insert(write_rate);
+  set_delayed_write_rate(*feedback_write_rates_.begin());
+  return std::unique_ptr<WriteControllerToken>(
+      new FeedbackDelayToken(this, write_rate));
+}
+
 std::unique_ptr<WriteControllerToken>
 WriteController::GetCompactionPressureToken() {
   ++total_compaction_pressure_;
@@ -120,6 +132,16 @@ DelayWriteToken::~DelayWriteToken() {
   assert(controller_->total_delayed_.load() >= 0);
 }
 
+FeedbackDelayToken::~FeedbackDelayToken() {
+  auto& rates = controller_->feedback_write_rates_;
+  auto it = rates.find(write_rate_);
+  assert(it != rates.end());
+  rates.erase(it);
+  if (!rates.empty()) {
+    controller_->set_delayed_write_rate(*rates.begin());
+  }
+}
+
 CompactionPressureToken::~CompactionPressureToken() {
   controller_->total_compaction_pressure_--;
   assert(controller_->total_compaction_pressure_ >= 0);
@@ -9,6 +9,7 @@
 
 #include <atomic>
 #include <memory>
+#include <set>
 #include "rocksdb/rate_limiter.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -44,6 +45,11 @@ class WriteController {
   // which returns number of microseconds to sleep.
   std::unique_ptr<WriteControllerToken> GetDelayToken(
       uint64_t delayed_write_rate);
+  // Like GetDelayToken(), but for the column families that pick their own
+  // rate with feedback_write_rate_control: while such tokens are held, the
+  // delayed write rate is the lowest of their rates.
+  std::unique_ptr<WriteControllerToken> GetFeedbackDelayToken(
+      uint64_t delayed_write_rate);
   // When an actor (column family) requests a moderate token, compaction
   // threads will be increased
   std::unique_ptr<WriteControllerToken> GetCompactionPressureToken();
@@ -90,6 +96,7 @@ class WriteController {
   friend class WriteControllerToken;
   friend class StopWriteToken;
   friend class DelayWriteToken;
+  friend class FeedbackDelayToken;
   friend class CompactionPressureToken;
 
   std::atomic<int> total_stopped_;
@@ -101,6 +108,8 @@ class WriteController {
   uint64_t max_delayed_write_rate_;
   // current write rate
   uint64_t delayed_write_rate_;
+  // The rates of the FeedbackDelayTokens held
+  std::multiset<uint64_t> feedback_write_rates_;
 
   std::unique_ptr<RateLimiter> low_pri_rate_limiter_;
 };
@@ -134,6 +143,16 @@ class DelayWriteToken : public WriteControllerToken {
   virtual ~DelayWriteToken();
 };
 
+class FeedbackDelayToken : public DelayWriteToken {
+ public:
+  FeedbackDelayToken(WriteController* controller, uint64_t write_rate)
+      : DelayWriteToken(controller), write_rate_(write_rate) {}
+  virtual ~FeedbackDelayToken();
+
+ private:
+  const uint64_t write_rate_;
+};
+
 class CompactionPressureToken : public WriteControllerToken {
  public:
   explicit CompactionPressureToken(WriteController* controller)
@@ -4,10 +4,12 @@
 //  (found in the LICENSE.Apache file in the root directory).
 
 #include "db/write_thread.h"
+#include <algorithm>
 #include <chrono>
 #include <thread>
 #include "db/column_family.h"
 #include "monitoring/perf_context_imp.h"
+#include "monitoring/statistics.h"
 #include "port/port.h"
 #include "test_util/sync_point.h"
 #include "util/random.h"
@@ -24,6 +26,13 @@ WriteThread::WriteThread(const ImmutableDBOptions& db_options)
       enable_pipelined_write_(db_options.enable_pipelined_write),
       max_write_batch_group_size_bytes(
           db_options.max_write_batch_group_size_bytes),
+      max_sync_delay_usec_(db_options.max_write_group_sync_delay_usec),
+      stats_(db_options.statistics.get()),
+      sync_latency_usec_(0),
+      sync_arrival_interval_nanos_(0),
+      last_sync_arrival_nanos_(0),
+      sync_arrivals_(0),
+      sync_delay_waiters_(0),
       newest_writer_(nullptr),
       newest_memtable_writer_(nullptr),
       last_sequence_(0),
@@ -208,6 +217,17 @@ uint8_t WriteThread::AwaitState(Writer* w, uint8_t goal_mask,
 }
 
 void WriteThread::SetState(Writer* w, uint8_t new_state) {
+  if (w->async_handler != nullptr) {
+    // Nobody is waiting on the state of w
+    assert(new_state == STATE_GROUP_LEADER || new_state == STATE_COMPLETED);
+    w->state.store(new_state, std::memory_order_release);
+    if (new_state == STATE_GROUP_LEADER) {
+      w->async_handler->BecomeLeader(w);
+    } else {
+      w->async_handler->Complete(w);
+    }
+    return;
+  }
   auto state = w->state.load(std::memory_order_acquire);
   if (state == STATE_LOCKED_WAITING ||
       !w->state.compare_exchange_strong(state, new_state)) {
@@ -374,7 +394,10 @@ void WriteThread::JoinBatchGroup(Writer* w) {
   TEST_SYNC_POINT_CALLBACK("WriteThread::JoinBatchGroup:Start", w);
   assert(w->batch != nullptr);
 
+  const bool sync = w->sync;
   bool linked_as_leader = LinkOne(w, &newest_writer_);
+  // Once linked, so that a leader woken up for w can add it to its group
+  RecordSyncArrival(sync);
 
   if (linked_as_leader) {
     SetState(w, STATE_GROUP_LEADER);
@@ -404,12 +427,123 @@ void WriteThread::JoinBatchGroup(Writer* w) {
   }
 }
 
+void WriteThread::JoinBatchGroupAsync(Writer* w) {
+  assert(w->batch != nullptr);
+  assert(w->async_handler != nullptr);
+
+  // w may be completed and freed once linked
+  const bool sync = w->sync;
+  bool linked_as_leader = LinkOne(w, &newest_writer_);
+  RecordSyncArrival(sync);
+
+  if (linked_as_leader) {
+    SetState(w, STATE_GROUP_LEADER);
+  }
+  // else w may have been completed already
+}
+
+namespace {
+uint64_t SteadyNowNanos() {
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now().time_since_epoch())
+          .count());
+}
+
+// Moves the average 1/8 of the way to sample. Updates racing with each other
+// may lose samples, which is fine for an estimate.
+void UpdateMovingAverage(std::atomic<uint64_t>* avg, uint64_t sample) {
+  uint64_t old_avg = avg->load(std::memory_order_relaxed);
+  uint64_t new_avg =
+      old_avg == 0 ? sample : old_avg - old_avg / 8 + sample / 8;
+  avg->store(new_avg, std::memory_order_relaxed);
+}
+}  // namespace
+
+void WriteThread::RecordSyncLatency(uint64_t micros) {
+  if (max_sync_delay_usec_ > 0) {
+    UpdateMovingAverage(&sync_latency_usec_, std::max<uint64_t>(micros, 1));
+  }
+}
+
+void WriteThread::RecordSyncArrival(bool sync) {
+  if (max_sync_delay_usec_ == 0 || !sync) {
+    return;
+  }
+  uint64_t now = SteadyNowNanos();
+  uint64_t prev =
+      last_sync_arrival_nanos_.exchange(now, std::memory_order_relaxed);
+  sync_arrivals_.fetch_add(1);
+  if (prev != 0 && now > prev) {
+    UpdateMovingAverage(&sync_arrival_interval_nanos_, now - prev);
+  }
+  if (sync_delay_waiters_.load() > 0) {
+    // Taking the mutex orders the wakeup after the leader's last check
+    { std::lock_guard<std::mutex> guard(sync_arrival_mu_); }
+    sync_arrival_cv_.notify_all();
+  }
+}
+
+uint64_t WriteThread::SyncDelayUsec(uint64_t* interval_nanos) const {
+  uint64_t latency_usec = sync_latency_usec_.load(std::memory_order_relaxed);
+  *interval_nanos = sync_arrival_interval_nanos_.load(std::memory_order_relaxed);
+  if (latency_usec == 0 || *interval_nanos == 0) {
+    return 0;
+  }
+  // Waiting for more than half a sync would add more latency to the writers
+  // already in the group than sharing the sync saves the newcomers.
+  uint64_t delay_usec = std::min(max_sync_delay_usec_, latency_usec / 2);
+  // At low load no other sync writer is expected before the delay is over,
+  // and the leader syncs right away.
+  if (*interval_nanos > delay_usec * 1000) {
+    return 0;
+  }
+  return delay_usec;
+}
+
+void WriteThread::DelayForSyncWriters() {
+  uint64_t interval_nanos;
+  uint64_t delay_usec = SyncDelayUsec(&interval_nanos);
+  if (delay_usec == 0) {
+    return;
+  }
+  TEST_SYNC_POINT_CALLBACK("WriteThread::DelayForSyncWriters:Delay",
+                           &delay_usec);
+  // Stop early once the writers expected in that time have arrived.
+  const uint64_t expected = std::max<uint64_t>(
+      delay_usec * 1000 / std::max<uint64_t>(interval_nanos, 1), 1);
+  sync_delay_waiters_.fetch_add(1);
+  const uint64_t arrivals = sync_arrivals_.load();
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t joined = 0;
+  {
+    std::unique_lock<std::mutex> guard(sync_arrival_mu_);
+    sync_arrival_cv_.wait_until(
+        guard, start + std::chrono::microseconds(delay_usec), [&] {
+          joined = sync_arrivals_.load() - arrivals;
+          return joined >= expected;
+        });
+  }
+  sync_delay_waiters_.fetch_sub(1);
+  const uint64_t waited_nanos = static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(
+          std::chrono::steady_clock::now() - start)
+          .count());
+  RecordTick(stats_, WRITE_GROUP_SYNC_DELAYED);
+  RecordTick(stats_, WRITE_GROUP_SYNC_DELAY_MICROS, waited_nanos / 1000);
+  RecordTick(stats_, WRITE_GROUP_SYNC_DELAY_WRITERS, joined);
+}
+
 size_t WriteThread::EnterAsBatchGroupLeader(Writer* leader,
                                             WriteGroup* write_group) {
   assert(leader->link_older == nullptr);
   assert(leader->batch != nullptr);
   assert(write_group != nullptr);
 
+  if (leader->sync && max_sync_delay_usec_ > 0) {
+    DelayForSyncWriters();
+  }
+
   size_t size = WriteBatchInternal::ByteSize(leader->batch);
 
   // Allow the group to grow up to a maximum size, but if the
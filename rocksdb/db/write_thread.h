@@ -74,10 +74,30 @@ class WriteThread {
 
   struct Writer;
 
+  // Takes over the writers that no thread waits on, see
+  // Writer::async_handler. The methods are called wherever the state of the
+  // writer changes, which may be under the DB mutex or while a leader exits
+  // its group, so they must only hand the writer over to another thread.
+  class AsyncHandler {
+   public:
+    virtual ~AsyncHandler() {}
+
+    // w has become the leader of a write group. Before doing the leader's
+    // work on another thread, its async_handler must be cleared.
+    virtual void BecomeLeader(Writer* w) = 0;
+
+    // w has been completed by the leader of its write group, and is not
+    // accessed by the write thread any more.
+    virtual void Complete(Writer* w) = 0;
+  };
+
   struct WriteGroup {
     Writer* leader = nullptr;
     Writer* last_writer = nullptr;
     SequenceNumber last_sequence;
+    // With write_queue_shards > 1, the last sequence number allocated before
+    // the group's, see DBImpl::ExitWriteQueueShardGroup()
+    SequenceNumber prev_sequence;
     // before running goes to zero, status needs leader->StateMutex()
     Status status;
     std::atomic<size_t> running;
@@ -134,6 +154,11 @@ class WriteThread {
     std::aligned_storage<sizeof(std::condition_variable)>::type state_cv_bytes;
     Writer* link_older;  // read/write only before linking, or as leader
     Writer* link_newer;  // lazy, read/write only before linking, or as leader
+    // Set for the writers of DB::WriteAsync(), which join with
+    // JoinBatchGroupAsync(). State changes are handed to it instead of
+    // waking up a waiting thread. Such a writer is never made a parallel
+    // memtable writer.
+    AsyncHandler* async_handler;
 
     Writer()
         : batch(nullptr),
@@ -151,7 +176,8 @@ class WriteThread {
           write_group(nullptr),
           sequence(kMaxSequenceNumber),
           link_older(nullptr),
-          link_newer(nullptr) {}
+          link_newer(nullptr),
+          async_handler(nullptr) {}
 
     Writer(const WriteOptions& write_options, WriteBatch* _batch,
            WriteCallback* _callback, uint64_t _log_ref, bool _disable_memtable,
@@ -172,7 +198,8 @@ class WriteThread {
           write_group(nullptr),
           sequence(kMaxSequenceNumber),
           link_older(nullptr),
-          link_newer(nullptr) {}
+          link_newer(nullptr),
+          async_handler(nullptr) {}
 
     ~Writer() {
       if (made_waitable) {
@@ -278,6 +305,12 @@ class WriteThread {
   // Writer* w:        Writer to be executed as part of a batch group
   void JoinBatchGroup(Writer* w);
 
+  // Registers w, whose async_handler is set, as ready to become part of a
+  // batch group without waiting for it. The handler is told when w becomes
+  // the leader of a write group or is completed, which may happen before
+  // this returns. Only blocks during a write stall, unless w->no_slowdown.
+  void JoinBatchGroupAsync(Writer* w);
+
   // Constructs a write batch group led by leader, which should be a
   // Writer passed to JoinBatchGroup on the current thread.
   //
@@ -351,6 +384,10 @@ class WriteThread {
   // Remove the dummy writer and wake up waiting writers
   void EndWriteStall();
 
+  // Feeds the latency of a WAL sync done for a write group into the
+  // estimate that sizes the delay of the leaders of sync write groups.
+  void RecordSyncLatency(uint64_t micros);
+
  private:
   // See AwaitState.
   const uint64_t max_yield_usec_;
@@ -367,6 +404,28 @@ class WriteThread {
   // is larger than 1/8 of this limit.
   const uint64_t max_write_batch_group_size_bytes;
 
+  // The upper bound of the delay of the leader of a group of sync writes,
+  // see DBOptions::max_write_group_sync_delay_usec. 0 if disabled.
+  const uint64_t max_sync_delay_usec_;
+
+  Statistics* const stats_;
+
+  // Moving averages of the latency of WAL syncs, and of the time between the
+  // arrivals of two sync writers. 0 until measured.
+  std::atomic<uint64_t> sync_latency_usec_;
+  std::atomic<uint64_t> sync_arrival_interval_nanos_;
+
+  // Arrival time of the newest sync writer, and number of sync writers that
+  // have arrived so far.
+  std::atomic<uint64_t> last_sync_arrival_nanos_;
+  std::atomic<uint64_t> sync_arrivals_;
+
+  // A leader delaying its sync waits on sync_arrival_cv_, which is signalled
+  // by sync writers arriving while sync_delay_waiters_ is not 0.
+  std::atomic<int> sync_delay_waiters_;
+  std::mutex sync_arrival_mu_;
+  std::condition_variable sync_arrival_cv_;
+
   // Points to the newest pending writer. Only leader can remove
   // elements, adding can be done lock-free by anybody.
   std::atomic<Writer*> newest_writer_;
@@ -403,6 +462,20 @@ class WriteThread {
   // Set writer state and wake the writer up if it is waiting.
   void SetState(Writer* w, uint8_t new_state);
 
+  // Updates the arrival estimates for a newly linked sync writer, and wakes
+  // up a leader delaying for it.
+  void RecordSyncArrival(bool sync);
+
+  // Returns how long the leader of a group of sync writes should wait for
+  // more sync writers, or 0 if it should not wait. Sets *interval_nanos to
+  // the expected time between two arrivals.
+  uint64_t SyncDelayUsec(uint64_t* interval_nanos) const;
+
+  // Lets the leader of a group of sync writes wait, up to SyncDelayUsec(),
+  // for the sync writers expected to arrive in that time, so that they share
+  // the WAL sync of its group.
+  void DelayForSyncWriters();
+
   // Links w into the newest_writer list. Return true if w was linked directly
   // into the leader position.  Safe to call from multiple threads without
   // external locking.
@@ -1997,7 +1997,8 @@ void StressTest::Open() {
       options_.memtable_factory.reset(NewHashSkipListRepFactory(10000));
       break;
     case kVectorRep:
-      options_.memtable_factory.reset(new VectorRepFactory());
+      options_.memtable_factory.reset(
+          new VectorRepFactory(0, 16384, db_stress_env));
       break;
 #else
     default:
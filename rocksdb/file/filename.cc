@@ -239,6 +239,14 @@ std::string IdentityFileName(const std::string& dbname) {
   return dbname + "/IDENTITY";
 }
 
+std::string BlockCacheKeysFileName(const std::string& dbname) {
+  return dbname + "/BLOCK_CACHE_KEYS";
+}
+
+std::string TempBlockCacheKeysFileName(const std::string& dbname) {
+  return BlockCacheKeysFileName(dbname) + "." + kTempFileNameSuffix;
+}
+
 // Owned filenames have the form:
 //    dbname/IDENTITY
 //    dbname/CURRENT
@@ -158,6 +158,14 @@ extern std::string MetaDatabaseName(const std::string& dbname,
 // either from a backup-image or empty
 extern std::string IdentityFileName(const std::string& dbname);
 
+// Return the name of the file that lists the blocks in the block cache, see
+// DBOptions::block_cache_dump_period_sec
+extern std::string BlockCacheKeysFileName(const std::string& dbname);
+
+// Return the name of the file that a new block cache keys file is written to
+// before it replaces the old one
+extern std::string TempBlockCacheKeysFileName(const std::string& dbname);
+
 // If filename is a rocksdb file, store the type of the file in *type.
 // The number encoded in the filename is stored in *number.  If the
 // filename was successfully parsed, returns true.  Else return false.
@@ -10,6 +10,7 @@
 #include "file/writable_file_writer.h"
 
 #include <algorithm>
+#include <condition_variable>
 #include <mutex>
 
 #include "db/version_edit.h"
@@ -77,7 +78,17 @@ IOStatus WritableFileWriter::Append(const Slice& data) {
       src += appended;
 
       if (left > 0) {
+#ifndef ROCKSDB_LITE
+        if (use_direct_io() && is_wal_ && env_ != nullptr) {
+          // The buffer is full, write it while the rest of data fills the
+          // other one.
+          s = WriteDirectInBackground();
+        } else {
+          s = Flush();
+        }
+#else
         s = Flush();
+#endif  // !ROCKSDB_LITE
         if (!s.ok()) {
           break;
         }
@@ -215,6 +226,15 @@ IOStatus WritableFileWriter::Flush() {
   TEST_KILL_RANDOM("WritableFileWriter::Flush:0",
                    rocksdb_kill_odds * REDUCE_ODDS2);
 
+#ifndef ROCKSDB_LITE
+  if (background_write_ != nullptr) {
+    s = WaitForBackgroundWrite();
+    if (!s.ok()) {
+      return s;
+    }
+  }
+#endif  // !ROCKSDB_LITE
+
   if (buf_.CurrentSize() > 0) {
     if (use_direct_io()) {
 #ifndef ROCKSDB_LITE
@@ -303,7 +323,9 @@ IOStatus WritableFileWriter::Sync(bool use_fsync) {
     return s;
   }
   TEST_KILL_RANDOM("WritableFileWriter::Sync:0", rocksdb_kill_odds);
-  if (!use_direct_io() && pending_sync_) {
+  // Direct writes bypass the OS cache, but the size and the device cache of
+  // a WAL, which is synced as it grows, still need the sync.
+  if ((!use_direct_io() || is_wal_) && pending_sync_) {
     s = SyncInternal(use_fsync);
     if (!s.ok()) {
       return s;
@@ -464,15 +486,36 @@ IOStatus WritableFileWriter::WriteDirect() {
   // Round up and pad
   buf_.PadToAlignmentWith(0);
 
-  const char* src = buf_.BufferStart();
-  uint64_t write_offset = next_write_offset_;
-  size_t left = buf_.CurrentSize();
+  s = WriteDirectAt(buf_.BufferStart(), buf_.CurrentSize(),
+                    next_write_offset_);
+  if (!s.ok()) {
+    buf_.Size(file_advance + leftover_tail);
+    return s;
+  }
+
+  // Move the tail to the beginning of the buffer
+  // This never happens during normal Append but rather during
+  // explicit call to Flush()/Sync() or Close()
+  buf_.RefitTail(file_advance, leftover_tail);
+  // This is where we start writing next time which may or not be
+  // the actual file size on disk. They match if the buffer size
+  // is a multiple of whole pages otherwise filesize_ is leftover_tail
+  // behind
+  next_write_offset_ += file_advance;
+  return s;
+}
 
+IOStatus WritableFileWriter::WriteDirectAt(const char* src, size_t left,
+                                           uint64_t write_offset) {
+  IOStatus s;
+  const size_t alignment = buf_.Alignment();
+  assert((write_offset % alignment) == 0);
+  assert((left % alignment) == 0);
   while (left > 0) {
     // Check how much is allowed
     size_t size;
     if (rate_limiter_ != nullptr) {
-      size = rate_limiter_->RequestToken(left, buf_.Alignment(),
+      size = rate_limiter_->RequestToken(left, alignment,
                                          writable_file_->GetIOPriority(),
                                          stats_, RateLimiter::OpType::kWrite);
     } else {
@@ -494,7 +537,6 @@ IOStatus WritableFileWriter::WriteDirect() {
         NotifyOnFileWriteFinish(write_offset, size, start_ts, finish_ts, s);
       }
       if (!s.ok()) {
-        buf_.Size(file_advance + leftover_tail);
         return s;
       }
     }
@@ -503,21 +545,112 @@ IOStatus WritableFileWriter::WriteDirect() {
     left -= size;
     src += size;
     write_offset += size;
-    assert((next_write_offset_ % alignment) == 0);
   }
 
-  if (s.ok()) {
-    // Move the tail to the beginning of the buffer
-    // This never happens during normal Append but rather during
-    // explicit call to Flush()/Sync() or Close()
-    buf_.RefitTail(file_advance, leftover_tail);
-    // This is where we start writing next time which may or not be
-    // the actual file size on disk. They match if the buffer size
-    // is a multiple of whole pages otherwise filesize_ is leftover_tail
-    // behind
-    next_write_offset_ += file_advance;
+  return s;
+}
+
+struct WritableFileWriter::BackgroundWrite {
+  std::mutex mu;
+  std::condition_variable cv;
+  // Set while a write of spare_buf_ is pending. The writer waits for it
+  // before going away, so it stays valid as long as requested is set.
+  WritableFileWriter* writer = nullptr;
+  bool requested = false;
+  bool running = false;
+  uint64_t offset = 0;
+  size_t size = 0;
+  IOStatus status;
+
+  // Does the requested write unless another thread is doing it.
+  // REQUIRES: *lock holds mu
+  void Run(std::unique_lock<std::mutex>* lock) {
+    if (!requested || running) {
+      return;
+    }
+    running = true;
+    lock->unlock();
+    // spare_buf_ is not touched by the writer until the request is done.
+    IOStatus s =
+        writer->WriteDirectAt(writer->spare_buf_.BufferStart(), size, offset);
+    lock->lock();
+    status = s;
+    requested = false;
+    running = false;
+    cv.notify_all();
   }
+};
+
+IOStatus WritableFileWriter::WriteDirectInBackground() {
+  assert(use_direct_io());
+  TEST_SYNC_POINT_CALLBACK("WritableFileWriter::WriteDirectInBackground",
+                           &file_name_);
+  IOStatus s = WaitForBackgroundWrite();
+  if (!s.ok()) {
+    return s;
+  }
+  const size_t alignment = buf_.Alignment();
+  assert((next_write_offset_ % alignment) == 0);
+  size_t file_advance = TruncateToPageBoundary(alignment, buf_.CurrentSize());
+  size_t leftover_tail = buf_.CurrentSize() - file_advance;
+  if (file_advance == 0) {
+    return WriteDirect();
+  }
+
+  // Keep filling the spare buffer, starting with the leftover tail, while
+  // the whole pages of this one are written.
+  if (spare_buf_.Capacity() != buf_.Capacity()) {
+    spare_buf_.Alignment(alignment);
+    spare_buf_.AllocateNewBuffer(buf_.Capacity());
+  }
+  spare_buf_.Size(0);
+  spare_buf_.Append(buf_.BufferStart() + file_advance, leftover_tail);
+  std::swap(buf_, spare_buf_);
+
+  if (background_write_ == nullptr) {
+    background_write_ = std::make_shared<BackgroundWrite>();
+  }
+  {
+    std::lock_guard<std::mutex> lock(background_write_->mu);
+    background_write_->writer = this;
+    background_write_->offset = next_write_offset_;
+    background_write_->size = file_advance;
+    background_write_->requested = true;
+  }
+  // The job may run after this writer is gone, when a Flush() did the write
+  // first, so it only holds on to the shared state. The flush pool is used
+  // since the WAL write must not queue up behind compactions; Flush() does
+  // the write itself if no thread has got to it.
+  env_->Schedule(&WritableFileWriter::BGWorkWrite,
+                 new std::shared_ptr<BackgroundWrite>(background_write_),
+                 Env::Priority::HIGH, nullptr,
+                 &WritableFileWriter::UnscheduleWrite);
+  next_write_offset_ += file_advance;
   return s;
 }
+
+IOStatus WritableFileWriter::WaitForBackgroundWrite() {
+  if (background_write_ == nullptr) {
+    return IOStatus::OK();
+  }
+  std::unique_lock<std::mutex> lock(background_write_->mu);
+  background_write_->Run(&lock);
+  background_write_->cv.wait(lock,
+                             [this] { return !background_write_->requested; });
+  IOStatus s = background_write_->status;
+  background_write_->status = IOStatus::OK();
+  return s;
+}
+
+void WritableFileWriter::BGWorkWrite(void* arg) {
+  std::unique_ptr<std::shared_ptr<BackgroundWrite>> background_write(
+      static_cast<std::shared_ptr<BackgroundWrite>*>(arg));
+  std::unique_lock<std::mutex> lock((*background_write)->mu);
+  (*background_write)->Run(&lock);
+}
+
+void WritableFileWriter::UnscheduleWrite(void* arg) {
+  delete static_cast<std::shared_ptr<BackgroundWrite>*>(arg);
+}
 #endif  // !ROCKSDB_LITE
 }  // namespace ROCKSDB_NAMESPACE
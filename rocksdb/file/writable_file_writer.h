@@ -130,7 +130,16 @@ class WritableFileWriter {
   // and writes must happen on aligned offsets
   // so we need to go back and write that page again
   uint64_t next_write_offset_;
+  // Direct writes of a WAL are double buffered: when buf_ is full in the
+  // middle of an Append(), the buffers are swapped and a job on env_'s
+  // thread pool writes the whole pages of spare_buf_ while buf_ fills.
+  // Flush() waits for it.
+  struct BackgroundWrite;
+  AlignedBuffer spare_buf_;
+  std::shared_ptr<BackgroundWrite> background_write_;
 #endif  // ROCKSDB_LITE
+  // Set for the files of a WAL, see the constructor
+  const bool is_wal_;
   bool pending_sync_;
   uint64_t last_sync_size_;
   uint64_t bytes_per_sync_;
@@ -141,12 +150,16 @@ class WritableFileWriter {
   bool checksum_finalized_;
 
  public:
+  // is_wal: the file is a WAL. Its direct writes are double buffered, and
+  // Sync() syncs it even with direct writes, see
+  // DBOptions::use_direct_io_for_wal.
   WritableFileWriter(
       std::unique_ptr<FSWritableFile>&& file, const std::string& _file_name,
       const FileOptions& options, Env* env = nullptr,
       Statistics* stats = nullptr,
       const std::vector<std::shared_ptr<EventListener>>& listeners = {},
-      FileChecksumGenFactory* file_checksum_gen_factory = nullptr)
+      FileChecksumGenFactory* file_checksum_gen_factory = nullptr,
+      bool is_wal = false)
       : writable_file_(std::move(file)),
         file_name_(_file_name),
         env_(env),
@@ -156,6 +169,7 @@ class WritableFileWriter {
 #ifndef ROCKSDB_LITE
         next_write_offset_(0),
 #endif  // ROCKSDB_LITE
+        is_wal_(is_wal),
         pending_sync_(false),
         last_sync_size_(0),
         bytes_per_sync_(options.bytes_per_sync),
@@ -167,7 +181,11 @@ class WritableFileWriter {
     TEST_SYNC_POINT_CALLBACK("WritableFileWriter::WritableFileWriter:0",
                              reinterpret_cast<void*>(max_buffer_size_));
     buf_.Alignment(writable_file_->GetRequiredBufferAlignment());
-    buf_.AllocateNewBuffer(std::min((size_t)65536, max_buffer_size_));
+    // Direct writes of a WAL end up using the whole buffer anyway, allocate
+    // it up front rather than growing it while appending.
+    buf_.AllocateNewBuffer(is_wal_ && writable_file_->use_direct_io()
+                               ? max_buffer_size_
+                               : std::min((size_t)65536, max_buffer_size_));
 #ifndef ROCKSDB_LITE
     std::for_each(listeners.begin(), listeners.end(),
                   [this](const std::shared_ptr<EventListener>& e) {
@@ -239,6 +257,16 @@ class WritableFileWriter {
   // DMA such as in Direct I/O mode
 #ifndef ROCKSDB_LITE
   IOStatus WriteDirect();
+  // Writes size bytes, a multiple of the alignment, at offset.
+  IOStatus WriteDirectAt(const char* src, size_t size, uint64_t offset);
+  // Schedules the write of the whole pages of the full buf_ on env_'s thread
+  // pool, and continues with the spare buffer.
+  IOStatus WriteDirectInBackground();
+  // Waits for the pending background write, doing it on this thread if no
+  // thread of the pool has started it yet, and returns its status.
+  IOStatus WaitForBackgroundWrite();
+  static void BGWorkWrite(void* arg);
+  static void UnscheduleWrite(void* arg);
 #endif  // !ROCKSDB_LITE
   // Normal write
   IOStatus WriteBuffered(const char* data, size_t size);
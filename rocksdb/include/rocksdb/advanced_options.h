@@ -304,15 +304,34 @@ struct AdvancedColumnFamilyOptions {
   // Dynamically changeable through SetOptions() API
   double memtable_prefix_bloom_size_ratio = 0.0;
 
-  // Enable whole key bloom filter in memtable. Note this will only take effect
-  // if memtable_prefix_bloom_size_ratio is not 0. Enabling whole key filtering
-  // can potentially reduce CPU usage for point-look-ups.
+  // Enable whole key bloom filter in memtable. It does not need a
+  // prefix_extractor and works with every memtable representation. If
+  // memtable_prefix_bloom_size_ratio is 0, the filter is sized as if it were
+  // 0.02 (about 10 bits per 64 bytes of write buffer). Each lookup touches a
+  // single cache line of the filter, so enabling whole key filtering can
+  // potentially reduce CPU usage for point-look-ups, especially misses that
+  // would otherwise search several immutable memtables.
   //
   // Default: false (disable)
   //
   // Dynamically changeable through SetOptions() API
   bool memtable_whole_key_filtering = false;
 
+  // If true, an immutable memtable that is waiting to be flushed is replaced,
+  // in the background, by a compacted copy: versions of a key that no live
+  // snapshot can see are dropped and merge operands are combined, the same
+  // way a flush would. This reduces the memory held by memtables and the size
+  // of the flushes when the same keys are overwritten many times. Memtables
+  // only wait for a flush while there are fewer than
+  // min_write_buffer_number_to_merge of them, so this needs
+  // min_write_buffer_number_to_merge > 1 to have an effect. While it runs,
+  // the compaction needs memory for a second copy of the memtable.
+  //
+  // Default: false (disable)
+  //
+  // Dynamically changeable through SetOptions() API
+  bool compact_immutable_memtables = false;
+
   // Page size for huge page for the arena used by the memtable. If <=0, it
   // won't allocate from huge page but from malloc.
   // Users are responsible to reserve huge pages for it to be allocated. For
@@ -23,6 +23,7 @@
 #pragma once
 
 #include <stdint.h>
+#include <functional>
 #include <memory>
 #include <string>
 #include "rocksdb/memory_allocator.h"
@@ -87,6 +88,22 @@ struct LRUCacheOptions {
   CacheMetadataChargePolicy metadata_charge_policy =
       kDefaultCacheMetadataChargePolicy;
 
+  // If true, an insertion that has to evict entries goes through a TinyLFU
+  // admission filter: each shard counts the lookups of keys in a small
+  // frequency sketch, and only admits the new entry if its key was looked up
+  // more often than that of the least recently used entry, which would be
+  // evicted first. Otherwise the entry is treated as if it was inserted and
+  // evicted immediately. If a handle is requested, it is still returned, and
+  // the entry is freed on its last release.
+  //
+  // This keeps blocks read once, e.g. by a long scan, from evicting a hot
+  // working set. Replacing an existing key is always admitted.
+  bool use_admission_filter = false;
+
+  // If non-nullptr, the admission filter reports its decisions in the
+  // CACHE_ADMISSION_ACCEPTED and CACHE_ADMISSION_REJECTED tickers.
+  std::shared_ptr<Statistics> statistics;
+
   LRUCacheOptions() {}
   LRUCacheOptions(size_t _capacity, int _num_shard_bits,
                   bool _strict_capacity_limit, double _high_pri_pool_ratio,
@@ -131,6 +148,58 @@ extern std::shared_ptr<Cache> NewClockCache(
     bool strict_capacity_limit = false,
     CacheMetadataChargePolicy metadata_charge_policy =
         kDefaultCacheMetadataChargePolicy);
+
+struct HyperClockCacheOptions {
+  // Capacity of the cache.
+  size_t capacity = 0;
+
+  // The expected average charge of an entry, e.g. the block size for a block
+  // cache. Each shard keeps its entries in a table of fixed size, allocated
+  // up front for capacity / estimated_entry_charge entries; raising the
+  // capacity later does not make room for more entries. Entries much smaller
+  // than this leave part of the capacity unused, entries much larger waste
+  // memory on table slots. Must be greater than zero.
+  size_t estimated_entry_charge = 0;
+
+  // Cache is sharded into 2^num_shard_bits shards, by hash of key. See
+  // LRUCacheOptions::num_shard_bits.
+  int num_shard_bits = -1;
+
+  // If strict_capacity_limit is set, insert to the cache will fail when cache
+  // is full.
+  bool strict_capacity_limit = false;
+
+  // See LRUCacheOptions::memory_allocator.
+  std::shared_ptr<MemoryAllocator> memory_allocator;
+
+  CacheMetadataChargePolicy metadata_charge_policy =
+      kDefaultCacheMetadataChargePolicy;
+
+  HyperClockCacheOptions() {}
+  HyperClockCacheOptions(
+      size_t _capacity, size_t _estimated_entry_charge,
+      int _num_shard_bits = -1, bool _strict_capacity_limit = false,
+      std::shared_ptr<MemoryAllocator> _memory_allocator = nullptr,
+      CacheMetadataChargePolicy _metadata_charge_policy =
+          kDefaultCacheMetadataChargePolicy)
+      : capacity(_capacity),
+        estimated_entry_charge(_estimated_entry_charge),
+        num_shard_bits(_num_shard_bits),
+        strict_capacity_limit(_strict_capacity_limit),
+        memory_allocator(std::move(_memory_allocator)),
+        metadata_charge_policy(_metadata_charge_policy) {}
+};
+
+// Similar to NewLRUCache, but create a cache based on the CLOCK algorithm
+// whose Lookup() and Release() take no lock, for block caches that many
+// threads read concurrently. It has no high priority pool: high priority
+// entries just survive more sweeps of the clock. See
+// cache/hyper_clock_cache.h for more detail.
+//
+// Return nullptr if the options are invalid.
+extern std::shared_ptr<Cache> NewHyperClockCache(
+    const HyperClockCacheOptions& cache_opts);
+
 class Cache {
  public:
   // Depending on implementation, cache entries with high priority could be less
@@ -279,6 +348,14 @@ class Cache {
   virtual void ApplyToAllCacheEntries(void (*callback)(void*, size_t),
                                       bool thread_safe) = 0;
 
+  // Apply callback to the key, value and charge of all entries in the cache.
+  // The part of the cache being visited is locked, so callback must be cheap
+  // and must not call into the cache. The default implementation visits
+  // nothing.
+  virtual void ApplyToAllEntries(
+      const std::function<void(const Slice& key, void* value, size_t charge)>&
+      /*callback*/) {}
+
   // Remove all entries.
   // Prerequisite: no entry is referenced.
   virtual void EraseUnRefEntries() = 0;
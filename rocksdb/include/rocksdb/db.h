@@ -10,6 +10,7 @@
 
 #include <stdint.h>
 #include <stdio.h>
+#include <functional>
 #include <map>
 #include <memory>
 #include <string>
@@ -397,6 +398,27 @@ class DB {
   // Note: consider setting options.sync = true.
   virtual Status Write(const WriteOptions& options, WriteBatch* updates) = 0;
 
+  // Like Write(), but returns without waiting for the write to be done, and
+  // calls `callback` with its status once it is in the WAL (synced if
+  // options.sync=true) and the memtables. The write is committed as part of
+  // the same write groups as the blocking writes. `updates` must be kept
+  // alive until the callback is called.
+  //
+  // `callback` runs on a thread owned by the DB and should not block, as the
+  // callbacks of the other writes and some write groups wait for it. The call
+  // itself may still wait while writes are stalled, unless
+  // options.no_slowdown=true.
+  //
+  // Returns OK if `callback` will be called, or a non-OK status if the write
+  // was rejected outright, in which case `callback` is not called.
+  // The default implementation calls Write() and then `callback`.
+  virtual Status WriteAsync(const WriteOptions& options, WriteBatch* updates,
+                            std::function<void(Status)> callback) {
+    Status s = Write(options, updates);
+    callback(s);
+    return Status::OK();
+  }
+
   // If the database contains an entry for "key" store the
   // corresponding value in *value and return OK.
   //
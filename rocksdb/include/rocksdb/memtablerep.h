@@ -17,7 +17,7 @@
 // The factory will be passed an MemTableAllocator object when a new MemTableRep
 // is requested.
 //
-// Users can implement their own memtable representations. We include three
+// Users can implement their own memtable representations. We include six
 // types built in:
 //  - SkipListRep: This is the default; it is backed by a skip list.
 //  - HashSkipListRep: The memtable rep that is best used for keys that are
@@ -28,10 +28,24 @@
 // vector is sorted. It is intelligent about sorting; once the MarkReadOnly()
 // has been called, the vector will only be sorted once. It is optimized for
 // random-write-heavy workloads.
+//  - AVLTreeRep: This is backed by an AVL tree whose nodes are allocated from
+//  the memtable's arena. Readers never lock, and concurrent inserts only
+//  serialize on linking and rebalancing, not on the search. Nodes track
+//  their subtree sizes, so ApproximateNumEntries() is exact and O(log n).
+//  - BTreeRep: This is backed by a B+-tree whose nodes are allocated from the
+//  memtable's arena. Nodes cache an 8-byte prefix of each key and search
+//  those with SIMD compares, so a lookup costs a few cache misses per level
+//  rather than one per key. The prefixes only help with the bytewise
+//  comparator. Readers never lock.
+//  - ARTRep: This is backed by an adaptive radix tree over the bytes of the
+//  keys, so it only works with the bytewise comparator; with any other it
+//  falls back to a skip list. Key bytes shared by a subtree are stored once,
+//  lookups never call the comparator, and readers never lock.
 //
-// The last four implementations are designed for situations in which
+// HashSkipListRep and VectorRep are designed for situations in which
 // iteration over the entire collection is rare since doing so requires all the
-// keys to be copied into a sorted data structure.
+// keys to be copied into a sorted data structure. The tree-based reps keep
+// their keys in order and iterate them in place.
 
 #pragma once
 
@@ -45,6 +59,8 @@ namespace ROCKSDB_NAMESPACE {
 
 class Arena;
 class Allocator;
+class Comparator;
+class Env;
 class LookupKey;
 class SliceTransform;
 class Logger;
@@ -75,6 +91,11 @@ class MemTableRep {
     virtual int operator()(const char* prefix_len_key,
                            const Slice& key) const = 0;
 
+    // Returns the comparator that orders the user keys inside the entries,
+    // or nullptr if it is not known. A rep may exploit the byte layout of
+    // keys (e.g. cache key prefixes) only if this is BytewiseComparator().
+    virtual const Comparator* user_comparator() const { return nullptr; }
+
     virtual ~KeyComparator() {}
   };
 
@@ -335,11 +356,23 @@ class SkipListFactory : public MemTableRepFactory {
 //   count: Passed to the constructor of the underlying std::vector of each
 //     VectorRep. On initialization, the underlying array will be at least count
 //     bytes reserved for usage.
+//   sort_run_size: Every time this many entries have been added, they are
+//     sealed into a run. The first iteration after the memtable becomes
+//     immutable sorts the runs that are not sorted yet and merges them, with
+//     the help of env's LOW priority thread pool. 0 sorts everything at the
+//     first iteration instead.
+//   env: The runs are sorted on env's LOW priority thread pool as they are
+//     sealed, so the first iteration only has to merge them. This should be
+//     the DB's Options::env. If nullptr, Env::Default() is used.
 class VectorRepFactory : public MemTableRepFactory {
   const size_t count_;
+  const size_t sort_run_size_;
+  Env* const env_;
 
  public:
-  explicit VectorRepFactory(size_t count = 0) : count_(count) {}
+  explicit VectorRepFactory(size_t count = 0, size_t sort_run_size = 16384,
+                            Env* env = nullptr)
+      : count_(count), sort_run_size_(sort_run_size), env_(env) {}
 
   using MemTableRepFactory::CreateMemTableRep;
   virtual MemTableRep* CreateMemTableRep(const MemTableRep::KeyComparator&,
@@ -381,7 +414,18 @@ extern MemTableRepFactory* NewHashLinkListRepFactory(
     bool if_log_bucket_dist_when_flash = true,
     uint32_t threshold_use_skiplist = 256);
 
+// This creates MemTableReps that are backed by an AVL tree. It supports
+// allow_concurrent_memtable_write and insert hints, like SkipListFactory.
 extern MemTableRepFactory* NewAVLTreeRepFactory();
 
+// This creates MemTableReps that are backed by a cache-conscious B+-tree.
+// It does not support allow_concurrent_memtable_write.
+extern MemTableRepFactory* NewBTreeRepFactory();
+
+// This creates MemTableReps that are backed by an adaptive radix tree. It
+// supports allow_concurrent_memtable_write. The user comparator must be
+// BytewiseComparator(); otherwise the factory creates skip lists.
+extern MemTableRepFactory* NewARTRepFactory();
+
 #endif  // ROCKSDB_LITE
 }  // namespace ROCKSDB_NAMESPACE
@@ -514,6 +514,23 @@ struct DBOptions {
   //   all log files in wal_dir and the dir itself is deleted
   std::string wal_dir = "";
 
+  // Directories, typically on other devices than wal_dir, to stripe the WAL
+  // across. Each WAL then has one file in wal_dir and one in each of these
+  // directories, and write groups append to them in turn, so that the WAL
+  // gets the bandwidth of all the devices. With write_queue_shards the write
+  // queues append to different files at the same time. A sync write still
+  // syncs every file, so that no earlier write can be lost without it.
+  // Recovery merges the files back in the order they were written.
+  //
+  // A directory must not be removed from the list while it holds live WAL
+  // files. Not compatible with WAL archiving (WAL_ttl_seconds and
+  // WAL_size_limit_MB), and recycle_log_file_num is ignored.
+  // GetUpdatesSince() and GetSortedWalFiles(), and hence checkpoints and
+  // backups, are not supported.
+  //
+  // Default: empty
+  std::vector<std::string> wal_stripe_dirs;
+
   // The periodicity when obsolete files get deleted. The default
   // value is 6 hours. The files that get out of scope by compaction
   // process will still get automatically delete on every compaction,
@@ -673,6 +690,20 @@ struct DBOptions {
   // Not supported in ROCKSDB_LITE mode!
   bool use_direct_io_for_flush_and_compaction = false;
 
+  // Use O_DIRECT for writes to the WAL, so that the WAL does not pollute the
+  // page cache. Appends to the WAL are buffered in a preallocated aligned
+  // buffer of writable_file_max_buffer_size bytes, and the partial last page
+  // is written again on the next flush. Consider recycle_log_file_num to
+  // keep the allocation of WAL files off the write path.
+  // When the buffer fills up, it is written in the background while appends
+  // go on in a second buffer. Unless manual_wal_flush is set, the WAL is
+  // flushed after every write group, so this only happens for a group
+  // larger than the buffer. With manual_wal_flush, small writes fill the
+  // buffers too, and only FlushWAL() waits for the writes to finish.
+  // Default: false
+  // Not supported in ROCKSDB_LITE mode!
+  bool use_direct_io_for_wal = false;
+
   // If false, fallocate() calls are bypassed
   bool allow_fallocate = true;
 
@@ -891,6 +922,21 @@ struct DBOptions {
   // Dynamically changeable through SetDBOptions() API.
   uint64_t delayed_write_rate = 0;
 
+  // If true, the rate of delayed writes is set continuously from how close
+  // each column family is to a write stop, instead of being stepped down and
+  // up when the slowdown triggers are crossed. Writes start to be delayed
+  // halfway between the points where compactions are sped up and where the
+  // slowdown triggers are (level0_slowdown_writes_trigger,
+  // soft_pending_compaction_bytes_limit and the last two memtables), at
+  // delayed_write_rate. The rate then falls linearly to 16KB/s at the stop
+  // triggers, taking into account where the level-0 file count and the
+  // pending compaction bytes get if they keep growing as fast as they did
+  // since the last flush or compaction. The stop triggers still stop writes.
+  // The decisions are counted in the "rocksdb.cfstats" property.
+  //
+  // Default: false
+  bool feedback_write_rate_control = false;
+
   // By default, a single write thread queue is maintained. The thread gets
   // to the head of the queue becomes write batch group leader and responsible
   // for writing to WAL and memtable for the batch group.
@@ -932,6 +978,23 @@ struct DBOptions {
   // Default: false
   bool unordered_write = false;
 
+  // Number of write queues. With more than one, each write joins the queue
+  // picked by WriteOptions::write_queue_shard, and every queue forms write
+  // groups with its own leader, so that writes to unrelated column families
+  // do not all wait behind a single leader. The groups of different queues
+  // append to the same WAL in turn and insert into the memtables
+  // concurrently. Sequence numbers are still allocated in WAL order and
+  // become visible to readers in that order, so snapshots stay immutable.
+  //
+  // Requires allow_concurrent_memtable_write and max_successive_merges == 0,
+  // and is not compatible with enable_pipelined_write, unordered_write and
+  // two_write_queues. Ignored by WritePrepared and WriteUnprepared
+  // transactions. OptimisticTransactionDB and writes with a WriteCallback are
+  // not supported.
+  //
+  // Default: 1
+  int write_queue_shards = 1;
+
   // If true, allow multi-writers to update mem tables in parallel.
   // Only some memtable_factory-s support concurrent writes; currently it
   // is implemented only for SkipListFactory.  Concurrent memtable writes
@@ -942,6 +1005,17 @@ struct DBOptions {
   // Default: true
   bool allow_concurrent_memtable_write = true;
 
+  // Number of threads, including the writing one, that insert a single large
+  // write batch into the memtables. A batch of at least two MB that is
+  // written alone is split into ranges of records that are inserted
+  // concurrently, each with the sequence numbers it would have got anyway.
+  // Only used when allow_concurrent_memtable_write is true, and not for
+  // batches with merges or for transactions that use a sequence number per
+  // batch (WritePrepared and WriteUnprepared).
+  //
+  // Default: 1
+  int memtable_insert_threads = 1;
+
   // If true, threads synchronizing with the write batch group leader will
   // wait for up to write_thread_max_yield_usec before blocking on a mutex.
   // This can substantially improve throughput for concurrent workloads,
@@ -976,6 +1050,19 @@ struct DBOptions {
   // Default: 3
   uint64_t write_thread_slow_yield_usec = 3;
 
+  // If positive, the leader of a write group with WriteOptions::sync=true
+  // may wait up to this many microseconds for more sync writers to join its
+  // group, so that they share its WAL sync. How long it waits adapts to the
+  // recent latency of WAL syncs and arrival rate of sync writers: it never
+  // waits longer than half a sync, and only if another sync writer is
+  // expected to arrive in the meantime, so writes at low load are not
+  // delayed. See the WRITE_GROUP_SYNC_DELAY* tickers.
+  //
+  // Has no effect with two_write_queues or write_queue_shards > 1.
+  //
+  // Default: 0 (disabled)
+  uint64_t max_write_group_sync_delay_usec = 0;
+
   // If true, then DB::Open() will not update the statistics used to optimize
   // compaction decision by loading table properties from many files.
   // Turning off this feature will improve DBOpen time especially in
@@ -998,6 +1085,17 @@ struct DBOptions {
   // Default: kPointInTimeRecovery
   WALRecoveryMode wal_recovery_mode = WALRecoveryMode::kPointInTimeRecovery;
 
+  // Number of threads that insert the write batches replayed from the WALs
+  // into the memtables on DB::Open(), while the opening thread reads and
+  // checksums the logs. With 1, batches are replayed on the opening thread.
+  // Only used when allow_concurrent_memtable_write is true, and not for
+  // transactions that use a sequence number per batch (WritePrepared and
+  // WriteUnprepared); batches with merges are always replayed on the opening
+  // thread.
+  //
+  // Default: 1
+  int wal_recovery_threads = 1;
+
   // if set to false then recovery will fail when a prepared
   // transaction is encountered in the WAL
   bool allow_2pc = false;
@@ -1082,6 +1180,16 @@ struct DBOptions {
   // file.
   bool manual_wal_flush = false;
 
+  // If not kNoCompression, the records of new WAL files are compressed with
+  // this compression type, with one compression stream per file so that
+  // small write batches benefit from what the previous ones contain. Files
+  // written with and without compression can be mixed and are read back
+  // either way. Only kZSTD and kZlibCompression are supported; any other
+  // type, or recycle_log_file_num > 0, leaves the WAL uncompressed.
+  //
+  // Default: kNoCompression
+  CompressionType wal_compression = kNoCompression;
+
   // If true, RocksDB supports flushing multiple column families and committing
   // their results atomically to MANIFEST. Note that it is not
   // necessary to set atomic_flush to true if WAL is always enabled since WAL
@@ -1157,6 +1265,20 @@ struct DBOptions {
   //
   // Default: 1000000 (microseconds).
   uint64_t bgerror_resume_retry_interval = 1000000;
+
+  // If not zero, the keys of the blocks of live SST files that are in the
+  // block cache, i.e. their file numbers and offsets, are saved to a file in
+  // the DB directory every block_cache_dump_period_sec seconds, and when the
+  // DB is closed. When the DB is opened, the data blocks listed in that file
+  // are loaded into the block cache by a job in the LOW priority thread pool,
+  // so that the cache is warm again soon after a restart. The reads of the
+  // loader are charged to rate_limiter at IO_LOW priority, so they are
+  // throttled if it limits reads.
+  // Only column families using BlockBasedTableFactory with a block cache are
+  // covered.
+  //
+  // Default: 0 (disabled)
+  unsigned int block_cache_dump_period_sec = 0;
 };
 
 // Options to control the behavior of a database (passed to DB::Open)
@@ -1440,10 +1562,9 @@ struct WriteOptions {
   bool low_pri;
 
   // If true, this writebatch will maintain the last insert positions of each
-  // memtable as hints in concurrent write. It can improve write performance
-  // in concurrent writes if keys in one writebatch are sequential. In
-  // non-concurrent writes (when concurrent_memtable_writes is false) this
-  // option will be ignored.
+  // memtable as hints. It can improve write performance if keys in one
+  // writebatch are sequential. Hints are used without this option once a
+  // writebatch puts a run of keys into a memtable in ascending order.
   //
   // Default: false
   bool memtable_insert_hint_per_batch;
@@ -1459,6 +1580,14 @@ struct WriteOptions {
   // and the API is subject to change.
   const Slice* timestamp;
 
+  // With DBOptions::write_queue_shards > 1, the write goes through queue
+  // write_queue_shard modulo write_queue_shards. When negative, the queue is
+  // picked from the column family of the first update in the batch, so that
+  // writes to different column families tend to go through different queues.
+  //
+  // Default: -1
+  int write_queue_shard;
+
   WriteOptions()
       : sync(false),
         disableWAL(false),
@@ -1466,7 +1595,8 @@ struct WriteOptions {
         no_slowdown(false),
         low_pri(false),
         memtable_insert_hint_per_batch(false),
-        timestamp(nullptr) {}
+        timestamp(nullptr),
+        write_queue_shard(-1) {}
 };
 
 // Options that control flush operations
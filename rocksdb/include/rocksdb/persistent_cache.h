@@ -70,4 +70,15 @@ Status NewPersistentCache(Env* const env, const std::string& path,
                           const std::shared_ptr<Logger>& log,
                           const bool optimized_for_nvm,
                           std::shared_ptr<PersistentCache>* cache);
+
+// Like the above, but if admit_on_second_access is true, a block is only
+// written to the cache once it has missed it twice recently. This keeps blocks
+// that are read once, e.g. by scans, from displacing hot blocks and wearing
+// out the device.
+Status NewPersistentCache(Env* const env, const std::string& path,
+                          const uint64_t size,
+                          const std::shared_ptr<Logger>& log,
+                          const bool optimized_for_nvm,
+                          const bool admit_on_second_access,
+                          std::shared_ptr<PersistentCache>* cache);
 }  // namespace ROCKSDB_NAMESPACE
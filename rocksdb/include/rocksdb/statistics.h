@@ -374,6 +374,19 @@ enum Tickers : uint32_t {
   // # of files deleted immediately by sst file manger through delete scheduler.
   FILES_DELETED_IMMEDIATELY,
 
+  // # of sync write groups whose leader waited for more sync writers, see
+  // DBOptions::max_write_group_sync_delay_usec.
+  WRITE_GROUP_SYNC_DELAYED,
+  // Total microseconds the leaders of sync write groups waited.
+  WRITE_GROUP_SYNC_DELAY_MICROS,
+  // # of sync writers that arrived while leaders waited.
+  WRITE_GROUP_SYNC_DELAY_WRITERS,
+
+  // # of insertions into a full LRUCache that its admission filter accepted
+  // or rejected, see LRUCacheOptions::use_admission_filter.
+  CACHE_ADMISSION_ACCEPTED,
+  CACHE_ADMISSION_REJECTED,
+
   TICKER_ENUM_MAX
 };
 
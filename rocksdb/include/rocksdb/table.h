@@ -160,6 +160,14 @@ struct BlockBasedTableOptions {
   //       same type of object there.
   std::shared_ptr<Cache> block_cache_compressed = nullptr;
 
+  // If not kNoCompression, blocks that are stored uncompressed in the file
+  // are compressed with this type, e.g. kLZ4Compression or kZSTD, and also
+  // kept in block_cache_compressed. Then block_cache_compressed acts as a
+  // second, compressed in-memory tier below block_cache, consulted before
+  // reading the file, whether or not the files are compressed. Blocks that do
+  // not compress well are left out. Filter blocks are never compressed.
+  CompressionType block_cache_compressed_type = kNoCompression;
+
   // Approximate size of user data packed per block.  Note that the
   // block size specified here corresponds to uncompressed data.  The
   // actual size of the unit read from disk may be smaller if
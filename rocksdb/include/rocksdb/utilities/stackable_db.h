@@ -180,6 +180,11 @@ class StackableDB : public DB {
     return db_->Write(opts, updates);
   }
 
+  virtual Status WriteAsync(const WriteOptions& opts, WriteBatch* updates,
+                            std::function<void(Status)> callback) override {
+    return db_->WriteAsync(opts, updates, std::move(callback));
+  }
+
   using DB::NewIterator;
   virtual Iterator* NewIterator(const ReadOptions& opts,
                                 ColumnFamilyHandle* column_family) override {
@@ -81,6 +81,22 @@ class WriteBatch : public WriteBatchBase {
     return Put(nullptr, key, value);
   }
 
+  // Variant of Put() that copies the key but only references the value, for
+  // large values that would otherwise be copied into the batch and then again
+  // into the memtable. The value is written to the WAL straight from the
+  // caller's buffer and copied once, into the memtable.
+  //
+  // REQUIRES: the value buffer stays valid and unchanged until the batch is
+  // cleared or destroyed, or at least until DB::Write() of the batch returns
+  // (or the callback of DB::WriteAsync() runs).
+  // Data() does not include pinned values; use the batch only with DB::Write()
+  // and Iterate(), not with WriteBatchWithIndex or transactions.
+  Status PutPinned(ColumnFamilyHandle* column_family, const Slice& key,
+                   const Slice& value);
+  Status PutPinned(const Slice& key, const Slice& value) {
+    return PutPinned(nullptr, key, value);
+  }
+
   using WriteBatchBase::Delete;
   // If the database contains a mapping for "key", erase it.  Else do nothing.
   Status Delete(ColumnFamilyHandle* column_family, const Slice& key) override;
@@ -277,10 +293,11 @@ class WriteBatch : public WriteBatchBase {
   };
   Status Iterate(Handler* handler) const;
 
-  // Retrieve the serialized version of this batch.
+  // Retrieve the serialized version of this batch. Values added with
+  // PutPinned() are referenced, not contained, in it.
   const std::string& Data() const { return rep_; }
 
-  // Retrieve data size of the batch.
+  // Retrieve data size of the batch, not counting pinned values.
   size_t GetDataSize() const { return rep_.size(); }
 
   // Returns the number of updates in the batch
@@ -367,6 +384,12 @@ class WriteBatch : public WriteBatchBase {
   // more details.
   bool is_latest_persistent_state_ = false;
 
+  // Number and total size of the values added with PutPinned() that are
+  // still in rep_. A batch refers to pinned values iff pinned_records_ > 0;
+  // the values themselves may be empty.
+  size_t pinned_records_ = 0;
+  size_t pinned_value_bytes_ = 0;
+
  protected:
   std::string rep_;  // See comment in write_batch.cc for the format of rep_
   const size_t timestamp_size_;
@@ -4961,6 +4961,16 @@ class TickerTypeJni {
         return -0x14;
       case ROCKSDB_NAMESPACE::Tickers::COMPACT_WRITE_BYTES_TTL:
         return -0x15;
+      case ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAYED:
+        return -0x16;
+      case ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAY_MICROS:
+        return -0x17;
+      case ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAY_WRITERS:
+        return -0x18;
+      case ROCKSDB_NAMESPACE::Tickers::CACHE_ADMISSION_ACCEPTED:
+        return -0x19;
+      case ROCKSDB_NAMESPACE::Tickers::CACHE_ADMISSION_REJECTED:
+        return -0x1A;
 
       case ROCKSDB_NAMESPACE::Tickers::TICKER_ENUM_MAX:
         // 0x5F for backwards compatibility on current minor version.
@@ -5273,6 +5283,16 @@ class TickerTypeJni {
         return ROCKSDB_NAMESPACE::Tickers::COMPACT_WRITE_BYTES_PERIODIC;
       case -0x15:
         return ROCKSDB_NAMESPACE::Tickers::COMPACT_WRITE_BYTES_TTL;
+      case -0x16:
+        return ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAYED;
+      case -0x17:
+        return ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAY_MICROS;
+      case -0x18:
+        return ROCKSDB_NAMESPACE::Tickers::WRITE_GROUP_SYNC_DELAY_WRITERS;
+      case -0x19:
+        return ROCKSDB_NAMESPACE::Tickers::CACHE_ADMISSION_ACCEPTED;
+      case -0x1A:
+        return ROCKSDB_NAMESPACE::Tickers::CACHE_ADMISSION_REJECTED;
       case 0x5F:
         // 0x5F for backwards compatibility on current minor version.
         return ROCKSDB_NAMESPACE::Tickers::TICKER_ENUM_MAX;
@@ -742,6 +742,33 @@ public enum TickerType {
     COMPACT_WRITE_BYTES_PERIODIC((byte) -0x14),
     COMPACT_WRITE_BYTES_TTL((byte) -0x15),
 
+    /**
+     * # of sync write groups whose leader waited for more sync writers.
+     */
+    WRITE_GROUP_SYNC_DELAYED((byte) -0x16),
+
+    /**
+     * Total microseconds the leaders of sync write groups waited.
+     */
+    WRITE_GROUP_SYNC_DELAY_MICROS((byte) -0x17),
+
+    /**
+     * # of sync writers that arrived while leaders waited.
+     */
+    WRITE_GROUP_SYNC_DELAY_WRITERS((byte) -0x18),
+
+    /**
+     * # of insertions into a full LRU cache that its admission filter
+     * accepted.
+     */
+    CACHE_ADMISSION_ACCEPTED((byte) -0x19),
+
+    /**
+     * # of insertions into a full LRU cache that its admission filter
+     * rejected.
+     */
+    CACHE_ADMISSION_REJECTED((byte) -0x1A),
+
     TICKER_ENUM_MAX((byte) 0x5F);
 
     private final byte value;
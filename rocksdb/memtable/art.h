@@ -0,0 +1,1094 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// AdaptiveRadixTree is an adaptive radix tree (Leis et al., "The Adaptive
+// Radix Tree: ARTful Indexing for Main-Memory Databases", ICDE 2013) whose
+// nodes are carved out of an Allocator (normally the memtable's Arena), so,
+// like SkipList, it never frees individual nodes.  It indexes entries by a
+// binary-comparable encoding of their keys: inner nodes branch on one byte of
+// the encoding, and a run of bytes shared by every key below a node is stored
+// once, as the node's prefix, instead of as a chain of one-child nodes.  The
+// leaves are the entries themselves, so a lookup does not run the comparator
+// at all; it touches one node per distinguishing byte and compares the full
+// key once, at the leaf.  Nodes come in four sizes (4, 16, 48 and 256
+// children) and are replaced by the next size up when they fill up.
+//
+// The codec must provide
+//
+//   // Returns an upper bound for the encoded size of entry
+//   size_t MaxEncodedSize(const char* entry) const;
+//   // Writes the encoding of entry to dst and returns its size
+//   size_t Encode(const char* entry, uint8_t* dst) const;
+//
+// such that memcmp order of the encodings is the desired order of the
+// entries, and no encoding is a proper prefix of another one.  Entries are
+// stored as tagged pointers, so they must be at even addresses.
+//
+// Thread safety
+// -------------
+//
+// Inserts may run concurrently with each other and with readers; nothing
+// locks for long.  Every node has a version whose low bits mark it as being
+// written or as replaced.  Readers and writers descend optimistically: they
+// note the version of a node, read it, and check that the version did not
+// move (optimistic lock coupling, see Leis et al., "The ART of Practical
+// Synchronization", DaMoN 2016).  A writer then upgrades its noted versions to
+// write locks on the one or two nodes it modifies, and restarts from the root
+// if any of them moved in the meantime.  A node that grows is copied and
+// marked obsolete, so anyone still holding it fails validation.  Iterators
+// remember the path to their entry and step along it while its versions hold,
+// and search from the root for their neighbor otherwise.
+//
+// Invariants:
+//
+// (1) Allocated nodes and prefixes are never deleted until the tree is
+// destroyed, so a reader holding a stale pointer can always dereference it.
+//
+// (2) Prefix bytes never change.  A node's prefix only ever loses bytes from
+// its front, when a new node is put above it.
+//
+// (3) Every node but the root has at least two children.  The root is a
+// 256-way node with an empty prefix and is never replaced.
+
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <memory>
+#include <string>
+#include "memory/allocator.h"
+#include "port/port.h"
+#include "util/autovector.h"
+#include "util/math.h"
+
+#ifdef HAVE_SSE42
+#include <nmmintrin.h>
+#endif
+
+namespace ROCKSDB_NAMESPACE {
+
+template <class Codec>
+class AdaptiveRadixTree {
+ private:
+  struct Node;
+  template <int kCapacity>
+  struct SortedNode;
+  struct Node48;
+  struct Node256;
+  typedef SortedNode<4> Node4;
+  typedef SortedNode<16> Node16;
+  class EncodedKey;
+
+ public:
+  // Create a new tree object that will use "codec" for encoding entries,
+  // and will allocate memory using "*allocator".  Objects allocated in the
+  // allocator must remain allocated for the lifetime of the tree object.
+  explicit AdaptiveRadixTree(Codec codec, Allocator* allocator);
+  // No copying allowed
+  AdaptiveRadixTree(const AdaptiveRadixTree&) = delete;
+  void operator=(const AdaptiveRadixTree&) = delete;
+
+  // Insert entry into the tree.  Thread-safe.
+  // REQUIRES: entry is at an even address.
+  // Returns false and leaves the tree unchanged if an entry with the same
+  // encoding is already in the tree.
+  bool Insert(const char* entry);
+
+  // Returns true iff an entry with the same encoding as entry is in the tree.
+  bool Contains(const char* entry) const;
+
+  // Return the number of entries in the tree.
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+  // Validate correctness of the tree: node sizes, key order, prefixes and
+  // the entry count.  Requires that no insert runs concurrently.
+  void TEST_Validate() const;
+
+  // Iteration over the contents of the tree
+  class Iterator {
+   public:
+    // Initialize an iterator over the specified tree.
+    // The returned iterator is not valid.
+    explicit Iterator(const AdaptiveRadixTree* tree);
+
+    // Change the underlying tree used for this iterator
+    // This enables us not changing the iterator without deallocating
+    // an old one and then allocating a new one
+    void SetList(const AdaptiveRadixTree* tree);
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const { return key_ != nullptr; }
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const char* key() const {
+      assert(Valid());
+      return key_;
+    }
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next();
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev();
+
+    // Advance to the first entry with a key >= target
+    void Seek(const char* target);
+
+    // Retreat to the last entry with a key <= target
+    void SeekForPrev(const char* target);
+
+    // Position at the first entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToFirst();
+
+    // Position at the last entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToLast();
+
+   private:
+    // A node on the path to key_, the version it was read at, and the byte
+    // of the child the path continues with.
+    struct Frame {
+      Node* node;
+      uint64_t version;
+      int byte;
+    };
+
+    // Each of the following returns false, with key_ unchanged, if a node
+    // moved under it; the caller then retries from the root.
+
+    // Moves to the first entry greater than target (or not less than target,
+    // if inclusive), or, if backward, to the last entry less than target (or
+    // not greater than target, if inclusive).
+    bool Find(const EncodedKey& target, bool inclusive, bool backward);
+
+    // Moves to the first (or, if last, the last) entry below child, which
+    // hangs off the end of path_.
+    bool Descend(uintptr_t child, bool last);
+
+    // Moves to the entry after (or, if backward, before) the subtree at the
+    // end of path_, popping the frames it leaves behind.
+    bool Step(bool backward);
+
+    // Search from the root for the neighbor of key_, for when Step fails.
+    void Reseek(bool backward);
+
+    const AdaptiveRadixTree* tree_;
+    autovector<Frame, 16> path_;
+    const char* key_;
+    // Intentionally copyable
+  };
+
+ private:
+  enum NodeType : uint8_t { kNode4, kNode16, kNode48, kNode256 };
+
+  // Leaves point to entries and have the low bit set; inner children point
+  // to nodes, which are aligned.
+  static const uintptr_t kLeafTag = 1;
+
+  static bool IsLeaf(uintptr_t child) { return (child & kLeafTag) != 0; }
+  static uintptr_t MakeLeaf(const char* entry) {
+    return reinterpret_cast<uintptr_t>(entry) | kLeafTag;
+  }
+  static const char* LeafEntry(uintptr_t child) {
+    return reinterpret_cast<const char*>(child & ~kLeafTag);
+  }
+  static Node* ChildNode(uintptr_t child) {
+    return reinterpret_cast<Node*>(child);
+  }
+
+  // Immutable after construction
+  Codec const codec_;
+  Allocator* const allocator_;  // Allocator used for allocations of nodes
+  Node256* const root_;
+
+  std::atomic<uint64_t> count_;
+
+  Node256* NewRoot();
+  Node4* NewNode4(const uint8_t* prefix, uint32_t prefix_len);
+  // Copies prefix into the allocator, for a prefix that is not already
+  // stored in some node.
+  const uint8_t* CopyPrefix(const uint8_t* prefix, uint32_t prefix_len);
+  // Returns a copy of the full node x with room for one more child.
+  // REQUIRES: x is write locked.
+  Node* Grow(const Node* x);
+
+  // Returns false if a node moved under it and the insert must restart.
+  // Otherwise sets *inserted to whether key was new.
+  bool TryInsert(const EncodedKey& key, uintptr_t leaf, bool* inserted);
+
+  static bool IsFull(const Node* x);
+  // Returns the child of x for byte b, or 0 if there is none.
+  static uintptr_t FindChild(const Node* x, int b);
+  // Returns the child of x with the smallest byte >= b, or, if backward,
+  // with the largest byte <= b, and stores its byte in *found.  Returns 0 if
+  // there is none.
+  static uintptr_t NeighborChild(const Node* x, int b, bool backward,
+                                 int* found);
+  // Adds child under byte b.
+  // REQUIRES: x is write locked and not full, and b has no child yet.
+  static void AddChild(Node* x, uint8_t b, uintptr_t child);
+  // Replaces the child under byte b.
+  // REQUIRES: x is write locked, and b has a child.
+  static void ReplaceChild(Node* x, uint8_t b, uintptr_t child);
+
+  // Checks the subtree rooted at child.  *path holds the bytes leading to
+  // it, *last the encoding of the previous entry in key order.
+  void ValidateSubtree(uintptr_t child, std::string* path, std::string* last,
+                       uint64_t* entries) const;
+};
+
+// Implementation details follow
+
+// The encoding of an entry; short ones live on the stack.
+template <class Codec>
+class AdaptiveRadixTree<Codec>::EncodedKey {
+ public:
+  EncodedKey(const Codec& codec, const char* entry) {
+    const size_t n = codec.MaxEncodedSize(entry);
+    data_ = inline_;
+    if (n > sizeof(inline_)) {
+      heap_.reset(new uint8_t[n]);
+      data_ = heap_.get();
+    }
+    size_ = codec.Encode(entry, data_);
+    assert(size_ <= n);
+  }
+  EncodedKey(const EncodedKey&) = delete;
+  void operator=(const EncodedKey&) = delete;
+
+  const uint8_t* data() const { return data_; }
+  size_t size() const { return size_; }
+
+  // Returns byte i, or -1, which orders before every byte, past the end.
+  int At(size_t i) const { return i < size_ ? data_[i] : -1; }
+
+  int Compare(const EncodedKey& other) const {
+    const size_t n = size_ < other.size_ ? size_ : other.size_;
+    int r = memcmp(data_, other.data_, n);
+    if (r == 0) {
+      r = size_ < other.size_ ? -1 : (size_ > other.size_ ? 1 : 0);
+    }
+    return r;
+  }
+
+ private:
+  uint8_t inline_[128];
+  std::unique_ptr<uint8_t[]> heap_;
+  uint8_t* data_;
+  size_t size_;
+};
+
+template <class Codec>
+struct AdaptiveRadixTree<Codec>::Node {
+  Node(NodeType t, const uint8_t* prefix, uint32_t prefix_len)
+      : type(t), version_(0), count_(0), prefix_(prefix),
+        prefix_len_(prefix_len) {}
+
+  const NodeType type;
+
+  // Number of children.  Its release store publishes the children.
+  int Count() const { return count_.load(std::memory_order_acquire); }
+  void SetCount(int n) { count_.store(n, std::memory_order_release); }
+
+  // The pointer is read before the length and written after it, so a reader
+  // that sees a shortened prefix never pairs it with the old length and
+  // reads past its end.
+  const uint8_t* Prefix(uint32_t* len) const {
+    const uint8_t* p = prefix_.load(std::memory_order_acquire);
+    *len = prefix_len_.load(std::memory_order_relaxed);
+    return p;
+  }
+  // Drops the first n bytes of the prefix.
+  // REQUIRES: this node is write locked.
+  void ChopPrefix(uint32_t n) {
+    const uint8_t* p = prefix_.load(std::memory_order_relaxed);
+    prefix_len_.store(prefix_len_.load(std::memory_order_relaxed) - n,
+                      std::memory_order_relaxed);
+    prefix_.store(p + n, std::memory_order_release);
+  }
+
+  // Bit 0 of the version marks a node that has been replaced, bit 1 a node
+  // that is being written.
+  static const uint64_t kObsolete = 1;
+  static const uint64_t kLocked = 2;
+
+  // Notes the version in *v.  Returns false if the node is being written or
+  // has been replaced.
+  bool ReadLock(uint64_t* v) const {
+    *v = version_.load(std::memory_order_acquire);
+    return (*v & (kObsolete | kLocked)) == 0;
+  }
+
+  // Returns true iff the version is still v, i.e. nothing read from this node
+  // since v was loaded has been modified.
+  bool Validate(uint64_t v) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == v;
+  }
+
+  // Takes the write lock iff the version is still v.  The fence makes sure
+  // that a reader who observes any store made under the lock also observes
+  // the locked version.
+  bool UpgradeToWriteLock(uint64_t v) {
+    if (!version_.compare_exchange_strong(v, v + kLocked,
+                                          std::memory_order_acquire)) {
+      return false;
+    }
+    std::atomic_thread_fence(std::memory_order_release);
+    return true;
+  }
+  void WriteUnlock() {
+    version_.fetch_add(kLocked, std::memory_order_release);
+  }
+  void WriteUnlockObsolete() {
+    version_.fetch_add(kLocked + kObsolete, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint64_t> version_;
+  std::atomic<int> count_;
+  std::atomic<const uint8_t*> prefix_;
+  std::atomic<uint32_t> prefix_len_;
+};
+
+// Node4 and Node16 keep their bytes sorted, next to the children.
+template <class Codec>
+template <int kCapacity>
+struct AdaptiveRadixTree<Codec>::SortedNode : public Node {
+  SortedNode(const uint8_t* prefix, uint32_t prefix_len)
+      : Node(kCapacity == 4 ? kNode4 : kNode16, prefix, prefix_len) {
+    memset(keys, 0, sizeof(keys));
+    for (int i = 0; i < kCapacity; i++) {
+      children[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  int Count() const {
+    int n = Node::Count();
+    // Clamp so that a reader racing with a grow never indexes out of range
+    return n < kCapacity ? n : kCapacity;
+  }
+
+  // Returns the number of the first n bytes that are less than b, or not
+  // greater than b if inclusive.
+  int Rank(int n, int b, bool inclusive) const {
+    if (!inclusive) {
+      b--;
+    }
+    if (b < 0) {
+      return 0;
+    }
+#ifdef HAVE_SSE42
+    if (kCapacity == 16) {
+      // Bit i of "le" is set iff keys[i] <= b, unsigned
+      const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(keys));
+      const __m128i le = _mm_cmpeq_epi8(
+          _mm_min_epu8(v, _mm_set1_epi8(static_cast<char>(b))), v);
+      return BitsSetToOne(static_cast<uint32_t>(_mm_movemask_epi8(le)) &
+                          ((1u << n) - 1));
+    }
+#endif
+    int r = 0;
+    while (r < n && keys[r] <= b) {
+      r++;
+    }
+    return r;
+  }
+
+  // Plain memory, so it can be searched with SIMD loads; a reader that races
+  // with the writer will fail validation.
+  uint8_t keys[kCapacity];
+  std::atomic<uintptr_t> children[kCapacity];
+};
+
+// Node48 maps each byte to a slot, plus one, among its children.
+template <class Codec>
+struct AdaptiveRadixTree<Codec>::Node48 : public Node {
+  static const int kCapacity = 48;
+
+  Node48(const uint8_t* prefix, uint32_t prefix_len)
+      : Node(kNode48, prefix, prefix_len) {
+    memset(index, 0, sizeof(index));
+    for (int i = 0; i < kCapacity; i++) {
+      children[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  uintptr_t Child(int b) const {
+    const int slot = index[b] - 1;
+    if (slot < 0 || slot >= kCapacity) {
+      return 0;
+    }
+    return children[slot].load(std::memory_order_acquire);
+  }
+
+  uint8_t index[256];
+  std::atomic<uintptr_t> children[kCapacity];
+};
+
+template <class Codec>
+struct AdaptiveRadixTree<Codec>::Node256 : public Node {
+  Node256(const uint8_t* prefix, uint32_t prefix_len)
+      : Node(kNode256, prefix, prefix_len) {
+    for (int i = 0; i < 256; i++) {
+      children[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  uintptr_t Child(int b) const {
+    return children[b].load(std::memory_order_acquire);
+  }
+
+  std::atomic<uintptr_t> children[256];
+};
+
+template <class Codec>
+typename AdaptiveRadixTree<Codec>::Node256*
+AdaptiveRadixTree<Codec>::NewRoot() {
+  char* mem = allocator_->AllocateAligned(sizeof(Node256));
+  return new (mem) Node256(nullptr, 0);
+}
+
+template <class Codec>
+typename AdaptiveRadixTree<Codec>::Node4* AdaptiveRadixTree<Codec>::NewNode4(
+    const uint8_t* prefix, uint32_t prefix_len) {
+  char* mem = allocator_->AllocateAligned(sizeof(Node4));
+  return new (mem) Node4(prefix, prefix_len);
+}
+
+template <class Codec>
+const uint8_t* AdaptiveRadixTree<Codec>::CopyPrefix(const uint8_t* prefix,
+                                                    uint32_t prefix_len) {
+  if (prefix_len == 0) {
+    return nullptr;
+  }
+  char* mem = allocator_->Allocate(prefix_len);
+  memcpy(mem, prefix, prefix_len);
+  return reinterpret_cast<const uint8_t*>(mem);
+}
+
+template <class Codec>
+AdaptiveRadixTree<Codec>::AdaptiveRadixTree(const Codec codec,
+                                            Allocator* allocator)
+    : codec_(codec), allocator_(allocator), root_(NewRoot()), count_(0) {}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::IsFull(const Node* x) {
+  switch (x->type) {
+    case kNode4:
+      return x->Count() >= 4;
+    case kNode16:
+      return x->Count() >= 16;
+    case kNode48:
+      return x->Count() >= Node48::kCapacity;
+    default:
+      return false;
+  }
+}
+
+template <class Codec>
+uintptr_t AdaptiveRadixTree<Codec>::FindChild(const Node* x, int b) {
+  switch (x->type) {
+    case kNode4: {
+      const Node4* y = static_cast<const Node4*>(x);
+      const int n = y->Count();
+      const int r = y->Rank(n, b, false);
+      return (r < n && y->keys[r] == b)
+                 ? y->children[r].load(std::memory_order_acquire)
+                 : 0;
+    }
+    case kNode16: {
+      const Node16* y = static_cast<const Node16*>(x);
+      const int n = y->Count();
+      const int r = y->Rank(n, b, false);
+      return (r < n && y->keys[r] == b)
+                 ? y->children[r].load(std::memory_order_acquire)
+                 : 0;
+    }
+    case kNode48:
+      return static_cast<const Node48*>(x)->Child(b);
+    default:
+      return static_cast<const Node256*>(x)->Child(b);
+  }
+}
+
+template <class Codec>
+uintptr_t AdaptiveRadixTree<Codec>::NeighborChild(const Node* x, int b,
+                                                  bool backward, int* found) {
+  if (b < 0 || b > 255) {
+    return 0;
+  }
+  switch (x->type) {
+    case kNode4:
+    case kNode16: {
+      // The two differ only in capacity, which Rank and Count handle
+      const uint8_t* keys;
+      const std::atomic<uintptr_t>* children;
+      int n;
+      int r;
+      if (x->type == kNode4) {
+        const Node4* y = static_cast<const Node4*>(x);
+        n = y->Count();
+        r = y->Rank(n, b, backward);
+        keys = y->keys;
+        children = y->children;
+      } else {
+        const Node16* y = static_cast<const Node16*>(x);
+        n = y->Count();
+        r = y->Rank(n, b, backward);
+        keys = y->keys;
+        children = y->children;
+      }
+      // Forward, r is the first byte >= b; backward, r - 1 the last <= b
+      const int i = backward ? r - 1 : r;
+      if (i < 0 || i >= n) {
+        return 0;
+      }
+      *found = keys[i];
+      return children[i].load(std::memory_order_acquire);
+    }
+    case kNode48: {
+      const Node48* y = static_cast<const Node48*>(x);
+      for (int c = b; c >= 0 && c <= 255; c += backward ? -1 : 1) {
+        uintptr_t child = y->Child(c);
+        if (child != 0) {
+          *found = c;
+          return child;
+        }
+      }
+      return 0;
+    }
+    default: {
+      const Node256* y = static_cast<const Node256*>(x);
+      for (int c = b; c >= 0 && c <= 255; c += backward ? -1 : 1) {
+        uintptr_t child = y->Child(c);
+        if (child != 0) {
+          *found = c;
+          return child;
+        }
+      }
+      return 0;
+    }
+  }
+}
+
+template <class Codec>
+void AdaptiveRadixTree<Codec>::AddChild(Node* x, uint8_t b, uintptr_t child) {
+  const int n = x->Count();
+  switch (x->type) {
+    case kNode4:
+    case kNode16: {
+      uint8_t* keys;
+      std::atomic<uintptr_t>* children;
+      int r;
+      if (x->type == kNode4) {
+        Node4* y = static_cast<Node4*>(x);
+        r = y->Rank(n, b, false);
+        keys = y->keys;
+        children = y->children;
+      } else {
+        Node16* y = static_cast<Node16*>(x);
+        r = y->Rank(n, b, false);
+        keys = y->keys;
+        children = y->children;
+      }
+      for (int i = n; i > r; i--) {
+        keys[i] = keys[i - 1];
+        children[i].store(children[i - 1].load(std::memory_order_relaxed),
+                          std::memory_order_relaxed);
+      }
+      keys[r] = b;
+      children[r].store(child, std::memory_order_release);
+      break;
+    }
+    case kNode48: {
+      // Nothing is ever removed, so the used slots are [0, n)
+      Node48* y = static_cast<Node48*>(x);
+      y->children[n].store(child, std::memory_order_release);
+      y->index[b] = static_cast<uint8_t>(n + 1);
+      break;
+    }
+    default:
+      static_cast<Node256*>(x)->children[b].store(child,
+                                                  std::memory_order_release);
+      break;
+  }
+  x->SetCount(n + 1);
+}
+
+template <class Codec>
+void AdaptiveRadixTree<Codec>::ReplaceChild(Node* x, uint8_t b,
+                                            uintptr_t child) {
+  switch (x->type) {
+    case kNode4: {
+      Node4* y = static_cast<Node4*>(x);
+      const int r = y->Rank(y->Count(), b, false);
+      assert(y->keys[r] == b);
+      y->children[r].store(child, std::memory_order_release);
+      break;
+    }
+    case kNode16: {
+      Node16* y = static_cast<Node16*>(x);
+      const int r = y->Rank(y->Count(), b, false);
+      assert(y->keys[r] == b);
+      y->children[r].store(child, std::memory_order_release);
+      break;
+    }
+    case kNode48: {
+      Node48* y = static_cast<Node48*>(x);
+      assert(y->index[b] != 0);
+      y->children[y->index[b] - 1].store(child, std::memory_order_release);
+      break;
+    }
+    default:
+      static_cast<Node256*>(x)->children[b].store(child,
+                                                  std::memory_order_release);
+      break;
+  }
+}
+
+template <class Codec>
+typename AdaptiveRadixTree<Codec>::Node* AdaptiveRadixTree<Codec>::Grow(
+    const Node* x) {
+  uint32_t prefix_len;
+  const uint8_t* prefix = x->Prefix(&prefix_len);
+  const int n = x->Count();
+  switch (x->type) {
+    case kNode4: {
+      const Node4* y = static_cast<const Node4*>(x);
+      char* mem = allocator_->AllocateAligned(sizeof(Node16));
+      Node16* z = new (mem) Node16(prefix, prefix_len);
+      for (int i = 0; i < n; i++) {
+        z->keys[i] = y->keys[i];
+        z->children[i].store(y->children[i].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+      }
+      z->SetCount(n);
+      return z;
+    }
+    case kNode16: {
+      const Node16* y = static_cast<const Node16*>(x);
+      char* mem = allocator_->AllocateAligned(sizeof(Node48));
+      Node48* z = new (mem) Node48(prefix, prefix_len);
+      for (int i = 0; i < n; i++) {
+        z->index[y->keys[i]] = static_cast<uint8_t>(i + 1);
+        z->children[i].store(y->children[i].load(std::memory_order_relaxed),
+                             std::memory_order_relaxed);
+      }
+      z->SetCount(n);
+      return z;
+    }
+    default: {
+      assert(x->type == kNode48);
+      const Node48* y = static_cast<const Node48*>(x);
+      char* mem = allocator_->AllocateAligned(sizeof(Node256));
+      Node256* z = new (mem) Node256(prefix, prefix_len);
+      for (int c = 0; c < 256; c++) {
+        z->children[c].store(y->Child(c), std::memory_order_relaxed);
+      }
+      z->SetCount(n);
+      return z;
+    }
+  }
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::Insert(const char* entry) {
+  assert((reinterpret_cast<uintptr_t>(entry) & kLeafTag) == 0);
+  EncodedKey key(codec_, entry);
+  bool inserted;
+  while (!TryInsert(key, MakeLeaf(entry), &inserted)) {
+  }
+  if (inserted) {
+    count_.fetch_add(1, std::memory_order_relaxed);
+  }
+  return inserted;
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::TryInsert(const EncodedKey& key,
+                                         uintptr_t leaf, bool* inserted) {
+  *inserted = true;
+  Node* parent = nullptr;
+  uint64_t parent_version = 0;
+  uint8_t parent_byte = 0;
+  Node* x = root_;
+  size_t level = 0;
+  while (true) {
+    uint64_t v;
+    if (!x->ReadLock(&v)) {
+      return false;
+    }
+    // x's prefix may have been cut short since we read the pointer to x;
+    // then parent has moved too.
+    if (parent != nullptr && !parent->Validate(parent_version)) {
+      return false;
+    }
+
+    uint32_t prefix_len;
+    const uint8_t* prefix = x->Prefix(&prefix_len);
+    uint32_t match = 0;
+    while (match < prefix_len && key.At(level + match) == prefix[match]) {
+      match++;
+    }
+    if (match < prefix_len) {
+      // The key leaves x's prefix early: put a node holding the common part
+      // between parent and x.  The root has no prefix, so parent exists.
+      assert(parent != nullptr);
+      assert(level + match < key.size());
+      if (!parent->UpgradeToWriteLock(parent_version)) {
+        return false;
+      }
+      if (!x->UpgradeToWriteLock(v)) {
+        parent->WriteUnlock();
+        return false;
+      }
+      Node4* split = NewNode4(prefix, match);
+      AddChild(split, key.data()[level + match], leaf);
+      AddChild(split, prefix[match], reinterpret_cast<uintptr_t>(x));
+      ReplaceChild(parent, parent_byte, reinterpret_cast<uintptr_t>(split));
+      parent->WriteUnlock();
+      x->ChopPrefix(match + 1);
+      x->WriteUnlock();
+      return true;
+    }
+    level += prefix_len;
+
+    assert(level < key.size());
+    const uint8_t b = key.data()[level];
+    const uintptr_t child = FindChild(x, b);
+    if (!x->Validate(v)) {
+      return false;
+    }
+
+    if (child == 0) {
+      if (!IsFull(x)) {
+        if (!x->UpgradeToWriteLock(v)) {
+          return false;
+        }
+        AddChild(x, b, leaf);
+        x->WriteUnlock();
+        return true;
+      }
+      // Replace x by a bigger copy.  The root is never full.
+      assert(parent != nullptr);
+      if (!parent->UpgradeToWriteLock(parent_version)) {
+        return false;
+      }
+      if (!x->UpgradeToWriteLock(v)) {
+        parent->WriteUnlock();
+        return false;
+      }
+      Node* bigger = Grow(x);
+      AddChild(bigger, b, leaf);
+      ReplaceChild(parent, parent_byte, reinterpret_cast<uintptr_t>(bigger));
+      x->WriteUnlockObsolete();
+      parent->WriteUnlock();
+      return true;
+    }
+
+    if (IsLeaf(child)) {
+      EncodedKey other(codec_, LeafEntry(child));
+      size_t i = level + 1;
+      while (i < key.size() && i < other.size() &&
+             key.data()[i] == other.data()[i]) {
+        i++;
+      }
+      if (i == key.size() && i == other.size()) {
+        *inserted = false;
+        return x->Validate(v);
+      }
+      // Neither encoding is a prefix of the other, so both have byte i.
+      // Fork below x, with the bytes both share as the prefix.
+      assert(i < key.size() && i < other.size());
+      if (!x->UpgradeToWriteLock(v)) {
+        return false;
+      }
+      Node4* fork = NewNode4(
+          CopyPrefix(key.data() + level + 1,
+                     static_cast<uint32_t>(i - level - 1)),
+          static_cast<uint32_t>(i - level - 1));
+      AddChild(fork, key.data()[i], leaf);
+      AddChild(fork, other.data()[i], child);
+      ReplaceChild(x, b, reinterpret_cast<uintptr_t>(fork));
+      x->WriteUnlock();
+      return true;
+    }
+
+    parent = x;
+    parent_version = v;
+    parent_byte = b;
+    x = ChildNode(child);
+    level++;
+  }
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::Contains(const char* entry) const {
+  Iterator iter(this);
+  iter.Seek(entry);
+  if (!iter.Valid()) {
+    return false;
+  }
+  EncodedKey key(codec_, entry);
+  EncodedKey found(codec_, iter.key());
+  return key.Compare(found) == 0;
+}
+
+template <class Codec>
+inline AdaptiveRadixTree<Codec>::Iterator::Iterator(
+    const AdaptiveRadixTree* tree) {
+  SetList(tree);
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::SetList(
+    const AdaptiveRadixTree* tree) {
+  tree_ = tree;
+  path_.clear();
+  key_ = nullptr;
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::Next() {
+  assert(Valid());
+  if (!Step(false)) {
+    Reseek(false);
+  }
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::Prev() {
+  assert(Valid());
+  if (!Step(true)) {
+    Reseek(true);
+  }
+}
+
+template <class Codec>
+void AdaptiveRadixTree<Codec>::Iterator::Reseek(bool backward) {
+  EncodedKey current(tree_->codec_, key_);
+  while (!Find(current, false, backward)) {
+  }
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::Seek(const char* target) {
+  EncodedKey key(tree_->codec_, target);
+  while (!Find(key, true, false)) {
+  }
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::SeekForPrev(
+    const char* target) {
+  EncodedKey key(tree_->codec_, target);
+  while (!Find(key, true, true)) {
+  }
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::SeekToFirst() {
+  do {
+    path_.clear();
+  } while (!Descend(reinterpret_cast<uintptr_t>(tree_->root_), false));
+}
+
+template <class Codec>
+inline void AdaptiveRadixTree<Codec>::Iterator::SeekToLast() {
+  do {
+    path_.clear();
+  } while (!Descend(reinterpret_cast<uintptr_t>(tree_->root_), true));
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::Iterator::Descend(uintptr_t child, bool last) {
+  while (!IsLeaf(child)) {
+    Node* x = ChildNode(child);
+    uint64_t v;
+    if (!x->ReadLock(&v)) {
+      return false;
+    }
+    int b = 0;
+    child = NeighborChild(x, last ? 255 : 0, last, &b);
+    if (!x->Validate(v)) {
+      return false;
+    }
+    if (child == 0) {
+      // Only the root can be empty
+      assert(path_.empty());
+      key_ = nullptr;
+      return true;
+    }
+    path_.push_back({x, v, b});
+  }
+  key_ = LeafEntry(child);
+  return true;
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::Iterator::Step(bool backward) {
+  while (!path_.empty()) {
+    Frame& f = path_.back();
+    int b = 0;
+    const uintptr_t child =
+        NeighborChild(f.node, backward ? f.byte - 1 : f.byte + 1, backward, &b);
+    if (!f.node->Validate(f.version)) {
+      return false;
+    }
+    if (child != 0) {
+      f.byte = b;
+      return Descend(child, backward);
+    }
+    path_.pop_back();
+  }
+  key_ = nullptr;
+  return true;
+}
+
+template <class Codec>
+bool AdaptiveRadixTree<Codec>::Iterator::Find(const EncodedKey& target,
+                                              bool inclusive, bool backward) {
+  path_.clear();
+  Node* x = tree_->root_;
+  size_t level = 0;
+  while (true) {
+    uint64_t v;
+    if (!x->ReadLock(&v)) {
+      return false;
+    }
+    if (!path_.empty() &&
+        !path_.back().node->Validate(path_.back().version)) {
+      return false;
+    }
+
+    // Compare target with x's prefix; cmp < 0 means every key below x is
+    // greater than target, cmp > 0 that every one is less.
+    uint32_t prefix_len;
+    const uint8_t* prefix = x->Prefix(&prefix_len);
+    int cmp = 0;
+    for (uint32_t i = 0; i < prefix_len && cmp == 0; i++) {
+      const int t = target.At(level + i);
+      if (t != prefix[i]) {
+        cmp = t < prefix[i] ? -1 : 1;
+      }
+    }
+    level += prefix_len;
+    const int b = target.At(level);
+    if (cmp == 0 && b < 0) {
+      // target ends here and is a proper prefix of every key below x
+      cmp = -1;
+    }
+    if (!x->Validate(v)) {
+      return false;
+    }
+    if (cmp != 0) {
+      if ((cmp < 0) != backward) {
+        return Descend(reinterpret_cast<uintptr_t>(x), backward);
+      }
+      // The whole subtree is on the wrong side; move past it
+      return Step(backward);
+    }
+
+    const uintptr_t child = FindChild(x, b);
+    if (!x->Validate(v)) {
+      return false;
+    }
+    path_.push_back({x, v, b});
+    if (child == 0) {
+      return Step(backward);
+    }
+    if (IsLeaf(child)) {
+      EncodedKey key(tree_->codec_, LeafEntry(child));
+      const int c = key.Compare(target);
+      if (c == 0 ? inclusive : ((c > 0) != backward)) {
+        key_ = LeafEntry(child);
+        return true;
+      }
+      return Step(backward);
+    }
+    x = ChildNode(child);
+    level++;
+  }
+}
+
+template <class Codec>
+void AdaptiveRadixTree<Codec>::TEST_Validate() const {
+  std::string path;
+  std::string last;
+  uint64_t entries = 0;
+  ValidateSubtree(reinterpret_cast<uintptr_t>(root_), &path, &last, &entries);
+  assert(entries == Count());
+  (void)entries;
+}
+
+template <class Codec>
+void AdaptiveRadixTree<Codec>::ValidateSubtree(uintptr_t child,
+                                               std::string* path,
+                                               std::string* last,
+                                               uint64_t* entries) const {
+  if (IsLeaf(child)) {
+    EncodedKey key(codec_, LeafEntry(child));
+    const std::string encoded(reinterpret_cast<const char*>(key.data()),
+                              key.size());
+    // Every byte on the way down is a byte of the key
+    assert(encoded.compare(0, path->size(), *path) == 0);
+    // Strictly ascending, and no key is a prefix of the previous one
+    assert(*entries == 0 || *last < encoded);
+    assert(*entries == 0 || last->compare(0, last->size(), encoded, 0,
+                                          last->size()) != 0);
+    *last = encoded;
+    (*entries)++;
+    return;
+  }
+
+  const Node* x = ChildNode(child);
+  uint64_t v;
+  const bool locked = x->ReadLock(&v);
+  assert(locked);
+  (void)locked;
+  (void)v;
+  uint32_t prefix_len;
+  const uint8_t* prefix = x->Prefix(&prefix_len);
+  const size_t saved = path->size();
+  path->append(reinterpret_cast<const char*>(prefix), prefix_len);
+
+  int children = 0;
+  int prev = -1;
+  int b = 0;
+  for (uintptr_t c = NeighborChild(x, 0, false, &b); c != 0;
+       c = NeighborChild(x, b + 1, false, &b)) {
+    assert(b > prev);
+    prev = b;
+    children++;
+    path->push_back(static_cast<char>(b));
+    ValidateSubtree(c, path, last, entries);
+    path->pop_back();
+  }
+  assert(children == x->Count());
+  assert(x == root_ || children >= 2);
+  switch (x->type) {
+    case kNode4:
+      assert(children <= 4);
+      break;
+    case kNode16:
+      assert(children > 4 && children <= 16);
+      break;
+    case kNode48:
+      assert(children > 16 && children <= Node48::kCapacity);
+      break;
+    default:
+      assert(x == root_ || children > Node48::kCapacity);
+      break;
+  }
+  path->resize(saved);
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,208 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#ifndef ROCKSDB_LITE
+#include "memtable/art_rep.h"
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "logging/logging.h"
+#include "memory/arena.h"
+#include "memtable/art.h"
+#include "rocksdb/comparator.h"
+#include "rocksdb/memtablerep.h"
+#include "util/coding.h"
+
+namespace ROCKSDB_NAMESPACE {
+namespace {
+
+// Encodes the internal key of an entry so that memcmp sorts the encodings
+// like InternalKeyComparator over BytewiseComparator: the user key with
+// every 0x00 escaped as 0x00 0xff, a 0x00 0x00 terminator, and then the
+// bit-inverted (sequence, type) footer in big-endian order, so that newer
+// entries of a user key come first.  The terminator makes the encodings
+// prefix-free, as AdaptiveRadixTree requires.
+class InternalKeyCodec {
+ public:
+  size_t MaxEncodedSize(const char* entry) const {
+    // The entry format is frozen; see MemTableRep::KeyComparator::decode_key
+    Slice internal_key = GetLengthPrefixedSlice(entry);
+    return 2 * internal_key.size() - 6;
+  }
+
+  size_t Encode(const char* entry, uint8_t* dst) const {
+    Slice internal_key = GetLengthPrefixedSlice(entry);
+    assert(internal_key.size() >= 8);
+    const size_t user_key_size = internal_key.size() - 8;
+    uint8_t* p = dst;
+    for (size_t i = 0; i < user_key_size; i++) {
+      const uint8_t c = static_cast<uint8_t>(internal_key[i]);
+      *p++ = c;
+      if (c == 0) {
+        *p++ = 0xff;
+      }
+    }
+    *p++ = 0;
+    *p++ = 0;
+    const uint64_t footer =
+        ~DecodeFixed64(internal_key.data() + user_key_size);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+      *p++ = static_cast<uint8_t>(footer >> shift);
+    }
+    return static_cast<size_t>(p - dst);
+  }
+};
+
+typedef AdaptiveRadixTree<InternalKeyCodec> MemTableART;
+
+class ARTRep : public MemTableRep {
+  MemTableART tree_;
+
+ public:
+  explicit ARTRep(Allocator* allocator)
+      : MemTableRep(allocator), tree_(InternalKeyCodec(), allocator) {}
+
+  // The tree tags its leaf pointers, so entries must be at even addresses.
+  KeyHandle Allocate(const size_t len, char** buf) override {
+    *buf = allocator_->AllocateAligned(len);
+    return static_cast<KeyHandle>(*buf);
+  }
+
+  // Insert key into the tree.
+  // REQUIRES: nothing that compares equal to key is currently in the tree.
+  void Insert(KeyHandle handle) override {
+    tree_.Insert(static_cast<char*>(handle));
+  }
+
+  bool InsertKey(KeyHandle handle) override {
+    return tree_.Insert(static_cast<char*>(handle));
+  }
+
+  void InsertConcurrently(KeyHandle handle) override {
+    tree_.Insert(static_cast<char*>(handle));
+  }
+
+  bool InsertKeyConcurrently(KeyHandle handle) override {
+    return tree_.Insert(static_cast<char*>(handle));
+  }
+
+  // The tree has no use for insert hints, but it must still reject
+  // duplicates when given one.
+  bool InsertKeyWithHint(KeyHandle handle, void** /*hint*/) override {
+    return InsertKey(handle);
+  }
+
+  bool InsertKeyWithHintConcurrently(KeyHandle handle,
+                                     void** /*hint*/) override {
+    return InsertKeyConcurrently(handle);
+  }
+
+  // Returns true iff an entry that compares equal to key is in the tree.
+  bool Contains(const char* key) const override { return tree_.Contains(key); }
+
+  size_t ApproximateMemoryUsage() override {
+    // All memory is allocated through allocator; nothing to report here
+    return 0;
+  }
+
+  void Get(const LookupKey& k, void* callback_args,
+           bool (*callback_func)(void* arg, const char* entry)) override {
+    ARTRep::Iterator iter(&tree_);
+    Slice dummy_slice;
+    for (iter.Seek(dummy_slice, k.memtable_key().data());
+         iter.Valid() && callback_func(callback_args, iter.key());
+         iter.Next()) {
+    }
+  }
+
+  ~ARTRep() override {}
+
+  // Iteration over the contents of the tree. Readers never lock; see the
+  // thread safety notes in memtable/art.h.
+  class Iterator : public MemTableRep::Iterator {
+    MemTableART::Iterator iter_;
+
+   public:
+    // Initialize an iterator over the specified tree.
+    // The returned iterator is not valid.
+    explicit Iterator(const MemTableART* tree) : iter_(tree) {}
+
+    ~Iterator() override {}
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const override { return iter_.Valid(); }
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const char* key() const override { return iter_.key(); }
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next() override { iter_.Next(); }
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev() override { iter_.Prev(); }
+
+    // Advance to the first entry with a key >= target
+    void Seek(const Slice& internal_key, const char* memtable_key) override {
+      if (memtable_key != nullptr) {
+        iter_.Seek(memtable_key);
+      } else {
+        iter_.Seek(EncodeKey(&tmp_, internal_key));
+      }
+    }
+
+    // Retreat to the last entry with a key <= target
+    void SeekForPrev(const Slice& internal_key,
+                     const char* memtable_key) override {
+      if (memtable_key != nullptr) {
+        iter_.SeekForPrev(memtable_key);
+      } else {
+        iter_.SeekForPrev(EncodeKey(&tmp_, internal_key));
+      }
+    }
+
+    // Position at the first entry in collection.
+    // Final state of iterator is Valid() iff collection is not empty.
+    void SeekToFirst() override { iter_.SeekToFirst(); }
+
+    // Position at the last entry in collection.
+    // Final state of iterator is Valid() iff collection is not empty.
+    void SeekToLast() override { iter_.SeekToLast(); }
+
+   protected:
+    std::string tmp_;       // For passing to EncodeKey
+  };
+
+  MemTableRep::Iterator* GetIterator(Arena* arena = nullptr) override {
+    void* mem = arena ? arena->AllocateAligned(sizeof(ARTRep::Iterator))
+                      : operator new(sizeof(ARTRep::Iterator));
+    return new (mem) ARTRep::Iterator(&tree_);
+  }
+};
+
+}  // anon namespace
+
+MemTableRep* ARTRepFactory::CreateMemTableRep(
+    const MemTableRep::KeyComparator& compare, Allocator* allocator,
+    const SliceTransform* transform, Logger* logger) {
+  if (compare.user_comparator() != BytewiseComparator()) {
+    // The tree orders entries by their bytes, which only agrees with the
+    // bytewise comparator
+    ROCKS_LOG_WARN(logger,
+                   "ARTRepFactory requires BytewiseComparator; using a skip "
+                   "list memtable instead");
+    return SkipListFactory().CreateMemTableRep(compare, allocator, transform,
+                                               logger);
+  }
+  return new ARTRep(allocator);
+}
+
+MemTableRepFactory* NewARTRepFactory() { return new ARTRepFactory(); }
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
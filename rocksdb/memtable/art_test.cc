@@ -0,0 +1,530 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memtable/art.h"
+#include <set>
+#include <string>
+#include "memory/arena.h"
+#include "memory/concurrent_arena.h"
+#include "rocksdb/env.h"
+#include "test_util/testharness.h"
+#include "util/coding.h"
+#include "util/hash.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+typedef uint64_t Key;
+
+// Entries are Keys stored in the allocator; they encode as 8 big-endian
+// bytes, so the encodings are all the same length and thus prefix-free.
+struct TestCodec {
+  size_t MaxEncodedSize(const char* /*entry*/) const { return sizeof(Key); }
+
+  size_t Encode(const char* entry, uint8_t* dst) const {
+    Key key = Decode(entry);
+    for (size_t i = 0; i < sizeof(Key); i++) {
+      dst[i] = static_cast<uint8_t>(key >> (8 * (sizeof(Key) - 1 - i)));
+    }
+    return sizeof(Key);
+  }
+
+  static Key Decode(const char* entry) {
+    Key key;
+    memcpy(&key, entry, sizeof(key));
+    return key;
+  }
+};
+
+// Entries are varint32-prefixed strings without 0x00 bytes; they encode as
+// the string plus a 0x00 terminator.
+struct StringCodec {
+  size_t MaxEncodedSize(const char* entry) const {
+    return GetLengthPrefixedSlice(entry).size() + 1;
+  }
+
+  size_t Encode(const char* entry, uint8_t* dst) const {
+    Slice s = GetLengthPrefixedSlice(entry);
+    memcpy(dst, s.data(), s.size());
+    dst[s.size()] = 0;
+    return s.size() + 1;
+  }
+};
+
+typedef AdaptiveRadixTree<TestCodec> TestART;
+typedef AdaptiveRadixTree<StringCodec> StringART;
+
+static const char* NewEntry(Allocator* allocator, Key key) {
+  char* mem = allocator->AllocateAligned(sizeof(Key));
+  memcpy(mem, &key, sizeof(key));
+  return mem;
+}
+
+static const char* NewEntry(Allocator* allocator, const std::string& s) {
+  std::string buf;
+  PutLengthPrefixedSlice(&buf, s);
+  char* mem = allocator->AllocateAligned(buf.size());
+  memcpy(mem, buf.data(), buf.size());
+  return mem;
+}
+
+class ARTTest : public testing::Test {};
+
+TEST_F(ARTTest, Empty) {
+  Arena arena;
+  TestART tree(TestCodec(), &arena);
+  ASSERT_TRUE(!tree.Contains(NewEntry(&arena, 10)));
+  ASSERT_EQ(0U, tree.Count());
+  tree.TEST_Validate();
+
+  TestART::Iterator iter(&tree);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  iter.Seek(NewEntry(&arena, 100));
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekForPrev(NewEntry(&arena, 100));
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+// spread scatters the keys over the bytes of the encoding, so that nodes of
+// every size and long prefixes both show up.
+TEST_F(ARTTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  for (Key spread : {Key{1}, Key{0x10001}, Key{0x0100000001}}) {
+    Random rnd(1000);
+    std::set<Key> keys;
+    Arena arena;
+    TestART tree(TestCodec(), &arena);
+    for (int i = 0; i < N; i++) {
+      Key key = (rnd.Next() % R) * spread;
+      bool inserted = keys.insert(key).second;
+      ASSERT_EQ(inserted, tree.Insert(NewEntry(&arena, key)));
+    }
+    ASSERT_EQ(keys.size(), tree.Count());
+    tree.TEST_Validate();
+
+    for (int i = 0; i < R; i++) {
+      if (tree.Contains(NewEntry(&arena, i * spread))) {
+        ASSERT_EQ(keys.count(i * spread), 1U);
+      } else {
+        ASSERT_EQ(keys.count(i * spread), 0U);
+      }
+    }
+
+    // Simple iterator tests
+    {
+      TestART::Iterator iter(&tree);
+      ASSERT_TRUE(!iter.Valid());
+
+      iter.Seek(NewEntry(&arena, 0));
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.begin()), TestCodec::Decode(iter.key()));
+
+      iter.SeekForPrev(NewEntry(&arena, (R - 1) * spread));
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.rbegin()), TestCodec::Decode(iter.key()));
+
+      iter.SeekToFirst();
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.begin()), TestCodec::Decode(iter.key()));
+
+      iter.SeekToLast();
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.rbegin()), TestCodec::Decode(iter.key()));
+    }
+
+    // Forward iteration test
+    for (int i = 0; i < R; i++) {
+      TestART::Iterator iter(&tree);
+      iter.Seek(NewEntry(&arena, i * spread));
+
+      // Compare against model iterator
+      std::set<Key>::iterator model_iter = keys.lower_bound(i * spread);
+      for (int j = 0; j < 3; j++) {
+        if (model_iter == keys.end()) {
+          ASSERT_TRUE(!iter.Valid());
+          break;
+        } else {
+          ASSERT_TRUE(iter.Valid());
+          ASSERT_EQ(*model_iter, TestCodec::Decode(iter.key()));
+          ++model_iter;
+          iter.Next();
+        }
+      }
+    }
+
+    // Backward iteration test
+    for (int i = 0; i < R; i++) {
+      TestART::Iterator iter(&tree);
+      iter.SeekForPrev(NewEntry(&arena, i * spread));
+
+      // Compare against model iterator
+      std::set<Key>::iterator model_iter = keys.upper_bound(i * spread);
+      for (int j = 0; j < 3; j++) {
+        if (model_iter == keys.begin()) {
+          ASSERT_TRUE(!iter.Valid());
+          break;
+        } else {
+          ASSERT_TRUE(iter.Valid());
+          ASSERT_EQ(*--model_iter, TestCodec::Decode(iter.key()));
+          iter.Prev();
+        }
+      }
+    }
+  }
+}
+
+// Dense keys fill 256-way nodes at the bottom; a full scan in both
+// directions must see every key once.
+TEST_F(ARTTest, SequentialInsert) {
+  const Key N = 100000;
+  for (bool ascending : {true, false}) {
+    Arena arena;
+    TestART tree(TestCodec(), &arena);
+    for (Key i = 0; i < N; i++) {
+      ASSERT_TRUE(tree.Insert(NewEntry(&arena, ascending ? i : N - 1 - i)));
+    }
+    ASSERT_EQ(N, tree.Count());
+    tree.TEST_Validate();
+
+    TestART::Iterator iter(&tree);
+    Key expected = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      ASSERT_EQ(expected++, TestCodec::Decode(iter.key()));
+    }
+    ASSERT_EQ(N, expected);
+    for (iter.SeekToLast(); iter.Valid(); iter.Prev()) {
+      ASSERT_EQ(--expected, TestCodec::Decode(iter.key()));
+    }
+    ASSERT_EQ(0U, expected);
+  }
+}
+
+// Variable-length keys with long shared runs exercise prefix compression:
+// inserts that leave a prefix early split it, and seeks to targets that end
+// inside a prefix or leave it early have to skip whole subtrees.
+TEST_F(ARTTest, SharedPrefixes) {
+  Random rnd(301);
+  Arena arena;
+  StringART tree(StringCodec(), &arena);
+  std::set<std::string> keys;
+  const char* const kStems[] = {"user/", "user/profile/", "users", "u",
+                                "order/2020/", "order/2021/"};
+  auto random_key = [&]() {
+    std::string key = kStems[rnd.Uniform(6)];
+    for (int n = rnd.Uniform(4); n > 0; n--) {
+      key.push_back(static_cast<char>('a' + rnd.Uniform(3)));
+    }
+    return key;
+  };
+  for (int i = 0; i < 1000; i++) {
+    std::string key = random_key();
+    bool inserted = keys.insert(key).second;
+    ASSERT_EQ(inserted, tree.Insert(NewEntry(&arena, key)));
+  }
+  ASSERT_EQ(keys.size(), tree.Count());
+  tree.TEST_Validate();
+
+  StringART::Iterator iter(&tree);
+  iter.SeekToFirst();
+  for (const std::string& key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(key, GetLengthPrefixedSlice(iter.key()).ToString());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+
+  for (int i = 0; i < 2000; i++) {
+    std::string target = random_key();
+    target.resize(rnd.Uniform(static_cast<int>(target.size()) + 1));
+    const char* entry = NewEntry(&arena, target);
+
+    iter.Seek(entry);
+    auto lower = keys.lower_bound(target);
+    if (lower == keys.end()) {
+      ASSERT_TRUE(!iter.Valid());
+    } else {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*lower, GetLengthPrefixedSlice(iter.key()).ToString());
+    }
+
+    iter.SeekForPrev(entry);
+    auto upper = keys.upper_bound(target);
+    if (upper == keys.begin()) {
+      ASSERT_TRUE(!iter.Valid());
+    } else {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*--upper, GetLengthPrefixedSlice(iter.key()).ToString());
+    }
+  }
+}
+
+#ifndef ROCKSDB_VALGRIND_RUN
+// We want to make sure that with concurrent writers and a concurrent reader
+// (with no synchronization other than when a reader's iterator is created),
+// the reader always observes all the data that was present in the tree when
+// the iterator was constructed.  Inserts grow and split nodes underneath the
+// reader, so this also exercises the optimistic validation on the read path.
+//
+// Keys are <key,gen,hash> as in skiplist_test.cc.
+class ConcurrentTest {
+ public:
+  static const uint32_t K = 8;
+
+ private:
+  static uint64_t key(Key key) { return (key >> 40); }
+  static uint64_t gen(Key key) { return (key >> 8) & 0xffffffffu; }
+  static uint64_t hash(Key key) { return key & 0xff; }
+
+  static uint64_t HashNumbers(uint64_t k, uint64_t g) {
+    uint64_t data[2] = {k, g};
+    return Hash(reinterpret_cast<char*>(data), sizeof(data), 0);
+  }
+
+  static Key MakeKey(uint64_t k, uint64_t g) {
+    assert(k <= K);  // We sometimes pass K to seek to the end of the tree
+    assert(g <= 0xffffffffu);
+    return ((k << 40) | (g << 8) | (HashNumbers(k, g) & 0xff));
+  }
+
+  static bool IsValidKey(Key k) {
+    return hash(k) == (HashNumbers(key(k), gen(k)) & 0xff);
+  }
+
+  static Key RandomTarget(Random* rnd) {
+    switch (rnd->Next() % 10) {
+      case 0:
+        // Seek to beginning
+        return MakeKey(0, 0);
+      case 1:
+        // Seek to end
+        return MakeKey(K, 0);
+      default:
+        // Seek to middle
+        return MakeKey(rnd->Next() % K, 0);
+    }
+  }
+
+  // Per-key generation
+  struct State {
+    std::atomic<int> generation[K];
+    void Set(int k, int v) {
+      generation[k].store(v, std::memory_order_release);
+    }
+    int Get(int k) { return generation[k].load(std::memory_order_acquire); }
+
+    State() {
+      for (unsigned int k = 0; k < K; k++) {
+        Set(k, 0);
+      }
+    }
+  };
+
+  // Current state of the test
+  State current_;
+
+  ConcurrentArena arena_;
+
+  TestART tree_;
+
+ public:
+  ConcurrentTest() : tree_(TestCodec(), &arena_) {}
+
+  // REQUIRES: No concurrent calls for the same k
+  void WriteStep(uint32_t k) {
+    const int g = current_.Get(k) + 1;
+    ASSERT_TRUE(tree_.Insert(NewEntry(&arena_, MakeKey(k, g))));
+    ASSERT_EQ(g, current_.Get(k) + 1);
+    current_.Set(k, g);
+  }
+
+  void ReadStep(Random* rnd) {
+    // Remember the initial committed state of the tree.
+    State initial_state;
+    for (unsigned int k = 0; k < K; k++) {
+      initial_state.Set(k, current_.Get(k));
+    }
+
+    Key pos = RandomTarget(rnd);
+    TestART::Iterator iter(&tree_);
+    iter.Seek(NewEntry(&arena_, pos));
+    while (true) {
+      Key current;
+      if (!iter.Valid()) {
+        current = MakeKey(K, 0);
+      } else {
+        current = TestCodec::Decode(iter.key());
+        ASSERT_TRUE(IsValidKey(current)) << current;
+      }
+      ASSERT_LE(pos, current) << "should not go backwards";
+
+      // Verify that everything in [pos,current) was not present in
+      // initial_state.
+      while (pos < current) {
+        ASSERT_LT(key(pos), K) << pos;
+
+        // Note that generation 0 is never inserted, so it is ok if
+        // <*,0,*> is missing.
+        ASSERT_TRUE((gen(pos) == 0U) ||
+                    (gen(pos) > static_cast<uint64_t>(initial_state.Get(
+                                    static_cast<int>(key(pos))))))
+            << "key: " << key(pos) << "; gen: " << gen(pos)
+            << "; initgen: " << initial_state.Get(static_cast<int>(key(pos)));
+
+        // Advance to next key in the valid key space
+        if (key(pos) < key(current)) {
+          pos = MakeKey(key(pos) + 1, 0);
+        } else {
+          pos = MakeKey(key(pos), gen(pos) + 1);
+        }
+      }
+
+      if (!iter.Valid()) {
+        break;
+      }
+
+      if (rnd->Next() % 2) {
+        iter.Next();
+        pos = MakeKey(key(pos), gen(pos) + 1);
+      } else {
+        Key new_target = RandomTarget(rnd);
+        if (new_target > pos) {
+          pos = new_target;
+          iter.Seek(NewEntry(&arena_, new_target));
+        }
+      }
+    }
+  }
+
+  void Validate() { tree_.TEST_Validate(); }
+};
+const uint32_t ConcurrentTest::K;
+
+// Simple test that does single-threaded testing of the ConcurrentTest
+// scaffolding.
+TEST_F(ARTTest, ConcurrentWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    test.WriteStep(rnd.Next() % ConcurrentTest::K);
+  }
+  test.Validate();
+}
+
+class TestState {
+ public:
+  ConcurrentTest t_;
+  int seed_;
+  std::atomic<bool> quit_flag_;
+  std::atomic<uint32_t> next_writer_;
+
+  enum ReaderState { STARTING, RUNNING, DONE };
+
+  explicit TestState(int s)
+      : seed_(s),
+        quit_flag_(false),
+        state_(STARTING),
+        pending_writers_(0),
+        state_cv_(&mu_) {}
+
+  void Wait(ReaderState s) {
+    mu_.Lock();
+    while (state_ != s) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+  void Change(ReaderState s) {
+    mu_.Lock();
+    state_ = s;
+    state_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  void AdjustPendingWriters(int delta) {
+    mu_.Lock();
+    pending_writers_ += delta;
+    if (pending_writers_ == 0) {
+      state_cv_.Signal();
+    }
+    mu_.Unlock();
+  }
+
+  void WaitForPendingWriters() {
+    mu_.Lock();
+    while (pending_writers_ != 0) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  ReaderState state_;
+  int pending_writers_;
+  port::CondVar state_cv_;
+};
+
+static void ConcurrentReader(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  Random rnd(state->seed_);
+  state->Change(TestState::RUNNING);
+  while (!state->quit_flag_.load(std::memory_order_acquire)) {
+    state->t_.ReadStep(&rnd);
+  }
+  state->Change(TestState::DONE);
+}
+
+static void ConcurrentWriter(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  uint32_t k = state->next_writer_++ % ConcurrentTest::K;
+  state->t_.WriteStep(k);
+  state->AdjustPendingWriters(-1);
+}
+
+static void RunConcurrentInsert(int run, int write_parallelism = 4) {
+  Env::Default()->SetBackgroundThreads(1 + write_parallelism,
+                                       Env::Priority::LOW);
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 1000;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    if ((i % 100) == 0) {
+      fprintf(stderr, "Run %d of %d\n", i, N);
+    }
+    TestState state(seed + 1);
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; k += write_parallelism) {
+      state.next_writer_ = rnd.Next();
+      state.AdjustPendingWriters(write_parallelism);
+      for (int p = 0; p < write_parallelism; ++p) {
+        Env::Default()->Schedule(ConcurrentWriter, &state);
+      }
+      state.WaitForPendingWriters();
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+    state.t_.Validate();
+  }
+}
+
+TEST_F(ARTTest, ConcurrentInsert1) { RunConcurrentInsert(1); }
+TEST_F(ARTTest, ConcurrentInsert2) { RunConcurrentInsert(2); }
+
+#endif  // ROCKSDB_VALGRIND_RUN
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -1,89 +1,126 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// AVLTree is a height-balanced binary search tree whose nodes are carved out
+// of an Allocator (normally the memtable's Arena), so, like SkipList, it never
+// frees individual nodes.
+//
+// Thread safety
+// -------------
+//
+// Reads never lock.  Unlike a skip list, an insert may rotate nodes that are
+// already linked into the tree, which can move a node out from under a
+// reader.  A rotation only ever shrinks the key range covered by the node
+// that moves down, so every node carries a version that is odd while the
+// node is being rotated down and is bumped once the rotation is done.  A
+// reader stepping from a node to a child loads the child's version and then
+// re-checks both the parent's version and the child link; if either moved it
+// starts the search over.  This is the optimistic hand-over-hand validation
+// from Bronson et al., "A Practical Concurrent Binary Search Tree" (PPoPP
+// 2010).  Iterator::Next()/Prev() instead walk parent links, validated by a
+// tree-wide rotation counter, and fall back to a search by key if a rotation
+// overlapped the walk.
+//
+// Insert() and InsertWithHint() require external synchronization, most
+// likely a mutex, against all other inserts.  InsertConcurrently() and
+// InsertWithHintConcurrently() may be called from many threads at once: the
+// descent to the insertion point runs lock-free, and only linking the new
+// node and the (amortized O(1)) rebalancing above it happen under a short
+// internal spin lock.  The two families must not be mixed concurrently.
+//
+// Invariants:
+//
+// (1) Allocated nodes are never deleted until the AVLTree is destroyed.
+//
+// (2) The key of a Node is immutable after the Node has been linked into the
+// tree.  An iterator positioned on a node therefore stays valid across
+// inserts.
+//
+// (3) For every node, the heights of its two subtrees differ by at most one,
+// which bounds the depth of the tree to about 1.44 * log2(n).
+//
+// (4) Child links never form a cycle, not even in the middle of a rotation,
+// so a reader following child links always reaches a leaf.
+//
+// (5) Every node records the number of nodes in its subtree, which makes
+// the tree an order-statistic tree: the rank of a key is found in one
+// descent.
+
 #pragma once
-#ifndef ROCKSDB_LITE
 #include <assert.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include "memory/allocator.h"
+#include "port/port.h"
+#include "util/mutexlock.h"
 
 namespace ROCKSDB_NAMESPACE {
 
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 class AVLTree {
  private:
   struct Node;
-  Node*  root;
-  uint64_t count_;
-  // Immutable after construction
-  Comparator const compare_;
-  Node* NewNode(const Key& key);
-
-  void LL(Node *&t);
-  void RR(Node *&t);
-  void LR(Node *&t);
-  void RL(Node *&t);
-  inline int height(Node *x){
-    if (x==nullptr)
-      return 0;
-    return x->Height();
-  }
-  inline int getbf(Node *x){
-    if (x==nullptr)
-      return 0;
-    else
-      return height(x->Left())-height(x->Right());
-  }
-  int max(int a, int b){return a>b?a:b;}
-  bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
-  bool LessThan(const Key& a, const Key& b) const {return (compare_(a, b) < 0); }
-  // Return true if key is greater than the data stored in "n"
-  bool KeyIsAfterNode(const Key& key, Node* n) const{  
-    return (n != nullptr) && (compare_(n->key, key) < 0);
-  }
-  // Returns the earliest node with a key >= key.
-  // Return nullptr if there is no such node.
-  Node* FindGreaterOrEqual(const Key& key) const{ return FindGreaterOrEqual(key, root);}
-  Node* FindGreaterOrEqual(const Key& key, Node* x) const;
-  // Return the latest node with a key < key.
-  // Return head_ if there is no such node.
-  // Fills prev[level] with pointer to previous node at "level" for every
-  // level in [0..max_height_-1], if prev is non-null.
-  Node* FindLessThan(const Key& key) const;
-
-  // Return the last node in the list.
-  // Return head_ if list is empty.
-  Node* FindLast() const;
+  struct Finger;
 
  public:
-
-  explicit AVLTree(const Comparator cmp);
+  // Create a new AVLTree object that will use "cmp" for comparing keys,
+  // and will allocate memory using "*allocator".  Objects allocated in the
+  // allocator must remain allocated for the lifetime of the tree object.
+  explicit AVLTree(Comparator cmp, Allocator* allocator);
   // No copying allowed
   AVLTree(const AVLTree&) = delete;
-  //void operator=(const AVLTree&) = delete;
-  
-  // Insert key into the list.
-  // REQUIRES: nothing that compares equal to key is currently in the list.
-  void Insert(const Key& key);
-  //bool InsertWithHint(const char* key, void** hint);
-  //bool InsertWithHintConcurrently(const char* key, void** hint);
+  void operator=(const AVLTree&) = delete;
+
+  // Insert key into the tree.
+  // REQUIRES: no concurrent calls to any Insert*().
+  // Returns false and leaves the tree unchanged if an entry that compares
+  // equal to key is already in the tree.
+  bool Insert(const Key& key);
+
+  // Inserts a key, first trying the slot right after the key that was last
+  // inserted with the same hint, which makes ascending inserts O(1) before
+  // rebalancing.  A key further after the last one is found by a finger
+  // search from it, in O(log d) for a key d entries away.  If hint points to
+  // nullptr, a new hint will be allocated from the allocator and populated.
+  // REQUIRES: no concurrent calls to any Insert*().
+  bool InsertWithHint(const Key& key, void** hint);
+
   // Like Insert, but external synchronization is not required.
-  //bool InsertConcurrently(const char* key);
+  bool InsertConcurrently(const Key& key);
+
+  // Like InsertWithHint, but external synchronization is not required.  If
+  // hint points to nullptr, a new hint will be allocated on heap with
+  // new char[] and the caller is responsible for delete[]-ing it.
+  bool InsertWithHintConcurrently(const Key& key, void** hint);
 
-  // Returns true iff an entry that compares equal to key is in the list.
+  // Returns true iff an entry that compares equal to key is in the tree.
   bool Contains(const Key& key) const;
 
-  // Return estimated number of entries smaller than `key`.
-  uint64_t EstimateCount(const Key& key) const{ return EstimateCount(key, root);}
-  uint64_t EstimateCount(const Key& key,const Node* x) const;
+  // Return the number of entries smaller than `key`.
+  // This is a single O(log n) descent.  The result is exact unless inserts
+  // are running concurrently, in which case it may be off by the number of
+  // those inserts.
+  uint64_t EstimateCount(const Key& key) const;
 
-  //Return Number of nodes in tree, for approximate memory usage
-  uint64_t Size(){return count_ * sizeof(Node);}
+  // Return the number of entries in the tree.
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
 
-  // Iteration over the contents of a skip list
+  // Validate correctness of the tree: key order, parent links, heights,
+  // balance and subtree sizes.  Requires that no insert runs concurrently.
+  void TEST_Validate() const;
+
+  // Iteration over the contents of the tree
   class Iterator {
    public:
-    // Initialize an iterator over the specified list.
+    // Initialize an iterator over the specified tree.
     // The returned iterator is not valid.
     explicit Iterator(const AVLTree* tree);
 
-    // Change the avltree used for this iterator
+    // Change the underlying tree used for this iterator
     // This enables us not changing the iterator without deallocating
     // an old one and then allocating a new one
     void SetList(const AVLTree* tree);
@@ -95,9 +132,6 @@ class AVLTree {
     // REQUIRES: Valid()
     const Key& key() const;
 
-    // Advance to the first entry with a key >= target
-    void Seek(const Key& target);
-
     // Advances to the next position.
     // REQUIRES: Valid()
     void Next();
@@ -106,21 +140,19 @@ class AVLTree {
     // REQUIRES: Valid()
     void Prev();
 
+    // Advance to the first entry with a key >= target
+    void Seek(const Key& target);
+
     // Retreat to the last entry with a key <= target
-    //void SeekForPrev(const Key& target);
+    void SeekForPrev(const Key& target);
 
-    // Position at the first entry in list.
-    // Final state of iterator is Valid() iff list is not empty.
-    void SeekToFirst(){
-      assert(Valid());
-      node_ = tree_->root;
-    }
+    // Position at the first entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToFirst();
 
-    // Position at the last entry in list.
-    // Final state of iterator is Valid() iff list is not empty.
-    void SeekToLast(){
-      assert(false);
-    }
+    // Position at the last entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToLast();
 
    private:
     const AVLTree* tree_;
@@ -128,315 +160,689 @@ class AVLTree {
     // Intentionally copyable
   };
 
-  
+ private:
+  enum Direction { kLeft = 0, kRight = 1 };
+
+  // Where a key sits in the tree.  prev and next are the entries on either
+  // side of the key (nullptr past either end), and the key belongs in the
+  // empty child slot "dir" of "parent", which is head_ for an empty tree.
+  struct Position {
+    Node* prev;
+    Node* next;
+    Node* parent;
+    Direction dir;
+  };
+
+  // Immutable after construction
+  Comparator const compare_;
+  Allocator* const allocator_;  // Allocator used for allocations of nodes
+
+  // Sentinel whose right child is the root.  It is never rotated, so
+  // readers can always start from it.
+  Node* const head_;
+
+  // Odd while a rotation is in progress; bumped twice per rotation.
+  std::atomic<uint64_t> rotations_;
+
+  // Modified only by inserts, which are serialized by the caller or mutex_.
+  std::atomic<uint64_t> count_;
+
+  // Serializes linking and rebalancing for InsertConcurrently()
+  SpinMutex mutex_;
+
+  Node* NewNode(const Key& key);
+
+  bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
+  bool LessThan(const Key& a, const Key& b) const {
+    return (compare_(a, b) < 0);
+  }
+
+  template <bool UseMutex>
+  bool Insert(const Key& key, Finger* finger);
+
+  // Fills *pos with the position of key, found without taking any lock.  An
+  // entry equal to key is reported as pos->prev if equal_is_before is true
+  // and as pos->next otherwise.
+  void FindPosition(const Key& key, bool equal_is_before, Position* pos) const;
+
+  // Returns true iff *pos still describes an empty slot between two
+  // adjacent entries.
+  // REQUIRES: the caller holds the insert lock.
+  bool IsCurrent(const Position& pos) const;
+
+  // Fills *pos with the slot right after "last" and returns true if that is
+  // where key belongs; otherwise returns false.
+  // REQUIRES: the caller holds the insert lock.
+  bool PositionAfter(Node* last, const Key& key, Position* pos) const;
+
+  // Fills *pos with the position of a key after "last" by climbing from last
+  // to the lowest ancestor whose subtree spans key and descending from there.
+  // Returns false if key is not after last.  An entry equal to key is
+  // reported as pos->next.
+  // REQUIRES: the caller holds the insert lock.
+  bool FingerSearch(Node* last, const Key& key, Position* pos) const;
+
+  // Links x into the empty slot described by pos and rebalances the tree.
+  // REQUIRES: the caller holds the insert lock.
+  void Link(const Position& pos, Node* x);
+
+  // Make "new_child" take the place of "old_child" under "parent".  A null
+  // parent means old_child was the root.
+  void ReplaceChild(Node* parent, Node* old_child, Node* new_child);
+
+  // Rotate the subtree rooted at "x" towards "dir", moving x down, and
+  // return the new subtree root.
+  Node* Rotate(Node* x, Direction dir);
+
+  // Restore the AVL invariant at "x", whose subtrees are already balanced,
+  // and return the root of the resulting subtree.
+  Node* Rebalance(Node* x);
+
+  static int Height(Node* n) { return n == nullptr ? 0 : n->height; }
+  static int BalanceFactor(Node* n) {
+    return Height(n->Child(kLeft)) - Height(n->Child(kRight));
+  }
+  static void UpdateHeight(Node* n) {
+    int hl = Height(n->Child(kLeft));
+    int hr = Height(n->Child(kRight));
+    n->height = (hl > hr ? hl : hr) + 1;
+  }
+  static uint64_t Size(Node* n) { return n == nullptr ? 0 : n->Size(); }
+  static void UpdateSize(Node* n) {
+    n->SetSize(Size(n->Child(kLeft)) + Size(n->Child(kRight)) + 1);
+  }
+
+  // Checks the subtree rooted at x and returns its height.
+  int ValidateSubtree(Node* x, Node* parent) const;
+
+  // Return the in-order neighbor of x in direction dir.
+  Node* Neighbor(Node* x, Direction dir) const;
+
+  // Return the first/last node in the tree.
+  // Return nullptr if the tree is empty.
+  Node* FindEdge(Direction dir) const;
+
+  // Returns the earliest node with a key >= key.
+  // Return nullptr if there is no such node.
+  Node* FindGreaterOrEqual(const Key& key) const {
+    Position pos;
+    FindPosition(key, false, &pos);
+    return pos.next;
+  }
+
+  // Return the latest node with a key < key.
+  // Return nullptr if there is no such node.
+  Node* FindLessThan(const Key& key) const {
+    Position pos;
+    FindPosition(key, false, &pos);
+    return pos.prev;
+  }
 };
+
 // Implementation details follow
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 struct AVLTree<Key, Comparator>::Node {
-  explicit Node(const Key& k) : key(k) {
-    left_ = nullptr;
-  	right_ = nullptr;
-	  parent_  =nullptr;
-	  height = -1; 
-   }
+  explicit Node(const Key& k) : key(k), height(1), version_(0), size_(1) {
+    child_[kLeft].store(nullptr, std::memory_order_relaxed);
+    child_[kRight].store(nullptr, std::memory_order_relaxed);
+    parent_.store(nullptr, std::memory_order_relaxed);
+  }
 
   Key const key;
 
-  //Find next node in order
-  Node* Next(){
-    if (right_ == nullptr){
-      if (parent_!=nullptr && parent_->Left() == this)
-        return parent_;
-      else 
-        return right_;
-    }
-    else {
-      Node* x = right_;
-      while (x->Left()!=nullptr){
-        x = x->Left();
-      }
-      return x;
-    }
-  }
+  // Height of the subtree rooted here; a leaf has height 1.  Only inserts
+  // read or write it.
+  int height;
 
+  // Accessors/mutators for links.  Wrapped in methods so we can
+  // add the appropriate barriers as necessary.
+  Node* Child(int dir) {
+    // Use an 'acquire load' so that we observe a fully initialized
+    // version of the returned Node.
+    return child_[dir].load(std::memory_order_acquire);
+  }
+  void SetChild(int dir, Node* x) {
+    // Use a 'release store' so that anybody who reads through this
+    // pointer observes a fully initialized version of the inserted node.
+    child_[dir].store(x, std::memory_order_release);
+  }
+  Node* Parent() { return parent_.load(std::memory_order_acquire); }
+  void SetParent(Node* x) { parent_.store(x, std::memory_order_release); }
+
+  uint32_t Version() { return version_.load(std::memory_order_acquire); }
+
+  // Number of nodes in the subtree rooted here.  Written only by inserts;
+  // readers use it for ranks, which are estimates anyway while inserts run.
+  uint64_t Size() { return size_.load(std::memory_order_relaxed); }
+  void SetSize(uint64_t n) { size_.store(n, std::memory_order_relaxed); }
+
+  // Bracket a rotation that moves this node down.  The fence makes sure that
+  // a reader who observes any link written inside the bracket also observes
+  // the odd version.
+  void BeginShrink() {
+    version_.store(version_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void EndShrink() {
+    version_.store(version_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
 
-  Node* Prev(){
-    if (left_ == nullptr){
-      if (parent_ != nullptr && parent_->Right() == this)
-        return parent_;
-      else 
-        return left_;
-    }
-    else{
-      Node* x = left_;
-      while (x->Right()!=nullptr)
-        x = x->Right();
+  // In-order neighbor in direction dir, following the links as they are
+  // right now.  Only meaningful if no rotation runs concurrently.
+  Node* Step(int dir) {
+    Node* x = this;
+    Node* c = x->Child(dir);
+    if (c != nullptr) {
+      x = c;
+      while ((c = x->Child(1 - dir)) != nullptr) {
+        x = c;
+      }
       return x;
     }
-    
-  }
-  
-  
-  
-  int Height(){   return height; };
-  void SetHeight(int x){  height = x;}
-  Node* Parent() {  return parent_;}
-  void SetParent(Node* x) { parent_ = x; }
-  Node* Left() { return left_; }
-  void SetLeft(Node* x) { left_ = x;}
-  Node* Right() { return right_; }
-  void SetRight(Node* x) { right_ = x;}
-  
+    Node* p = x->Parent();
+    while (p != nullptr && p->Child(dir) == x) {
+      x = p;
+      p = x->Parent();
+    }
+    return p;
+  }
 
  private:
-  // Array of length equal to the node height.  next_[0] is lowest level link.
-  Node* left_;
-  Node* right_; 
-  Node* parent_;
-  int height;
+  std::atomic<Node*> child_[2];
+  std::atomic<Node*> parent_;
+  std::atomic<uint32_t> version_;
+  std::atomic<uint64_t> size_;
 };
 
-template<typename Key, class Comparator>
-typename AVLTree<Key, Comparator>::Node*
-AVLTree<Key, Comparator>::NewNode(const Key& key) {
-  return new Node(key);
+// The state behind an insert hint: the node most recently inserted with it.
+template <typename Key, class Comparator>
+struct AVLTree<Key, Comparator>::Finger {
+  Node* last = nullptr;
+};
+
+template <typename Key, class Comparator>
+typename AVLTree<Key, Comparator>::Node* AVLTree<Key, Comparator>::NewNode(
+    const Key& key) {
+  char* mem = allocator_->AllocateAligned(sizeof(Node));
+  return new (mem) Node(key);
 }
 
-template<typename Key, class Comparator>
-inline AVLTree<Key, Comparator>::Iterator::Iterator(
-  const AVLTree* tree) {
+template <typename Key, class Comparator>
+inline AVLTree<Key, Comparator>::Iterator::Iterator(const AVLTree* tree) {
   SetList(tree);
 }
 
-template<typename Key, class Comparator>
-inline void AVLTree<Key, Comparator>::Iterator::SetList(
-  const AVLTree* tree) {
+template <typename Key, class Comparator>
+inline void AVLTree<Key, Comparator>::Iterator::SetList(const AVLTree* tree) {
   tree_ = tree;
-  node_ = tree->root;
+  node_ = nullptr;
 }
 
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 inline bool AVLTree<Key, Comparator>::Iterator::Valid() const {
   return node_ != nullptr;
 }
 
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 inline const Key& AVLTree<Key, Comparator>::Iterator::key() const {
   assert(Valid());
   return node_->key;
 }
 
-
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 inline void AVLTree<Key, Comparator>::Iterator::Next() {
   assert(Valid());
-  node_ = node_->Next();
+  node_ = tree_->Neighbor(node_, kRight);
 }
 
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 inline void AVLTree<Key, Comparator>::Iterator::Prev() {
-  // Instead of using explicit "prev" links, we just search for the
-  // last node that falls before key.
   assert(Valid());
-  node_ = node_->Prev();
-  
+  node_ = tree_->Neighbor(node_, kLeft);
 }
 
-template<typename Key, class Comparator>
+template <typename Key, class Comparator>
 inline void AVLTree<Key, Comparator>::Iterator::Seek(const Key& target) {
   node_ = tree_->FindGreaterOrEqual(target);
 }
 
+template <typename Key, class Comparator>
+inline void AVLTree<Key, Comparator>::Iterator::SeekForPrev(
+    const Key& target) {
+  Position pos;
+  tree_->FindPosition(target, true, &pos);
+  node_ = pos.prev;
+}
 
-template<typename Key, class Comparator>
-typename AVLTree<Key, Comparator>::Node* 
-AVLTree<Key, Comparator>::FindGreaterOrEqual(const Key& key, Node* x) const{
-    if (x==nullptr)
-      return x;
+template <typename Key, class Comparator>
+inline void AVLTree<Key, Comparator>::Iterator::SeekToFirst() {
+  node_ = tree_->FindEdge(kLeft);
+}
+
+template <typename Key, class Comparator>
+inline void AVLTree<Key, Comparator>::Iterator::SeekToLast() {
+  node_ = tree_->FindEdge(kRight);
+}
 
-    if (Equal(key,x->key))//Equal then return
-      return x;  
+template <typename Key, class Comparator>
+void AVLTree<Key, Comparator>::FindPosition(const Key& key,
+                                            bool equal_is_before,
+                                            Position* pos) const {
+  while (true) {
+    Node* prev = nullptr;
+    Node* next = nullptr;
+    Node* x = head_;
+    uint32_t x_version = 0;  // head_ is never rotated
+    Direction dir = kRight;
+    while (true) {
+      Node* c = x->Child(dir);
+      if (c == nullptr) {
+        if (x->Version() != x_version) {
+          break;
+        }
+        pos->prev = prev;
+        pos->next = next;
+        pos->parent = x;
+        pos->dir = dir;
+        return;
+      }
+      // x's key range contained key when x_version was read.  If x has not
+      // been rotated down since, the range of its current child c contains
+      // key as well, as of when c_version was read.
+      uint32_t c_version = c->Version();
+      if ((c_version & 1) != 0 || x->Child(dir) != c ||
+          x->Version() != x_version) {
+        break;
+      }
+      int cmp = compare_(c->key, key);
+      if (cmp < 0 || (cmp == 0 && equal_is_before)) {
+        prev = c;
+        dir = kRight;
+      } else {
+        next = c;
+        dir = kLeft;
+      }
+      x = c;
+      x_version = c_version;
+    }
+    // A rotation moved a node on our path; start over from the root
+    port::AsmVolatilePause();
+  }
+}
 
-    else if (KeyIsAfterNode(key, x)) 
-    //x->key < target key
-    //then we search in the right subtree
-      return FindGreaterOrEqual(key, x->Right());
+template <typename Key, class Comparator>
+typename AVLTree<Key, Comparator>::Node* AVLTree<Key, Comparator>::Neighbor(
+    Node* x, Direction dir) const {
+  uint64_t seq = rotations_.load(std::memory_order_acquire);
+  if ((seq & 1) == 0) {
+    Node* n = x->Step(dir);
+    if (rotations_.load(std::memory_order_acquire) == seq) {
+      return n;
+    }
+  }
+  // A rotation overlapped the walk, so search by key instead
+  Position pos;
+  FindPosition(x->key, dir == kRight, &pos);
+  return dir == kRight ? pos.next : pos.prev;
+}
 
-    else{
-    //x->key < target key
-    //then we search in the left subtree
-      Node* prev = x->Prev();
-      if (KeyIsAfterNode(key, prev)){
+template <typename Key, class Comparator>
+typename AVLTree<Key, Comparator>::Node* AVLTree<Key, Comparator>::FindEdge(
+    Direction dir) const {
+  while (true) {
+    uint64_t seq = rotations_.load(std::memory_order_acquire);
+    if ((seq & 1) == 0) {
+      Node* x = head_->Child(kRight);
+      Node* c;
+      while (x != nullptr && (c = x->Child(dir)) != nullptr) {
+        x = c;
+      }
+      if (rotations_.load(std::memory_order_acquire) == seq) {
         return x;
       }
-      else 
-        return FindGreaterOrEqual(key,x->Left());
-      
-    } 
+    }
+    port::AsmVolatilePause();
+  }
 }
 
+template <typename Key, class Comparator>
+uint64_t AVLTree<Key, Comparator>::EstimateCount(const Key& key) const {
+  // Every node that is smaller than key lies on the search path or in the
+  // left subtree of a path node that is smaller than key.  A rotation during
+  // the descent can make us count a subtree twice or not at all, so retry a
+  // few times under the rotation seqlock before settling for an estimate.
+  const int kMaxAttempts = 4;
+  uint64_t count = 0;
+  for (int attempt = 1;; attempt++) {
+    uint64_t seq = rotations_.load(std::memory_order_acquire);
+    count = 0;
+    Node* x = head_->Child(kRight);
+    while (x != nullptr) {
+      if (LessThan(x->key, key)) {
+        count += 1 + Size(x->Child(kLeft));
+        x = x->Child(kRight);
+      } else {
+        x = x->Child(kLeft);
+      }
+    }
+    if (attempt == kMaxAttempts ||
+        ((seq & 1) == 0 && rotations_.load(std::memory_order_acquire) == seq)) {
+      return count;
+    }
+    port::AsmVolatilePause();
+  }
+}
 
-template<typename Key, class Comparator>
-typename AVLTree<Key, Comparator>::Node* 
-AVLTree<Key, Comparator>::FindLessThan(const Key& key) const{
+template <typename Key, class Comparator>
+void AVLTree<Key, Comparator>::ReplaceChild(Node* parent, Node* old_child,
+                                            Node* new_child) {
+  if (parent == nullptr) {
+    head_->SetChild(kRight, new_child);
+  } else if (parent->Child(kLeft) == old_child) {
+    parent->SetChild(kLeft, new_child);
+  } else {
+    assert(parent->Child(kRight) == old_child);
+    parent->SetChild(kRight, new_child);
+  }
+  if (new_child != nullptr) {
+    new_child->SetParent(parent);
+  }
+}
 
+template <typename Key, class Comparator>
+typename AVLTree<Key, Comparator>::Node* AVLTree<Key, Comparator>::Rotate(
+    Node* x, Direction dir) {
+  // x's child y on the opposite side becomes the subtree root, and y's
+  // inner subtree b moves over to x.  x is the only node whose key range
+  // shrinks, so it is the only one that needs a new version.  The links are
+  // written so that a reader following child links never sees a cycle.
+  const Direction other = dir == kLeft ? kRight : kLeft;
+  Node* y = x->Child(other);
+  assert(y != nullptr);
+  Node* b = y->Child(dir);
+  Node* p = x->Parent();
+
+  rotations_.store(rotations_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+  x->BeginShrink();
+  x->SetChild(other, b);
+  if (b != nullptr) {
+    b->SetParent(x);
+  }
+  y->SetChild(dir, x);
+  x->SetParent(y);
+  ReplaceChild(p, x, y);
+  x->EndShrink();
+  rotations_.store(rotations_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+
+  UpdateHeight(x);
+  UpdateHeight(y);
+  // y takes over x's place and x's subtree size
+  UpdateSize(x);
+  UpdateSize(y);
+  return y;
 }
 
-template<typename Key, class Comparator>
-typename AVLTree<Key, Comparator>::Node* 
-AVLTree<Key, Comparator>::FindLast() const{
-    Node * x = root;
-    while (x->Right()!= nullptr){
-      x = x->Right();
+template <typename Key, class Comparator>
+typename AVLTree<Key, Comparator>::Node* AVLTree<Key, Comparator>::Rebalance(
+    Node* x) {
+  UpdateHeight(x);
+  int bf = BalanceFactor(x);
+  if (bf > 1) {
+    if (BalanceFactor(x->Child(kLeft)) < 0) {
+      Rotate(x->Child(kLeft), kLeft);
     }
-    return x;
-}
-/*---------------------------------------Tree Operations-------------------------------------*/
-template <typename Key, class Comparator>
-void AVLTree<Key, Comparator>::LL(Node* &t){
-    //LL rotate
-    Node* tmp = t->Left();
-    t->SetLeft(tmp->Right());
-    tmp->Right()->SetParent(t);
-
-    //change parent after rotate
-    tmp->SetRight(t);
-    t->SetParent(tmp);
-
-    //Set height of changed nodes
-    t->SetHeight(max(height(t->Left()), height(t->Right()))+1);
-    tmp->SetHeight(max(height(tmp->Left()), height(tmp->Right()))+1);
-    t = tmp;
+    return Rotate(x, kRight);
+  } else if (bf < -1) {
+    if (BalanceFactor(x->Child(kRight)) > 0) {
+      Rotate(x->Child(kRight), kRight);
+    }
+    return Rotate(x, kLeft);
+  }
+  return x;
 }
 
 template <typename Key, class Comparator>
-void AVLTree<Key,Comparator>::RR(Node* &t){
-    //RR rotate
-    Node* tmp = t->Right();
-    t->SetRight(tmp->Left());
-    tmp->Left()->SetParent(t);
+AVLTree<Key, Comparator>::AVLTree(const Comparator cmp, Allocator* allocator)
+    : compare_(cmp),
+      allocator_(allocator),
+      head_(NewNode(0 /* any key will do */)),
+      rotations_(0),
+      count_(0) {}
 
-    //change parent after rotate
-    tmp->SetLeft(t);
-    t->SetParent(tmp);
-
-    //Set height of changed nodes
-    t->SetHeight(max(height(t->Left()), height(t->Right()))+1);
-    tmp->SetHeight(max(height(tmp->Left()), height(tmp->Right()))+1);
-    t = tmp;
+template <typename Key, class Comparator>
+bool AVLTree<Key, Comparator>::IsCurrent(const Position& pos) const {
+  if (pos.parent->Child(pos.dir) != nullptr) {
+    return false;
+  }
+  if (pos.parent == head_) {
+    return true;
+  }
+  // The slot is still empty; make sure the entry on its other side is still
+  // the one the search saw, so nothing can lie between prev and next.
+  if (pos.dir == kLeft) {
+    return pos.parent == pos.next && pos.parent->Step(kLeft) == pos.prev;
+  } else {
+    return pos.parent == pos.prev && pos.parent->Step(kRight) == pos.next;
+  }
 }
 
 template <typename Key, class Comparator>
-void AVLTree<Key,Comparator>::LR(Node* &t){
-	  Node* x = t->Left();
-    RR(x);
-    LL(t);
+bool AVLTree<Key, Comparator>::PositionAfter(Node* last, const Key& key,
+                                             Position* pos) const {
+  if (last == nullptr || !LessThan(last->key, key)) {
+    return false;
+  }
+  Node* next = last->Step(kRight);
+  if (next != nullptr && !LessThan(key, next->key)) {
+    return false;
+  }
+  // The empty slot between last and next is either last's right child or,
+  // if that is taken, the left child of next, the leftmost node below it.
+  pos->prev = last;
+  pos->next = next;
+  if (last->Child(kRight) == nullptr) {
+    pos->parent = last;
+    pos->dir = kRight;
+  } else {
+    assert(next != nullptr && next->Child(kLeft) == nullptr);
+    pos->parent = next;
+    pos->dir = kLeft;
+  }
+  return true;
 }
 
 template <typename Key, class Comparator>
-void AVLTree<Key,Comparator>::RL(Node* &t){
-	  Node* x = t->Right();
-    LL(x);
-    RR(t);
+bool AVLTree<Key, Comparator>::FingerSearch(Node* last, const Key& key,
+                                            Position* pos) const {
+  if (last == nullptr || !LessThan(last->key, key)) {
+    return false;
+  }
+  // Climb while x's subtree lies entirely before key.  Once x is a left child
+  // and its parent is not before key, the parent bounds x's subtree from
+  // above, and last (inside the subtree) bounds key from below.
+  Node* x = last;
+  Node* next = nullptr;
+  for (Node* parent = x->Parent(); parent != nullptr;
+       x = parent, parent = x->Parent()) {
+    if (parent->Child(kLeft) == x && !LessThan(parent->key, key)) {
+      next = parent;
+      break;
+    }
+  }
+  Node* prev = nullptr;
+  while (true) {
+    Direction dir;
+    if (LessThan(x->key, key)) {
+      prev = x;
+      dir = kRight;
+    } else {
+      next = x;
+      dir = kLeft;
+    }
+    Node* c = x->Child(dir);
+    if (c == nullptr) {
+      pos->prev = prev;
+      pos->next = next;
+      pos->parent = x;
+      pos->dir = dir;
+      return true;
+    }
+    x = c;
+  }
 }
 
+template <typename Key, class Comparator>
+void AVLTree<Key, Comparator>::Link(const Position& pos, Node* x) {
+  Node* parent = pos.parent == head_ ? nullptr : pos.parent;
+  x->SetParent(parent);
+  pos.parent->SetChild(pos.dir, x);
+  count_.store(count_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+  // Every ancestor gains one node, including those above the point where
+  // rebalancing stops.
+  for (Node* n = parent; n != nullptr; n = n->Parent()) {
+    n->SetSize(n->Size() + 1);
+  }
+
+  // Walk back up, fixing heights.  An insert needs at most one (single or
+  // double) rotation, after which the subtree is back at its old height and
+  // nothing above it changes.
+  while (parent != nullptr) {
+    int old_height = parent->height;
+    Node* grand_parent = parent->Parent();
+    Node* subtree = Rebalance(parent);
+    if (subtree->height == old_height) {
+      break;
+    }
+    parent = grand_parent;
+  }
+}
 
 template <typename Key, class Comparator>
-uint64_t AVLTree<Key, Comparator>::EstimateCount(const Key& key,const Node* x) const {
-  uint64_t count = 0;
-  if (x==nullptr)
-    return 0;
+template <bool UseMutex>
+bool AVLTree<Key, Comparator>::Insert(const Key& key, Finger* finger) {
+  Position pos;
+  bool positioned = false;
+  if (UseMutex && finger == nullptr) {
+    // Do the expensive descent before taking the lock.  Another insert may
+    // fill the slot or rotate the tree before we get the lock, which
+    // IsCurrent() detects.
+    FindPosition(key, false, &pos);
+    if (pos.next != nullptr && Equal(key, pos.next->key)) {
+      return false;
+    }
+    positioned = true;
+  }
 
-  if (LessThan(x->key,key)){
-    count = count + 1 + EstimateCount(key,x->Left()) + EstimateCount(key,x->Right());
+  std::unique_lock<SpinMutex> lock(mutex_, std::defer_lock);
+  if (UseMutex) {
+    lock.lock();
+    positioned = positioned && IsCurrent(pos);
   }
-  else{
-    count = count + EstimateCount(key,x->Left());
+  if (!positioned && finger != nullptr) {
+    positioned = PositionAfter(finger->last, key, &pos);
+    if (!positioned && FingerSearch(finger->last, key, &pos)) {
+      if (pos.next != nullptr && Equal(key, pos.next->key)) {
+        return false;
+      }
+      positioned = true;
+    }
   }
-    
-  return count;
-  
+  if (!positioned) {
+    FindPosition(key, false, &pos);
+    if (pos.next != nullptr && Equal(key, pos.next->key)) {
+      return false;
+    }
+  }
+
+  Node* x = NewNode(key);
+  Link(pos, x);
+  if (finger != nullptr) {
+    finger->last = x;
+  }
+  return true;
 }
 
 template <typename Key, class Comparator>
-AVLTree<Key, Comparator>::AVLTree(const Comparator cmp)
-    : compare_(cmp){
-    root = nullptr;
-    count_ = 0;
+bool AVLTree<Key, Comparator>::Insert(const Key& key) {
+  return Insert<false>(key, nullptr);
 }
 
-template<typename Key, class Comparator>
-void AVLTree<Key, Comparator>::Insert(const Key& key) {
-  if (root == nullptr){
-     root = NewNode(key);
-     return;
-  }
-  /*Find position to insert*/
-  Node* cur_node = root;
-  Node* cur_parent = nullptr;
-  while (cur_node){
-    cur_parent = cur_node;
-    if (LessThan(key, cur_node->key))
-      cur_node = cur_node->Left();
-    else 
-      cur_node = cur_node->Right();
-  }
-  /*Create new node and insert*/
-  cur_node = NewNode(key);
-  if (LessThan(key,cur_parent->key))
-    cur_parent->SetLeft(cur_node);
-  else
-    cur_parent->SetRight(cur_node);
-  cur_node->SetParent(cur_parent);
-
-  int hl = height(cur_node->Left());
-  int hr = height(cur_node->Right());
-  cur_node->SetHeight((hl > hr? hl : hr)+1);
- // cur_node->SetHeight(max(cur_node->Left(), cur_node->Right())+1);
-  int bf;
-  /*balance*/  
-  while (cur_parent!=nullptr){
-    bf = getbf(cur_parent);
-    if (bf==0)
-      return ;
-    else if (bf==-1 || bf ==1){
-      cur_node = cur_parent;
-      cur_parent = cur_node->Parent();
-    }
-    else {//Not balance
-      if (bf==2){// Right subtree is higher
-        if (getbf(cur_node)==1)
-          LL(cur_parent);
-        else
-          RL(cur_parent);
-      }
-      else{
-        if (getbf(cur_node)==-1)
-          RR(cur_parent);
-        else
-          LR(cur_parent);
-      }
-    }
-    break;
+template <typename Key, class Comparator>
+bool AVLTree<Key, Comparator>::InsertWithHint(const Key& key, void** hint) {
+  assert(hint != nullptr);
+  Finger* finger = reinterpret_cast<Finger*>(*hint);
+  if (finger == nullptr) {
+    char* mem = allocator_->AllocateAligned(sizeof(Finger));
+    finger = new (mem) Finger();
+    *hint = finger;
   }
-  count_ ++;
+  return Insert<false>(key, finger);
 }
 
-template<typename Key, class Comparator>
-bool AVLTree<Key, Comparator>::Contains(const Key& key) const {
-  Node *x= root;
-  while (x){
-    if (Equal(x->key,key))
-      return true;
-    if (LessThan(key, x->key))
-      x = x->Left();
-    else 
-      x = x->Right();
+template <typename Key, class Comparator>
+bool AVLTree<Key, Comparator>::InsertConcurrently(const Key& key) {
+  return Insert<true>(key, nullptr);
+}
+
+template <typename Key, class Comparator>
+bool AVLTree<Key, Comparator>::InsertWithHintConcurrently(const Key& key,
+                                                          void** hint) {
+  assert(hint != nullptr);
+  Finger* finger = reinterpret_cast<Finger*>(*hint);
+  if (finger == nullptr) {
+    char* mem = new char[sizeof(Finger)];
+    finger = new (mem) Finger();
+    *hint = finger;
+  }
+  return Insert<true>(key, finger);
+}
+
+template <typename Key, class Comparator>
+int AVLTree<Key, Comparator>::ValidateSubtree(Node* x, Node* parent) const {
+  if (x == nullptr) {
+    return 0;
   }
-  return false;
+  assert(x->Parent() == parent);
+  assert((x->Version() & 1) == 0);
+  Node* left = x->Child(kLeft);
+  Node* right = x->Child(kRight);
+  assert(left == nullptr || LessThan(left->key, x->key));
+  assert(right == nullptr || LessThan(x->key, right->key));
+  int hl = ValidateSubtree(left, x);
+  int hr = ValidateSubtree(right, x);
+  assert(hl - hr <= 1 && hr - hl <= 1);
+  assert(x->height == (hl > hr ? hl : hr) + 1);
+  assert(x->Size() == Size(left) + Size(right) + 1);
+  return x->height;
+}
 
+template <typename Key, class Comparator>
+void AVLTree<Key, Comparator>::TEST_Validate() const {
+  assert((rotations_.load(std::memory_order_relaxed) & 1) == 0);
+  ValidateSubtree(head_->Child(kRight), nullptr);
+  // Subtree order alone does not bound keys by their ancestors, so also
+  // check the in-order walk.
+  uint64_t n = 0;
+  for (Node* x = FindEdge(kLeft); x != nullptr; x = x->Step(kRight)) {
+    Node* next = x->Step(kRight);
+    assert(next == nullptr || LessThan(x->key, next->key));
+    (void)next;
+    n++;
+  }
+  assert(n == Count());
+  assert(n == Size(head_->Child(kRight)));
+  (void)n;
 }
 
-}  // namespace ROCKSDB_NAMESPACE
+template <typename Key, class Comparator>
+bool AVLTree<Key, Comparator>::Contains(const Key& key) const {
+  Node* x = FindGreaterOrEqual(key);
+  return x != nullptr && Equal(key, x->key);
+}
 
-#endif  // ROCKSDB_LITE
+}  // namespace ROCKSDB_NAMESPACE
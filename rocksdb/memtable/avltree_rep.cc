@@ -1,55 +1,104 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
 
 #ifndef ROCKSDB_LITE
 #include "memtable/avltree_rep.h"
 
 #include "db/memtable.h"
-#include "memtable/avltree.h"
 #include "memory/arena.h"
+#include "memtable/avltree.h"
+#include "port/port.h"
 #include "rocksdb/memtablerep.h"
 
 namespace ROCKSDB_NAMESPACE {
 namespace {
 
 class AVLTreeRep : public MemTableRep {
-  typedef AVLTree<const char* , const MemTableRep::KeyComparator&> Bucket;
- private:
-  Allocator* const allocator_;
-  const SliceTransform* transform_;
-  const MemTableRep::KeyComparator& compare_;
-  AVLTree<const char*, const MemTableRep::KeyComparator&> avltree_;
-  mutable port::RWMutex rwlock_;
+  AVLTree<const char*, const MemTableRep::KeyComparator&> tree_;
+
  public:
-  AVLTreeRep(const MemTableRep::KeyComparator& compare,
-              Allocator* allocator, const SliceTransform* transform ): 
-                  MemTableRep(allocator),
-                  allocator_(allocator),
-                  transform_(transform),
-                  compare_(compare),
-                  avltree_(compare) 
-            {};
-  ~AVLTreeRep() {}
-  void Insert(KeyHandle handle) override;
-
-  bool Contains(const char* key) const override;
+  explicit AVLTreeRep(const MemTableRep::KeyComparator& compare,
+                      Allocator* allocator)
+      : MemTableRep(allocator), tree_(compare, allocator) {}
+
+  // Insert key into the tree.
+  // REQUIRES: nothing that compares equal to key is currently in the tree.
+  void Insert(KeyHandle handle) override {
+    tree_.Insert(static_cast<char*>(handle));
+  }
 
-  void Get(const LookupKey& k, void* callback_args,
-           bool (*callback_func)(void* arg, const char* entry)) override;
-  size_t ApproximateMemoryUsage() override{
-    return sizeof(avltree_) + avltree_.Size();
+  bool InsertKey(KeyHandle handle) override {
+    return tree_.Insert(static_cast<char*>(handle));
+  }
+
+  void InsertWithHint(KeyHandle handle, void** hint) override {
+    tree_.InsertWithHint(static_cast<char*>(handle), hint);
+  }
+
+  bool InsertKeyWithHint(KeyHandle handle, void** hint) override {
+    return tree_.InsertWithHint(static_cast<char*>(handle), hint);
+  }
+
+  void InsertWithHintConcurrently(KeyHandle handle, void** hint) override {
+    tree_.InsertWithHintConcurrently(static_cast<char*>(handle), hint);
+  }
+
+  bool InsertKeyWithHintConcurrently(KeyHandle handle, void** hint) override {
+    return tree_.InsertWithHintConcurrently(static_cast<char*>(handle), hint);
+  }
+
+  void InsertConcurrently(KeyHandle handle) override {
+    tree_.InsertConcurrently(static_cast<char*>(handle));
+  }
+
+  bool InsertKeyConcurrently(KeyHandle handle) override {
+    return tree_.InsertConcurrently(static_cast<char*>(handle));
+  }
+
+  // Returns true iff an entry that compares equal to key is in the tree.
+  bool Contains(const char* key) const override { return tree_.Contains(key); }
+
+  // Exact unless inserts run concurrently: every node tracks the size of its
+  // subtree, so both ranks come from a single descent.
+  uint64_t ApproximateNumEntries(const Slice& start_ikey,
+                                 const Slice& end_ikey) override {
+    std::string tmp;
+    uint64_t start_count = tree_.EstimateCount(EncodeKey(&tmp, start_ikey));
+    uint64_t end_count = tree_.EstimateCount(EncodeKey(&tmp, end_ikey));
+    return (end_count >= start_count) ? (end_count - start_count) : 0;
   }
-  Iterator* GetIterator(Arena* arena = nullptr) override{
-    return new AVLTreeRep::Iterator(&avltree_);
+
+  size_t ApproximateMemoryUsage() override {
+    // All memory is allocated through allocator; nothing to report here
+    return 0;
   }
 
+  void Get(const LookupKey& k, void* callback_args,
+           bool (*callback_func)(void* arg, const char* entry)) override {
+    AVLTreeRep::Iterator iter(&tree_);
+    Slice dummy_slice;
+    for (iter.Seek(dummy_slice, k.memtable_key().data());
+         iter.Valid() && callback_func(callback_args, iter.key());
+         iter.Next()) {
+    }
+  }
 
- private:
+  ~AVLTreeRep() override {}
 
+  // Iteration over the contents of the tree. Readers never lock; see the
+  // thread safety notes in memtable/avltree.h.
   class Iterator : public MemTableRep::Iterator {
     AVLTree<const char*, const MemTableRep::KeyComparator&>::Iterator iter_;
+
    public:
+    // Initialize an iterator over the specified tree.
+    // The returned iterator is not valid.
     explicit Iterator(
-           AVLTree<const char*, const MemTableRep::KeyComparator&> *tree )
-        : iter_(tree){}
+        const AVLTree<const char*, const MemTableRep::KeyComparator&>* tree)
+        : iter_(tree) {}
 
     ~Iterator() override {}
 
@@ -58,28 +107,19 @@ class AVLTreeRep : public MemTableRep {
 
     // Returns the key at the current position.
     // REQUIRES: Valid()
-    const char* key() const override {
-      assert(Valid());
-      return iter_.key();
-    }
+    const char* key() const override { return iter_.key(); }
 
     // Advances to the next position.
     // REQUIRES: Valid()
-    void Next() override {
-      assert(Valid());
-      iter_.Next();
-    }
+    void Next() override { iter_.Next(); }
 
     // Advances to the previous position.
     // REQUIRES: Valid()
-    void Prev() override {
-      assert(Valid());
-      iter_.Prev();
-    }
+    void Prev() override { iter_.Prev(); }
 
     // Advance to the first entry with a key >= target
     void Seek(const Slice& internal_key, const char* memtable_key) override {
-        if (memtable_key != nullptr) {
+      if (memtable_key != nullptr) {
         iter_.Seek(memtable_key);
       } else {
         iter_.Seek(EncodeKey(&tmp_, internal_key));
@@ -87,67 +127,43 @@ class AVLTreeRep : public MemTableRep {
     }
 
     // Retreat to the last entry with a key <= target
-    void SeekForPrev(const Slice& /*internal_key*/,
-                     const char* /*memtable_key*/) override {
-      // not supported
-      assert(false);
+    void SeekForPrev(const Slice& internal_key,
+                     const char* memtable_key) override {
+      if (memtable_key != nullptr) {
+        iter_.SeekForPrev(memtable_key);
+      } else {
+        iter_.SeekForPrev(EncodeKey(&tmp_, internal_key));
+      }
     }
 
     // Position at the first entry in collection.
     // Final state of iterator is Valid() iff collection is not empty.
-    void SeekToFirst() override {
-        iter_.SeekToFirst();
-    }
+    void SeekToFirst() override { iter_.SeekToFirst(); }
 
     // Position at the last entry in collection.
     // Final state of iterator is Valid() iff collection is not empty.
-    void SeekToLast() override {
-        iter_.SeekToLast();
-    }
+    void SeekToLast() override { iter_.SeekToLast(); }
+
    protected:
     std::string tmp_;       // For passing to EncodeKey
-
   };
 
+  MemTableRep::Iterator* GetIterator(Arena* arena = nullptr) override {
+    void* mem = arena ? arena->AllocateAligned(sizeof(AVLTreeRep::Iterator))
+                      : operator new(sizeof(AVLTreeRep::Iterator));
+    return new (mem) AVLTreeRep::Iterator(&tree_);
+  }
 };
 
-
-
-void AVLTreeRep::Insert(KeyHandle handle) {
-  auto* key = static_cast<char*>(handle);
-  assert(!Contains(key));
-  WriteLock l(&rwlock_);
-  avltree_.Insert(key);
-}
-
-bool AVLTreeRep::Contains(const char* key) const {
-  ReadLock l(&rwlock_);
-  return avltree_.Contains(key);
-}
-
-
-void AVLTreeRep::Get(const LookupKey& k, void* callback_args,
-                          bool (*callback_func)(void* arg, const char* entry)) {
-   AVLTreeRep::Iterator iter(&avltree_);
-   for (iter.Seek(k.user_key(), k.memtable_key().data());
-        iter.Valid() && callback_func(callback_args, iter.key()); iter.Next()) {
-   }
-}
-
-
-
-
-} // anon namespace
+}  // anon namespace
 
 MemTableRep* AVLTreeRepFactory::CreateMemTableRep(
     const MemTableRep::KeyComparator& compare, Allocator* allocator,
-    const SliceTransform* transform, Logger* /*logger*/) {
-  return new AVLTreeRep(compare, allocator, transform);
+    const SliceTransform* /*transform*/, Logger* /*logger*/) {
+  return new AVLTreeRep(compare, allocator);
 }
 
-MemTableRepFactory* NewAVLTreeRepFactory() {
-  return new AVLTreeRepFactory();
-}
+MemTableRepFactory* NewAVLTreeRepFactory() { return new AVLTreeRepFactory(); }
 
 }  // namespace ROCKSDB_NAMESPACE
 #endif  // ROCKSDB_LITE
@@ -1,3 +1,8 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
 #pragma once
 #ifndef ROCKSDB_LITE
 #include "rocksdb/slice_transform.h"
@@ -7,7 +12,7 @@ namespace ROCKSDB_NAMESPACE {
 
 class AVLTreeRepFactory : public MemTableRepFactory {
  public:
-  explicit AVLTreeRepFactory(){ }
+  AVLTreeRepFactory() {}
 
   virtual ~AVLTreeRepFactory() {}
 
@@ -20,6 +25,9 @@ class AVLTreeRepFactory : public MemTableRepFactory {
     return "AVLTreeRepFactory";
   }
 
+  bool IsInsertConcurrentlySupported() const override { return true; }
+
+  bool CanHandleDuplicatedKey() const override { return true; }
 };
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -0,0 +1,646 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memtable/avltree.h"
+#include <set>
+#include "memory/arena.h"
+#include "memory/concurrent_arena.h"
+#include "rocksdb/env.h"
+#include "test_util/testharness.h"
+#include "util/hash.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+typedef uint64_t Key;
+
+struct TestComparator {
+  int operator()(const Key& a, const Key& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+};
+
+typedef AVLTree<Key, TestComparator> TestAVLTree;
+
+class AVLTreeTest : public testing::Test {
+ public:
+  void Validate(TestAVLTree* tree) {
+    // Check keys exist.
+    for (Key key : keys_) {
+      ASSERT_TRUE(tree->Contains(key));
+    }
+    // Iterate over the tree and make sure keys appear in order and no extra
+    // keys exist.
+    TestAVLTree::Iterator iter(tree);
+    ASSERT_FALSE(iter.Valid());
+    iter.SeekToFirst();
+    uint64_t rank = 0;
+    for (Key key : keys_) {
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(key, iter.key());
+      ASSERT_EQ(rank++, tree->EstimateCount(key));
+      iter.Next();
+    }
+    ASSERT_FALSE(iter.Valid());
+    ASSERT_EQ(keys_.size(), tree->Count());
+    tree->TEST_Validate();
+  }
+
+  bool InsertWithHint(TestAVLTree* tree, Key key, void** hint) {
+    bool res = tree->InsertWithHint(key, hint);
+    keys_.insert(key);
+    return res;
+  }
+
+  bool Insert(TestAVLTree* tree, Key key) {
+    bool res = tree->Insert(key);
+    keys_.insert(key);
+    return res;
+  }
+
+ private:
+  std::set<Key> keys_;
+};
+
+TEST_F(AVLTreeTest, Empty) {
+  Arena arena;
+  TestComparator cmp;
+  AVLTree<Key, TestComparator> tree(cmp, &arena);
+  ASSERT_TRUE(!tree.Contains(10));
+  ASSERT_EQ(0U, tree.Count());
+  ASSERT_EQ(0U, tree.EstimateCount(10));
+
+  AVLTree<Key, TestComparator>::Iterator iter(&tree);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  iter.Seek(100);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekForPrev(100);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST_F(AVLTreeTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  Random rnd(1000);
+  std::set<Key> keys;
+  Arena arena;
+  TestComparator cmp;
+  AVLTree<Key, TestComparator> tree(cmp, &arena);
+  for (int i = 0; i < N; i++) {
+    Key key = rnd.Next() % R;
+    bool inserted = keys.insert(key).second;
+    ASSERT_EQ(inserted, tree.Insert(key));
+  }
+  ASSERT_EQ(keys.size(), tree.Count());
+  tree.TEST_Validate();
+
+  for (int i = 0; i < R; i++) {
+    if (tree.Contains(i)) {
+      ASSERT_EQ(keys.count(i), 1U);
+    } else {
+      ASSERT_EQ(keys.count(i), 0U);
+    }
+  }
+
+  // Simple iterator tests
+  {
+    AVLTree<Key, TestComparator>::Iterator iter(&tree);
+    ASSERT_TRUE(!iter.Valid());
+
+    iter.Seek(0);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*(keys.begin()), iter.key());
+
+    iter.SeekForPrev(R - 1);
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*(keys.rbegin()), iter.key());
+
+    iter.SeekToFirst();
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*(keys.begin()), iter.key());
+
+    iter.SeekToLast();
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(*(keys.rbegin()), iter.key());
+  }
+
+  // Forward iteration test
+  for (int i = 0; i < R; i++) {
+    AVLTree<Key, TestComparator>::Iterator iter(&tree);
+    iter.Seek(i);
+
+    // Compare against model iterator
+    std::set<Key>::iterator model_iter = keys.lower_bound(i);
+    for (int j = 0; j < 3; j++) {
+      if (model_iter == keys.end()) {
+        ASSERT_TRUE(!iter.Valid());
+        break;
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*model_iter, iter.key());
+        ++model_iter;
+        iter.Next();
+      }
+    }
+  }
+
+  // Backward iteration test
+  for (int i = 0; i < R; i++) {
+    AVLTree<Key, TestComparator>::Iterator iter(&tree);
+    iter.SeekForPrev(i);
+
+    // Compare against model iterator
+    std::set<Key>::iterator model_iter = keys.upper_bound(i);
+    for (int j = 0; j < 3; j++) {
+      if (model_iter == keys.begin()) {
+        ASSERT_TRUE(!iter.Valid());
+        break;
+      } else {
+        ASSERT_TRUE(iter.Valid());
+        ASSERT_EQ(*--model_iter, iter.key());
+        iter.Prev();
+      }
+    }
+  }
+
+  // Rank test
+  uint64_t rank = 0;
+  for (int i = 0; i < R; i++) {
+    ASSERT_EQ(rank, tree.EstimateCount(i));
+    rank += keys.count(i);
+  }
+}
+
+// Ascending and descending inserts drive the rebalancing code through every
+// rotation; a full scan in both directions must still see every key once.
+TEST_F(AVLTreeTest, SequentialInsert) {
+  const Key N = 10000;
+  for (bool ascending : {true, false}) {
+    Arena arena;
+    TestComparator cmp;
+    AVLTree<Key, TestComparator> tree(cmp, &arena);
+    for (Key i = 0; i < N; i++) {
+      tree.Insert(ascending ? i : N - 1 - i);
+    }
+    ASSERT_EQ(N, tree.Count());
+    tree.TEST_Validate();
+
+    AVLTree<Key, TestComparator>::Iterator iter(&tree);
+    Key expected = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      ASSERT_EQ(expected++, iter.key());
+    }
+    ASSERT_EQ(N, expected);
+    for (iter.SeekToLast(); iter.Valid(); iter.Prev()) {
+      ASSERT_EQ(--expected, iter.key());
+    }
+    ASSERT_EQ(0U, expected);
+  }
+}
+
+// Subtree sizes must survive every kind of rotation, so the count of keys in
+// any range is exact.
+TEST_F(AVLTreeTest, RangeCount) {
+  const int N = 20000;
+  const int R = 100000;
+  Random rnd(301);
+  std::set<Key> keys;
+  Arena arena;
+  TestComparator cmp;
+  TestAVLTree tree(cmp, &arena);
+  for (int i = 0; i < N; i++) {
+    Key key = rnd.Uniform(R);
+    keys.insert(key);
+    tree.Insert(key);
+  }
+  tree.TEST_Validate();
+  ASSERT_EQ(keys.size(), tree.EstimateCount(R));
+
+  for (int i = 0; i < 1000; i++) {
+    Key start = rnd.Uniform(R);
+    Key end = start + rnd.Uniform(R / 10);
+    uint64_t expected = std::distance(keys.lower_bound(start),
+                                      keys.lower_bound(end));
+    ASSERT_EQ(expected, tree.EstimateCount(end) - tree.EstimateCount(start));
+  }
+}
+
+TEST_F(AVLTreeTest, InsertWithHint_Sequential) {
+  const int N = 100000;
+  Arena arena;
+  TestComparator cmp;
+  TestAVLTree tree(cmp, &arena);
+  void* hint = nullptr;
+  for (int i = 0; i < N; i++) {
+    ASSERT_TRUE(InsertWithHint(&tree, i, &hint));
+  }
+  ASSERT_FALSE(InsertWithHint(&tree, N / 2, &hint));
+  Validate(&tree);
+}
+
+TEST_F(AVLTreeTest, InsertWithHint_FingerSearch) {
+  const int N = 100000;
+  Arena arena;
+  TestComparator cmp;
+  TestAVLTree tree(cmp, &arena);
+  for (int i = 0; i < N; i += 2) {
+    ASSERT_TRUE(Insert(&tree, i));
+  }
+  // Each key lands past the entry after the previous one, so the hint has
+  // to search forward rather than take the slot right after it.
+  void* hint = nullptr;
+  for (int i = 1; i < N; i += 2) {
+    ASSERT_TRUE(InsertWithHint(&tree, i, &hint));
+    if (i % 1000 == 1) {
+      ASSERT_FALSE(InsertWithHint(&tree, i + 1, &hint));
+    }
+  }
+  // Keys far after the last one, then one before it
+  ASSERT_TRUE(InsertWithHint(&tree, 3 * N, &hint));
+  ASSERT_TRUE(InsertWithHint(&tree, 2 * N, &hint));
+  ASSERT_TRUE(InsertWithHint(&tree, 4 * N, &hint));
+  ASSERT_FALSE(InsertWithHint(&tree, 2 * N, &hint));
+  Validate(&tree);
+}
+
+TEST_F(AVLTreeTest, InsertWithHint_MultipleHints) {
+  const int N = 100000;
+  const int S = 100;
+  Random rnd(534);
+  Arena arena;
+  TestComparator cmp;
+  TestAVLTree tree(cmp, &arena);
+  void* hints[S];
+  Key last_key[S];
+  for (int i = 0; i < S; i++) {
+    hints[i] = nullptr;
+    last_key[i] = 0;
+  }
+  for (int i = 0; i < N; i++) {
+    Key s = rnd.Uniform(S);
+    Key key = (s << 32) + (++last_key[s]);
+    InsertWithHint(&tree, key, &hints[s]);
+  }
+  Validate(&tree);
+}
+
+TEST_F(AVLTreeTest, InsertWithHint_CompatibleWithInsertWithoutHint) {
+  const int N = 100000;
+  const int S = 100;
+  Random rnd(534);
+  Arena arena;
+  TestComparator cmp;
+  TestAVLTree tree(cmp, &arena);
+  void* hints[S];
+  for (int i = 0; i < S; i++) {
+    hints[i] = nullptr;
+  }
+  for (int i = 0; i < N; i++) {
+    Key s = rnd.Uniform(2 * S);
+    Key key = (s << 32) + rnd.Next();
+    if (s < S) {
+      InsertWithHint(&tree, key, &hints[s]);
+    } else {
+      Insert(&tree, key);
+    }
+  }
+  Validate(&tree);
+}
+
+#ifndef ROCKSDB_VALGRIND_RUN
+// Same scheme as the skiplist concurrency tests: readers must observe every
+// key that was present when their iterator was created, while a single
+// writer (WriteStep) or several concurrent writers (ConcurrentWriteStep)
+// keep inserting.  Inserts trigger rotations, so this also exercises the
+// optimistic validation on the read path.
+//
+// Keys are <key,gen,hash> as in skiplist_test.cc.
+class ConcurrentTest {
+ public:
+  static const uint32_t K = 8;
+
+ private:
+  static uint64_t key(Key key) { return (key >> 40); }
+  static uint64_t gen(Key key) { return (key >> 8) & 0xffffffffu; }
+  static uint64_t hash(Key key) { return key & 0xff; }
+
+  static uint64_t HashNumbers(uint64_t k, uint64_t g) {
+    uint64_t data[2] = {k, g};
+    return Hash(reinterpret_cast<char*>(data), sizeof(data), 0);
+  }
+
+  static Key MakeKey(uint64_t k, uint64_t g) {
+    assert(k <= K);  // We sometimes pass K to seek to the end of the tree
+    assert(g <= 0xffffffffu);
+    return ((k << 40) | (g << 8) | (HashNumbers(k, g) & 0xff));
+  }
+
+  static bool IsValidKey(Key k) {
+    return hash(k) == (HashNumbers(key(k), gen(k)) & 0xff);
+  }
+
+  static Key RandomTarget(Random* rnd) {
+    switch (rnd->Next() % 10) {
+      case 0:
+        // Seek to beginning
+        return MakeKey(0, 0);
+      case 1:
+        // Seek to end
+        return MakeKey(K, 0);
+      default:
+        // Seek to middle
+        return MakeKey(rnd->Next() % K, 0);
+    }
+  }
+
+  // Per-key generation
+  struct State {
+    std::atomic<int> generation[K];
+    void Set(int k, int v) {
+      generation[k].store(v, std::memory_order_release);
+    }
+    int Get(int k) { return generation[k].load(std::memory_order_acquire); }
+
+    State() {
+      for (unsigned int k = 0; k < K; k++) {
+        Set(k, 0);
+      }
+    }
+  };
+
+  // Current state of the test
+  State current_;
+
+  ConcurrentArena arena_;
+
+  TestAVLTree tree_;
+
+ public:
+  ConcurrentTest() : tree_(TestComparator(), &arena_) {}
+
+  // REQUIRES: No concurrent calls to WriteStep or ConcurrentWriteStep
+  void WriteStep(Random* rnd) {
+    const uint32_t k = rnd->Next() % K;
+    const int g = current_.Get(k) + 1;
+    tree_.Insert(MakeKey(k, g));
+    current_.Set(k, g);
+  }
+
+  // REQUIRES: No concurrent calls for the same k
+  void ConcurrentWriteStep(uint32_t k, bool use_hint = false) {
+    const int g = current_.Get(k) + 1;
+    const Key new_key = MakeKey(k, g);
+    if (use_hint) {
+      void* hint = nullptr;
+      ASSERT_TRUE(tree_.InsertWithHintConcurrently(new_key, &hint));
+      delete[] reinterpret_cast<char*>(hint);
+    } else {
+      ASSERT_TRUE(tree_.InsertConcurrently(new_key));
+    }
+    ASSERT_EQ(g, current_.Get(k) + 1);
+    current_.Set(k, g);
+  }
+
+  void ReadStep(Random* rnd) {
+    // Remember the initial committed state of the tree.
+    State initial_state;
+    for (unsigned int k = 0; k < K; k++) {
+      initial_state.Set(k, current_.Get(k));
+    }
+
+    Key pos = RandomTarget(rnd);
+    TestAVLTree::Iterator iter(&tree_);
+    iter.Seek(pos);
+    while (true) {
+      Key current;
+      if (!iter.Valid()) {
+        current = MakeKey(K, 0);
+      } else {
+        current = iter.key();
+        ASSERT_TRUE(IsValidKey(current)) << current;
+      }
+      ASSERT_LE(pos, current) << "should not go backwards";
+
+      // Verify that everything in [pos,current) was not present in
+      // initial_state.
+      while (pos < current) {
+        ASSERT_LT(key(pos), K) << pos;
+
+        // Note that generation 0 is never inserted, so it is ok if
+        // <*,0,*> is missing.
+        ASSERT_TRUE((gen(pos) == 0U) ||
+                    (gen(pos) > static_cast<uint64_t>(initial_state.Get(
+                                    static_cast<int>(key(pos))))))
+            << "key: " << key(pos) << "; gen: " << gen(pos)
+            << "; initgen: " << initial_state.Get(static_cast<int>(key(pos)));
+
+        // Advance to next key in the valid key space
+        if (key(pos) < key(current)) {
+          pos = MakeKey(key(pos) + 1, 0);
+        } else {
+          pos = MakeKey(key(pos), gen(pos) + 1);
+        }
+      }
+
+      if (!iter.Valid()) {
+        break;
+      }
+
+      if (rnd->Next() % 2) {
+        iter.Next();
+        pos = MakeKey(key(pos), gen(pos) + 1);
+      } else {
+        Key new_target = RandomTarget(rnd);
+        if (new_target > pos) {
+          pos = new_target;
+          iter.Seek(new_target);
+        }
+      }
+    }
+  }
+
+  void Validate() { tree_.TEST_Validate(); }
+};
+const uint32_t ConcurrentTest::K;
+
+// Simple test that does single-threaded testing of the ConcurrentTest
+// scaffolding.
+TEST_F(AVLTreeTest, ConcurrentReadWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    test.WriteStep(&rnd);
+  }
+  test.Validate();
+}
+
+TEST_F(AVLTreeTest, ConcurrentInsertWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    uint32_t base = rnd.Next();
+    for (int j = 0; j < 4; ++j) {
+      test.ConcurrentWriteStep((base + j) % ConcurrentTest::K, j % 2 == 0);
+    }
+  }
+  test.Validate();
+}
+
+class TestState {
+ public:
+  ConcurrentTest t_;
+  bool use_hint_;
+  int seed_;
+  std::atomic<bool> quit_flag_;
+  std::atomic<uint32_t> next_writer_;
+
+  enum ReaderState { STARTING, RUNNING, DONE };
+
+  explicit TestState(int s)
+      : use_hint_(false),
+        seed_(s),
+        quit_flag_(false),
+        state_(STARTING),
+        pending_writers_(0),
+        state_cv_(&mu_) {}
+
+  void Wait(ReaderState s) {
+    mu_.Lock();
+    while (state_ != s) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+  void Change(ReaderState s) {
+    mu_.Lock();
+    state_ = s;
+    state_cv_.Signal();
+    mu_.Unlock();
+  }
+
+  void AdjustPendingWriters(int delta) {
+    mu_.Lock();
+    pending_writers_ += delta;
+    if (pending_writers_ == 0) {
+      state_cv_.Signal();
+    }
+    mu_.Unlock();
+  }
+
+  void WaitForPendingWriters() {
+    mu_.Lock();
+    while (pending_writers_ != 0) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  ReaderState state_;
+  int pending_writers_;
+  port::CondVar state_cv_;
+};
+
+static void ConcurrentReader(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  Random rnd(state->seed_);
+  state->Change(TestState::RUNNING);
+  while (!state->quit_flag_.load(std::memory_order_acquire)) {
+    state->t_.ReadStep(&rnd);
+  }
+  state->Change(TestState::DONE);
+}
+
+static void ConcurrentWriter(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  uint32_t k = state->next_writer_++ % ConcurrentTest::K;
+  state->t_.ConcurrentWriteStep(k, state->use_hint_);
+  state->AdjustPendingWriters(-1);
+}
+
+static void RunConcurrentRead(int run) {
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 1000;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    if ((i % 100) == 0) {
+      fprintf(stderr, "Run %d of %d\n", i, N);
+    }
+    TestState state(seed + 1);
+    Env::Default()->SetBackgroundThreads(1);
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; ++k) {
+      state.t_.WriteStep(&rnd);
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+    state.t_.Validate();
+  }
+}
+
+static void RunConcurrentInsert(int run, bool use_hint = false,
+                                int write_parallelism = 4) {
+  Env::Default()->SetBackgroundThreads(1 + write_parallelism,
+                                       Env::Priority::LOW);
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 1000;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    if ((i % 100) == 0) {
+      fprintf(stderr, "Run %d of %d\n", i, N);
+    }
+    TestState state(seed + 1);
+    state.use_hint_ = use_hint;
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; k += write_parallelism) {
+      state.next_writer_ = rnd.Next();
+      state.AdjustPendingWriters(write_parallelism);
+      for (int p = 0; p < write_parallelism; ++p) {
+        Env::Default()->Schedule(ConcurrentWriter, &state);
+      }
+      state.WaitForPendingWriters();
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+    state.t_.Validate();
+  }
+}
+
+TEST_F(AVLTreeTest, ConcurrentRead1) { RunConcurrentRead(1); }
+TEST_F(AVLTreeTest, ConcurrentRead2) { RunConcurrentRead(2); }
+TEST_F(AVLTreeTest, ConcurrentInsert1) { RunConcurrentInsert(1); }
+TEST_F(AVLTreeTest, ConcurrentInsert2) { RunConcurrentInsert(2); }
+TEST_F(AVLTreeTest, ConcurrentInsertWithHint1) {
+  RunConcurrentInsert(1, true);
+}
+TEST_F(AVLTreeTest, ConcurrentInsertWithHint2) {
+  RunConcurrentInsert(2, true);
+}
+
+#endif  // ROCKSDB_VALGRIND_RUN
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
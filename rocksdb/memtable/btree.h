@@ -0,0 +1,874 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+// BTree is a B+-tree whose nodes are carved out of an Allocator (normally the
+// memtable's Arena), so, like SkipList, it never frees individual nodes.
+// Entries live only in the leaves, which are chained left to right; inner
+// nodes hold separator keys.  Next to its keys every node keeps an array of
+// 8-byte, order-preserving key prefixes.  A node search first compares the
+// target's prefix against that whole array with a few SIMD instructions and
+// then falls back to the comparator only for the keys whose prefix ties with
+// the target's, so most of a lookup touches a few contiguous cache lines per
+// level instead of one key per pointer hop.
+//
+// Besides operator(), the comparator must provide
+//
+//   uint64_t prefix(const Key& key) const;
+//
+// such that compare(a, b) < 0 implies prefix(a) <= prefix(b).  A comparator
+// that knows nothing about the layout of its keys may return a constant,
+// which turns every node search into a plain binary search.
+//
+// Thread safety
+// -------------
+//
+// Writes require external synchronization, most likely a mutex.  Reads never
+// lock.  Every node has a version that is odd while the writer modifies the
+// node.  A reader notes the version of a node, reads the node, and then
+// checks that the version did not move; on the way down it checks the parent
+// after it has noted the version of the child, so a validated path is one
+// that existed at some instant (optimistic lock coupling, see Leis et al.,
+// "The ART of Practical Synchronization", DaMoN 2016).  A reader that sees a
+// version move restarts from the root.  A split keeps every node it touches
+// odd until the separators have been pushed into all ancestors, so readers
+// never see a half-split tree.
+//
+// Invariants:
+//
+// (1) Allocated nodes are never deleted until the BTree is destroyed, so a
+// reader holding a stale pointer can always dereference it.
+//
+// (2) Every separator in an inner node is the smallest key of the subtree to
+// its right.  Since entries are never removed, each subtree but the leftmost
+// one of a node is nonempty.
+//
+// (3) All leaves are at the same depth, and the leaf chain visits the leaves
+// in key order.
+
+#pragma once
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include "memory/allocator.h"
+#include "port/port.h"
+#include "util/math.h"
+
+#ifdef HAVE_AVX2
+#include <immintrin.h>
+#elif defined(HAVE_SSE42)
+#include <nmmintrin.h>
+#endif
+
+namespace ROCKSDB_NAMESPACE {
+
+template <typename Key, class Comparator>
+class BTree {
+ private:
+  struct Node;
+  struct Leaf;
+  struct Inner;
+
+ public:
+  // Maximum number of keys in a node.  Must be a multiple of 4 for the SIMD
+  // prefix search.
+  static const int kNodeCapacity = 32;
+
+  // Create a new BTree object that will use "cmp" for comparing keys,
+  // and will allocate memory using "*allocator".  Objects allocated in the
+  // allocator must remain allocated for the lifetime of the tree object.
+  explicit BTree(Comparator cmp, Allocator* allocator);
+  // No copying allowed
+  BTree(const BTree&) = delete;
+  void operator=(const BTree&) = delete;
+
+  // Insert key into the tree.
+  // REQUIRES: external synchronization against other inserts.
+  // Returns false and leaves the tree unchanged if an entry that compares
+  // equal to key is already in the tree.
+  bool Insert(const Key& key);
+
+  // Returns true iff an entry that compares equal to key is in the tree.
+  bool Contains(const Key& key) const;
+
+  // Return the number of entries in the tree.
+  uint64_t Count() const { return count_.load(std::memory_order_relaxed); }
+
+  // Validate correctness of the tree: key order, cached prefixes,
+  // separators, leaf depth and the leaf chain.  Requires that no insert runs
+  // concurrently.
+  void TEST_Validate() const;
+
+  // Iteration over the contents of the tree
+  class Iterator {
+   public:
+    // Initialize an iterator over the specified tree.
+    // The returned iterator is not valid.
+    explicit Iterator(const BTree* tree);
+
+    // Change the underlying tree used for this iterator
+    // This enables us not changing the iterator without deallocating
+    // an old one and then allocating a new one
+    void SetList(const BTree* tree);
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const;
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const Key& key() const;
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next();
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev();
+
+    // Advance to the first entry with a key >= target
+    void Seek(const Key& target);
+
+    // Retreat to the last entry with a key <= target
+    void SeekForPrev(const Key& target);
+
+    // Position at the first entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToFirst();
+
+    // Position at the last entry in the tree.
+    // Final state of iterator is Valid() iff tree is not empty.
+    void SeekToLast();
+
+   private:
+    const BTree* tree_;
+    Leaf* leaf_;
+    int index_;
+    // Version of leaf_ when index_ was read; while it holds, index_ +/- 1
+    // are the neighbors of the current entry.
+    uint32_t version_;
+    Key key_;
+    // Intentionally copyable
+  };
+
+ private:
+  // Bound on the depth of the tree.  Every split leaves at least one full
+  // node or two half-full ones, so the fanout is far above 2 in practice.
+  static const int kMaxHeight = 32;
+
+  // An entry in a leaf, together with the leaf version it was read at.
+  // leaf is nullptr if there is no such entry.
+  struct Position {
+    Leaf* leaf;
+    int index;
+    uint32_t version;
+    Key key;
+  };
+
+  // Immutable after construction
+  Comparator const compare_;
+  Allocator* const allocator_;  // Allocator used for allocations of nodes
+
+  std::atomic<Node*> root_;
+
+  // Modified only by Insert(), which is externally synchronized.
+  std::atomic<uint64_t> count_;
+
+  Leaf* NewLeaf();
+  Inner* NewInner();
+
+  bool Equal(const Key& a, const Key& b) const { return (compare_(a, b) == 0); }
+
+  // Prefixes are stored with the sign bit flipped, so that signed 64-bit
+  // compares, the only kind SSE and AVX2 have, order them as unsigned.
+  static int64_t Bias(uint64_t prefix) {
+    return static_cast<int64_t>(prefix ^ (uint64_t{1} << 63));
+  }
+  int64_t BiasedPrefix(const Key& key) const {
+    return Bias(compare_.prefix(key));
+  }
+
+  // Sets *lo to the number of the first n prefixes that are smaller than p
+  // and *hi to the number that are not greater.
+  static void PrefixRange(const int64_t* prefixes, int n, int64_t p, int* lo,
+                          int* hi);
+
+  // Returns the number of the first n keys of x that are less than key, or
+  // not greater than key if inclusive.  p is key's biased prefix.  The result
+  // is only meaningful if x's version holds across the call.
+  int Rank(Node* x, int n, const Key& key, int64_t p, bool inclusive) const;
+
+  // Fills *pos with the first entry greater than key (or not less than key,
+  // if !inclusive), or, if backward, with the last entry less than key (or
+  // not greater than key, if inclusive).
+  void Find(const Key& key, bool inclusive, bool backward,
+            Position* pos) const;
+
+  // Fills *pos with the first or last entry of the tree.
+  void FindEdge(bool last, Position* pos) const;
+
+  // Moves *pos one entry forward or backward without a search.  Returns
+  // false if pos->leaf has changed since *pos was filled.
+  bool Step(bool backward, Position* pos) const;
+
+  // Fills *pos with the first entry of leaf x.  Returns false if x is being
+  // modified.
+  bool ReadFirst(Leaf* x, Position* pos) const;
+
+  // Makes room at slot i of x, which holds n keys, and stores key there.
+  // REQUIRES: n < kNodeCapacity, x is being written.
+  static void InsertKey(Node* x, int n, int i, const Key& key, int64_t p);
+
+  // Moves the keys [from, n) of leaf x to the empty leaf right.
+  static void MoveKeys(Node* x, int from, int n, Node* right);
+
+  // Checks the subtree rooted at x and returns its depth.  lower is the
+  // separator bounding x from the left, or nullptr for the leftmost subtree;
+  // *leftmost receives the smallest key in the subtree and *next_leaf is
+  // advanced along the leaf chain.
+  int ValidateSubtree(Node* x, const Key* lower, Key* leftmost,
+                      Leaf** next_leaf, uint64_t* entries) const;
+};
+
+// Implementation details follow
+template <typename Key, class Comparator>
+struct BTree<Key, Comparator>::Node {
+  explicit Node(bool is_leaf) : leaf(is_leaf), version_(0), count_(0) {
+    for (int i = 0; i < kNodeCapacity; i++) {
+      prefix[i] = 0;
+      keys_[i].store(Key(), std::memory_order_relaxed);
+    }
+  }
+
+  const bool leaf;
+
+  // Biased prefixes of the keys.  Plain memory, so it can be searched with
+  // SIMD loads; a reader that races with the writer will fail validation.
+  int64_t prefix[kNodeCapacity];
+
+  // Number of keys.  Its release store publishes the keys below it.
+  int Count() const {
+    int n = count_.load(std::memory_order_acquire);
+    // Clamp so that a reader racing with a split never indexes out of range
+    return n < kNodeCapacity ? n : kNodeCapacity;
+  }
+  void SetCount(int n) { count_.store(n, std::memory_order_release); }
+
+  // Accessors/mutators for keys.  Wrapped in methods so we can
+  // add the appropriate barriers as necessary.
+  Key KeyAt(int i) const { return keys_[i].load(std::memory_order_acquire); }
+  void SetKey(int i, const Key& key, int64_t p) {
+    prefix[i] = p;
+    keys_[i].store(key, std::memory_order_release);
+  }
+
+  // Returns the current version, which is odd while a write is in progress.
+  uint32_t Version() const { return version_.load(std::memory_order_acquire); }
+
+  // Returns true iff the version is still v, i.e. nothing read from this node
+  // since v was loaded has been modified.
+  bool Validate(uint32_t v) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return version_.load(std::memory_order_relaxed) == v;
+  }
+
+  // Bracket a modification of this node.  The fence makes sure that a reader
+  // who observes any store made inside the bracket also observes the odd
+  // version.
+  void BeginWrite() {
+    assert((version_.load(std::memory_order_relaxed) & 1) == 0);
+    version_.store(version_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+  void EndWrite() {
+    version_.store(version_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint32_t> version_;
+  std::atomic<int> count_;
+  std::atomic<Key> keys_[kNodeCapacity];
+};
+
+template <typename Key, class Comparator>
+struct BTree<Key, Comparator>::Leaf : public Node {
+  Leaf() : Node(true) { next_.store(nullptr, std::memory_order_relaxed); }
+
+  Leaf* Next() const { return next_.load(std::memory_order_acquire); }
+  void SetNext(Leaf* x) { next_.store(x, std::memory_order_release); }
+
+ private:
+  std::atomic<Leaf*> next_;
+};
+
+// An inner node with n separators has n + 1 children.
+template <typename Key, class Comparator>
+struct BTree<Key, Comparator>::Inner : public Node {
+  Inner() : Node(false) {
+    for (int i = 0; i <= kNodeCapacity; i++) {
+      child_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  Node* Child(int i) const { return child_[i].load(std::memory_order_acquire); }
+  void SetChild(int i, Node* x) {
+    child_[i].store(x, std::memory_order_release);
+  }
+
+ private:
+  std::atomic<Node*> child_[kNodeCapacity + 1];
+};
+
+template <typename Key, class Comparator>
+typename BTree<Key, Comparator>::Leaf* BTree<Key, Comparator>::NewLeaf() {
+  char* mem = allocator_->AllocateAligned(sizeof(Leaf));
+  return new (mem) Leaf();
+}
+
+template <typename Key, class Comparator>
+typename BTree<Key, Comparator>::Inner* BTree<Key, Comparator>::NewInner() {
+  char* mem = allocator_->AllocateAligned(sizeof(Inner));
+  return new (mem) Inner();
+}
+
+template <typename Key, class Comparator>
+BTree<Key, Comparator>::BTree(const Comparator cmp, Allocator* allocator)
+    : compare_(cmp), allocator_(allocator), count_(0) {
+  static_assert(kNodeCapacity % 4 == 0 && kNodeCapacity < 64,
+                "kNodeCapacity must be a multiple of 4 that fits a bitmask");
+  root_.store(NewLeaf(), std::memory_order_relaxed);
+}
+
+template <typename Key, class Comparator>
+inline BTree<Key, Comparator>::Iterator::Iterator(const BTree* tree) {
+  SetList(tree);
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::SetList(const BTree* tree) {
+  tree_ = tree;
+  leaf_ = nullptr;
+}
+
+template <typename Key, class Comparator>
+inline bool BTree<Key, Comparator>::Iterator::Valid() const {
+  return leaf_ != nullptr;
+}
+
+template <typename Key, class Comparator>
+inline const Key& BTree<Key, Comparator>::Iterator::key() const {
+  assert(Valid());
+  return key_;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::Next() {
+  assert(Valid());
+  Position pos = {leaf_, index_, version_, key_};
+  if (!tree_->Step(false, &pos)) {
+    // The leaf changed under us, so search for the successor instead
+    tree_->Find(key_, true, false, &pos);
+  }
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::Prev() {
+  assert(Valid());
+  Position pos = {leaf_, index_, version_, key_};
+  if (!tree_->Step(true, &pos)) {
+    tree_->Find(key_, false, true, &pos);
+  }
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::Seek(const Key& target) {
+  Position pos;
+  tree_->Find(target, false, false, &pos);
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::SeekForPrev(const Key& target) {
+  Position pos;
+  tree_->Find(target, true, true, &pos);
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::SeekToFirst() {
+  Position pos;
+  tree_->FindEdge(false, &pos);
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+inline void BTree<Key, Comparator>::Iterator::SeekToLast() {
+  Position pos;
+  tree_->FindEdge(true, &pos);
+  leaf_ = pos.leaf;
+  index_ = pos.index;
+  version_ = pos.version;
+  key_ = pos.key;
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::PrefixRange(const int64_t* prefixes, int n,
+                                         int64_t p, int* lo, int* hi) {
+  // Bit i of "less" is set iff prefixes[i] < p, and bit i of "greater" iff
+  // prefixes[i] > p.  Slots at or past n hold stale or zero prefixes and are
+  // masked off below; kNodeCapacity is a multiple of the vector width, so
+  // the loads never leave the array.
+  uint64_t less = 0;
+  uint64_t greater = 0;
+#ifdef HAVE_AVX2
+  const __m256i target = _mm256_set1_epi64x(p);
+  for (int i = 0; i < n; i += 4) {
+    const __m256i v =
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prefixes + i));
+    less |= static_cast<uint64_t>(_mm256_movemask_pd(
+                _mm256_castsi256_pd(_mm256_cmpgt_epi64(target, v))))
+            << i;
+    greater |= static_cast<uint64_t>(_mm256_movemask_pd(
+                   _mm256_castsi256_pd(_mm256_cmpgt_epi64(v, target))))
+               << i;
+  }
+#elif defined(HAVE_SSE42)
+  const __m128i target = _mm_set1_epi64x(p);
+  for (int i = 0; i < n; i += 2) {
+    const __m128i v =
+        _mm_loadu_si128(reinterpret_cast<const __m128i*>(prefixes + i));
+    less |= static_cast<uint64_t>(_mm_movemask_pd(
+                _mm_castsi128_pd(_mm_cmpgt_epi64(target, v))))
+            << i;
+    greater |= static_cast<uint64_t>(_mm_movemask_pd(
+                   _mm_castsi128_pd(_mm_cmpgt_epi64(v, target))))
+               << i;
+  }
+#else
+  for (int i = 0; i < n; i++) {
+    less |= static_cast<uint64_t>(prefixes[i] < p) << i;
+    greater |= static_cast<uint64_t>(prefixes[i] > p) << i;
+  }
+#endif
+  const uint64_t mask = (uint64_t{1} << n) - 1;
+  *lo = BitsSetToOne(less & mask);
+  *hi = n - BitsSetToOne(greater & mask);
+}
+
+template <typename Key, class Comparator>
+int BTree<Key, Comparator>::Rank(Node* x, int n, const Key& key, int64_t p,
+                                 bool inclusive) const {
+  int lo, hi;
+  PrefixRange(x->prefix, n, p, &lo, &hi);
+  // Only keys whose prefix ties with key's need a full compare
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    int cmp = compare_(x->KeyAt(mid), key);
+    if (cmp < 0 || (cmp == 0 && inclusive)) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+template <typename Key, class Comparator>
+bool BTree<Key, Comparator>::ReadFirst(Leaf* x, Position* pos) const {
+  uint32_t v = x->Version();
+  if ((v & 1) != 0) {
+    return false;
+  }
+  int n = x->Count();
+  Key k = x->KeyAt(0);
+  if (!x->Validate(v)) {
+    return false;
+  }
+  // Only the root leaf of an empty tree has no keys, and it has no next
+  assert(n > 0);
+  (void)n;
+  pos->leaf = x;
+  pos->index = 0;
+  pos->version = v;
+  pos->key = k;
+  return true;
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::Find(const Key& key, bool inclusive,
+                                  bool backward, Position* pos) const {
+  const int64_t p = BiasedPrefix(key);
+  while (true) {
+    Node* x = root_.load(std::memory_order_acquire);
+    uint32_t v = x->Version();
+    bool restart = (v & 1) != 0 || root_.load(std::memory_order_acquire) != x;
+    while (!restart && !x->leaf) {
+      int i = Rank(x, x->Count(), key, p, inclusive);
+      Node* c = static_cast<Inner*>(x)->Child(i);
+      if (c == nullptr) {
+        restart = true;
+        break;
+      }
+      // x's range contained key when v was read.  If x has not changed
+      // since, c's range contains key as of when cv was read.
+      uint32_t cv = c->Version();
+      if ((cv & 1) != 0 || !x->Validate(v)) {
+        restart = true;
+        break;
+      }
+      x = c;
+      v = cv;
+    }
+    if (!restart) {
+      Leaf* leaf = static_cast<Leaf*>(x);
+      int n = x->Count();
+      int i = Rank(x, n, key, p, inclusive);
+      if (backward) {
+        // By invariant (2), only the leftmost leaf can have nothing before
+        // key, and then the whole tree has nothing before key.
+        Key k = i > 0 ? x->KeyAt(i - 1) : Key();
+        if (x->Validate(v)) {
+          pos->leaf = i > 0 ? leaf : nullptr;
+          pos->index = i - 1;
+          pos->version = v;
+          pos->key = k;
+          return;
+        }
+      } else if (i < n) {
+        Key k = x->KeyAt(i);
+        if (x->Validate(v)) {
+          pos->leaf = leaf;
+          pos->index = i;
+          pos->version = v;
+          pos->key = k;
+          return;
+        }
+      } else {
+        // Everything in this leaf is before key; the answer is the first
+        // entry of the next leaf, if any.
+        Leaf* next = leaf->Next();
+        if (x->Validate(v)) {
+          if (next == nullptr) {
+            pos->leaf = nullptr;
+            return;
+          }
+          if (ReadFirst(next, pos)) {
+            return;
+          }
+        }
+      }
+    }
+    // The writer changed a node on our path; start over from the root
+    port::AsmVolatilePause();
+  }
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::FindEdge(bool last, Position* pos) const {
+  while (true) {
+    Node* x = root_.load(std::memory_order_acquire);
+    uint32_t v = x->Version();
+    bool restart = (v & 1) != 0 || root_.load(std::memory_order_acquire) != x;
+    while (!restart && !x->leaf) {
+      Node* c = static_cast<Inner*>(x)->Child(last ? x->Count() : 0);
+      if (c == nullptr) {
+        restart = true;
+        break;
+      }
+      uint32_t cv = c->Version();
+      if ((cv & 1) != 0 || !x->Validate(v)) {
+        restart = true;
+        break;
+      }
+      x = c;
+      v = cv;
+    }
+    if (!restart) {
+      int n = x->Count();
+      int i = last ? n - 1 : 0;
+      Key k = n > 0 ? x->KeyAt(i) : Key();
+      if (x->Validate(v)) {
+        pos->leaf = n > 0 ? static_cast<Leaf*>(x) : nullptr;
+        pos->index = i;
+        pos->version = v;
+        pos->key = k;
+        return;
+      }
+    }
+    port::AsmVolatilePause();
+  }
+}
+
+template <typename Key, class Comparator>
+bool BTree<Key, Comparator>::Step(bool backward, Position* pos) const {
+  Leaf* leaf = pos->leaf;
+  int n = leaf->Count();
+  int i = backward ? pos->index - 1 : pos->index + 1;
+  if (i >= 0 && i < n) {
+    Key k = leaf->KeyAt(i);
+    if (!leaf->Validate(pos->version)) {
+      return false;
+    }
+    pos->index = i;
+    pos->key = k;
+    return true;
+  }
+  if (backward) {
+    // Leaves have no back links; let the caller search
+    return false;
+  }
+  Leaf* next = leaf->Next();
+  if (!leaf->Validate(pos->version)) {
+    return false;
+  }
+  if (next == nullptr) {
+    pos->leaf = nullptr;
+    return true;
+  }
+  return ReadFirst(next, pos);
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::InsertKey(Node* x, int n, int i, const Key& key,
+                                       int64_t p) {
+  assert(n < kNodeCapacity);
+  // Shift from the right end, so that every slot below the count always
+  // holds some key.  The count goes up last.
+  for (int j = n; j > i; j--) {
+    x->SetKey(j, x->KeyAt(j - 1), x->prefix[j - 1]);
+  }
+  x->SetKey(i, key, p);
+  x->SetCount(n + 1);
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::MoveKeys(Node* x, int from, int n, Node* right) {
+  for (int j = from; j < n; j++) {
+    right->SetKey(j - from, x->KeyAt(j), x->prefix[j]);
+  }
+  right->SetCount(n - from);
+  x->SetCount(from);
+}
+
+template <typename Key, class Comparator>
+bool BTree<Key, Comparator>::Insert(const Key& key) {
+  const int64_t p = BiasedPrefix(key);
+
+  // Descend, remembering the path.  There is no other writer, so nothing on
+  // the path changes under us.
+  Inner* path[kMaxHeight];
+  int slot[kMaxHeight];
+  int depth = 0;
+  Node* x = root_.load(std::memory_order_relaxed);
+  while (!x->leaf) {
+    assert(depth < kMaxHeight);
+    // A key equal to a separator lives right of it, so route inclusively to
+    // find duplicates
+    int i = Rank(x, x->Count(), key, p, true);
+    path[depth] = static_cast<Inner*>(x);
+    slot[depth] = i;
+    depth++;
+    x = static_cast<Inner*>(x)->Child(i);
+  }
+  Leaf* leaf = static_cast<Leaf*>(x);
+  int n = leaf->Count();
+  int i = Rank(leaf, n, key, p, false);
+  if (i < n && Equal(key, leaf->KeyAt(i))) {
+    return false;
+  }
+  count_.store(count_.load(std::memory_order_relaxed) + 1,
+               std::memory_order_relaxed);
+
+  if (n < kNodeCapacity) {
+    leaf->BeginWrite();
+    InsertKey(leaf, n, i, key, p);
+    leaf->EndWrite();
+    return true;
+  }
+
+  // The leaf is full and splits.  Every node touched stays odd until the
+  // split has propagated as far up as it goes.
+  Node* locked[kMaxHeight + 1];
+  int num_locked = 0;
+  leaf->BeginWrite();
+  locked[num_locked++] = leaf;
+
+  // Appending to a full leaf, which is what ascending inserts do, moves
+  // nothing and leaves the old leaf full.
+  Leaf* right = NewLeaf();
+  const int mid = i == n ? n : n / 2;
+  MoveKeys(leaf, mid, n, right);
+  if (i <= mid && i < n) {
+    InsertKey(leaf, mid, i, key, p);
+  } else {
+    InsertKey(right, n - mid, i - mid, key, p);
+  }
+  right->SetNext(leaf->Next());
+  leaf->SetNext(right);
+
+  // Push (separator, new_child) into the ancestors, splitting full ones
+  Key separator = right->KeyAt(0);
+  int64_t separator_prefix = right->prefix[0];
+  Node* new_child = right;
+  while (new_child != nullptr && depth > 0) {
+    depth--;
+    Inner* parent = path[depth];
+    const int pos = slot[depth];
+    const int count = parent->Count();
+    parent->BeginWrite();
+    locked[num_locked++] = parent;
+    if (count < kNodeCapacity) {
+      for (int j = count + 1; j > pos + 1; j--) {
+        parent->SetChild(j, parent->Child(j - 1));
+      }
+      parent->SetChild(pos + 1, new_child);
+      InsertKey(parent, count, pos, separator, separator_prefix);
+      new_child = nullptr;
+      break;
+    }
+
+    // Split the full parent around separator m of the merged sequence; m
+    // moves up.  As with leaves, appending leaves the old node full.
+    Key keys[kNodeCapacity + 1];
+    int64_t prefixes[kNodeCapacity + 1];
+    Node* children[kNodeCapacity + 2];
+    for (int j = 0, k = 0; j <= count; j++) {
+      if (j == pos) {
+        keys[j] = separator;
+        prefixes[j] = separator_prefix;
+      } else {
+        keys[j] = parent->KeyAt(k);
+        prefixes[j] = parent->prefix[k];
+        k++;
+      }
+    }
+    for (int j = 0, k = 0; j <= count + 1; j++) {
+      children[j] = j == pos + 1 ? new_child : parent->Child(k++);
+    }
+    const int m = pos == count ? count : count / 2;
+
+    Inner* sibling = NewInner();
+    for (int j = m + 1; j <= count; j++) {
+      sibling->SetKey(j - m - 1, keys[j], prefixes[j]);
+    }
+    for (int j = m + 1; j <= count + 1; j++) {
+      sibling->SetChild(j - m - 1, children[j]);
+    }
+    sibling->SetCount(count - m);
+
+    for (int j = 0; j < m; j++) {
+      parent->SetKey(j, keys[j], prefixes[j]);
+    }
+    for (int j = 0; j <= m; j++) {
+      parent->SetChild(j, children[j]);
+    }
+    parent->SetCount(m);
+
+    separator = keys[m];
+    separator_prefix = prefixes[m];
+    new_child = sibling;
+  }
+
+  if (new_child != nullptr) {
+    // The root split; grow the tree by one level.  The old root is still
+    // odd, so readers that loaded it retry and pick up the new root.
+    Node* old_root = root_.load(std::memory_order_relaxed);
+    Inner* root = NewInner();
+    root->SetChild(0, old_root);
+    root->SetChild(1, new_child);
+    root->SetKey(0, separator, separator_prefix);
+    root->SetCount(1);
+    root_.store(root, std::memory_order_release);
+  }
+
+  while (num_locked > 0) {
+    locked[--num_locked]->EndWrite();
+  }
+  return true;
+}
+
+template <typename Key, class Comparator>
+bool BTree<Key, Comparator>::Contains(const Key& key) const {
+  Position pos;
+  Find(key, false, false, &pos);
+  return pos.leaf != nullptr && Equal(key, pos.key);
+}
+
+template <typename Key, class Comparator>
+int BTree<Key, Comparator>::ValidateSubtree(Node* x, const Key* lower,
+                                            Key* leftmost, Leaf** next_leaf,
+                                            uint64_t* entries) const {
+  assert((x->Version() & 1) == 0);
+  const int n = x->Count();
+  for (int j = 0; j < n; j++) {
+    assert(x->prefix[j] == BiasedPrefix(x->KeyAt(j)));
+    assert(j == 0 || compare_(x->KeyAt(j - 1), x->KeyAt(j)) < 0);
+    assert(lower == nullptr || compare_(*lower, x->KeyAt(j)) <= 0);
+  }
+  if (x->leaf) {
+    // Only the root of an empty tree may be an empty leaf
+    assert(n > 0 || x == root_.load(std::memory_order_relaxed));
+    assert(*next_leaf == x);
+    *next_leaf = static_cast<Leaf*>(x)->Next();
+    *entries += n;
+    if (n > 0) {
+      *leftmost = x->KeyAt(0);
+    }
+    return 1;
+  }
+  Inner* in = static_cast<Inner*>(x);
+  int depth = 0;
+  for (int j = 0; j <= n; j++) {
+    Key child_leftmost = Key();
+    Key separator = j > 0 ? x->KeyAt(j - 1) : Key();
+    int d = ValidateSubtree(in->Child(j), j > 0 ? &separator : lower,
+                            &child_leftmost, next_leaf, entries);
+    // Invariant (2): a separator is the smallest key to its right
+    assert(j == 0 || Equal(separator, child_leftmost));
+    assert(j == 0 || d == depth);
+    if (j == 0) {
+      *leftmost = child_leftmost;
+    }
+    depth = d;
+  }
+  return depth + 1;
+}
+
+template <typename Key, class Comparator>
+void BTree<Key, Comparator>::TEST_Validate() const {
+  Node* x = root_.load(std::memory_order_relaxed);
+  Node* first = x;
+  while (!first->leaf) {
+    first = static_cast<Inner*>(first)->Child(0);
+  }
+  Leaf* next_leaf = static_cast<Leaf*>(first);
+  Key leftmost = Key();
+  uint64_t entries = 0;
+  ValidateSubtree(x, nullptr, &leftmost, &next_leaf, &entries);
+  assert(next_leaf == nullptr);
+  assert(entries == Count());
+  (void)entries;
+}
+
+}  // namespace ROCKSDB_NAMESPACE
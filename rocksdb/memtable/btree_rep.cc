@@ -0,0 +1,177 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#ifndef ROCKSDB_LITE
+#include "memtable/btree_rep.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "db/dbformat.h"
+#include "db/memtable.h"
+#include "memory/arena.h"
+#include "memtable/btree.h"
+#include "rocksdb/comparator.h"
+#include "rocksdb/memtablerep.h"
+#include "util/coding.h"
+
+namespace ROCKSDB_NAMESPACE {
+namespace {
+
+// Wraps the memtable's KeyComparator with the key prefix BTree caches in its
+// nodes.  With a bytewise user comparator the first 8 bytes of the user key,
+// read big-endian and zero-padded, order the same way as the entries;
+// otherwise every prefix is 0 and searches fall back to the comparator.
+class PrefixKeyComparator {
+ public:
+  PrefixKeyComparator(const MemTableRep::KeyComparator& compare,
+                      bool bytewise)
+      : compare_(compare), bytewise_(bytewise) {}
+
+  int operator()(const char* a, const char* b) const { return compare_(a, b); }
+
+  uint64_t prefix(const char* key) const {
+    if (!bytewise_) {
+      return 0;
+    }
+    // The entry format is frozen; see MemTableRep::KeyComparator::decode_key
+    Slice user_key = ExtractUserKey(GetLengthPrefixedSlice(key));
+    char buf[sizeof(uint64_t)] = {0};
+    memcpy(buf, user_key.data(), std::min(user_key.size(), sizeof(buf)));
+    return EndianSwapValue(DecodeFixed64(buf));
+  }
+
+ private:
+  const MemTableRep::KeyComparator& compare_;
+  const bool bytewise_;
+};
+
+typedef BTree<const char*, PrefixKeyComparator> MemTableBTree;
+
+class BTreeRep : public MemTableRep {
+  MemTableBTree tree_;
+
+ public:
+  explicit BTreeRep(const MemTableRep::KeyComparator& compare,
+                    Allocator* allocator)
+      : MemTableRep(allocator),
+        tree_(PrefixKeyComparator(
+                  compare, compare.user_comparator() == BytewiseComparator()),
+              allocator) {}
+
+  // Insert key into the tree.
+  // REQUIRES: nothing that compares equal to key is currently in the tree.
+  void Insert(KeyHandle handle) override {
+    tree_.Insert(static_cast<char*>(handle));
+  }
+
+  bool InsertKey(KeyHandle handle) override {
+    return tree_.Insert(static_cast<char*>(handle));
+  }
+
+  // The tree has no use for insert hints, but it must still reject
+  // duplicates when given one.
+  bool InsertKeyWithHint(KeyHandle handle, void** /*hint*/) override {
+    return InsertKey(handle);
+  }
+
+  // Returns true iff an entry that compares equal to key is in the tree.
+  bool Contains(const char* key) const override { return tree_.Contains(key); }
+
+  size_t ApproximateMemoryUsage() override {
+    // All memory is allocated through allocator; nothing to report here
+    return 0;
+  }
+
+  void Get(const LookupKey& k, void* callback_args,
+           bool (*callback_func)(void* arg, const char* entry)) override {
+    BTreeRep::Iterator iter(&tree_);
+    Slice dummy_slice;
+    for (iter.Seek(dummy_slice, k.memtable_key().data());
+         iter.Valid() && callback_func(callback_args, iter.key());
+         iter.Next()) {
+    }
+  }
+
+  ~BTreeRep() override {}
+
+  // Iteration over the contents of the tree. Readers never lock; see the
+  // thread safety notes in memtable/btree.h.
+  class Iterator : public MemTableRep::Iterator {
+    MemTableBTree::Iterator iter_;
+
+   public:
+    // Initialize an iterator over the specified tree.
+    // The returned iterator is not valid.
+    explicit Iterator(const MemTableBTree* tree) : iter_(tree) {}
+
+    ~Iterator() override {}
+
+    // Returns true iff the iterator is positioned at a valid node.
+    bool Valid() const override { return iter_.Valid(); }
+
+    // Returns the key at the current position.
+    // REQUIRES: Valid()
+    const char* key() const override { return iter_.key(); }
+
+    // Advances to the next position.
+    // REQUIRES: Valid()
+    void Next() override { iter_.Next(); }
+
+    // Advances to the previous position.
+    // REQUIRES: Valid()
+    void Prev() override { iter_.Prev(); }
+
+    // Advance to the first entry with a key >= target
+    void Seek(const Slice& internal_key, const char* memtable_key) override {
+      if (memtable_key != nullptr) {
+        iter_.Seek(memtable_key);
+      } else {
+        iter_.Seek(EncodeKey(&tmp_, internal_key));
+      }
+    }
+
+    // Retreat to the last entry with a key <= target
+    void SeekForPrev(const Slice& internal_key,
+                     const char* memtable_key) override {
+      if (memtable_key != nullptr) {
+        iter_.SeekForPrev(memtable_key);
+      } else {
+        iter_.SeekForPrev(EncodeKey(&tmp_, internal_key));
+      }
+    }
+
+    // Position at the first entry in collection.
+    // Final state of iterator is Valid() iff collection is not empty.
+    void SeekToFirst() override { iter_.SeekToFirst(); }
+
+    // Position at the last entry in collection.
+    // Final state of iterator is Valid() iff collection is not empty.
+    void SeekToLast() override { iter_.SeekToLast(); }
+
+   protected:
+    std::string tmp_;       // For passing to EncodeKey
+  };
+
+  MemTableRep::Iterator* GetIterator(Arena* arena = nullptr) override {
+    void* mem = arena ? arena->AllocateAligned(sizeof(BTreeRep::Iterator))
+                      : operator new(sizeof(BTreeRep::Iterator));
+    return new (mem) BTreeRep::Iterator(&tree_);
+  }
+};
+
+}  // anon namespace
+
+MemTableRep* BTreeRepFactory::CreateMemTableRep(
+    const MemTableRep::KeyComparator& compare, Allocator* allocator,
+    const SliceTransform* /*transform*/, Logger* /*logger*/) {
+  return new BTreeRep(compare, allocator);
+}
+
+MemTableRepFactory* NewBTreeRepFactory() { return new BTreeRepFactory(); }
+
+}  // namespace ROCKSDB_NAMESPACE
+#endif  // ROCKSDB_LITE
@@ -0,0 +1,442 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+
+#include "memtable/btree.h"
+#include <set>
+#include "memory/arena.h"
+#include "rocksdb/env.h"
+#include "test_util/testharness.h"
+#include "util/hash.h"
+#include "util/random.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+typedef uint64_t Key;
+
+// prefix_shift controls how much of a key its prefix keeps: 0 keeps all of
+// it, larger shifts make neighboring keys tie on the prefix so the search
+// has to fall back to the comparator, and 64 makes every prefix equal.
+struct TestComparator {
+  explicit TestComparator(int shift = 0) : prefix_shift(shift) {}
+
+  int operator()(const Key& a, const Key& b) const {
+    if (a < b) {
+      return -1;
+    } else if (a > b) {
+      return +1;
+    } else {
+      return 0;
+    }
+  }
+
+  uint64_t prefix(const Key& key) const {
+    return prefix_shift >= 64 ? 0 : key >> prefix_shift;
+  }
+
+  int prefix_shift;
+};
+
+typedef BTree<Key, TestComparator> TestBTree;
+
+class BTreeTest : public testing::Test {};
+
+TEST_F(BTreeTest, Empty) {
+  Arena arena;
+  TestComparator cmp;
+  TestBTree tree(cmp, &arena);
+  ASSERT_TRUE(!tree.Contains(10));
+  ASSERT_EQ(0U, tree.Count());
+  tree.TEST_Validate();
+
+  TestBTree::Iterator iter(&tree);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToFirst();
+  ASSERT_TRUE(!iter.Valid());
+  iter.Seek(100);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekForPrev(100);
+  ASSERT_TRUE(!iter.Valid());
+  iter.SeekToLast();
+  ASSERT_TRUE(!iter.Valid());
+}
+
+TEST_F(BTreeTest, InsertAndLookup) {
+  const int N = 2000;
+  const int R = 5000;
+  for (int shift : {0, 4, 64}) {
+    Random rnd(1000);
+    std::set<Key> keys;
+    Arena arena;
+    TestComparator cmp(shift);
+    TestBTree tree(cmp, &arena);
+    for (int i = 0; i < N; i++) {
+      Key key = rnd.Next() % R;
+      bool inserted = keys.insert(key).second;
+      ASSERT_EQ(inserted, tree.Insert(key));
+    }
+    ASSERT_EQ(keys.size(), tree.Count());
+    tree.TEST_Validate();
+
+    for (int i = 0; i < R; i++) {
+      if (tree.Contains(i)) {
+        ASSERT_EQ(keys.count(i), 1U);
+      } else {
+        ASSERT_EQ(keys.count(i), 0U);
+      }
+    }
+
+    // Simple iterator tests
+    {
+      TestBTree::Iterator iter(&tree);
+      ASSERT_TRUE(!iter.Valid());
+
+      iter.Seek(0);
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.begin()), iter.key());
+
+      iter.SeekForPrev(R - 1);
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.rbegin()), iter.key());
+
+      iter.SeekToFirst();
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.begin()), iter.key());
+
+      iter.SeekToLast();
+      ASSERT_TRUE(iter.Valid());
+      ASSERT_EQ(*(keys.rbegin()), iter.key());
+    }
+
+    // Forward iteration test
+    for (int i = 0; i < R; i++) {
+      TestBTree::Iterator iter(&tree);
+      iter.Seek(i);
+
+      // Compare against model iterator
+      std::set<Key>::iterator model_iter = keys.lower_bound(i);
+      for (int j = 0; j < 3; j++) {
+        if (model_iter == keys.end()) {
+          ASSERT_TRUE(!iter.Valid());
+          break;
+        } else {
+          ASSERT_TRUE(iter.Valid());
+          ASSERT_EQ(*model_iter, iter.key());
+          ++model_iter;
+          iter.Next();
+        }
+      }
+    }
+
+    // Backward iteration test
+    for (int i = 0; i < R; i++) {
+      TestBTree::Iterator iter(&tree);
+      iter.SeekForPrev(i);
+
+      // Compare against model iterator
+      std::set<Key>::iterator model_iter = keys.upper_bound(i);
+      for (int j = 0; j < 3; j++) {
+        if (model_iter == keys.begin()) {
+          ASSERT_TRUE(!iter.Valid());
+          break;
+        } else {
+          ASSERT_TRUE(iter.Valid());
+          ASSERT_EQ(*--model_iter, iter.key());
+          iter.Prev();
+        }
+      }
+    }
+  }
+}
+
+// Ascending inserts take the append split, descending ones the middle split;
+// either way a full scan in both directions must see every key once, and Prev
+// has to cross leaf boundaries by searching.
+TEST_F(BTreeTest, SequentialInsert) {
+  const Key N = 100000;
+  for (bool ascending : {true, false}) {
+    Arena arena;
+    TestComparator cmp;
+    TestBTree tree(cmp, &arena);
+    for (Key i = 0; i < N; i++) {
+      ASSERT_TRUE(tree.Insert(ascending ? i : N - 1 - i));
+    }
+    ASSERT_EQ(N, tree.Count());
+    tree.TEST_Validate();
+
+    TestBTree::Iterator iter(&tree);
+    Key expected = 0;
+    for (iter.SeekToFirst(); iter.Valid(); iter.Next()) {
+      ASSERT_EQ(expected++, iter.key());
+    }
+    ASSERT_EQ(N, expected);
+    for (iter.SeekToLast(); iter.Valid(); iter.Prev()) {
+      ASSERT_EQ(--expected, iter.key());
+    }
+    ASSERT_EQ(0U, expected);
+  }
+}
+
+// Interleaved ascending runs, the shape of memtable inserts from several
+// writers, mix append splits with middle splits of inner nodes.
+TEST_F(BTreeTest, InterleavedRuns) {
+  const int N = 100000;
+  const int S = 100;
+  Random rnd(534);
+  Arena arena;
+  TestComparator cmp(8);
+  TestBTree tree(cmp, &arena);
+  std::set<Key> keys;
+  Key last_key[S] = {};
+  for (int i = 0; i < N; i++) {
+    Key s = rnd.Uniform(S);
+    Key key = (s << 32) + (++last_key[s]);
+    keys.insert(key);
+    ASSERT_TRUE(tree.Insert(key));
+  }
+  tree.TEST_Validate();
+
+  TestBTree::Iterator iter(&tree);
+  iter.SeekToFirst();
+  for (Key key : keys) {
+    ASSERT_TRUE(iter.Valid());
+    ASSERT_EQ(key, iter.key());
+    iter.Next();
+  }
+  ASSERT_TRUE(!iter.Valid());
+}
+
+#ifndef ROCKSDB_VALGRIND_RUN
+// We want to make sure that with a single writer and multiple concurrent
+// readers (with no synchronization other than when a reader's iterator is
+// created), the reader always observes all the data that was present in the
+// tree when the iterator was constructed, even though splits move entries
+// between leaves underneath it.
+//
+// Keys are <key,gen,hash> as in skiplist_test.cc.
+class ConcurrentTest {
+ private:
+  static const uint32_t K = 4;
+
+  static uint64_t key(Key key) { return (key >> 40); }
+  static uint64_t gen(Key key) { return (key >> 8) & 0xffffffffu; }
+  static uint64_t hash(Key key) { return key & 0xff; }
+
+  static uint64_t HashNumbers(uint64_t k, uint64_t g) {
+    uint64_t data[2] = {k, g};
+    return Hash(reinterpret_cast<char*>(data), sizeof(data), 0);
+  }
+
+  static Key MakeKey(uint64_t k, uint64_t g) {
+    assert(k <= K);  // We sometimes pass K to seek to the end of the tree
+    assert(g <= 0xffffffffu);
+    return ((k << 40) | (g << 8) | (HashNumbers(k, g) & 0xff));
+  }
+
+  static bool IsValidKey(Key k) {
+    return hash(k) == (HashNumbers(key(k), gen(k)) & 0xff);
+  }
+
+  static Key RandomTarget(Random* rnd) {
+    switch (rnd->Next() % 10) {
+      case 0:
+        // Seek to beginning
+        return MakeKey(0, 0);
+      case 1:
+        // Seek to end
+        return MakeKey(K, 0);
+      default:
+        // Seek to middle
+        return MakeKey(rnd->Next() % K, 0);
+    }
+  }
+
+  // Per-key generation
+  struct State {
+    std::atomic<int> generation[K];
+    void Set(int k, int v) {
+      generation[k].store(v, std::memory_order_release);
+    }
+    int Get(int k) { return generation[k].load(std::memory_order_acquire); }
+
+    State() {
+      for (unsigned int k = 0; k < K; k++) {
+        Set(k, 0);
+      }
+    }
+  };
+
+  // Current state of the test
+  State current_;
+
+  Arena arena_;
+
+  // BTree is not protected by mu_.  We just use a single writer
+  // thread to modify it.
+  TestBTree tree_;
+
+ public:
+  ConcurrentTest() : tree_(TestComparator(), &arena_) {}
+
+  // REQUIRES: External synchronization
+  void WriteStep(Random* rnd) {
+    const uint32_t k = rnd->Next() % K;
+    const int g = current_.Get(k) + 1;
+    tree_.Insert(MakeKey(k, g));
+    current_.Set(k, g);
+  }
+
+  void ReadStep(Random* rnd) {
+    // Remember the initial committed state of the tree.
+    State initial_state;
+    for (unsigned int k = 0; k < K; k++) {
+      initial_state.Set(k, current_.Get(k));
+    }
+
+    Key pos = RandomTarget(rnd);
+    TestBTree::Iterator iter(&tree_);
+    iter.Seek(pos);
+    while (true) {
+      Key current;
+      if (!iter.Valid()) {
+        current = MakeKey(K, 0);
+      } else {
+        current = iter.key();
+        ASSERT_TRUE(IsValidKey(current)) << current;
+      }
+      ASSERT_LE(pos, current) << "should not go backwards";
+
+      // Verify that everything in [pos,current) was not present in
+      // initial_state.
+      while (pos < current) {
+        ASSERT_LT(key(pos), K) << pos;
+
+        // Note that generation 0 is never inserted, so it is ok if
+        // <*,0,*> is missing.
+        ASSERT_TRUE((gen(pos) == 0U) ||
+                    (gen(pos) > static_cast<uint64_t>(initial_state.Get(
+                                    static_cast<int>(key(pos))))))
+            << "key: " << key(pos) << "; gen: " << gen(pos)
+            << "; initgen: " << initial_state.Get(static_cast<int>(key(pos)));
+
+        // Advance to next key in the valid key space
+        if (key(pos) < key(current)) {
+          pos = MakeKey(key(pos) + 1, 0);
+        } else {
+          pos = MakeKey(key(pos), gen(pos) + 1);
+        }
+      }
+
+      if (!iter.Valid()) {
+        break;
+      }
+
+      if (rnd->Next() % 2) {
+        iter.Next();
+        pos = MakeKey(key(pos), gen(pos) + 1);
+      } else {
+        Key new_target = RandomTarget(rnd);
+        if (new_target > pos) {
+          pos = new_target;
+          iter.Seek(new_target);
+        }
+      }
+    }
+  }
+
+  void Validate() { tree_.TEST_Validate(); }
+};
+const uint32_t ConcurrentTest::K;
+
+// Simple test that does single-threaded testing of the ConcurrentTest
+// scaffolding.
+TEST_F(BTreeTest, ConcurrentWithoutThreads) {
+  ConcurrentTest test;
+  Random rnd(test::RandomSeed());
+  for (int i = 0; i < 10000; i++) {
+    test.ReadStep(&rnd);
+    test.WriteStep(&rnd);
+  }
+  test.Validate();
+}
+
+class TestState {
+ public:
+  ConcurrentTest t_;
+  int seed_;
+  std::atomic<bool> quit_flag_;
+
+  enum ReaderState {
+    STARTING,
+    RUNNING,
+    DONE
+  };
+
+  explicit TestState(int s)
+      : seed_(s), quit_flag_(false), state_(STARTING), state_cv_(&mu_) {}
+
+  void Wait(ReaderState s) {
+    mu_.Lock();
+    while (state_ != s) {
+      state_cv_.Wait();
+    }
+    mu_.Unlock();
+  }
+
+  void Change(ReaderState s) {
+    mu_.Lock();
+    state_ = s;
+    state_cv_.Signal();
+    mu_.Unlock();
+  }
+
+ private:
+  port::Mutex mu_;
+  ReaderState state_;
+  port::CondVar state_cv_;
+};
+
+static void ConcurrentReader(void* arg) {
+  TestState* state = reinterpret_cast<TestState*>(arg);
+  Random rnd(state->seed_);
+  state->Change(TestState::RUNNING);
+  while (!state->quit_flag_.load(std::memory_order_acquire)) {
+    state->t_.ReadStep(&rnd);
+  }
+  state->Change(TestState::DONE);
+}
+
+static void RunConcurrent(int run) {
+  const int seed = test::RandomSeed() + (run * 100);
+  Random rnd(seed);
+  const int N = 1000;
+  const int kSize = 1000;
+  for (int i = 0; i < N; i++) {
+    if ((i % 100) == 0) {
+      fprintf(stderr, "Run %d of %d\n", i, N);
+    }
+    TestState state(seed + 1);
+    Env::Default()->SetBackgroundThreads(1);
+    Env::Default()->Schedule(ConcurrentReader, &state);
+    state.Wait(TestState::RUNNING);
+    for (int k = 0; k < kSize; k++) {
+      state.t_.WriteStep(&rnd);
+    }
+    state.quit_flag_.store(true, std::memory_order_release);
+    state.Wait(TestState::DONE);
+    state.t_.Validate();
+  }
+}
+
+TEST_F(BTreeTest, Concurrent1) { RunConcurrent(1); }
+TEST_F(BTreeTest, Concurrent2) { RunConcurrent(2); }
+TEST_F(BTreeTest, Concurrent3) { RunConcurrent(3); }
+
+#endif  // ROCKSDB_VALGRIND_RUN
+}  // namespace ROCKSDB_NAMESPACE
+
+int main(int argc, char** argv) {
+  ::testing::InitGoogleTest(&argc, argv);
+  return RUN_ALL_TESTS();
+}
@@ -15,7 +15,9 @@ int main() {
 }
 #else
 
+#include <algorithm>
 #include <atomic>
+#include <cmath>
 #include <iostream>
 #include <memory>
 #include <thread>
@@ -25,6 +27,8 @@ int main() {
 #include "db/dbformat.h"
 #include "db/memtable.h"
 #include "memory/arena.h"
+#include "memory/concurrent_arena.h"
+#include "monitoring/histogram.h"
 #include "port/port.h"
 #include "port/stack_trace.h"
 #include "rocksdb/comparator.h"
@@ -34,6 +38,7 @@ int main() {
 #include "rocksdb/write_buffer_manager.h"
 #include "test_util/testutil.h"
 #include "util/gflags_compat.h"
+#include "util/hash.h"
 #include "util/mutexlock.h"
 #include "util/stop_watch.h"
 
@@ -51,7 +56,12 @@ DEFINE_string(benchmarks, "fillrandom",
               "do random\n"
               "\t                          reads\n"
               "\tseqreadwrite           -- 1 thread writes while N - 1 threads "
-              "do scans\n");
+              "do scans\n"
+              "\tmixedreadwrite         -- --num_writers threads write while "
+              "--num_readers\n"
+              "\t                          threads do random reads and prefix "
+              "scans,\n"
+              "\t                          reporting latency percentiles\n");
 
 DEFINE_string(memtablerep, "skiplist",
               "Which implementation of memtablerep to use. See "
@@ -61,6 +71,9 @@ DEFINE_string(memtablerep, "skiplist",
               "\tvector              -- backed by an std::vector\n"
               "\thashskiplist        -- backed by a hash skip list\n"
               "\thashlinklist        -- backed by a hash linked list\n"
+              "\tavltree             -- backed by an AVL tree\n"
+              "\tart                 -- backed by an adaptive radix tree\n"
+              "\tbtree               -- backed by a B+-tree\n"
               "\tcuckoo              -- backed by a cuckoo hash table");
 
 DEFINE_int64(bucket_count, 1000000,
@@ -120,6 +133,34 @@ DEFINE_int64(seed, 0,
              "Seed base for random number generators. "
              "When 0 it is deterministic.");
 
+/* mixedreadwrite settings */
+DEFINE_int32(num_writers, 1,
+             "Number of writer threads in mixedreadwrite. More than one "
+             "requires a memtablerep that supports concurrent inserts");
+
+DEFINE_int32(num_readers, 1, "Number of reader threads in mixedreadwrite");
+
+DEFINE_string(key_distribution, "uniform",
+              "Distribution of the keys written and read by mixedreadwrite. "
+              "Options:\n"
+              "\tuniform             -- every key is equally likely\n"
+              "\tzipfian             -- a few hot keys get most operations, "
+              "see --zipf_alpha");
+
+DEFINE_double(zipf_alpha, 0.99,
+              "Skew of the zipfian key distribution; larger is more skewed");
+
+DEFINE_int32(prefix_scan_percent, 0,
+             "Percentage of mixedreadwrite reads that are prefix scans "
+             "instead of point lookups");
+
+DEFINE_int32(scan_length, 100,
+             "Maximum number of entries a mixedreadwrite prefix scan visits");
+
+DEFINE_int32(keys_per_prefix, 16,
+             "Number of consecutive mixedreadwrite keys that share a "
+             "--prefix_length prefix");
+
 namespace ROCKSDB_NAMESPACE {
 
 namespace {
@@ -155,12 +196,26 @@ class RandomGenerator {
   }
 };
 
-enum WriteMode { SEQUENTIAL, RANDOM, UNIQUE_RANDOM };
+enum WriteMode { SEQUENTIAL, RANDOM, UNIQUE_RANDOM, ZIPFIAN };
 
 class KeyGenerator {
  public:
   KeyGenerator(Random64* rand, WriteMode mode, uint64_t num)
       : rand_(rand), mode_(mode), num_(num), next_(0) {
+    if (mode_ == ZIPFIAN) {
+      // Inverse CDF of a zipfian distribution over kZipfRanks ranks. Ranks
+      // are scaled to [0, num) and then hashed, so that the hot keys are
+      // scattered over the key space instead of clustering next to 0.
+      zipf_cdf_.resize(kZipfRanks);
+      double sum = 0;
+      for (size_t i = 0; i < kZipfRanks; ++i) {
+        sum += 1.0 / std::pow(static_cast<double>(i + 1), FLAGS_zipf_alpha);
+        zipf_cdf_[i] = sum;
+      }
+      for (auto& p : zipf_cdf_) {
+        p /= sum;
+      }
+    }
     if (mode_ == UNIQUE_RANDOM) {
       // NOTE: if memory consumption of this approach becomes a concern,
       // we can either break it into pieces and only random shuffle a section
@@ -183,6 +238,16 @@ class KeyGenerator {
         return rand_->Next() % num_;
       case UNIQUE_RANDOM:
         return values_[next_++];
+      case ZIPFIAN: {
+        double p = static_cast<double>(rand_->Next() >> 11) /
+                   static_cast<double>(uint64_t{1} << 53);
+        uint64_t rank = std::upper_bound(zipf_cdf_.begin(), zipf_cdf_.end(),
+                                         p) -
+                        zipf_cdf_.begin();
+        rank = std::min<uint64_t>(rank, kZipfRanks - 1) * num_ / kZipfRanks;
+        return NPHash64(reinterpret_cast<const char*>(&rank), sizeof(rank)) %
+               num_;
+      }
     }
     assert(false);
     return std::numeric_limits<uint64_t>::max();
@@ -194,6 +259,8 @@ class KeyGenerator {
   const uint64_t num_;
   uint64_t next_;
   std::vector<uint64_t> values_;
+  static const size_t kZipfRanks = 100000;
+  std::vector<double> zipf_cdf_;
 };
 
 class BenchmarkThread {
@@ -551,6 +618,241 @@ class ReadWriteBenchmark : public Benchmark {
   }
 };
 
+// Per-thread results of mixedreadwrite, merged once the threads are joined.
+struct MixedThreadStats {
+  uint64_t bytes_written = 0;
+  uint64_t bytes_read = 0;
+  uint64_t read_hits = 0;
+  HistogramImpl write_nanos;
+  HistogramImpl get_nanos;
+  HistogramImpl scan_nanos;
+};
+
+// mixedreadwrite keys are the big-endian prefix id (key divided by
+// --keys_per_prefix) in --prefix_length bytes followed by the big-endian key,
+// so that a prefix scan visits neighbouring keys in every memtablerep and the
+// hash reps group keys by the same prefix.
+class MixedKey {
+ public:
+  static size_t UserKeySize() { return FLAGS_prefix_length + 8; }
+
+  explicit MixedKey(uint64_t key) : buf_(UserKeySize(), '\0') {
+    EncodeBigEndian(&buf_[0], FLAGS_prefix_length, key / FLAGS_keys_per_prefix);
+    EncodeBigEndian(&buf_[FLAGS_prefix_length], 8, key);
+  }
+
+  Slice user_key() const { return Slice(buf_); }
+  Slice prefix() const { return Slice(buf_.data(), FLAGS_prefix_length); }
+
+ private:
+  // Writes the low `n` bytes of v, most significant first
+  static void EncodeBigEndian(char* buf, int n, uint64_t v) {
+    for (int i = n - 1; i >= 0; --i) {
+      buf[i] = static_cast<char>(v & 0xff);
+      v >>= 8;
+    }
+  }
+
+  std::string buf_;
+};
+
+class MixedWriteThread {
+ public:
+  MixedWriteThread(MemTableRep* table, bool concurrent, uint64_t seed,
+                   WriteMode mode, std::atomic<uint64_t>* sequence,
+                   uint64_t num_ops, MixedThreadStats* stats)
+      : table_(table),
+        concurrent_(concurrent),
+        rand_(new Random64(seed)),
+        key_gen_(new KeyGenerator(rand_.get(), mode, FLAGS_num_operations)),
+        sequence_(sequence),
+        num_ops_(num_ops),
+        stats_(stats) {}
+
+  void operator()() {
+    const size_t internal_key_size = MixedKey::UserKeySize() + 8;
+    const size_t encoded_len = VarintLength(internal_key_size) +
+                               internal_key_size + FLAGS_item_size;
+    for (uint64_t i = 0; i < num_ops_; ++i) {
+      MixedKey key(key_gen_->Next());
+      uint64_t start = Env::Default()->NowNanos();
+      char* buf = nullptr;
+      KeyHandle handle = table_->Allocate(encoded_len, &buf);
+      char* p = EncodeVarint32(buf, static_cast<uint32_t>(internal_key_size));
+      memcpy(p, key.user_key().data(), key.user_key().size());
+      p += key.user_key().size();
+      EncodeFixed64(p, PackSequenceAndType(sequence_->fetch_add(1) + 1,
+                                           kTypeValue));
+      p += 8;
+      Slice bytes = generator_.Generate(FLAGS_item_size);
+      memcpy(p, bytes.data(), FLAGS_item_size);
+      if (concurrent_) {
+        table_->InsertConcurrently(handle);
+      } else {
+        table_->Insert(handle);
+      }
+      stats_->write_nanos.Add(Env::Default()->NowNanos() - start);
+      stats_->bytes_written += encoded_len;
+    }
+  }
+
+ private:
+  MemTableRep* table_;
+  const bool concurrent_;
+  // Heap allocated so that key_gen_ keeps pointing to the right generator
+  // when the thread object is moved.
+  std::unique_ptr<Random64> rand_;
+  std::unique_ptr<KeyGenerator> key_gen_;
+  std::atomic<uint64_t>* sequence_;
+  const uint64_t num_ops_;
+  MixedThreadStats* stats_;
+  RandomGenerator generator_;
+};
+
+class MixedReadThread {
+ public:
+  MixedReadThread(MemTableRep* table, uint64_t seed, WriteMode mode,
+                  std::atomic<uint64_t>* sequence, uint64_t num_ops,
+                  MixedThreadStats* stats)
+      : table_(table),
+        rand_(new Random64(seed)),
+        key_gen_(new KeyGenerator(rand_.get(), mode, FLAGS_num_operations)),
+        sequence_(sequence),
+        num_ops_(num_ops),
+        stats_(stats) {}
+
+  void operator()() {
+    InternalKeyComparator internal_key_comp(BytewiseComparator());
+    for (uint64_t i = 0; i < num_ops_; ++i) {
+      MixedKey key(key_gen_->Next());
+      if (rand_->Uniform(100) <
+          static_cast<uint64_t>(FLAGS_prefix_scan_percent)) {
+        uint64_t start = Env::Default()->NowNanos();
+        ScanOne(key);
+        stats_->scan_nanos.Add(Env::Default()->NowNanos() - start);
+      } else {
+        uint64_t start = Env::Default()->NowNanos();
+        LookupKey lookup_key(key.user_key(), sequence_->load());
+        CallbackVerifyArgs verify_args;
+        verify_args.found = false;
+        verify_args.key = &lookup_key;
+        verify_args.table = table_;
+        verify_args.comparator = &internal_key_comp;
+        table_->Get(lookup_key, &verify_args, ReadBenchmarkThread::callback);
+        stats_->get_nanos.Add(Env::Default()->NowNanos() - start);
+        if (verify_args.found) {
+          stats_->bytes_read += VarintLength(MixedKey::UserKeySize() + 8) +
+                                MixedKey::UserKeySize() + 8 + FLAGS_item_size;
+          ++stats_->read_hits;
+        }
+      }
+    }
+  }
+
+ private:
+  // Visits up to --scan_length entries sharing the prefix of `key`, starting
+  // from the first key of that prefix.
+  void ScanOne(const MixedKey& key) {
+    std::string seek_key = key.prefix().ToString();
+    seek_key.append(MixedKey::UserKeySize() - seek_key.size(), '\0');
+    PutFixed64(&seek_key,
+               PackSequenceAndType(kMaxSequenceNumber, kValueTypeForSeek));
+    std::unique_ptr<MemTableRep::Iterator> iter(
+        table_->GetDynamicPrefixIterator());
+    int n = 0;
+    for (iter->Seek(seek_key, nullptr); iter->Valid() && n < FLAGS_scan_length;
+         iter->Next(), ++n) {
+      Slice internal_key = GetLengthPrefixedSlice(iter->key());
+      if (!internal_key.starts_with(key.prefix())) {
+        break;
+      }
+      stats_->bytes_read += internal_key.size() + FLAGS_item_size;
+    }
+  }
+
+  MemTableRep* table_;
+  // Heap allocated so that key_gen_ keeps pointing to the right generator
+  // when the thread object is moved.
+  std::unique_ptr<Random64> rand_;
+  std::unique_ptr<KeyGenerator> key_gen_;
+  std::atomic<uint64_t>* sequence_;
+  const uint64_t num_ops_;
+  MixedThreadStats* stats_;
+};
+
+class MixedReadWriteBenchmark : public Benchmark {
+ public:
+  explicit MixedReadWriteBenchmark(MemTableRep* table, WriteMode mode,
+                                   bool concurrent_writes)
+      : Benchmark(table, nullptr, nullptr,
+                  FLAGS_num_writers + FLAGS_num_readers),
+        mode_(mode),
+        concurrent_writes_(concurrent_writes),
+        last_sequence_(0) {
+    num_write_ops_per_thread_ =
+        FLAGS_num_writers > 0 ? FLAGS_num_operations / FLAGS_num_writers : 0;
+    num_read_ops_per_thread_ =
+        FLAGS_num_readers > 0 ? FLAGS_num_operations / FLAGS_num_readers : 0;
+  }
+
+  void Run() override {
+    Benchmark::Run();
+    if (total_.write_nanos.num() > 0) {
+      std::cout << "Write latency (ns):\n"
+                << total_.write_nanos.ToString() << std::endl;
+    }
+    if (total_.get_nanos.num() > 0) {
+      std::cout << "read hit%: "
+                << static_cast<double>(total_.read_hits) /
+                       total_.get_nanos.num() * 100
+                << std::endl;
+      std::cout << "Get latency (ns):\n"
+                << total_.get_nanos.ToString() << std::endl;
+    }
+    if (total_.scan_nanos.num() > 0) {
+      std::cout << "Prefix scan latency (ns):\n"
+                << total_.scan_nanos.ToString() << std::endl;
+    }
+  }
+
+  void RunThreads(std::vector<port::Thread>* threads, uint64_t* bytes_written,
+                  uint64_t* bytes_read, bool /*write*/,
+                  uint64_t* read_hits) override {
+    std::vector<std::unique_ptr<MixedThreadStats>> stats;
+    for (int i = 0; i < FLAGS_num_writers + FLAGS_num_readers; ++i) {
+      stats.emplace_back(new MixedThreadStats);
+      uint64_t seed = FLAGS_seed + i;
+      if (i < FLAGS_num_writers) {
+        threads->emplace_back(MixedWriteThread(
+            table_, concurrent_writes_, seed, mode_, &last_sequence_,
+            num_write_ops_per_thread_, stats.back().get()));
+      } else {
+        threads->emplace_back(MixedReadThread(
+            table_, seed, mode_, &last_sequence_, num_read_ops_per_thread_,
+            stats.back().get()));
+      }
+    }
+    for (auto& thread : *threads) {
+      thread.join();
+    }
+    for (auto& s : stats) {
+      *bytes_written += s->bytes_written;
+      *bytes_read += s->bytes_read;
+      *read_hits += s->read_hits;
+      total_.read_hits += s->read_hits;
+      total_.write_nanos.Merge(s->write_nanos);
+      total_.get_nanos.Merge(s->get_nanos);
+      total_.scan_nanos.Merge(s->scan_nanos);
+    }
+  }
+
+ private:
+  const WriteMode mode_;
+  const bool concurrent_writes_;
+  std::atomic<uint64_t> last_sequence_;
+  MixedThreadStats total_;
+};
+
 }  // namespace ROCKSDB_NAMESPACE
 
 void PrintWarnings() {
@@ -593,6 +895,12 @@ int main(int argc, char** argv) {
         FLAGS_if_log_bucket_dist_when_flash, FLAGS_threshold_use_skiplist));
     options.prefix_extractor.reset(
         ROCKSDB_NAMESPACE::NewFixedPrefixTransform(FLAGS_prefix_length));
+  } else if (FLAGS_memtablerep == "avltree") {
+    factory.reset(ROCKSDB_NAMESPACE::NewAVLTreeRepFactory());
+  } else if (FLAGS_memtablerep == "btree") {
+    factory.reset(ROCKSDB_NAMESPACE::NewBTreeRepFactory());
+  } else if (FLAGS_memtablerep == "art") {
+    factory.reset(ROCKSDB_NAMESPACE::NewARTRepFactory());
 #endif  // ROCKSDB_LITE
   } else {
     fprintf(stdout, "Unknown memtablerep: %s\n", FLAGS_memtablerep.c_str());
@@ -603,11 +911,12 @@ int main(int argc, char** argv) {
       ROCKSDB_NAMESPACE::BytewiseComparator());
   ROCKSDB_NAMESPACE::MemTable::KeyComparator key_comp(internal_key_comp);
   ROCKSDB_NAMESPACE::Arena arena;
+  ROCKSDB_NAMESPACE::ConcurrentArena concurrent_arena;
   ROCKSDB_NAMESPACE::WriteBufferManager wb(FLAGS_write_buffer_size);
   uint64_t sequence;
-  auto createMemtableRep = [&] {
+  auto createMemtableRep = [&](ROCKSDB_NAMESPACE::Allocator* allocator) {
     sequence = 0;
-    return factory->CreateMemTableRep(key_comp, &arena,
+    return factory->CreateMemTableRep(key_comp, allocator,
                                       options.prefix_extractor.get(),
                                       options.info_log.get());
   };
@@ -627,13 +936,13 @@ int main(int argc, char** argv) {
     }
     std::unique_ptr<ROCKSDB_NAMESPACE::Benchmark> benchmark;
     if (name == ROCKSDB_NAMESPACE::Slice("fillseq")) {
-      memtablerep.reset(createMemtableRep());
+      memtablerep.reset(createMemtableRep(&arena));
       key_gen.reset(new ROCKSDB_NAMESPACE::KeyGenerator(
           &rng, ROCKSDB_NAMESPACE::SEQUENTIAL, FLAGS_num_operations));
       benchmark.reset(new ROCKSDB_NAMESPACE::FillBenchmark(
           memtablerep.get(), key_gen.get(), &sequence));
     } else if (name == ROCKSDB_NAMESPACE::Slice("fillrandom")) {
-      memtablerep.reset(createMemtableRep());
+      memtablerep.reset(createMemtableRep(&arena));
       key_gen.reset(new ROCKSDB_NAMESPACE::KeyGenerator(
           &rng, ROCKSDB_NAMESPACE::UNIQUE_RANDOM, FLAGS_num_operations));
       benchmark.reset(new ROCKSDB_NAMESPACE::FillBenchmark(
@@ -649,19 +958,43 @@ int main(int argc, char** argv) {
       benchmark.reset(new ROCKSDB_NAMESPACE::SeqReadBenchmark(memtablerep.get(),
                                                               &sequence));
     } else if (name == ROCKSDB_NAMESPACE::Slice("readwrite")) {
-      memtablerep.reset(createMemtableRep());
+      memtablerep.reset(createMemtableRep(&arena));
       key_gen.reset(new ROCKSDB_NAMESPACE::KeyGenerator(
           &rng, ROCKSDB_NAMESPACE::RANDOM, FLAGS_num_operations));
       benchmark.reset(new ROCKSDB_NAMESPACE::ReadWriteBenchmark<
                       ROCKSDB_NAMESPACE::ConcurrentReadBenchmarkThread>(
           memtablerep.get(), key_gen.get(), &sequence));
     } else if (name == ROCKSDB_NAMESPACE::Slice("seqreadwrite")) {
-      memtablerep.reset(createMemtableRep());
+      memtablerep.reset(createMemtableRep(&arena));
       key_gen.reset(new ROCKSDB_NAMESPACE::KeyGenerator(
           &rng, ROCKSDB_NAMESPACE::RANDOM, FLAGS_num_operations));
       benchmark.reset(new ROCKSDB_NAMESPACE::ReadWriteBenchmark<
                       ROCKSDB_NAMESPACE::SeqConcurrentReadBenchmarkThread>(
           memtablerep.get(), key_gen.get(), &sequence));
+    } else if (name == ROCKSDB_NAMESPACE::Slice("mixedreadwrite")) {
+      ROCKSDB_NAMESPACE::WriteMode mode;
+      if (FLAGS_key_distribution == "uniform") {
+        mode = ROCKSDB_NAMESPACE::RANDOM;
+      } else if (FLAGS_key_distribution == "zipfian") {
+        mode = ROCKSDB_NAMESPACE::ZIPFIAN;
+      } else {
+        fprintf(stdout, "Unknown key_distribution: %s\n",
+                FLAGS_key_distribution.c_str());
+        exit(1);
+      }
+      if (FLAGS_prefix_length < 1) {
+        fprintf(stdout, "mixedreadwrite needs a positive prefix_length\n");
+        exit(1);
+      }
+      bool concurrent_writes = FLAGS_num_writers > 1;
+      if (concurrent_writes && !factory->IsInsertConcurrentlySupported()) {
+        fprintf(stdout, "memtablerep %s does not support concurrent inserts\n",
+                FLAGS_memtablerep.c_str());
+        exit(1);
+      }
+      memtablerep.reset(createMemtableRep(&concurrent_arena));
+      benchmark.reset(new ROCKSDB_NAMESPACE::MixedReadWriteBenchmark(
+          memtablerep.get(), mode, concurrent_writes));
     } else {
       std::cout << "WARNING: skipping unknown benchmark '" << name.ToString()
                 << std::endl;
@@ -10,12 +10,15 @@
 #include <set>
 #include <memory>
 #include <algorithm>
+#include <atomic>
+#include <functional>
 #include <type_traits>
 
 #include "db/memtable.h"
 #include "memory/arena.h"
 #include "memtable/stl_wrappers.h"
 #include "port/port.h"
+#include "rocksdb/env.h"
 #include "util/mutexlock.h"
 
 namespace ROCKSDB_NAMESPACE {
@@ -23,9 +26,86 @@ namespace {
 
 using namespace stl_wrappers;
 
+// The work of one ParallelFor() call, shared by the calling thread and the
+// jobs it schedules. A job that only starts once the call has returned finds
+// it closed and does nothing.
+struct ParallelForWork {
+  port::Mutex mu;
+  port::CondVar cv;
+  int running;
+  bool closed;
+  std::atomic<size_t> next;
+  const size_t n;
+  const std::function<void(size_t)>* const fn;
+
+  ParallelForWork(size_t _n, const std::function<void(size_t)>* _fn)
+      : cv(&mu), running(0), closed(false), next(0), n(_n), fn(_fn) {}
+
+  void Run() {
+    for (size_t i = next.fetch_add(1); i < n; i = next.fetch_add(1)) {
+      (*fn)(i);
+    }
+  }
+};
+
+void BGParallelFor(void* arg) {
+  std::unique_ptr<std::shared_ptr<ParallelForWork>> work(
+      reinterpret_cast<std::shared_ptr<ParallelForWork>*>(arg));
+  ParallelForWork* w = work->get();
+  {
+    MutexLock l(&w->mu);
+    if (w->closed) {
+      return;
+    }
+    w->running++;
+  }
+  w->Run();
+  MutexLock l(&w->mu);
+  w->running--;
+  w->cv.SignalAll();
+}
+
+void UnscheduleParallelFor(void* arg) {
+  delete reinterpret_cast<std::shared_ptr<ParallelForWork>*>(arg);
+}
+
+// Runs fn(0), ..., fn(n - 1) on the calling thread and on up to
+// max_threads - 1 jobs in env's LOW priority thread pool, scheduled with tag.
+// The calling thread does whatever the jobs have not started on, so a busy
+// pool never holds it up. Without env, everything runs on the calling thread.
+void ParallelFor(Env* env, void* tag, size_t n, size_t max_threads,
+                 const std::function<void(size_t)>& fn) {
+  auto work = std::make_shared<ParallelForWork>(n, &fn);
+  if (env != nullptr) {
+    for (size_t t = 1; t < std::min(n, max_threads); t++) {
+      env->Schedule(&BGParallelFor,
+                    new std::shared_ptr<ParallelForWork>(work),
+                    Env::Priority::LOW, tag, &UnscheduleParallelFor);
+    }
+  }
+  work->Run();
+  MutexLock l(&work->mu);
+  work->closed = true;
+  while (work->running > 0) {
+    work->cv.Wait();
+  }
+}
+
 class VectorRep : public MemTableRep {
+ private:
+  typedef std::vector<const char*> Bucket;
+
+  // Entries that were added one after another.  Sorting a run publishes a
+  // sorted copy; a published vector is never modified, so iterators over
+  // the mutable memtable can share it.
+  struct Run {
+    std::shared_ptr<const Bucket> keys;
+    bool sorted;
+  };
+
  public:
-  VectorRep(const KeyComparator& compare, Allocator* allocator, size_t count);
+  VectorRep(const KeyComparator& compare, Allocator* allocator, size_t count,
+            size_t sort_run_size, Env* env);
 
   // Insert key into the collection. (The caller will pack key and value into a
   // single buffer and pass that in as the parameter to Insert)
@@ -43,20 +123,22 @@ class VectorRep : public MemTableRep {
   void Get(const LookupKey& k, void* callback_args,
            bool (*callback_func)(void* arg, const char* entry)) override;
 
-  ~VectorRep() override {}
+  ~VectorRep() override;
 
   class Iterator : public MemTableRep::Iterator {
     class VectorRep* vrep_;
-    std::shared_ptr<std::vector<const char*>> bucket_;
+    // Runs still to be merged into bucket_, for an iterator over a mutable
+    // memtable
+    std::vector<Run> mutable runs_;
+    std::shared_ptr<std::vector<const char*>> mutable bucket_;
     std::vector<const char*>::const_iterator mutable cit_;
     const KeyComparator& compare_;
     std::string tmp_;       // For passing to EncodeKey
     bool mutable sorted_;
     void DoSort() const;
    public:
-    explicit Iterator(class VectorRep* vrep,
-      std::shared_ptr<std::vector<const char*>> bucket,
-      const KeyComparator& compare);
+    explicit Iterator(class VectorRep* vrep, std::vector<Run> runs,
+                      const KeyComparator& compare);
 
     // Initialize an iterator over the specified collection.
     // The returned iterator is not valid.
@@ -98,11 +180,68 @@ class VectorRep : public MemTableRep {
 
  private:
   friend class Iterator;
-  typedef std::vector<const char*> Bucket;
+
+  // Merging fewer entries than this is not worth scheduling jobs for.
+  static const size_t kMinParallelSort = 1 << 16;
+  static const size_t kMaxSortThreads = 8;
+
+  // Tracks the sorts scheduled on env_, which may still be queued when the
+  // memtable goes away.
+  struct BackgroundSorts {
+    port::Mutex mu;
+    port::CondVar cv;
+    int running;
+    bool closed;
+    BackgroundSorts() : cv(&mu), running(0), closed(false) {}
+  };
+  struct SortJob {
+    std::shared_ptr<BackgroundSorts> sorts;
+    VectorRep* rep;
+    size_t run;
+  };
+  static void BGSortRun(void* arg);
+  static void UnscheduleSortRun(void* arg);
+
+  // Turns the unsorted tail into a run and schedules its sort, if there is
+  // an env_ to sort it on.
+  // REQUIRES: rwlock_ is write locked.
+  void SealRunLocked();
+
+  // Publishes a sorted copy of runs_[run] unless that has happened already.
+  void SortRun(size_t run);
+
+  // Returns the runs plus a copy of the tail.
+  // REQUIRES: rwlock_ is locked.
+  std::vector<Run> SnapshotRunsLocked() const;
+
+  // Merges runs_ and the tail into bucket_.
+  // REQUIRES: rwlock_ is write locked, immutable_.
+  void MergeRunsLocked();
+
+  // Sorts the runs that are not sorted yet and merges all of them into *out.
+  // Large inputs are cut into ranges that are sorted and merged on the
+  // calling thread and on up to max_threads - 1 jobs in env's LOW priority
+  // thread pool, scheduled with tag.
+  static void SortAndMerge(const std::vector<Run>& runs,
+                           const KeyComparator& compare, Env* env, void* tag,
+                           size_t max_threads, Bucket* out);
+
+  // Merges the sorted ranges [begins[i], ends[i]) into out.
+  static void MergeRanges(const std::vector<const char* const*>& begins,
+                          const std::vector<const char* const*>& ends,
+                          const Compare& less, const char** out);
+
+  // Before MarkReadOnly(), the entries that do not fill a run yet; after
+  // the first iteration of the immutable memtable, all entries in order.
   std::shared_ptr<Bucket> bucket_;
+  std::vector<Run> runs_;
   mutable port::RWMutex rwlock_;
   bool immutable_;
   bool sorted_;
+  std::atomic<size_t> num_entries_;
+  const size_t sort_run_size_;
+  Env* const env_;
+  std::shared_ptr<BackgroundSorts> background_sorts_;
   const KeyComparator& compare_;
 };
 
@@ -111,60 +250,282 @@ void VectorRep::Insert(KeyHandle handle) {
   WriteLock l(&rwlock_);
   assert(!immutable_);
   bucket_->push_back(key);
+  num_entries_.fetch_add(1, std::memory_order_relaxed);
+  if (sort_run_size_ > 0 && bucket_->size() >= sort_run_size_) {
+    SealRunLocked();
+  }
 }
 
 // Returns true iff an entry that compares equal to key is in the collection.
 bool VectorRep::Contains(const char* key) const {
   ReadLock l(&rwlock_);
-  return std::find(bucket_->begin(), bucket_->end(), key) != bucket_->end();
+  if (std::find(bucket_->begin(), bucket_->end(), key) != bucket_->end()) {
+    return true;
+  }
+  for (const Run& run : runs_) {
+    if (std::find(run.keys->begin(), run.keys->end(), key) !=
+        run.keys->end()) {
+      return true;
+    }
+  }
+  return false;
 }
 
 void VectorRep::MarkReadOnly() {
   WriteLock l(&rwlock_);
   immutable_ = true;
+  // Give the last entries a head start on the flush, too
+  if (sort_run_size_ > 0 && !bucket_->empty()) {
+    SealRunLocked();
+  }
 }
 
 size_t VectorRep::ApproximateMemoryUsage() {
   return
     sizeof(bucket_) + sizeof(*bucket_) +
-    bucket_->size() *
+    num_entries_.load(std::memory_order_relaxed) *
     sizeof(
       std::remove_reference<decltype(*bucket_)>::type::value_type
     );
 }
 
 VectorRep::VectorRep(const KeyComparator& compare, Allocator* allocator,
-                     size_t count)
+                     size_t count, size_t sort_run_size, Env* env)
     : MemTableRep(allocator),
       bucket_(new Bucket()),
       immutable_(false),
       sorted_(false),
+      num_entries_(0),
+      sort_run_size_(sort_run_size),
+      env_(env),
+      background_sorts_(std::make_shared<BackgroundSorts>()),
       compare_(compare) {
-  bucket_.get()->reserve(count);
+  bucket_.get()->reserve(sort_run_size_ > 0 ? std::min(count, sort_run_size_)
+                                            : count);
+}
+
+VectorRep::~VectorRep() {
+  // Queued sorts are dropped; running ones still use runs_ and compare_.
+  // The jobs of a flush-time merge have all finished or been closed by now.
+  if (env_ != nullptr) {
+    env_->UnSchedule(this, Env::Priority::LOW);
+  }
+  MutexLock l(&background_sorts_->mu);
+  background_sorts_->closed = true;
+  while (background_sorts_->running > 0) {
+    background_sorts_->cv.Wait();
+  }
+}
+
+void VectorRep::SealRunLocked() {
+  runs_.push_back({std::move(bucket_), false});
+  bucket_.reset(new Bucket());
+  bucket_->reserve(sort_run_size_);
+  if (env_ != nullptr) {
+    env_->Schedule(&VectorRep::BGSortRun,
+                   new SortJob{background_sorts_, this, runs_.size() - 1},
+                   Env::Priority::LOW, this, &VectorRep::UnscheduleSortRun);
+  }
+}
+
+void VectorRep::BGSortRun(void* arg) {
+  std::unique_ptr<SortJob> job(reinterpret_cast<SortJob*>(arg));
+  BackgroundSorts* sorts = job->sorts.get();
+  {
+    MutexLock l(&sorts->mu);
+    if (sorts->closed) {
+      return;
+    }
+    sorts->running++;
+  }
+  job->rep->SortRun(job->run);
+  MutexLock l(&sorts->mu);
+  sorts->running--;
+  sorts->cv.SignalAll();
+}
+
+void VectorRep::UnscheduleSortRun(void* arg) {
+  delete reinterpret_cast<SortJob*>(arg);
+}
+
+void VectorRep::SortRun(size_t run) {
+  std::shared_ptr<const Bucket> keys;
+  {
+    ReadLock l(&rwlock_);
+    if (sorted_ || run >= runs_.size() || runs_[run].sorted) {
+      return;
+    }
+    keys = runs_[run].keys;
+  }
+  std::shared_ptr<Bucket> sorted(new Bucket(*keys));
+  std::sort(sorted->begin(), sorted->end(), Compare(compare_));
+  WriteLock l(&rwlock_);
+  // The first iteration of the immutable memtable may have beaten us to it
+  if (!sorted_ && runs_[run].keys == keys) {
+    runs_[run] = {std::move(sorted), true};
+  }
+}
+
+std::vector<VectorRep::Run> VectorRep::SnapshotRunsLocked() const {
+  std::vector<Run> runs(runs_);
+  if (!bucket_->empty()) {
+    runs.push_back({std::make_shared<const Bucket>(*bucket_), false});
+  }
+  return runs;
+}
+
+void VectorRep::MergeRunsLocked() {
+  assert(immutable_);
+  if (!bucket_->empty()) {
+    runs_.push_back({std::move(bucket_), false});
+  }
+  std::shared_ptr<Bucket> merged(new Bucket());
+  SortAndMerge(runs_, compare_, env_, this, kMaxSortThreads, merged.get());
+  bucket_ = std::move(merged);
+  runs_.clear();
+  sorted_ = true;
+}
+
+void VectorRep::SortAndMerge(const std::vector<Run>& runs,
+                             const KeyComparator& compare, Env* env, void* tag,
+                             size_t max_threads, Bucket* out) {
+  const Compare less(compare);
+  size_t total = 0;
+  for (const Run& run : runs) {
+    total += run.keys->size();
+  }
+  const size_t threads =
+      total < kMinParallelSort || env == nullptr
+          ? 1
+          : std::max<size_t>(1, std::min<size_t>(
+                                    max_threads,
+                                    port::Thread::hardware_concurrency()));
+
+  // Sorted ranges to merge.  Unsorted runs are copied and cut into up to
+  // `threads` ranges each, so one big unsorted run is sorted in parallel too.
+  std::vector<const char* const*> begins;
+  std::vector<const char* const*> ends;
+  std::vector<std::unique_ptr<Bucket>> copies;
+  std::vector<std::pair<const char**, const char**>> to_sort;
+  for (const Run& run : runs) {
+    if (run.keys->empty()) {
+      continue;
+    }
+    if (run.sorted) {
+      begins.push_back(run.keys->data());
+      ends.push_back(run.keys->data() + run.keys->size());
+      continue;
+    }
+    copies.emplace_back(new Bucket(*run.keys));
+    Bucket* copy = copies.back().get();
+    const size_t piece = (copy->size() + threads - 1) / threads;
+    for (size_t i = 0; i < copy->size(); i += piece) {
+      const char** b = copy->data() + i;
+      const char** e = copy->data() + std::min(copy->size(), i + piece);
+      to_sort.emplace_back(b, e);
+      begins.push_back(b);
+      ends.push_back(e);
+    }
+  }
+  ParallelFor(env, tag, to_sort.size(), threads, [&](size_t i) {
+    std::sort(to_sort[i].first, to_sort[i].second, less);
+  });
+
+  out->resize(total);
+  if (begins.size() <= 1) {
+    if (!begins.empty()) {
+      std::copy(begins[0], ends[0], out->begin());
+    }
+    return;
+  }
+
+  // Cut the output into `threads` partitions at keys sampled from every
+  // range, and find where each partition starts in each range.
+  std::vector<const char*> samples;
+  for (size_t r = 0; r < begins.size(); r++) {
+    const size_t n = static_cast<size_t>(ends[r] - begins[r]);
+    for (size_t i = 1; i <= threads; i++) {
+      samples.push_back(begins[r][i * n / (threads + 1)]);
+    }
+  }
+  std::sort(samples.begin(), samples.end(), less);
+  std::vector<std::vector<const char* const*>> bounds(threads + 1);
+  bounds[0] = begins;
+  bounds[threads] = ends;
+  std::vector<size_t> offsets(threads + 1, 0);
+  for (size_t p = 1; p < threads; p++) {
+    const char* splitter = samples[p * samples.size() / threads];
+    for (size_t r = 0; r < begins.size(); r++) {
+      const char* const* pos =
+          std::lower_bound(begins[r], ends[r], splitter, less);
+      bounds[p].push_back(pos);
+      offsets[p] += static_cast<size_t>(pos - begins[r]);
+    }
+  }
+  ParallelFor(env, tag, threads, threads, [&](size_t p) {
+    MergeRanges(bounds[p], bounds[p + 1], less, out->data() + offsets[p]);
+  });
+}
+
+void VectorRep::MergeRanges(const std::vector<const char* const*>& begins,
+                            const std::vector<const char* const*>& ends,
+                            const Compare& less, const char** out) {
+  // A min-heap of the ranges, by their first key
+  typedef std::pair<const char* const*, const char* const*> Range;
+  auto greater = [&less](const Range& a, const Range& b) {
+    return less(*b.first, *a.first);
+  };
+  std::vector<Range> heap;
+  for (size_t r = 0; r < begins.size(); r++) {
+    if (begins[r] != ends[r]) {
+      heap.emplace_back(begins[r], ends[r]);
+    }
+  }
+  std::make_heap(heap.begin(), heap.end(), greater);
+  while (heap.size() > 1) {
+    std::pop_heap(heap.begin(), heap.end(), greater);
+    Range& top = heap.back();
+    *out++ = *top.first++;
+    if (top.first == top.second) {
+      heap.pop_back();
+    } else {
+      std::push_heap(heap.begin(), heap.end(), greater);
+    }
+  }
+  if (!heap.empty()) {
+    std::copy(heap[0].first, heap[0].second, out);
+  }
 }
 
-VectorRep::Iterator::Iterator(class VectorRep* vrep,
-                   std::shared_ptr<std::vector<const char*>> bucket,
-                   const KeyComparator& compare)
-: vrep_(vrep),
-  bucket_(bucket),
-  cit_(bucket_->end()),
-  compare_(compare),
-  sorted_(false) { }
+VectorRep::Iterator::Iterator(class VectorRep* vrep, std::vector<Run> runs,
+                              const KeyComparator& compare)
+    : vrep_(vrep),
+      runs_(std::move(runs)),
+      bucket_(vrep != nullptr ? vrep->bucket_ : std::make_shared<Bucket>()),
+      cit_(bucket_->end()),
+      compare_(compare),
+      sorted_(false) {}
 
 void VectorRep::Iterator::DoSort() const {
   // vrep is non-null means that we are working on an immutable memtable
   if (!sorted_ && vrep_ != nullptr) {
     WriteLock l(&vrep_->rwlock_);
     if (!vrep_->sorted_) {
-      std::sort(bucket_->begin(), bucket_->end(), Compare(compare_));
+      vrep_->MergeRunsLocked();
+      bucket_ = vrep_->bucket_;
       cit_ = bucket_->begin();
-      vrep_->sorted_ = true;
+    } else if (bucket_ != vrep_->bucket_) {
+      // Another iterator merged the runs after we were created
+      bucket_ = vrep_->bucket_;
+      cit_ = bucket_->end();
     }
     sorted_ = true;
   }
   if (!sorted_) {
-    std::sort(bucket_->begin(), bucket_->end(), Compare(compare_));
+    // Reads of the mutable memtable stay on the calling thread
+    SortAndMerge(runs_, compare_, nullptr /* env */, nullptr /* tag */,
+                 1 /* max_threads */, bucket_.get());
+    runs_.clear();
     cit_ = bucket_->begin();
     sorted_ = true;
   }
@@ -251,14 +612,14 @@ void VectorRep::Get(const LookupKey& k, void* callback_args,
                     bool (*callback_func)(void* arg, const char* entry)) {
   rwlock_.ReadLock();
   VectorRep* vector_rep;
-  std::shared_ptr<Bucket> bucket;
+  std::vector<Run> runs;
   if (immutable_) {
     vector_rep = this;
   } else {
     vector_rep = nullptr;
-    bucket.reset(new Bucket(*bucket_));  // make a copy
+    runs = SnapshotRunsLocked();
   }
-  VectorRep::Iterator iter(vector_rep, immutable_ ? bucket_ : bucket, compare_);
+  VectorRep::Iterator iter(vector_rep, std::move(runs), compare_);
   rwlock_.ReadUnlock();
 
   for (iter.Seek(k.user_key(), k.memtable_key().data());
@@ -276,17 +637,17 @@ MemTableRep::Iterator* VectorRep::GetIterator(Arena* arena) {
   // a Seek is performed on the iterator.
   if (immutable_) {
     if (arena == nullptr) {
-      return new Iterator(this, bucket_, compare_);
+      return new Iterator(this, std::vector<Run>(), compare_);
     } else {
-      return new (mem) Iterator(this, bucket_, compare_);
+      return new (mem) Iterator(this, std::vector<Run>(), compare_);
     }
   } else {
-    std::shared_ptr<Bucket> tmp;
-    tmp.reset(new Bucket(*bucket_)); // make a copy
+    // Sorted runs are shared; the tail is copied
+    std::vector<Run> runs = SnapshotRunsLocked();
     if (arena == nullptr) {
-      return new Iterator(nullptr, tmp, compare_);
+      return new Iterator(nullptr, std::move(runs), compare_);
     } else {
-      return new (mem) Iterator(nullptr, tmp, compare_);
+      return new (mem) Iterator(nullptr, std::move(runs), compare_);
     }
   }
 }
@@ -295,7 +656,8 @@ MemTableRep::Iterator* VectorRep::GetIterator(Arena* arena) {
 MemTableRep* VectorRepFactory::CreateMemTableRep(
     const MemTableRep::KeyComparator& compare, Allocator* allocator,
     const SliceTransform*, Logger* /*logger*/) {
-  return new VectorRep(compare, allocator, count_);
+  return new VectorRep(compare, allocator, count_, sort_run_size_,
+                       env_ != nullptr ? env_ : Env::Default());
 }
 }  // namespace ROCKSDB_NAMESPACE
 #endif  // ROCKSDB_LITE
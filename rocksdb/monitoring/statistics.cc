@@ -192,6 +192,11 @@ const std::vector<std::pair<Tickers, std::string>> TickersNameMap = {
      "rocksdb.block.cache.compression.dict.add.redundant"},
     {FILES_MARKED_TRASH, "rocksdb.files.marked.trash"},
     {FILES_DELETED_IMMEDIATELY, "rocksdb.files.deleted.immediately"},
+    {WRITE_GROUP_SYNC_DELAYED, "rocksdb.write.group.sync.delayed"},
+    {WRITE_GROUP_SYNC_DELAY_MICROS, "rocksdb.write.group.sync.delay.micros"},
+    {WRITE_GROUP_SYNC_DELAY_WRITERS, "rocksdb.write.group.sync.delay.writers"},
+    {CACHE_ADMISSION_ACCEPTED, "rocksdb.cache.admission.accepted"},
+    {CACHE_ADMISSION_REJECTED, "rocksdb.cache.admission.rejected"},
 };
 
 const std::vector<std::pair<Histograms, std::string>> HistogramsNameMap = {
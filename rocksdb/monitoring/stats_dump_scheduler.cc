@@ -17,7 +17,8 @@ StatsDumpScheduler::StatsDumpScheduler(Env* env) {
 
 void StatsDumpScheduler::Register(DBImpl* dbi,
                                   unsigned int stats_dump_period_sec,
-                                  unsigned int stats_persist_period_sec) {
+                                  unsigned int stats_persist_period_sec,
+                                  unsigned int block_cache_dump_period_sec) {
   static std::atomic<uint64_t> initial_delay(0);
   if (stats_dump_period_sec > 0) {
     timer->Start();
@@ -35,11 +36,19 @@ void StatsDumpScheduler::Register(DBImpl* dbi,
             static_cast<uint64_t>(stats_persist_period_sec) * kMicrosInSecond,
         static_cast<uint64_t>(stats_persist_period_sec) * kMicrosInSecond);
   }
+  if (block_cache_dump_period_sec > 0) {
+    timer->Start();
+    timer->Add(
+        [dbi]() { dbi->SaveBlockCacheKeys(); }, GetTaskName(dbi, "dump_bck"),
+        static_cast<uint64_t>(block_cache_dump_period_sec) * kMicrosInSecond,
+        static_cast<uint64_t>(block_cache_dump_period_sec) * kMicrosInSecond);
+  }
 }
 
 void StatsDumpScheduler::Unregister(DBImpl* dbi) {
   timer->Cancel(GetTaskName(dbi, "dump_st"));
   timer->Cancel(GetTaskName(dbi, "pst_st"));
+  timer->Cancel(GetTaskName(dbi, "dump_bck"));
   if (!timer->HasPendingTask()) {
     timer->Shutdown();
   }
@@ -13,12 +13,12 @@
 namespace ROCKSDB_NAMESPACE {
 
 // StatsDumpScheduler is a singleton object, which is scheduling/running
-// DumpStats() and PersistStats() for all DB instances. All DB instances uses
-// the same object from `Default()`.
+// DumpStats(), PersistStats() and SaveBlockCacheKeys() for all DB instances.
+// All DB instances uses the same object from `Default()`.
 // Internally, it uses a single threaded timer object to run the stats dump
 // functions. Timer thread won't be started if there's no function needs to run,
-// for example, option.stats_dump_period_sec and option.stats_persist_period_sec
-// are set to 0.
+// for example, option.stats_dump_period_sec, option.stats_persist_period_sec
+// and option.block_cache_dump_period_sec are set to 0.
 class StatsDumpScheduler {
  public:
   static StatsDumpScheduler* Default();
@@ -30,7 +30,8 @@ class StatsDumpScheduler {
   StatsDumpScheduler& operator=(StatsDumpScheduler&&) = delete;
 
   void Register(DBImpl* dbi, unsigned int stats_dump_period_sec,
-                unsigned int stats_persist_period_sec);
+                unsigned int stats_persist_period_sec,
+                unsigned int block_cache_dump_period_sec);
 
   void Unregister(DBImpl* dbi);
 
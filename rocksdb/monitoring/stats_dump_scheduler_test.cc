@@ -201,6 +201,53 @@ TEST_F(StatsDumpSchedulerTest, MultiEnv) {
   delete db;
   Close();
 }
+TEST_F(StatsDumpSchedulerTest, BlockCacheKeys) {
+  constexpr int kPeriodSec = 5;
+  Close();
+  Options options;
+  options.block_cache_dump_period_sec = kPeriodSec;
+  options.create_if_missing = true;
+  options.env = mock_env_.get();
+
+  int dump_bck_counter = 0;
+  SyncPoint::GetInstance()->SetCallBack(
+      "DBImpl::SaveBlockCacheKeys:StartRunning",
+      [&](void*) { dump_bck_counter++; });
+  SyncPoint::GetInstance()->EnableProcessing();
+
+  Reopen(options);
+  dbfull()->TEST_WaitForBlockCacheWarmup();
+  ASSERT_OK(Put("foo", "bar"));
+  ASSERT_OK(Flush());
+  ASSERT_EQ("bar", Get("foo"));
+
+  auto scheduler = dbfull()->TEST_GetStatsDumpScheduler();
+  ASSERT_NE(nullptr, scheduler);
+  ASSERT_EQ(1, scheduler->TEST_GetValidTaskNum());
+
+  // The first save is a whole period after open, not while the block cache
+  // is still being warmed up
+  dbfull()->TEST_WaitForStatsDumpRun(
+      [&] { mock_env_->MockSleepForSeconds(kPeriodSec - 1); });
+  ASSERT_EQ(0, dump_bck_counter);
+  ASSERT_TRUE(env_->FileExists(BlockCacheKeysFileName(dbname_)).IsNotFound());
+
+  dbfull()->TEST_WaitForStatsDumpRun(
+      [&] { mock_env_->MockSleepForSeconds(1); });
+  ASSERT_EQ(1, dump_bck_counter);
+  ASSERT_OK(env_->FileExists(BlockCacheKeysFileName(dbname_)));
+
+  dbfull()->TEST_WaitForStatsDumpRun(
+      [&] { mock_env_->MockSleepForSeconds(kPeriodSec); });
+  ASSERT_EQ(2, dump_bck_counter);
+
+  // Changing the stats periods keeps the block cache keys task
+  ASSERT_OK(dbfull()->SetDBOptions({{"stats_dump_period_sec", "5"}}));
+  scheduler = dbfull()->TEST_GetStatsDumpScheduler();
+  ASSERT_EQ(2, scheduler->TEST_GetValidTaskNum());
+
+  Close();
+}
 #endif  // !ROCKSDB_LITE
 }  // namespace ROCKSDB_NAMESPACE
 
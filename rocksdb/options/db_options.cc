@@ -77,9 +77,17 @@ std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct DBOptions, use_direct_io_for_flush_and_compaction),
           OptionType::kBoolean, OptionVerificationType::kNormal,
           OptionTypeFlags::kNone, 0}},
+        {"use_direct_io_for_wal",
+         {offsetof(struct DBOptions, use_direct_io_for_wal),
+          OptionType::kBoolean, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}},
         {"allow_2pc",
          {offsetof(struct DBOptions, allow_2pc), OptionType::kBoolean,
           OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0}},
+        {"feedback_write_rate_control",
+         {offsetof(struct DBOptions, feedback_write_rate_control),
+          OptionType::kBoolean, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}},
         {"allow_os_buffer",
          {0, OptionType::kBoolean, OptionVerificationType::kDeprecated,
           OptionTypeFlags::kMutable, 0}},
@@ -199,6 +207,11 @@ std::unordered_map<std::string, OptionTypeInfo>
         {"wal_dir",
          {offsetof(struct DBOptions, wal_dir), OptionType::kString,
           OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0}},
+        {"wal_stripe_dirs",
+         OptionTypeInfo::Vector<std::string>(
+             offsetof(struct DBOptions, wal_stripe_dirs),
+             OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0,
+             {0, OptionType::kString})},
         {"WAL_size_limit_MB",
          {offsetof(struct DBOptions, WAL_size_limit_MB), OptionType::kUInt64T,
           OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0}},
@@ -266,13 +279,24 @@ std::unordered_map<std::string, OptionTypeInfo>
         {"unordered_write",
          {offsetof(struct DBOptions, unordered_write), OptionType::kBoolean,
           OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0}},
+        {"write_queue_shards",
+         {offsetof(struct DBOptions, write_queue_shards), OptionType::kInt,
+          OptionVerificationType::kNormal, OptionTypeFlags::kNone, 0}},
         {"allow_concurrent_memtable_write",
          {offsetof(struct DBOptions, allow_concurrent_memtable_write),
           OptionType::kBoolean, OptionVerificationType::kNormal,
           OptionTypeFlags::kNone, 0}},
+        {"memtable_insert_threads",
+         {offsetof(struct DBOptions, memtable_insert_threads), OptionType::kInt,
+          OptionVerificationType::kNormal, OptionTypeFlags::kNone,
+          offsetof(struct ImmutableDBOptions, memtable_insert_threads)}},
         {"wal_recovery_mode", OptionTypeInfo::Enum<WALRecoveryMode>(
                                   offsetof(struct DBOptions, wal_recovery_mode),
                                   &wal_recovery_mode_string_map)},
+        {"wal_recovery_threads",
+         {offsetof(struct DBOptions, wal_recovery_threads), OptionType::kInt,
+          OptionVerificationType::kNormal, OptionTypeFlags::kNone,
+          offsetof(struct ImmutableDBOptions, wal_recovery_threads)}},
         {"enable_write_thread_adaptive_yield",
          {offsetof(struct DBOptions, enable_write_thread_adaptive_yield),
           OptionType::kBoolean, OptionVerificationType::kNormal,
@@ -281,6 +305,10 @@ std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct DBOptions, write_thread_slow_yield_usec),
           OptionType::kUInt64T, OptionVerificationType::kNormal,
           OptionTypeFlags::kNone, 0}},
+        {"max_write_group_sync_delay_usec",
+         {offsetof(struct DBOptions, max_write_group_sync_delay_usec),
+          OptionType::kUInt64T, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}},
         {"max_write_batch_group_size_bytes",
          {offsetof(struct DBOptions, max_write_batch_group_size_bytes),
           OptionType::kUInt64T, OptionVerificationType::kNormal,
@@ -332,6 +360,11 @@ std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct DBOptions, manual_wal_flush), OptionType::kBoolean,
           OptionVerificationType::kNormal, OptionTypeFlags::kNone,
           offsetof(struct ImmutableDBOptions, manual_wal_flush)}},
+        {"wal_compression",
+         {offsetof(struct DBOptions, wal_compression),
+          OptionType::kCompressionType, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone,
+          offsetof(struct ImmutableDBOptions, wal_compression)}},
         {"seq_per_batch",
          {0, OptionType::kBoolean, OptionVerificationType::kDeprecated,
           OptionTypeFlags::kNone, 0}},
@@ -363,6 +396,10 @@ std::unordered_map<std::string, OptionTypeInfo>
          {offsetof(struct DBOptions, bgerror_resume_retry_interval),
           OptionType::kUInt64T, OptionVerificationType::kNormal,
           OptionTypeFlags::kNone, 0}},
+        {"block_cache_dump_period_sec",
+         {offsetof(struct DBOptions, block_cache_dump_period_sec),
+          OptionType::kUInt, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}},
         // The following properties were handled as special cases in ParseOption
         // This means that the properties could be read from the options file
         // but never written to the file or compared to each other.
@@ -416,6 +453,7 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       db_paths(options.db_paths),
       db_log_dir(options.db_log_dir),
       wal_dir(options.wal_dir),
+      wal_stripe_dirs(options.wal_stripe_dirs),
       max_log_file_size(options.max_log_file_size),
       log_file_time_to_roll(options.log_file_time_to_roll),
       keep_log_file_num(options.keep_log_file_num),
@@ -432,6 +470,7 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       use_direct_reads(options.use_direct_reads),
       use_direct_io_for_flush_and_compaction(
           options.use_direct_io_for_flush_and_compaction),
+      use_direct_io_for_wal(options.use_direct_io_for_wal),
       allow_fallocate(options.allow_fallocate),
       is_fd_close_on_exec(options.is_fd_close_on_exec),
       advise_random_on_open(options.advise_random_on_open),
@@ -444,17 +483,22 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       use_adaptive_mutex(options.use_adaptive_mutex),
       listeners(options.listeners),
       enable_thread_tracking(options.enable_thread_tracking),
+      feedback_write_rate_control(options.feedback_write_rate_control),
       enable_pipelined_write(options.enable_pipelined_write),
       unordered_write(options.unordered_write),
+      write_queue_shards(options.write_queue_shards),
       allow_concurrent_memtable_write(options.allow_concurrent_memtable_write),
+      memtable_insert_threads(options.memtable_insert_threads),
       enable_write_thread_adaptive_yield(
           options.enable_write_thread_adaptive_yield),
       write_thread_max_yield_usec(options.write_thread_max_yield_usec),
       write_thread_slow_yield_usec(options.write_thread_slow_yield_usec),
+      max_write_group_sync_delay_usec(options.max_write_group_sync_delay_usec),
       skip_stats_update_on_db_open(options.skip_stats_update_on_db_open),
       skip_checking_sst_file_sizes_on_db_open(
           options.skip_checking_sst_file_sizes_on_db_open),
       wal_recovery_mode(options.wal_recovery_mode),
+      wal_recovery_threads(options.wal_recovery_threads),
       allow_2pc(options.allow_2pc),
       row_cache(options.row_cache),
 #ifndef ROCKSDB_LITE
@@ -467,6 +511,7 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       preserve_deletes(options.preserve_deletes),
       two_write_queues(options.two_write_queues),
       manual_wal_flush(options.manual_wal_flush),
+      wal_compression(options.wal_compression),
       atomic_flush(options.atomic_flush),
       avoid_unnecessary_blocking_io(options.avoid_unnecessary_blocking_io),
       persist_stats_to_disk(options.persist_stats_to_disk),
@@ -475,7 +520,8 @@ ImmutableDBOptions::ImmutableDBOptions(const DBOptions& options)
       file_checksum_gen_factory(options.file_checksum_gen_factory),
       best_efforts_recovery(options.best_efforts_recovery),
       max_bgerror_resume_count(options.max_bgerror_resume_count),
-      bgerror_resume_retry_interval(options.bgerror_resume_retry_interval) {
+      bgerror_resume_retry_interval(options.bgerror_resume_retry_interval),
+      block_cache_dump_period_sec(options.block_cache_dump_period_sec) {
 }
 
 void ImmutableDBOptions::Dump(Logger* log) const {
@@ -524,12 +570,18 @@ void ImmutableDBOptions::Dump(Logger* log) const {
                    "                       "
                    "Options.use_direct_io_for_flush_and_compaction: %d",
                    use_direct_io_for_flush_and_compaction);
+  ROCKS_LOG_HEADER(log, "                  Options.use_direct_io_for_wal: %d",
+                   use_direct_io_for_wal);
   ROCKS_LOG_HEADER(log, "         Options.create_missing_column_families: %d",
                    create_missing_column_families);
   ROCKS_LOG_HEADER(log, "                             Options.db_log_dir: %s",
                    db_log_dir.c_str());
   ROCKS_LOG_HEADER(log, "                                Options.wal_dir: %s",
                    wal_dir.c_str());
+  for (const auto& wal_stripe_dir : wal_stripe_dirs) {
+    ROCKS_LOG_HEADER(log, "                        Options.wal_stripe_dirs: %s",
+                     wal_stripe_dir.c_str());
+  }
   ROCKS_LOG_HEADER(log, "               Options.table_cache_numshardbits: %d",
                    table_cache_numshardbits);
   ROCKS_LOG_HEADER(log,
@@ -570,14 +622,22 @@ void ImmutableDBOptions::Dump(Logger* log) const {
       sst_file_manager ? sst_file_manager->GetDeleteRateBytesPerSecond() : 0);
   ROCKS_LOG_HEADER(log, "                      Options.wal_recovery_mode: %d",
                    static_cast<int>(wal_recovery_mode));
+  ROCKS_LOG_HEADER(log, "                   Options.wal_recovery_threads: %d",
+                   wal_recovery_threads);
   ROCKS_LOG_HEADER(log, "                 Options.enable_thread_tracking: %d",
                    enable_thread_tracking);
+  ROCKS_LOG_HEADER(log, "            Options.feedback_write_rate_control: %d",
+                   feedback_write_rate_control);
   ROCKS_LOG_HEADER(log, "                 Options.enable_pipelined_write: %d",
                    enable_pipelined_write);
   ROCKS_LOG_HEADER(log, "                 Options.unordered_write: %d",
                    unordered_write);
+  ROCKS_LOG_HEADER(log, "                     Options.write_queue_shards: %d",
+                   write_queue_shards);
   ROCKS_LOG_HEADER(log, "        Options.allow_concurrent_memtable_write: %d",
                    allow_concurrent_memtable_write);
+  ROCKS_LOG_HEADER(log, "                Options.memtable_insert_threads: %d",
+                   memtable_insert_threads);
   ROCKS_LOG_HEADER(log, "     Options.enable_write_thread_adaptive_yield: %d",
                    enable_write_thread_adaptive_yield);
   ROCKS_LOG_HEADER(log,
@@ -586,6 +646,9 @@ void ImmutableDBOptions::Dump(Logger* log) const {
   ROCKS_LOG_HEADER(log,
                    "           Options.write_thread_slow_yield_usec: %" PRIu64,
                    write_thread_slow_yield_usec);
+  ROCKS_LOG_HEADER(log,
+                   "        Options.max_write_group_sync_delay_usec: %" PRIu64,
+                   max_write_group_sync_delay_usec);
   if (row_cache) {
     ROCKS_LOG_HEADER(
         log,
@@ -610,6 +673,8 @@ void ImmutableDBOptions::Dump(Logger* log) const {
                    two_write_queues);
   ROCKS_LOG_HEADER(log, "            Options.manual_wal_flush: %d",
                    manual_wal_flush);
+  ROCKS_LOG_HEADER(log, "            Options.wal_compression: %d",
+                   static_cast<int>(wal_compression));
   ROCKS_LOG_HEADER(log, "            Options.atomic_flush: %d", atomic_flush);
   ROCKS_LOG_HEADER(log,
                    "            Options.avoid_unnecessary_blocking_io: %d",
@@ -631,6 +696,8 @@ void ImmutableDBOptions::Dump(Logger* log) const {
   ROCKS_LOG_HEADER(log,
                    "           Options.bgerror_resume_retry_interval: %" PRIu64,
                    bgerror_resume_retry_interval);
+  ROCKS_LOG_HEADER(log, "            Options.block_cache_dump_period_sec: %u",
+                   block_cache_dump_period_sec);
 }
 
 MutableDBOptions::MutableDBOptions()
@@ -1107,8 +1107,8 @@ EnvOptions WinEnvIO::OptimizeForLogWrite(const EnvOptions& env_options,
   // This adversely affects %999 on windows
   optimized.use_mmap_writes = false;
   // Direct writes will produce a huge perf impact on
-  // Windows. Pre-allocate space for WAL.
-  optimized.use_direct_writes = false;
+  // Windows unless explicitly asked for. Pre-allocate space for WAL.
+  optimized.use_direct_writes = db_options.use_direct_io_for_wal;
   return optimized;
 }
 
@@ -2,6 +2,8 @@
 LIB_SOURCES =                                                   \
   cache/cache.cc                                                \
   cache/clock_cache.cc                                          \
+  cache/frequency_sketch.cc                                     \
+  cache/hyper_clock_cache.cc                                    \
   cache/lru_cache.cc                                            \
   cache/sharded_cache.cc                                        \
   db/arena_wrapped_db_iter.cc                                   \
@@ -27,6 +29,7 @@ LIB_SOURCES =                                                   \
   db/convenience.cc                                             \
   db/db_filesnapshot.cc                                         \
   db/db_impl/db_impl.cc                                         \
+  db/db_impl/db_impl_block_cache_keys.cc                        \
   db/db_impl/db_impl_compaction_flush.cc                        \
   db/db_impl/db_impl_debug.cc                                   \
   db/db_impl/db_impl_experimental.cc                            \
@@ -102,6 +105,9 @@ LIB_SOURCES =                                                   \
   memory/jemalloc_nodump_allocator.cc                           \
   memory/memkind_kmem_allocator.cc                              \
   memtable/alloc_tracker.cc                                     \
+  memtable/art_rep.cc                                           \
+  memtable/avltree_rep.cc                                       \
+  memtable/btree_rep.cc                                         \
   memtable/hash_linklist_rep.cc                                 \
   memtable/hash_skiplist_rep.cc                                 \
   memtable/skiplistrep.cc                                       \
@@ -187,6 +193,7 @@ LIB_SOURCES =                                                   \
   util/coding.cc                                                \
   util/compaction_job_stats_impl.cc                             \
   util/comparator.cc                                            \
+  util/compression.cc                                           \
   util/compression_context_cache.cc                             \
   util/concurrent_task_limiter_impl.cc                          \
   util/crc32c.cc                                                \
@@ -431,6 +438,9 @@ TEST_MAIN_SOURCES =                                                     \
   logging/event_logger_test.cc                                          \
   memory/arena_test.cc                                                  \
   memory/memkind_kmem_allocator_test.cc                                 \
+  memtable/art_test.cc                                                  \
+  memtable/avltree_test.cc                                              \
+  memtable/btree_test.cc                                                \
   memtable/inlineskiplist_test.cc                                       \
   memtable/skiplist_test.cc                                             \
   memtable/write_buffer_manager_test.cc                                 \
@@ -346,6 +346,10 @@ static std::unordered_map<std::string, OptionTypeInfo>
                    pin_top_level_index_and_filter),
           OptionType::kBoolean, OptionVerificationType::kNormal,
           OptionTypeFlags::kNone, 0}},
+        {"block_cache_compressed_type",
+         {offsetof(struct BlockBasedTableOptions, block_cache_compressed_type),
+          OptionType::kCompressionType, OptionVerificationType::kNormal,
+          OptionTypeFlags::kNone, 0}},
         {"block_cache",
          {offsetof(struct BlockBasedTableOptions, block_cache),
           OptionType::kUnknown, OptionVerificationType::kNormal,
@@ -575,6 +579,10 @@ std::string BlockBasedTableFactory::GetPrintableTableOptions() const {
     ret.append("  block_cache_compressed_options:\n");
     ret.append(table_options_.block_cache_compressed->GetPrintableOptions());
   }
+  snprintf(buffer, kBufferSize, "  block_cache_compressed_type: %s\n",
+           CompressionTypeToString(table_options_.block_cache_compressed_type)
+               .c_str());
+  ret.append(buffer);
   snprintf(buffer, kBufferSize, "  persistent_cache: %p\n",
            static_cast<void*>(table_options_.persistent_cache.get()));
   ret.append(buffer);
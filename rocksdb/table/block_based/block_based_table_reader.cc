@@ -31,6 +31,7 @@
 #include "rocksdb/filter_policy.h"
 #include "rocksdb/iterator.h"
 #include "rocksdb/options.h"
+#include "rocksdb/rate_limiter.h"
 #include "rocksdb/statistics.h"
 #include "rocksdb/table.h"
 #include "rocksdb/table_properties.h"
@@ -225,6 +226,35 @@ CacheAllocationPtr CopyBufferToHeap(MemoryAllocator* allocator, Slice& buf) {
   memcpy(heap_buf.get(), buf.data(), buf.size());
   return heap_buf;
 }
+
+// Compresses the contents of a block stored uncompressed in the file into a
+// raw block for the compressed block cache, i.e. followed by the compression
+// type byte. Returns nullptr if the block does not compress well.
+BlockContents* CompressBlockForCache(const Slice& data, CompressionType type,
+                                     uint32_t format_version,
+                                     MemoryAllocator* allocator) {
+  CompressionOptions opts;
+  CompressionContext context(type);
+  CompressionInfo info(opts, context, CompressionDict::GetEmptyDict(), type,
+                       0 /* sample_for_compression */);
+  std::string compressed;
+  if (!CompressData(data, info, GetCompressFormatForVersion(format_version),
+                    &compressed) ||
+      compressed.size() >= data.size() - (data.size() / 8u)) {
+    return nullptr;
+  }
+  CacheAllocationPtr buf =
+      AllocateBlock(compressed.size() + kBlockTrailerSize, allocator);
+  memcpy(buf.get(), compressed.data(), compressed.size());
+  // Only the type byte of the trailer is read from the cache
+  memset(buf.get() + compressed.size(), 0, kBlockTrailerSize);
+  buf.get()[compressed.size()] = static_cast<char>(type);
+  BlockContents* contents = new BlockContents(std::move(buf), compressed.size());
+#ifndef NDEBUG
+  contents->is_raw_block = true;
+#endif  // NDEBUG
+  return contents;
+}
 }  // namespace
 
 void BlockBasedTable::UpdateCacheHitMetrics(BlockType block_type,
@@ -1263,6 +1293,22 @@ Status BlockBasedTable::PutDataBlockToCache(
   Status s;
   Statistics* statistics = ioptions.statistics;
 
+  // Blocks stored uncompressed in the file go into the compressed block cache
+  // compressed with block_cache_compressed_type, if it is set.
+  std::unique_ptr<BlockContents> block_cont_for_comp_cache;
+  const CompressionType block_cache_compressed_type =
+      rep_->table_options.block_cache_compressed_type;
+  if (block_cache_compressed != nullptr &&
+      raw_block_comp_type == kNoCompression &&
+      block_cache_compressed_type != kNoCompression &&
+      block_type != BlockType::kFilter &&
+      block_type != BlockType::kCompressionDictionary &&
+      raw_block_contents != nullptr) {
+    block_cont_for_comp_cache.reset(CompressBlockForCache(
+        raw_block_contents->data, block_cache_compressed_type, format_version,
+        memory_allocator));
+  }
+
   std::unique_ptr<TBlocklike> block_holder;
   if (raw_block_comp_type != kNoCompression) {
     // Retrieve the uncompressed contents into a new buffer
@@ -1299,18 +1345,20 @@ Status BlockBasedTable::PutDataBlockToCache(
 
     // We cannot directly put raw_block_contents because this could point to
     // an object in the stack.
-    BlockContents* block_cont_for_comp_cache =
-        new BlockContents(std::move(*raw_block_contents));
+    block_cont_for_comp_cache.reset(
+        new BlockContents(std::move(*raw_block_contents)));
+  }
+  if (block_cont_for_comp_cache != nullptr) {
     s = block_cache_compressed->Insert(
-        compressed_block_cache_key, block_cont_for_comp_cache,
+        compressed_block_cache_key, block_cont_for_comp_cache.get(),
         block_cont_for_comp_cache->ApproximateMemoryUsage(),
         &DeleteCachedEntry<BlockContents>);
     if (s.ok()) {
       // Avoid the following code to delete this cached block.
+      block_cont_for_comp_cache.release();
       RecordTick(statistics, BLOCK_CACHE_COMPRESSED_ADD);
     } else {
       RecordTick(statistics, BLOCK_CACHE_COMPRESSED_ADD_FAILURES);
-      delete block_cont_for_comp_cache;
     }
   }
 
@@ -2770,6 +2818,85 @@ Status BlockBasedTable::Prefetch(const Slice* const begin,
   return Status::OK();
 }
 
+Status BlockBasedTable::LoadDataBlocksToCache(
+    const std::vector<uint64_t>& offsets, RateLimiter* rate_limiter,
+    const std::atomic<bool>* stop) {
+  assert(std::is_sorted(offsets.begin(), offsets.end()));
+  Cache* const block_cache = rep_->table_options.block_cache.get();
+  if (block_cache == nullptr || offsets.empty()) {
+    return Status::OK();
+  }
+
+  BlockCacheLookupContext lookup_context{TableReaderCaller::kPrefetch};
+  IndexBlockIter iiter_on_stack;
+  auto iiter = NewIndexIterator(ReadOptions(), /*need_upper_bound_check=*/false,
+                                &iiter_on_stack, /*get_context=*/nullptr,
+                                &lookup_context);
+  std::unique_ptr<InternalIteratorBase<IndexValue>> iiter_unique_ptr;
+  if (iiter != &iiter_on_stack) {
+    iiter_unique_ptr = std::unique_ptr<InternalIteratorBase<IndexValue>>(iiter);
+  }
+
+  if (!iiter->status().ok()) {
+    // error opening index iterator
+    return iiter->status();
+  }
+
+  // The index lists the data blocks in file order
+  auto offset = offsets.begin();
+  for (iiter->SeekToFirst(); iiter->Valid() && offset != offsets.end();
+       iiter->Next()) {
+    if (stop != nullptr && stop->load(std::memory_order_relaxed)) {
+      break;
+    }
+    BlockHandle block_handle = iiter->value().handle;
+    while (offset != offsets.end() && *offset < block_handle.offset()) {
+      ++offset;
+    }
+    if (offset == offsets.end() || *offset != block_handle.offset()) {
+      continue;
+    }
+    ++offset;
+
+    char cache_key[kMaxCacheKeyPrefixSize + kMaxVarint64Length];
+    Slice key = GetCacheKey(rep_->cache_key_prefix, rep_->cache_key_prefix_size,
+                            block_handle, cache_key);
+    Cache::Handle* cache_handle = block_cache->Lookup(key);
+    if (cache_handle != nullptr) {
+      block_cache->Release(cache_handle);
+      continue;
+    }
+
+    if (rate_limiter != nullptr) {
+      int64_t bytes = static_cast<int64_t>(block_size(block_handle));
+      while (bytes > 0) {
+        const int64_t request =
+            std::min(bytes, rate_limiter->GetSingleBurstBytes());
+        rate_limiter->Request(request, Env::IO_LOW, rep_->ioptions.statistics,
+                              RateLimiter::OpType::kRead);
+        bytes -= request;
+      }
+    }
+
+    // Load the block specified by the block_handle into the block cache
+    DataBlockIter biter;
+    NewDataBlockIterator<DataBlockIter>(
+        ReadOptions(), block_handle, &biter, /*type=*/BlockType::kData,
+        /*get_context=*/nullptr, &lookup_context, Status(),
+        /*prefetch_buffer=*/nullptr);
+
+    if (!biter.status().ok()) {
+      return biter.status();
+    }
+  }
+
+  return Status::OK();
+}
+
+Slice BlockBasedTable::GetCacheKeyPrefix() const {
+  return Slice(rep_->cache_key_prefix, rep_->cache_key_prefix_size);
+}
+
 Status BlockBasedTable::VerifyChecksum(const ReadOptions& read_options,
                                        TableReaderCaller caller) {
   Status s;
@@ -9,8 +9,12 @@
 
 #pragma once
 
+#include <atomic>
+#include <vector>
+
 #include "db/range_tombstone_fragmenter.h"
 #include "file/filename.h"
+#include "rocksdb/rate_limiter.h"
 #include "table/block_based/block_based_table_factory.h"
 #include "table/block_based/block_type.h"
 #include "table/block_based/cachable_entry.h"
@@ -142,6 +146,19 @@ class BlockBasedTable : public TableReader {
   // IO or iteration error.
   Status Prefetch(const Slice* begin, const Slice* end) override;
 
+  // Loads the data blocks that start at the given file offsets, in ascending
+  // order, into the block cache, unless they are cached already. Offsets that
+  // do not start a data block are skipped. Each block read is charged to
+  // rate_limiter, if not null, at IO_LOW priority. Stops early once *stop is
+  // true.
+  Status LoadDataBlocksToCache(const std::vector<uint64_t>& offsets,
+                               RateLimiter* rate_limiter,
+                               const std::atomic<bool>* stop);
+
+  // The prefix of the keys of this table's blocks in the block cache, empty
+  // if there is no block cache
+  Slice GetCacheKeyPrefix() const;
+
   // Given a key, return an approximate byte offset in the file where
   // the data for that key begins (or would begin if the key were
   // present in the file). The returned value is in terms of file
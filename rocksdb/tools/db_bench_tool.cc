@@ -450,6 +450,11 @@ DEFINE_double(cache_high_pri_pool_ratio, 0.0,
 DEFINE_bool(use_clock_cache, false,
             "Replace default LRU block cache with clock cache.");
 
+DEFINE_bool(use_hyper_clock_cache, false,
+            "Replace default LRU block cache with HyperClockCache, whose "
+            "lookups take no lock. Its tables are sized for entries of "
+            "block_size.");
+
 DEFINE_int64(simcache_size, -1,
              "Number of bytes to use as a simcache of "
              "uncompressed data. Nagative value disables simcache.");
@@ -606,6 +611,10 @@ DEFINE_int64(read_cache_size, 4LL * 1024 * 1024 * 1024,
 DEFINE_bool(read_cache_direct_write, true,
             "Whether to use Direct IO for writing to the read cache");
 
+DEFINE_bool(read_cache_admit_on_second_access, false,
+            "Whether to write blocks to the read cache only on their second "
+            "recent miss");
+
 DEFINE_bool(read_cache_direct_read, true,
             "Whether to use Direct IO for reading from read cache");
 
@@ -643,6 +652,10 @@ DEFINE_bool(disable_wal, false, "If true, do not write WAL for write.");
 
 DEFINE_string(wal_dir, "", "If not empty, use the given dir for WAL");
 
+DEFINE_string(wal_stripe_dirs, "",
+              "Comma-separated list of directories to stripe the WAL across, "
+              "in addition to wal_dir");
+
 DEFINE_string(truth_db, "/dev/shm/truth_db/dbbench",
               "Truth key/values used when using verify");
 
@@ -910,6 +923,13 @@ DEFINE_string(compression_type, "snappy",
 static enum ROCKSDB_NAMESPACE::CompressionType FLAGS_compression_type_e =
     ROCKSDB_NAMESPACE::kSnappyCompression;
 
+DEFINE_string(compressed_cache_type, "none",
+              "Algorithm to compress blocks that are uncompressed in the "
+              "files with before adding them to the compressed block cache "
+              "(none = such blocks bypass the compressed cache)");
+static enum ROCKSDB_NAMESPACE::CompressionType FLAGS_compressed_cache_type_e =
+    ROCKSDB_NAMESPACE::kNoCompression;
+
 DEFINE_int64(sample_for_compression, 0, "Sample every N block for compression");
 
 DEFINE_int32(compression_level, ROCKSDB_NAMESPACE::CompressionOptions().level,
@@ -1004,6 +1024,11 @@ DEFINE_uint64(delayed_write_rate, 8388608u,
               "Limited bytes allowed to DB when soft_rate_limit or "
               "level0_slowdown_writes_trigger triggers");
 
+DEFINE_bool(feedback_write_rate_control,
+            ROCKSDB_NAMESPACE::Options().feedback_write_rate_control,
+            "Set the delayed write rate continuously from how close the DB "
+            "is to a write stop");
+
 DEFINE_bool(enable_pipelined_write, true,
             "Allow WAL and memtable writes to be pipelined");
 
@@ -1015,6 +1040,11 @@ DEFINE_bool(
 DEFINE_bool(allow_concurrent_memtable_write, true,
             "Allow multi-writers to update mem tables in parallel.");
 
+DEFINE_int32(memtable_insert_threads,
+             ROCKSDB_NAMESPACE::Options().memtable_insert_threads,
+             "Number of threads that insert a single large write batch into "
+             "the memtables.");
+
 DEFINE_bool(inplace_update_support,
             ROCKSDB_NAMESPACE::Options().inplace_update_support,
             "Support in-place memtable update for smaller or same-size values");
@@ -1034,6 +1064,10 @@ DEFINE_uint64(write_thread_slow_yield_usec, 3,
               "The threshold at which a slow yield is considered a signal that "
               "other processes or threads want the core.");
 
+DEFINE_uint64(max_write_group_sync_delay_usec, 0,
+              "Maximum microseconds the leader of a group of sync writes waits "
+              "for more sync writers, 0 to disable.");
+
 DEFINE_int32(rate_limit_delay_max_milliseconds, 1000,
              "When hard_rate_limit is set then this is the max time a put will"
              " be stalled.");
@@ -1169,6 +1203,10 @@ DEFINE_bool(use_direct_io_for_flush_and_compaction,
             ROCKSDB_NAMESPACE::Options().use_direct_io_for_flush_and_compaction,
             "Use O_DIRECT for background flush and compaction writes");
 
+DEFINE_bool(use_direct_io_for_wal,
+            ROCKSDB_NAMESPACE::Options().use_direct_io_for_wal,
+            "Use O_DIRECT for WAL writes");
+
 DEFINE_bool(advise_random_on_open,
             ROCKSDB_NAMESPACE::Options().advise_random_on_open,
             "Advise random access on table file open");
@@ -1278,6 +1316,8 @@ enum RepFactory {
   kVectorRep,
   kHashLinkedList,
   kAVLTree,
+  kBTree,
+  kART,
 };
 
 static enum RepFactory StringToRepFactory(const char* ctype) {
@@ -1293,6 +1333,10 @@ static enum RepFactory StringToRepFactory(const char* ctype) {
     return kHashLinkedList;
   else if (!strcasecmp(ctype, "avltree"))
     return kAVLTree;
+  else if (!strcasecmp(ctype, "btree"))
+    return kBTree;
+  else if (!strcasecmp(ctype, "art"))
+    return kART;
   fprintf(stdout, "Cannot parse memreptable %s\n", ctype);
   return kSkipList;
 }
@@ -2499,6 +2543,12 @@ class Benchmark {
       case kAVLTree:
         fprintf(stdout, "Memtablerep: avltree\n");
         break;
+      case kBTree:
+        fprintf(stdout, "Memtablerep: btree\n");
+        break;
+      case kART:
+        fprintf(stdout, "Memtablerep: art\n");
+        break;
     }
     fprintf(stdout, "Perf Level: %d\n", FLAGS_perf_level);
 
@@ -2640,7 +2690,16 @@ class Benchmark {
     if (capacity <= 0) {
       return nullptr;
     }
-    if (FLAGS_use_clock_cache) {
+    if (FLAGS_use_hyper_clock_cache) {
+      auto cache = NewHyperClockCache(HyperClockCacheOptions(
+          static_cast<size_t>(capacity), static_cast<size_t>(FLAGS_block_size),
+          FLAGS_cache_numshardbits));
+      if (!cache) {
+        fprintf(stderr, "Invalid hyper clock cache options.");
+        exit(1);
+      }
+      return cache;
+    } else if (FLAGS_use_clock_cache) {
       auto cache = NewClockCache(static_cast<size_t>(capacity),
                                  FLAGS_cache_numshardbits);
       if (!cache) {
@@ -3661,6 +3720,7 @@ class Benchmark {
     options.use_direct_reads = FLAGS_use_direct_reads;
     options.use_direct_io_for_flush_and_compaction =
         FLAGS_use_direct_io_for_flush_and_compaction;
+    options.use_direct_io_for_wal = FLAGS_use_direct_io_for_wal;
 #ifndef ROCKSDB_LITE
     options.ttl = FLAGS_fifo_compaction_ttl;
     options.compaction_options_fifo = CompactionOptionsFIFO(
@@ -3728,7 +3788,7 @@ class Benchmark {
         break;
       case kVectorRep:
         options.memtable_factory.reset(
-          new VectorRepFactory
+          new VectorRepFactory(0, 16384, FLAGS_env)
         );
         break;
       case kAVLTree:
@@ -3736,6 +3796,12 @@ class Benchmark {
           NewAVLTreeRepFactory()
         );
         break;
+      case kBTree:
+        options.memtable_factory.reset(NewBTreeRepFactory());
+        break;
+      case kART:
+        options.memtable_factory.reset(NewARTRepFactory());
+        break;
 #else
       default:
         fprintf(stderr, "Only skip list is supported in lite mode\n");
@@ -3854,6 +3920,8 @@ class Benchmark {
       }
       block_based_options.block_cache = cache_;
       block_based_options.block_cache_compressed = compressed_cache_;
+      block_based_options.block_cache_compressed_type =
+          FLAGS_compressed_cache_type_e;
       block_based_options.block_size = FLAGS_block_size;
       block_based_options.block_restart_interval = FLAGS_block_restart_interval;
       block_based_options.index_block_restart_interval =
@@ -3894,6 +3962,8 @@ class Benchmark {
 
           rc_cfg.enable_direct_reads = FLAGS_read_cache_direct_read;
           rc_cfg.enable_direct_writes = FLAGS_read_cache_direct_write;
+          rc_cfg.admit_on_second_access =
+              FLAGS_read_cache_admit_on_second_access;
           rc_cfg.writer_qdepth = 4;
           rc_cfg.writer_dispatch_size = 4 * 1024;
 
@@ -3956,8 +4026,10 @@ class Benchmark {
     options.hard_pending_compaction_bytes_limit =
         FLAGS_hard_pending_compaction_bytes_limit;
     options.delayed_write_rate = FLAGS_delayed_write_rate;
+    options.feedback_write_rate_control = FLAGS_feedback_write_rate_control;
     options.allow_concurrent_memtable_write =
         FLAGS_allow_concurrent_memtable_write;
+    options.memtable_insert_threads = FLAGS_memtable_insert_threads;
     options.inplace_update_support = FLAGS_inplace_update_support;
     options.inplace_update_num_locks = FLAGS_inplace_update_num_locks;
     options.enable_write_thread_adaptive_yield =
@@ -3966,6 +4038,8 @@ class Benchmark {
     options.unordered_write = FLAGS_unordered_write;
     options.write_thread_max_yield_usec = FLAGS_write_thread_max_yield_usec;
     options.write_thread_slow_yield_usec = FLAGS_write_thread_slow_yield_usec;
+    options.max_write_group_sync_delay_usec =
+        FLAGS_max_write_group_sync_delay_usec;
     options.rate_limit_delay_max_milliseconds =
       FLAGS_rate_limit_delay_max_milliseconds;
     options.table_cache_numshardbits = FLAGS_table_cache_numshardbits;
@@ -4038,6 +4112,9 @@ class Benchmark {
     options.create_missing_column_families = FLAGS_num_column_families > 1;
     options.statistics = dbstats;
     options.wal_dir = FLAGS_wal_dir;
+    if (!FLAGS_wal_stripe_dirs.empty()) {
+      options.wal_stripe_dirs = StringSplit(FLAGS_wal_stripe_dirs, ',');
+    }
     options.create_if_missing = !FLAGS_use_existing_db;
     options.dump_malloc_stats = FLAGS_dump_malloc_stats;
     options.stats_dump_period_sec =
@@ -7103,6 +7180,8 @@ int db_bench_tool(int argc, char** argv) {
 
   FLAGS_compression_type_e =
     StringToCompressionType(FLAGS_compression_type.c_str());
+  FLAGS_compressed_cache_type_e =
+      StringToCompressionType(FLAGS_compressed_cache_type.c_str());
 
 #ifndef ROCKSDB_LITE
   FLAGS_blob_db_compression_type_e =
@@ -9,6 +9,7 @@
 #include <sstream>
 #include <thread>
 #include "db/db_impl/db_impl.h"
+#include "db/write_batch_internal.h"
 #include "rocksdb/slice.h"
 #include "rocksdb/write_batch.h"
 #include "util/coding.h"
@@ -76,7 +77,11 @@ Status Tracer::Write(WriteBatch* write_batch) {
   Trace trace;
   trace.ts = env_->NowMicros();
   trace.type = trace_type;
-  trace.payload = write_batch->Data();
+  if (WriteBatchInternal::HasPinnedValues(write_batch)) {
+    WriteBatchInternal::GetMaterializedContents(write_batch, &trace.payload);
+  } else {
+    trace.payload = write_batch->Data();
+  }
   return WriteTrace(trace);
 }
 
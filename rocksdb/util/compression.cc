@@ -0,0 +1,206 @@
+//  Copyright (c) 2011-present, Facebook, Inc.  All rights reserved.
+//  This source code is licensed under both the GPLv2 (found in the
+//  COPYING file in the root directory) and Apache 2.0 License
+//  (found in the LICENSE.Apache file in the root directory).
+//
+
+#include "util/compression.h"
+
+namespace ROCKSDB_NAMESPACE {
+
+namespace {
+
+// Size of the chunks the compressed or decompressed output is produced in.
+const size_t kStreamingChunkSize = 16 << 10;
+
+#ifdef ZLIB
+// Raw deflate, without the zlib header and trailer: the framing of the
+// records already carries a checksum.
+const int kZlibStreamingWindowBits = -15;
+
+class ZlibStreamingCompress : public StreamingCompress {
+ public:
+  explicit ZlibStreamingCompress(const CompressionOptions& opts) {
+    memset(&stream_, 0, sizeof(stream_));
+    int level = opts.level == CompressionOptions::kDefaultCompressionLevel
+                    ? Z_DEFAULT_COMPRESSION
+                    : opts.level;
+    initialized_ = deflateInit2(&stream_, level, Z_DEFLATED,
+                                kZlibStreamingWindowBits, 8,
+                                Z_DEFAULT_STRATEGY) == Z_OK;
+  }
+
+  ~ZlibStreamingCompress() override {
+    if (initialized_) {
+      deflateEnd(&stream_);
+    }
+  }
+
+  Status Compress(const Slice& input, std::string* output) override {
+    if (!initialized_) {
+      return Status::Corruption("zlib deflateInit2 failed");
+    }
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream_.avail_in = static_cast<uInt>(input.size());
+    do {
+      size_t old_size = output->size();
+      output->resize(old_size + kStreamingChunkSize);
+      stream_.next_out = reinterpret_cast<Bytef*>(&(*output)[old_size]);
+      stream_.avail_out = static_cast<uInt>(kStreamingChunkSize);
+      int st = deflate(&stream_, Z_SYNC_FLUSH);
+      output->resize(output->size() - stream_.avail_out);
+      if (st != Z_OK && st != Z_BUF_ERROR) {
+        return Status::Corruption("zlib deflate failed");
+      }
+    } while (stream_.avail_out == 0);
+    assert(stream_.avail_in == 0);
+    return Status::OK();
+  }
+
+ private:
+  z_stream stream_;
+  bool initialized_;
+};
+
+class ZlibStreamingUncompress : public StreamingUncompress {
+ public:
+  ZlibStreamingUncompress() {
+    memset(&stream_, 0, sizeof(stream_));
+    initialized_ = inflateInit2(&stream_, kZlibStreamingWindowBits) == Z_OK;
+  }
+
+  ~ZlibStreamingUncompress() override {
+    if (initialized_) {
+      inflateEnd(&stream_);
+    }
+  }
+
+  Status Uncompress(const Slice& input, std::string* output) override {
+    if (!initialized_) {
+      return Status::Corruption("zlib inflateInit2 failed");
+    }
+    stream_.next_in =
+        reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+    stream_.avail_in = static_cast<uInt>(input.size());
+    do {
+      size_t old_size = output->size();
+      output->resize(old_size + kStreamingChunkSize);
+      stream_.next_out = reinterpret_cast<Bytef*>(&(*output)[old_size]);
+      stream_.avail_out = static_cast<uInt>(kStreamingChunkSize);
+      int st = inflate(&stream_, Z_SYNC_FLUSH);
+      output->resize(output->size() - stream_.avail_out);
+      if (st != Z_OK && st != Z_BUF_ERROR) {
+        return Status::Corruption("zlib inflate failed");
+      }
+    } while (stream_.avail_out == 0);
+    if (stream_.avail_in != 0) {
+      return Status::Corruption("zlib inflate left input behind");
+    }
+    return Status::OK();
+  }
+
+ private:
+  z_stream stream_;
+  bool initialized_;
+};
+#endif  // ZLIB
+
+#if defined(ZSTD) && ZSTD_VERSION_NUMBER >= 10400
+class ZSTDStreamingCompress : public StreamingCompress {
+ public:
+  explicit ZSTDStreamingCompress(const CompressionOptions& opts)
+      : cctx_(ZSTD_createCCtx()) {
+    // 3 is the value of ZSTD_CLEVEL_DEFAULT, see ZSTD_Compress().
+    int level = opts.level == CompressionOptions::kDefaultCompressionLevel
+                    ? 3
+                    : opts.level;
+    ZSTD_CCtx_setParameter(cctx_, ZSTD_c_compressionLevel, level);
+  }
+
+  ~ZSTDStreamingCompress() override { ZSTD_freeCCtx(cctx_); }
+
+  Status Compress(const Slice& input, std::string* output) override {
+    ZSTD_inBuffer in = {input.data(), input.size(), 0};
+    size_t remaining;
+    do {
+      size_t old_size = output->size();
+      output->resize(old_size + kStreamingChunkSize);
+      ZSTD_outBuffer out = {&(*output)[old_size], kStreamingChunkSize, 0};
+      remaining = ZSTD_compressStream2(cctx_, &out, &in, ZSTD_e_flush);
+      output->resize(old_size + out.pos);
+      if (ZSTD_isError(remaining)) {
+        return Status::Corruption(ZSTD_getErrorName(remaining));
+      }
+    } while (remaining != 0);
+    return Status::OK();
+  }
+
+ private:
+  ZSTD_CCtx* cctx_;
+};
+
+class ZSTDStreamingUncompress : public StreamingUncompress {
+ public:
+  ZSTDStreamingUncompress() : dctx_(ZSTD_createDCtx()) {}
+
+  ~ZSTDStreamingUncompress() override { ZSTD_freeDCtx(dctx_); }
+
+  Status Uncompress(const Slice& input, std::string* output) override {
+    ZSTD_inBuffer in = {input.data(), input.size(), 0};
+    bool output_full;
+    do {
+      size_t old_size = output->size();
+      output->resize(old_size + kStreamingChunkSize);
+      ZSTD_outBuffer out = {&(*output)[old_size], kStreamingChunkSize, 0};
+      size_t ret = ZSTD_decompressStream(dctx_, &out, &in);
+      output->resize(old_size + out.pos);
+      if (ZSTD_isError(ret)) {
+        return Status::Corruption(ZSTD_getErrorName(ret));
+      }
+      output_full = out.pos == out.size;
+    } while (in.pos < in.size || output_full);
+    return Status::OK();
+  }
+
+ private:
+  ZSTD_DCtx* dctx_;
+};
+#endif  // ZSTD && ZSTD_VERSION_NUMBER >= 10400
+
+}  // namespace
+
+StreamingCompress* StreamingCompress::Create(CompressionType compression_type,
+                                             const CompressionOptions& opts) {
+  switch (compression_type) {
+#ifdef ZLIB
+    case kZlibCompression:
+      return new ZlibStreamingCompress(opts);
+#endif  // ZLIB
+#if defined(ZSTD) && ZSTD_VERSION_NUMBER >= 10400
+    case kZSTD:
+      return new ZSTDStreamingCompress(opts);
+#endif  // ZSTD && ZSTD_VERSION_NUMBER >= 10400
+    default:
+      (void)opts;
+      return nullptr;
+  }
+}
+
+StreamingUncompress* StreamingUncompress::Create(
+    CompressionType compression_type) {
+  switch (compression_type) {
+#ifdef ZLIB
+    case kZlibCompression:
+      return new ZlibStreamingUncompress();
+#endif  // ZLIB
+#if defined(ZSTD) && ZSTD_VERSION_NUMBER >= 10400
+    case kZSTD:
+      return new ZSTDStreamingUncompress();
+#endif  // ZSTD && ZSTD_VERSION_NUMBER >= 10400
+    default:
+      return nullptr;
+  }
+}
+
+}  // namespace ROCKSDB_NAMESPACE
@@ -1449,4 +1449,59 @@ inline bool CompressData(const Slice& raw,
   return ret;
 }
 
+inline bool ZSTD_Streaming_Supported() {
+#if defined(ZSTD) && ZSTD_VERSION_NUMBER >= 10400  // v1.4.0+
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Returns true if a stream of records can be compressed with the given
+// type by StreamingCompress.
+inline bool StreamingCompressionTypeSupported(
+    CompressionType compression_type) {
+  switch (compression_type) {
+    case kNoCompression:
+      return true;
+    case kZlibCompression:
+      return Zlib_Supported();
+    case kZSTD:
+      return ZSTD_Streaming_Supported();
+    default:
+      return false;
+  }
+}
+
+// Compresses a stream of records with a compression context that persists
+// across records, so that small records that repeat each other compress
+// much better than one by one. Every call to Compress() flushes the
+// stream: the output of a call can be decompressed as soon as the outputs
+// of all the previous calls have been, without waiting for later records.
+class StreamingCompress {
+ public:
+  // Returns nullptr if the type is not supported, see
+  // StreamingCompressionTypeSupported().
+  static StreamingCompress* Create(CompressionType compression_type,
+                                   const CompressionOptions& opts);
+
+  virtual ~StreamingCompress() {}
+
+  // Appends the compressed form of `input` to *output.
+  virtual Status Compress(const Slice& input, std::string* output) = 0;
+};
+
+// Decompresses, in the same order, the outputs of a StreamingCompress.
+class StreamingUncompress {
+ public:
+  // Returns nullptr if the type is not supported.
+  static StreamingUncompress* Create(CompressionType compression_type);
+
+  virtual ~StreamingUncompress() {}
+
+  // Appends the decompressed form of `input`, the output of one
+  // StreamingCompress::Compress() call, to *output.
+  virtual Status Uncompress(const Slice& input, std::string* output) = 0;
+};
+
 }  // namespace ROCKSDB_NAMESPACE
@@ -128,6 +128,12 @@ class BlobDBImpl : public BlobDB {
 
   virtual Status Write(const WriteOptions& opts, WriteBatch* updates) override;
 
+  // Write() may move large values to blob files first.
+  virtual Status WriteAsync(const WriteOptions& opts, WriteBatch* updates,
+                            std::function<void(Status)> callback) override {
+    return DB::WriteAsync(opts, updates, std::move(callback));
+  }
+
   virtual Status Close() override;
 
   using BlobDB::PutWithTTL;
@@ -13,6 +13,7 @@
 #include "logging/logging.h"
 #include "port/port.h"
 #include "test_util/sync_point.h"
+#include "util/hash.h"
 #include "util/stop_watch.h"
 #include "utilities/persistent_cache/block_cache_tier_file.h"
 
@@ -149,6 +150,8 @@ PersistentCache::StatsType BlockCacheTier::Stats() {
       stats_.bytes_read_.Average());
   Add(&stats, "persistentcache.blockcachetier.insert_dropped",
       stats_.insert_dropped_);
+  Add(&stats, "persistentcache.blockcachetier.insert_rejected",
+      stats_.insert_rejected_);
   Add(&stats, "persistentcache.blockcachetier.cache_hits",
       stats_.cache_hits_);
   Add(&stats, "persistentcache.blockcachetier.cache_misses",
@@ -171,8 +174,40 @@ PersistentCache::StatsType BlockCacheTier::Stats() {
   return out;
 }
 
+size_t BlockCacheTier::AdmissionTableSize(const uint64_t cache_size) {
+  size_t n = kMinAdmissionTableSize;
+  while (n < kMaxAdmissionTableSize && n * kAdmissionBlockSize < cache_size) {
+    n *= 2;
+  }
+  return n;
+}
+
+bool BlockCacheTier::Admit(const Slice& key) {
+  if (!admission_table_) {
+    return true;
+  }
+
+  const uint64_t hash = GetSliceNPHash64(key);
+  const uint32_t fingerprint = static_cast<uint32_t>(hash >> 32) | 1;
+  std::atomic<uint32_t>& entry =
+      admission_table_[static_cast<size_t>(hash) & admission_table_mask_];
+  if (entry.load(std::memory_order_relaxed) == fingerprint) {
+    return true;
+  }
+  // Racing inserts of different keys may overwrite each other, which only
+  // delays the admission of one of them
+  entry.store(fingerprint, std::memory_order_relaxed);
+  return false;
+}
+
 Status BlockCacheTier::Insert(const Slice& key, const char* data,
                               const size_t size) {
+  if (!Admit(key)) {
+    // first recent access of the key, remember it but don't write it out
+    stats_.insert_rejected_++;
+    return Status::OK();
+  }
+
   // update stats
   stats_.bytes_pipelined_.Add(size);
 
@@ -224,14 +259,21 @@ Status BlockCacheTier::InsertImpl(const Slice& key, const Slice& data) {
 
   StopWatchNano timer(opt_.env, /*auto_start=*/ true);
 
-  WriteLock _(&lock_);
-
+  // The block index has its own locks, so duplicates can be skipped without
+  // waiting for writes of other keys
   LBA lba;
   if (metadata_.Lookup(key, &lba)) {
     // the key already exists, this is duplicate insert
     return Status::OK();
   }
 
+  WriteLock _(&lock_);
+
+  if (metadata_.Lookup(key, &lba)) {
+    // the key was inserted concurrently
+    return Status::OK();
+  }
+
   while (!cache_file_->Append(key, data, &lba)) {
     if (!cache_file_->Eof()) {
       ROCKS_LOG_DEBUG(opt_.log, "Error inserting to cache file %d",
@@ -302,9 +344,11 @@ Status BlockCacheTier::Lookup(const Slice& key, std::unique_ptr<char[]>* val,
 
   assert(blk_key == key);
 
-  val->reset(new char[blk_val.size()]);
-  memcpy(val->get(), blk_val.data(), blk_val.size());
+  // Hand the read buffer out instead of copying the value into a new one
+  assert(blk_val.data() >= scratch.get());
+  memmove(scratch.get(), blk_val.data(), blk_val.size());
   *size = blk_val.size();
+  val->reset(scratch.release());
 
   stats_.bytes_read_.Add(*size);
   stats_.cache_hits_++;
@@ -395,6 +439,16 @@ Status NewPersistentCache(Env* const env, const std::string& path,
                           const std::shared_ptr<Logger>& log,
                           const bool optimized_for_nvm,
                           std::shared_ptr<PersistentCache>* cache) {
+  return NewPersistentCache(env, path, size, log, optimized_for_nvm,
+                            /*admit_on_second_access=*/false, cache);
+}
+
+Status NewPersistentCache(Env* const env, const std::string& path,
+                          const uint64_t size,
+                          const std::shared_ptr<Logger>& log,
+                          const bool optimized_for_nvm,
+                          const bool admit_on_second_access,
+                          std::shared_ptr<PersistentCache>* cache) {
   if (!cache) {
     return Status::IOError("invalid argument cache");
   }
@@ -408,6 +462,7 @@ Status NewPersistentCache(Env* const env, const std::string& path,
     opt.writer_qdepth = 4;
     opt.writer_dispatch_size = 4 * 1024;
   }
+  opt.admit_on_second_access = admit_on_second_access;
 
   auto pcache = std::make_shared<BlockCacheTier>(opt);
   Status s = pcache->Open();
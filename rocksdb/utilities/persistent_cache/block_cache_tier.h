@@ -49,6 +49,14 @@ class BlockCacheTier : public PersistentCacheTier {
         writer_(this, opt_.writer_qdepth, static_cast<size_t>(opt_.writer_dispatch_size)) {
     Info(opt_.log, "Initializing allocator. size=%d B count=%" ROCKSDB_PRIszt,
          opt_.write_buffer_size, opt_.write_buffer_count());
+    if (opt_.admit_on_second_access) {
+      const size_t n = AdmissionTableSize(opt_.cache_size);
+      admission_table_.reset(new std::atomic<uint32_t>[n]);
+      for (size_t i = 0; i < n; i++) {
+        admission_table_[i].store(0, std::memory_order_relaxed);
+      }
+      admission_table_mask_ = n - 1;
+    }
   }
 
   virtual ~BlockCacheTier() {
@@ -83,6 +91,11 @@ class BlockCacheTier : public PersistentCacheTier {
   static const size_t kEvictPct = 10;
   // Max attempts to insert key, value to cache in pipelined mode
   static const size_t kMaxRetry = 3;
+  // Block size assumed to size the admission table
+  static const size_t kAdmissionBlockSize = 4 * 1024;
+  // Bounds of the number of admission table entries
+  static const size_t kMinAdmissionTableSize = 4 * 1024;
+  static const size_t kMaxAdmissionTableSize = 4 * 1024 * 1024;
 
   // Pipelined operation
   struct InsertOp {
@@ -103,6 +116,12 @@ class BlockCacheTier : public PersistentCacheTier {
     bool signal_ = false;  // signal to request processing thread to exit
   };
 
+  // Returns the number of admission table entries for a cache of cache_size
+  // bytes, a power of two
+  static size_t AdmissionTableSize(uint64_t cache_size);
+  // Returns true if key is to be written to the cache, i.e. if it was
+  // inserted recently before. Otherwise records the key and returns false.
+  bool Admit(const Slice& key);
   // entry point for insert thread
   void InsertMain();
   // insert implementation
@@ -126,6 +145,7 @@ class BlockCacheTier : public PersistentCacheTier {
     std::atomic<uint64_t> cache_misses_{0};
     std::atomic<uint64_t> cache_errors_{0};
     std::atomic<uint64_t> insert_dropped_{0};
+    std::atomic<uint64_t> insert_rejected_{0};
 
     double CacheHitPct() const {
       const auto lookups = cache_hits_ + cache_misses_;
@@ -149,6 +169,10 @@ class BlockCacheTier : public PersistentCacheTier {
   BlockCacheTierMetadata metadata_;             // Cache meta data manager
   std::atomic<uint64_t> size_{0};               // Size of the cache
   Statistics stats_;                                 // Statistics
+  // Fingerprints of keys inserted for the first time recently, indexed by
+  // key hash, for admit_on_second_access. Zero marks an empty entry.
+  std::unique_ptr<std::atomic<uint32_t>[]> admission_table_;
+  size_t admission_table_mask_ = 0;
 };
 
 }  // namespace ROCKSDB_NAMESPACE
@@ -174,6 +174,35 @@ TEST_F(PersistentCacheTierTest, BasicTest) {
   RunInsertTest(/*nthreads=*/1, /*max_keys=*/1024);
 }
 
+TEST_F(PersistentCacheTierTest, BlockCacheAdmitOnSecondAccess) {
+  auto log = std::make_shared<ConsoleLogger>();
+  PersistentCacheConfig opt(Env::Default(), path_,
+                            /*size=*/std::numeric_limits<uint64_t>::max(), log);
+  opt.cache_file_size =
+      static_cast<uint32_t>(12 * 1024 * 1024 * kStressFactor);
+  opt.pipeline_writes = false;
+  opt.admit_on_second_access = true;
+  cache_ = std::make_shared<BlockCacheTier>(opt);
+  ASSERT_OK(cache_->Open());
+
+  const std::string key = "key";
+  const std::string data(1024, 'x');
+  std::unique_ptr<char[]> val;
+  size_t size;
+
+  // The first insert is only remembered
+  ASSERT_OK(cache_->Insert(key, data.data(), data.size()));
+  ASSERT_TRUE(cache_->Lookup(key, &val, &size).IsNotFound());
+
+  // The second one is written to the cache
+  ASSERT_OK(cache_->Insert(key, data.data(), data.size()));
+  ASSERT_OK(cache_->Lookup(key, &val, &size));
+  ASSERT_EQ(data, std::string(val.get(), size));
+
+  ASSERT_OK(cache_->Close());
+  cache_.reset();
+}
+
 // Volatile cache tests
 // DISABLED for now (somewhat expensive)
 TEST_F(PersistentCacheTierTest, DISABLED_VolatileCacheInsert) {
@@ -49,6 +49,9 @@ std::string PersistentCacheConfig::ToString() const {
   ret.append(buffer);
   snprintf(buffer, kBufferSize, "    is_compressed: %d\n", is_compressed);
   ret.append(buffer);
+  snprintf(buffer, kBufferSize, "    admit_on_second_access: %d\n",
+           admit_on_second_access);
+  ret.append(buffer);
 
   return ret;
 }
@@ -217,6 +217,18 @@ struct PersistentCacheConfig {
   // uncompressed mode
   bool is_compressed = true;
 
+  // admit-on-second-access
+  //
+  // If true, a block is only written to the cache when it is inserted for the
+  // second time recently, i.e. after it missed the cache twice. Blocks that
+  // are read just once, e.g. by compactions or scans, then do not evict hot
+  // blocks nor take write bandwidth of the device. Recently seen blocks are
+  // remembered in a fixed size table of key fingerprints, so a block can be
+  // forgotten before its second access
+  //
+  // default: false
+  bool admit_on_second_access = false;
+
   PersistentCacheConfig MakePersistentCacheConfig(
       const std::string& path, const uint64_t size,
       const std::shared_ptr<Logger>& log);
@@ -229,6 +229,14 @@ Status BlockCacheTraceSimulator::InitializeCaches() {
             NewLRUCache(simulate_cache_capacity, config.num_shard_bits,
                         /*strict_capacity_limit=*/false,
                         /*high_pri_pool_ratio=*/0));
+      } else if (cache_name == "lru_tinylfu") {
+        LRUCacheOptions cache_opts(simulate_cache_capacity,
+                                   config.num_shard_bits,
+                                   /*strict_capacity_limit=*/false,
+                                   /*high_pri_pool_ratio=*/0);
+        cache_opts.use_admission_filter = true;
+        sim_cache = std::make_shared<CacheSimulator>(std::move(ghost_cache),
+                                                     NewLRUCache(cache_opts));
       } else if (cache_name == "lru_priority") {
         sim_cache = std::make_shared<PrioritizedCacheSimulator>(
             std::move(ghost_cache),
@@ -75,6 +75,13 @@ Status OptimisticTransactionDB::Open(
   Status s;
   DB* db;
 
+  if (db_options.write_queue_shards > 1) {
+    // Commits are validated with write callbacks, which the other write
+    // queues would race with
+    return Status::InvalidArgument(
+        "OptimisticTransactionDB is incompatible with write_queue_shards > 1");
+  }
+
   std::vector<ColumnFamilyDescriptor> column_families_copy = column_families;
 
   // Enable MemTable History if not already enabled
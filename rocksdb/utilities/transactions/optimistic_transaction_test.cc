@@ -1510,6 +1510,22 @@ TEST_P(OptimisticTransactionTest, SequenceNumberAfterRecoverTest) {
   delete transaction;
 }
 
+// Commits are checked for conflicts by write callbacks, which cannot see the
+// writes of the other write queues.
+TEST_P(OptimisticTransactionTest, WriteQueueShards) {
+  delete txn_db;
+  txn_db = nullptr;
+  options.write_queue_shards = 2;
+  OptimisticTransactionDB* db = nullptr;
+  Status s = OptimisticTransactionDB::Open(options, dbname, &db);
+  ASSERT_TRUE(s.IsInvalidArgument());
+  ASSERT_EQ(nullptr, db);
+
+  options.write_queue_shards = 1;
+  Reopen();
+  ASSERT_OK(txn_db->Put(WriteOptions(), "foo", "bar"));
+}
+
 INSTANTIATE_TEST_CASE_P(
     InstanceOccGroup, OptimisticTransactionTest,
     testing::Values(OccValidationPolicy::kValidateSerial,
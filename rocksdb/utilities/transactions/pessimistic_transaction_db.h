@@ -68,6 +68,14 @@ class PessimisticTransactionDB : public TransactionDB {
 
   using TransactionDB::Write;
   virtual Status Write(const WriteOptions& opts, WriteBatch* updates) override;
+
+  // Write() has to lock the keys of the batch, so the write cannot be handed
+  // to the base DB as is.
+  virtual Status WriteAsync(const WriteOptions& opts, WriteBatch* updates,
+                            std::function<void(Status)> callback) override {
+    return DB::WriteAsync(opts, updates, std::move(callback));
+  }
+
   inline Status WriteWithConcurrencyControl(const WriteOptions& opts,
                                             WriteBatch* updates) {
     // Need to lock all keys in this batch to prevent write conflicts with
@@ -76,6 +76,12 @@ class DBWithTTLImpl : public DBWithTTL {
 
   virtual Status Write(const WriteOptions& opts, WriteBatch* updates) override;
 
+  // Write() has to append the timestamps to the values.
+  virtual Status WriteAsync(const WriteOptions& opts, WriteBatch* updates,
+                            std::function<void(Status)> callback) override {
+    return DB::WriteAsync(opts, updates, std::move(callback));
+  }
+
   using StackableDB::NewIterator;
   virtual Iterator* NewIterator(const ReadOptions& opts,
                                 ColumnFamilyHandle* column_family) override;